@@ -14,6 +14,7 @@ criminal penalties as provided by law.
 #include "login_interface.hpp"
 #include "cstdmf/debug.hpp"
 #include "cstdmf/memory_stream.hpp"
+#include "network/aes_gcm_filter.hpp"
 
 #ifdef WIN32
 #define USE_OPENSSL
@@ -107,3 +108,20 @@ bool LogOnParams::readFromStream( BinaryIStream & data,
 
 	return !data.error();
 }
+
+
+/**
+ *	This method returns the key that the client's channel filter should be
+ *	created from (see Mercury::createChannelFilter). This is the encryption key,
+ *	tagged for AES-GCM if that was agreed to at login.
+ */
+std::string LogOnParams::channelKey() const
+{
+	if (this->wantsAesGcm() &&
+		(encryptionKey_.size() == Mercury::AesGcmFilter::KEY_SIZE))
+	{
+		return Mercury::AesGcmFilter::tagKey( encryptionKey_ );
+	}
+
+	return encryptionKey_;
+}
@@ -99,6 +99,10 @@ public:
 	static const Flags HAS_ALL = 0x1;
 	static const Flags PASS_THRU = 0xFF;
 
+	/// This flag is set by clients that can use an AES-GCM channel filter
+	/// instead of Blowfish. The LoginApp clears it if it does not agree.
+	static const Flags WANTS_AES_GCM = 0x2;
+
 	LogOnParams() :
 		flags_( HAS_ALL )
 	{
@@ -124,6 +128,9 @@ public:
 		Mercury::PublicKeyCipher * pKey = NULL );
 
 	Flags flags() const { return flags_; }
+	void flags( Flags flags ) { flags_ = flags; }
+
+	bool wantsAesGcm() const { return (flags_ & WANTS_AES_GCM) != 0; }
 
 	const std::string & username() const { return username_; }
 	void username( const std::string & username ) { username_ = username; }
@@ -134,6 +141,8 @@ public:
 	const std::string & encryptionKey() const { return encryptionKey_; }
 	void encryptionKey( const std::string & s ) { encryptionKey_ = s; }
 
+	std::string channelKey() const;
+
 	const MD5::Digest & digest() const { return digest_; }
 	void digest( const MD5::Digest & digest ){ digest_ = digest; }
 
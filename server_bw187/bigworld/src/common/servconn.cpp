@@ -310,7 +310,7 @@ BaseAppLoginRequest::BaseAppLoginRequest( LoginHandler & parent ) :
 		*pNub_, pParent_->baseAppAddr(),
 		Mercury::Channel::EXTERNAL,
 		/* minInactivityResendDelay: */ 1.0,
-		servConn.pFilter().getObject() );
+		servConn.pChannelFilter().getObject() );
 
 	// Set the servconn as the bundle primer
 	pChannel_->bundlePrimer( servConn );
@@ -493,7 +493,7 @@ void LoginHandler::onLoginReply( BinaryIStream & data )
 	{
 		// The reply record is symmetrically encrypted.
 		MemoryOStream clearText;
-		pServerConnection_->pFilter()->decryptStream( data, clearText );
+		pServerConnection_->decryptLoginReply( data, clearText );
 		clearText >> replyRecord_;
 
 		// Correct sized reply
@@ -692,6 +692,7 @@ ServerConnection::ServerConnection() :
 	nub_(),
 	pChannel_( NULL ),
 	pFilter_( new Mercury::EncryptionFilter() ),
+	pChannelFilter_( pFilter_.getObject() ),
 	inactivityTimeout_( DEFAULT_INACTIVITY_TIMEOUT ),
 	// see also initialiseConnectionState
 	FIRST_AVATAR_UPDATE_MESSAGE(
@@ -704,6 +705,12 @@ ServerConnection::ServerConnection() :
 	tryToReconfigurePorts_ = false;
 	this->initialiseConnectionState();
 
+#ifdef MERCURY_HAS_AES_GCM
+	// Use the same key, so that the LoginApp can choose either cipher.
+	pAesGcmFilter_ = new Mercury::AesGcmFilter( pFilter_->key(),
+		Mercury::AesGcmFilter::CLIENT, Mercury::AesGcmFilter::BASE_APP );
+#endif
+
 	memset( &digest_, 0, sizeof( digest_ ) );
 	latencyTab_ = new SMA<float>(static_cast<int>(s_updateFrequency_ * 10));
 	for (uint i = 0; i < 256; i++)
@@ -887,6 +894,45 @@ LogOnStatus ServerConnection::logOn( ServerMessageHandler * pHandler,
 }
 
 
+/**
+ *	This method decrypts the reply record from the LoginApp, and chooses the
+ *	filter for the channel to the BaseApp to match. If we asked for AES-GCM,
+ *	the reply only passes its tag check if the LoginApp agreed to it.
+ */
+void ServerConnection::decryptLoginReply( BinaryIStream & data,
+	BinaryOStream & clearText )
+{
+	pChannelFilter_ = pFilter_.getObject();
+
+#ifdef MERCURY_HAS_AES_GCM
+	if (pAesGcmFilter_->isGood())
+	{
+		int size = data.remainingLength();
+		char * pCipherText = (char *)data.retrieve( size );
+
+		MemoryIStream sealedStream( pCipherText, size );
+
+		// The LoginApp seals with a key of its own.
+		Mercury::AesGcmFilter replyFilter( pFilter_->key(),
+			Mercury::AesGcmFilter::CLIENT, Mercury::AesGcmFilter::LOGIN_APP );
+
+		if (replyFilter.decryptStream( sealedStream, clearText ))
+		{
+			pChannelFilter_ = pAesGcmFilter_.getObject();
+			return;
+		}
+
+		// The LoginApp did not agree, so the reply is in Blowfish.
+		MemoryIStream blowfishStream( pCipherText, size );
+		pFilter_->decryptStream( blowfishStream, clearText );
+		return;
+	}
+#endif
+
+	pFilter_->decryptStream( data, clearText );
+}
+
+
 /**
  *	This method begins an asynchronous login
  */
@@ -897,11 +943,6 @@ LoginHandlerPtr ServerConnection::logOnBegin(
 	const char * publicKeyPath,
 	uint16 port )
 {
-	LogOnParamsPtr pParams = new LogOnParams( username, password,
-		pFilter_->key() );
-
-	pParams->digest( this->digest() );
-
 	g_isMainThread = true;
 
 	// make sure we are not already logged on
@@ -914,6 +955,28 @@ LoginHandlerPtr ServerConnection::logOnBegin(
 	// Clean up old state if we have been connected before
 	this->initialiseConnectionState();
 
+	// Each logon gets a new key. The AES-GCM filters on both ends start
+	// their nonces from zero, so reusing a key would reuse (key, nonce) pairs.
+	pFilter_ = new Mercury::EncryptionFilter();
+	pChannelFilter_ = pFilter_.getObject();
+
+#ifdef MERCURY_HAS_AES_GCM
+	pAesGcmFilter_ = new Mercury::AesGcmFilter( pFilter_->key(),
+		Mercury::AesGcmFilter::CLIENT, Mercury::AesGcmFilter::BASE_APP );
+#endif
+
+	LogOnParamsPtr pParams = new LogOnParams( username, password,
+		pFilter_->key() );
+
+	pParams->digest( this->digest() );
+
+#ifdef MERCURY_HAS_AES_GCM
+	if (pAesGcmFilter_->isGood())
+	{
+		pParams->flags( pParams->flags() | LogOnParams::WANTS_AES_GCM );
+	}
+#endif
+
 	TRACE_MSG( "ServerConnection::logOnBegin: "
 		"server:%s username:%s\n", serverName, pParams->username().c_str() );
 
@@ -20,6 +20,7 @@ criminal penalties as provided by law.
 #include "cstdmf/memory_stream.hpp"
 #include "network/channel.hpp"
 #include "network/endpoint.hpp"
+#include "network/aes_gcm_filter.hpp"
 #include "network/encryption_filter.hpp"
 #include "network/public_key_cipher.hpp"
 #include "common/client_interface.hpp"
@@ -431,6 +432,9 @@ public:
 	const Mercury::Address & addr() const;
 
 	Mercury::EncryptionFilterPtr pFilter() { return pFilter_; }
+	Mercury::PacketFilterPtr pChannelFilter() { return pChannelFilter_; }
+
+	void decryptLoginReply( BinaryIStream & data, BinaryOStream & clearText );
 
 	void addMove( ObjectID id, SpaceID spaceID, ObjectID vehicleID,
 		const Vector3 & pos, float yaw, float pitch, float roll,
@@ -682,6 +686,13 @@ private:
 	Mercury::Channel*	pChannel_;
 	Mercury::EncryptionFilterPtr pFilter_;
 
+	// The filter for the channel to the BaseApp. This is pFilter_ unless the
+	// LoginApp agreed to use AES-GCM.
+	Mercury::PacketFilterPtr pChannelFilter_;
+#ifdef MERCURY_HAS_AES_GCM
+	Mercury::AesGcmFilterPtr pAesGcmFilter_;
+#endif
+
 	bool		everReceivedPacket_;
 	bool		tryToReconfigurePorts_;
 	bool		entitiesEnabled_;
@@ -0,0 +1,478 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "base_backup.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/watcher.hpp"
+
+DECLARE_DEBUG_COMPONENT( 0 )
+
+namespace
+{
+/**
+ *	This function returns the 64-bit FNV-1a hash of the given data. A segment
+ *	whose hash does not change is not sent, so the hash needs to be wide
+ *	enough that a collision is practically impossible.
+ */
+uint64 hashSegment( const char * pData, int size )
+{
+	uint64 hash = 14695981039346656037ULL;
+
+	for (int i = 0; i < size; ++i)
+	{
+		hash ^= uint8( pData[i] );
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: BackupSegments
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ */
+BackupSegments::BackupSegments() :
+	stream_( 1024 )
+{
+}
+
+
+/**
+ *	This method clears the segments so that another base can be backed up.
+ */
+void BackupSegments::clear()
+{
+	stream_.reset();
+	ends_.clear();
+}
+
+
+/**
+ *	This method ends the current segment. Anything added to the stream after
+ *	this goes into the next segment.
+ */
+void BackupSegments::endSegment()
+{
+	ends_.push_back( stream_.size() );
+}
+
+
+/**
+ *	This method returns the size of the given segment.
+ */
+int BackupSegments::segmentSize( int i ) const
+{
+	return (i == 0) ? ends_[0] : ends_[i] - ends_[i - 1];
+}
+
+
+/**
+ *	This method returns the data of the given segment.
+ */
+const char * BackupSegments::segmentData( int i ) const
+{
+	const char * pStart = static_cast< const char * >(
+		const_cast< MemoryOStream & >( stream_ ).data() );
+
+	return (i == 0) ? pStart : pStart + ends_[i - 1];
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: BackupDeltaWriter
+// -----------------------------------------------------------------------------
+
+int BackupDeltaWriter::s_fullBackupPeriod = 10;
+BackupDeltaWriter::Stats BackupDeltaWriter::s_current;
+BackupDeltaWriter::Stats BackupDeltaWriter::s_lastCycle;
+
+
+/**
+ *	Constructor.
+ */
+BackupDeltaWriter::BackupDeltaWriter() :
+	dstAddr_( Mercury::Address::NONE ),
+	backupsUntilFull_( 0 ),
+	sequence_( 0 )
+{
+}
+
+
+/**
+ *	This method streams the backup of a base entity. The first backup, and
+ *	every s_fullBackupPeriod backups after that, contain all of the segments.
+ *	The rest only contain the segments that have changed.
+ *
+ *	@param segments	The entity's current backup data.
+ *	@param dstAddr	The address of the BaseApp that the backup is for.
+ *	@param stream	The stream to add the backup to.
+ *
+ *	@return	False if nothing has changed since the last backup, in which case
+ *			nothing is added to the stream and nothing needs to be sent.
+ */
+bool BackupDeltaWriter::write( const BackupSegments & segments,
+		const Mercury::Address & dstAddr, BinaryOStream & stream )
+{
+	int numSegments = segments.numSegments();
+
+	bool isFull = (backupsUntilFull_ <= 0) ||
+		(dstAddr != dstAddr_) ||
+		(numSegments != int( hashes_.size() ));
+
+	int numChanged = 0;
+
+	if (isFull)
+	{
+		hashes_.resize( numSegments );
+	}
+
+	// Work out which segments have changed. The old hashes are kept until the
+	// changed segments have been streamed.
+	static std::vector< uint64 > s_newHashes;
+	s_newHashes.resize( numSegments );
+
+	for (int i = 0; i < numSegments; ++i)
+	{
+		s_newHashes[i] = hashSegment( segments.segmentData( i ),
+				segments.segmentSize( i ) );
+
+		if (isFull || (s_newHashes[i] != hashes_[i]))
+		{
+			++numChanged;
+		}
+	}
+
+	if (numChanged == 0)
+	{
+		--backupsUntilFull_;
+		return false;
+	}
+
+	++sequence_;
+
+	int numBytes = 0;
+
+	if (isFull)
+	{
+		stream << uint8( FULL ) << sequence_ << uint32( numSegments );
+
+		for (int i = 0; i < numSegments; ++i)
+		{
+			int size = segments.segmentSize( i );
+			stream.writeStringLength( size );
+			stream.addBlob( segments.segmentData( i ), size );
+			numBytes += size;
+		}
+
+		dstAddr_ = dstAddr;
+		backupsUntilFull_ = s_fullBackupPeriod;
+		++s_current.numFull;
+	}
+	else
+	{
+		stream << uint8( DELTA ) << sequence_ << uint32( numSegments ) <<
+			uint32( numChanged );
+
+		for (int i = 0; i < numSegments; ++i)
+		{
+			if (s_newHashes[i] != hashes_[i])
+			{
+				int size = segments.segmentSize( i );
+				stream << uint32( i );
+				stream.writeStringLength( size );
+				stream.addBlob( segments.segmentData( i ), size );
+				numBytes += size;
+			}
+		}
+
+		--backupsUntilFull_;
+	}
+
+	for (int i = 0; i < numSegments; ++i)
+	{
+		hashes_[i] = s_newHashes[i];
+	}
+
+	++s_current.numEntities;
+	s_current.numBytes += numBytes;
+
+	return true;
+}
+
+
+/**
+ *	This static method should be called each time all of the bases on this
+ *	BaseApp have been backed up. It keeps the statistics for the cycle that
+ *	has just finished, so that they can be watched.
+ */
+void BackupDeltaWriter::endCycle()
+{
+	s_lastCycle = s_current;
+
+	s_current.numEntities = 0;
+	s_current.numFull = 0;
+	s_current.numBytes = 0;
+}
+
+
+/**
+ *	This static method adds the watchers for base entity backups.
+ */
+void BackupDeltaWriter::addWatchers()
+{
+	MF_WATCH( "backup/fullBackupPeriod", s_fullBackupPeriod,
+		Watcher::WT_READ_WRITE,
+		"The number of backups of an entity between full backups" );
+
+	MF_WATCH( "backup/lastCycle/entities", s_lastCycle.numEntities,
+		Watcher::WT_READ_ONLY,
+		"The number of entities that were sent in the last backup cycle" );
+	MF_WATCH( "backup/lastCycle/fullBackups", s_lastCycle.numFull,
+		Watcher::WT_READ_ONLY,
+		"The number of entities that were sent in full in the last cycle" );
+	MF_WATCH( "backup/lastCycle/bytes", s_lastCycle.numBytes,
+		Watcher::WT_READ_ONLY,
+		"The number of bytes of entity data sent in the last backup cycle" );
+
+	MF_WATCH( "backup/storedBytes", BackedUpEntity::s_totalSize,
+		Watcher::WT_READ_ONLY,
+		"The number of bytes used to store other BaseApps' entities" );
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: BackedUpEntity
+// -----------------------------------------------------------------------------
+
+int BackedUpEntity::s_totalSize = 0;
+
+
+/**
+ *	Constructor.
+ */
+BackedUpEntity::BackedUpEntity() :
+	sequence_( 0 )
+{
+}
+
+
+/**
+ *	Copy constructor.
+ */
+BackedUpEntity::BackedUpEntity( const BackedUpEntity & other ) :
+	data_( other.data_ ),
+	sequence_( other.sequence_ )
+{
+	s_totalSize += this->size();
+}
+
+
+/**
+ *	Destructor.
+ */
+BackedUpEntity::~BackedUpEntity()
+{
+	s_totalSize -= this->size();
+}
+
+
+/**
+ *	Assignment operator.
+ */
+BackedUpEntity & BackedUpEntity::operator=( const BackedUpEntity & other )
+{
+	s_totalSize += other.size() - this->size();
+	data_ = other.data_;
+	sequence_ = other.sequence_;
+
+	return *this;
+}
+
+
+/**
+ *	This method applies a backup that was streamed by BackupDeltaWriter::write.
+ *
+ *	A delta can only be applied on top of the backup that came just before
+ *	it. If one is missing, the delta is ignored and the old data is kept until
+ *	the next full backup arrives.
+ *
+ *	@return	True if the backup was applied, otherwise false.
+ */
+bool BackedUpEntity::apply( BinaryIStream & data )
+{
+	uint8 flags;
+	uint8 sequence;
+	uint32 numSegments;
+	data >> flags >> sequence >> numSegments;
+
+	std::string newData;
+
+	if (flags & BackupDeltaWriter::FULL)
+	{
+		// The header is filled in once the segment sizes are known.
+		newData.resize( (numSegments + 1) * sizeof( uint32 ) );
+
+		uint32 end = 0;
+
+		for (uint32 i = 0; i < numSegments; ++i)
+		{
+			int size = data.readStringLength();
+			const char * pSegment =
+				static_cast< const char * >( data.retrieve( size ) );
+
+			if (data.error())
+			{
+				ERROR_MSG( "BackedUpEntity::apply: Full backup is truncated\n" );
+				return false;
+			}
+
+			newData.append( pSegment, size );
+
+			end += size;
+			memcpy( &newData[ (i + 1) * sizeof( uint32 ) ], &end,
+					sizeof( uint32 ) );
+		}
+
+		memcpy( &newData[0], &numSegments, sizeof( uint32 ) );
+	}
+	else
+	{
+		uint32 numChanged;
+		data >> numChanged;
+
+		if (!this->isValid() ||
+				(sequence != uint8( sequence_ + 1 )) ||
+				(numSegments != this->numSegments()))
+		{
+			WARNING_MSG( "BackedUpEntity::apply: Ignoring a delta that does "
+					"not follow the last backup (sequence %d, expected %d)\n",
+				sequence, uint8( sequence_ + 1 ) );
+			data.finish();
+			return false;
+		}
+
+		newData.reserve( data_.size() + data.remainingLength() );
+		newData.append( data_, 0, (numSegments + 1) * sizeof( uint32 ) );
+
+		uint32 nextIndex = numSegments;
+
+		if (numChanged > 0)
+		{
+			data >> nextIndex;
+		}
+
+		uint32 end = 0;
+
+		for (uint32 i = 0; i < numSegments; ++i)
+		{
+			if ((numChanged > 0) && (i == nextIndex))
+			{
+				int size = data.readStringLength();
+				newData.append(
+					static_cast< const char * >( data.retrieve( size ) ),
+					size );
+				end += size;
+
+				if (--numChanged > 0)
+				{
+					data >> nextIndex;
+				}
+			}
+			else
+			{
+				uint32 start = (i == 0) ? 0 : this->segmentEnd( i - 1 );
+				uint32 size = this->segmentEnd( i ) - start;
+				newData.append( this->segmentData( i ), size );
+				end += size;
+			}
+
+			memcpy( &newData[ (i + 1) * sizeof( uint32 ) ], &end,
+					sizeof( uint32 ) );
+		}
+
+		if (data.error() || (numChanged > 0))
+		{
+			ERROR_MSG( "BackedUpEntity::apply: Delta backup is invalid\n" );
+			return false;
+		}
+	}
+
+	this->setData( newData );
+	sequence_ = sequence;
+
+	return true;
+}
+
+
+/**
+ *	This method adds the entity's data to the stream, in the same form as a
+ *	full backup from Base::backup, so that it can be passed to Base::restore.
+ */
+void BackedUpEntity::addToStream( BinaryOStream & stream ) const
+{
+	if (this->isValid())
+	{
+		uint32 headerSize = (this->numSegments() + 1) * sizeof( uint32 );
+		stream.addBlob( data_.data() + headerSize, data_.size() - headerSize );
+	}
+}
+
+
+/**
+ *	This method returns the number of segments in the stored data.
+ */
+uint32 BackedUpEntity::numSegments() const
+{
+	uint32 numSegments;
+	memcpy( &numSegments, data_.data(), sizeof( uint32 ) );
+	return numSegments;
+}
+
+
+/**
+ *	This method returns the offset of the end of the given segment, from the
+ *	start of the first segment.
+ */
+uint32 BackedUpEntity::segmentEnd( uint32 i ) const
+{
+	uint32 end;
+	memcpy( &end, data_.data() + (i + 1) * sizeof( uint32 ), sizeof( uint32 ) );
+	return end;
+}
+
+
+/**
+ *	This method returns the start of the given segment's data.
+ */
+const char * BackedUpEntity::segmentData( uint32 i ) const
+{
+	uint32 start = (i == 0) ? 0 : this->segmentEnd( i - 1 );
+	return data_.data() + (this->numSegments() + 1) * sizeof( uint32 ) + start;
+}
+
+
+/**
+ *	This method replaces the stored data. The argument is left holding the old
+ *	data.
+ */
+void BackedUpEntity::setData( std::string & newData )
+{
+	s_totalSize += int( newData.size() ) - this->size();
+	data_.swap( newData );
+}
+
+// base_backup.cpp
@@ -0,0 +1,172 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef BASE_BACKUP_HPP
+#define BASE_BACKUP_HPP
+
+#include "cstdmf/memory_stream.hpp"
+#include "cstdmf/stdmf.hpp"
+#include "network/basictypes.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ *	This class holds a base entity's backup data, split into segments.
+ *
+ *	Base::backup streams the state that is not a property as the first
+ *	segment, then each of its base properties as a segment of its own. The
+ *	segments joined together are the same as a full backup stream, so
+ *	Base::restore does not need to know about them.
+ *
+ *	One instance is reused for every base that is backed up, so that its
+ *	buffers are only allocated once.
+ */
+class BackupSegments
+{
+public:
+	BackupSegments();
+
+	void clear();
+
+	/**
+	 *	Return the stream that the current segment should be added to.
+	 */
+	BinaryOStream & stream()				{ return stream_; }
+
+	void endSegment();
+
+	int numSegments() const					{ return int( ends_.size() ); }
+	int segmentSize( int i ) const;
+	const char * segmentData( int i ) const;
+
+private:
+	MemoryOStream		stream_;
+	std::vector< int >	ends_;
+};
+
+
+/**
+ *	This class decides what is sent when a base entity is backed up.
+ *
+ *	It keeps a hash of each segment that was last sent. Only the segments
+ *	whose hash has changed are sent, unless a full backup is due. A full
+ *	backup is sent every s_fullBackupPeriod backups, when the backup BaseApp
+ *	changes, and when the number of segments changes.
+ */
+class BackupDeltaWriter
+{
+public:
+	/**
+	 *	The flags at the start of each backup.
+	 */
+	enum
+	{
+		FULL = 0x1,
+		DELTA = 0x2
+	};
+
+	BackupDeltaWriter();
+
+	bool write( const BackupSegments & segments,
+			const Mercury::Address & dstAddr, BinaryOStream & stream );
+
+	/**
+	 *	This method makes the next backup a full one.
+	 */
+	void forceFullBackup()					{ backupsUntilFull_ = 0; }
+
+	static int fullBackupPeriod()			{ return s_fullBackupPeriod; }
+	static void fullBackupPeriod( int value )
+	{
+		s_fullBackupPeriod = value;
+	}
+
+	static void endCycle();
+	static void addWatchers();
+
+private:
+	/**
+	 *	This structure holds the backup statistics for this BaseApp.
+	 */
+	struct Stats
+	{
+		uint32	numEntities;
+		uint32	numFull;
+		uint32	numBytes;
+	};
+
+	std::vector< uint64 >	hashes_;
+	Mercury::Address		dstAddr_;
+	int						backupsUntilFull_;
+	uint8					sequence_;
+
+	static int		s_fullBackupPeriod;
+
+	static Stats	s_current;
+	static Stats	s_lastCycle;
+};
+
+
+/**
+ *	This class is the backup of a single base entity that is stored on behalf
+ *	of another BaseApp.
+ *
+ *	All of the data is kept in a single string. It starts with the number of
+ *	segments and the offset of the end of each segment, followed by the
+ *	segments themselves. Applying a delta rebuilds the string.
+ */
+class BackedUpEntity
+{
+public:
+	BackedUpEntity();
+	BackedUpEntity( const BackedUpEntity & other );
+	~BackedUpEntity();
+
+	BackedUpEntity & operator=( const BackedUpEntity & other );
+
+	bool apply( BinaryIStream & data );
+
+	void addToStream( BinaryOStream & stream ) const;
+
+	/**
+	 *	Return whether a full backup has been received for this entity.
+	 */
+	bool isValid() const					{ return !data_.empty(); }
+
+	/**
+	 *	Return the number of bytes used to store this entity.
+	 */
+	int size() const						{ return int( data_.size() ); }
+
+	/**
+	 *	Return the number of bytes used to store all of the entities that this
+	 *	BaseApp is backing up.
+	 */
+	static int totalSize()					{ return s_totalSize; }
+
+private:
+	uint32 numSegments() const;
+	uint32 segmentEnd( uint32 i ) const;
+	const char * segmentData( uint32 i ) const;
+
+	void setData( std::string & newData );
+
+	std::string		data_;
+	uint8			sequence_;
+
+	static int		s_totalSize;
+
+	friend class BackupDeltaWriter;
+};
+
+#endif // BASE_BACKUP_HPP
@@ -21,6 +21,9 @@ criminal penalties as provided by law.
 #include "server/common.hpp"
 #include "cstdmf/profile.hpp"
 #include "cstdmf/time_queue.hpp"
+#ifdef USE_TIMING_WHEEL
+#include "cstdmf/timing_wheel.hpp"
+#endif
 
 #include "baseappmgr/baseappmgr_interface.hpp"
 #include "server/backup_hash.hpp"
@@ -270,7 +273,12 @@ public:
 	CellEntityMailBoxPtr findMailBoxInSpace( SpaceID spaceID );
 
 	TimeStamp time() const			{ return time_; }
-	TimeQueue & timeQueue()			{ return timeQueue_; }
+#ifdef USE_TIMING_WHEEL
+	typedef TimingWheel AppTimeQueue;
+#else
+	typedef TimeQueue AppTimeQueue;
+#endif
+	AppTimeQueue & timeQueue()		{ return timeQueue_; }
 	int updateHertz() const			{ return updateHertz_; }
 	float inactivityTimeout() const	{ return inactivityTimeout_; }
 	int clientOverflowLimit() const	{ return clientOverflowLimit_; }
@@ -393,7 +401,7 @@ private:
 	TimeStamp		time_;
 	TimeStamp		shutDownTime_;
 	Mercury::ReplyID	shutDownReplyID_;
-	TimeQueue		timeQueue_;
+	AppTimeQueue	timeQueue_;
 	int				updateHertz_;
 	TimeKeeper *	pTimeKeeper_;
 	int				gameTimerID_;
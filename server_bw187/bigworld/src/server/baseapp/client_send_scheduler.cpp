@@ -0,0 +1,447 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "client_send_scheduler.hpp"
+
+#include "network/interface_element.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/timestamp.hpp"
+#include "cstdmf/watcher.hpp"
+
+DECLARE_DEBUG_COMPONENT( 0 )
+
+namespace
+{
+/// The weighting given to each new sample in the average queueing delays.
+const double DELAY_AVERAGE_BIAS = 0.01;
+
+class WatcherIniter
+{
+public:
+	WatcherIniter()
+	{
+		ClientSendScheduler::addWatchers();
+	}
+};
+
+WatcherIniter s_watcherIniter_;
+}
+
+int ClientSendScheduler::s_defaultBytesPerTick = 2000;
+int ClientSendScheduler::s_maxQueueTicks = 10;
+ClientSendScheduler::ClassStats
+	ClientSendScheduler::s_stats[ ClientSendScheduler::NUM_CLASSES ];
+
+
+/**
+ *	Constructor.
+ */
+ClientSendScheduler::ClientSendScheduler() :
+	pCurrent_( NULL ),
+	currentClass_( MOVEMENT ),
+	bytesPerTick_( s_defaultBytesPerTick ),
+	budget_( 0 ),
+	numFlushes_( 0 )
+{
+	for (int i = 0; i < NUM_CLASSES; ++i)
+	{
+		numQueued_[i] = 0;
+		queuedBytes_[i] = 0;
+	}
+}
+
+
+/**
+ *	Destructor.
+ */
+ClientSendScheduler::~ClientSendScheduler()
+{
+	this->clear();
+}
+
+
+/**
+ *	This method starts a message to the client. The message's arguments should
+ *	be streamed onto the returned stream. It goes onto the client's bundle the
+ *	next time flush is called, if there is room in the budget.
+ *
+ *	@param messageClass	The priority class of the message.
+ *	@param id			The entity that the message is about, or NULL_ENTITY.
+ *						Messages about the same entity are sent in the order
+ *						that they were started, whatever their class.
+ *	@param ie			The interface element of the message.
+ *	@param reliable		Whether the message is reliable.
+ */
+BinaryOStream & ClientSendScheduler::startMessage( MessageClass messageClass,
+	EntityID id, const Mercury::InterfaceElement & ie,
+	Mercury::ReliableType reliable )
+{
+	MF_ASSERT( 0 <= messageClass && messageClass < NUM_CLASSES );
+
+	this->closeMessage();
+
+	pCurrent_ = new PendingMessage( messageClass, id, ie, reliable );
+	pCurrent_->queueTime = timestamp();
+	pCurrent_->queueTick = numFlushes_;
+	currentClass_ = messageClass;
+
+	queues_[ messageClass ].push_back( pCurrent_ );
+	++numQueued_[ messageClass ];
+
+	if (id != NULL_ENTITY)
+	{
+		EntityMessagesMap::iterator iter = entityMessages_.find( id );
+
+		if (iter == entityMessages_.end())
+		{
+			EntityMessages & messages = entityMessages_[ id ];
+			messages.pFirst = pCurrent_;
+			messages.pLast = pCurrent_;
+		}
+		else
+		{
+			iter->second.pLast->pNextForEntity = pCurrent_;
+			iter->second.pLast = pCurrent_;
+		}
+	}
+
+	return pCurrent_->data;
+}
+
+
+/**
+ *	This method finishes the accounting for the message that was last started.
+ */
+void ClientSendScheduler::closeMessage()
+{
+	if (pCurrent_ == NULL)
+	{
+		return;
+	}
+
+	int size = pCurrent_->data.size();
+
+	queuedBytes_[ currentClass_ ] += size;
+
+	ClassStats & stats = s_stats[ currentClass_ ];
+	++stats.numMessagesQueued;
+	stats.numBytesQueued += size;
+
+	pCurrent_ = NULL;
+}
+
+
+/**
+ *	This method moves as many queued messages onto the bundle as this tick's
+ *	budget allows. Messages that have waited for maxQueueTicks go first,
+ *	oldest first, and then the rest go highest priority class first. It
+ *	should be called once per tick, before the bundle is sent.
+ *
+ *	@return	The number of bytes that were added to the bundle.
+ */
+int ClientSendScheduler::flush( Mercury::Bundle & bundle )
+{
+	this->closeMessage();
+
+	++numFlushes_;
+
+	// Any deficit from the last tick is carried over, but unused budget is
+	// not, so that an idle client cannot save up for a burst.
+	budget_ = std::min( budget_, 0 ) + bytesPerTick_;
+
+	int startBudget = budget_;
+	uint64 now = timestamp();
+
+	while (budget_ > 0)
+	{
+		PendingMessage * pMessage = this->oldestAged();
+
+		if (pMessage == NULL)
+		{
+			break;
+		}
+
+		this->send( bundle, *pMessage, now );
+	}
+
+	for (int i = 0; i < NUM_CLASSES && budget_ > 0; ++i)
+	{
+		PendingMessage * pMessage;
+
+		while (budget_ > 0 &&
+				(pMessage = this->front( MessageClass( i ) )) != NULL)
+		{
+			this->send( bundle, *pMessage, now );
+		}
+	}
+
+	// Free the messages that went early, with an entity's earlier message.
+	for (int i = 0; i < NUM_CLASSES; ++i)
+	{
+		this->front( MessageClass( i ) );
+	}
+
+	return startBudget - budget_;
+}
+
+
+/**
+ *	This method returns the first unsent message of the given class, or NULL
+ *	if there is none. Messages at the front of the queue that have already
+ *	been sent are freed.
+ */
+ClientSendScheduler::PendingMessage * ClientSendScheduler::front(
+	MessageClass messageClass )
+{
+	Queue & queue = queues_[ messageClass ];
+
+	while (!queue.empty() && queue.front()->isSent)
+	{
+		delete queue.front();
+		queue.pop_front();
+	}
+
+	return queue.empty() ? NULL : queue.front();
+}
+
+
+/**
+ *	This method returns the oldest unsent message that has been queued for at
+ *	least maxQueueTicks flushes, or NULL if there is none. Of messages queued
+ *	in the same tick, the one of the highest class is returned.
+ */
+ClientSendScheduler::PendingMessage * ClientSendScheduler::oldestAged()
+{
+	PendingMessage * pOldest = NULL;
+
+	for (int i = 0; i < NUM_CLASSES; ++i)
+	{
+		PendingMessage * pMessage = this->front( MessageClass( i ) );
+
+		if ((pMessage == NULL) ||
+				(int( numFlushes_ - pMessage->queueTick ) < s_maxQueueTicks))
+		{
+			continue;
+		}
+
+		if ((pOldest == NULL) || (pMessage->queueTick < pOldest->queueTick))
+		{
+			pOldest = pMessage;
+		}
+	}
+
+	return pOldest;
+}
+
+
+/**
+ *	This method sends the given message, after every message about the same
+ *	entity that was started before it. Those may be of lower classes, and
+ *	are sent even if they take the budget further into deficit.
+ */
+void ClientSendScheduler::send( Mercury::Bundle & bundle,
+	PendingMessage & message, uint64 now )
+{
+	if (message.id != NULL_ENTITY)
+	{
+		EntityMessagesMap::iterator iter = entityMessages_.find( message.id );
+		MF_ASSERT( iter != entityMessages_.end() );
+
+		PendingMessage * pEarlier = iter->second.pFirst;
+
+		while (pEarlier != &message)
+		{
+			this->addToBundle( bundle, *pEarlier, now );
+			pEarlier = pEarlier->pNextForEntity;
+		}
+
+		if (message.pNextForEntity != NULL)
+		{
+			iter->second.pFirst = message.pNextForEntity;
+		}
+		else
+		{
+			entityMessages_.erase( iter );
+		}
+	}
+
+	this->addToBundle( bundle, message, now );
+}
+
+
+/**
+ *	This method streams the given message onto the bundle and marks it as
+ *	sent. It is freed when it reaches the front of its class queue.
+ */
+void ClientSendScheduler::addToBundle( Mercury::Bundle & bundle,
+	PendingMessage & message, uint64 now )
+{
+	int size = message.data.size();
+
+	bundle.startMessage( *message.pIE, message.reliable );
+	bundle.addBlob( message.data.retrieve( size ), size );
+
+	budget_ -= size;
+	--numQueued_[ message.messageClass ];
+	queuedBytes_[ message.messageClass ] -= size;
+
+	onSent( message.messageClass, size, now - message.queueTime );
+
+	message.isSent = true;
+}
+
+
+/**
+ *	This method throws away all queued messages. It is used when the client
+ *	goes away.
+ */
+void ClientSendScheduler::clear()
+{
+	this->closeMessage();
+
+	for (int i = 0; i < NUM_CLASSES; ++i)
+	{
+		Queue & queue = queues_[i];
+
+		s_stats[i].numMessagesQueued -= numQueued_[i];
+		s_stats[i].numBytesQueued -= queuedBytes_[i];
+
+		while (!queue.empty())
+		{
+			delete queue.front();
+			queue.pop_front();
+		}
+
+		numQueued_[i] = 0;
+		queuedBytes_[i] = 0;
+	}
+
+	entityMessages_.clear();
+	budget_ = 0;
+}
+
+
+/**
+ *	This method returns whether there are no messages waiting to be sent.
+ */
+bool ClientSendScheduler::isEmpty() const
+{
+	for (int i = 0; i < NUM_CLASSES; ++i)
+	{
+		if (numQueued_[i] != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ *	This method returns the number of messages of the given class that are
+ *	waiting to be sent.
+ */
+int ClientSendScheduler::numQueuedMessages( MessageClass messageClass ) const
+{
+	return numQueued_[ messageClass ];
+}
+
+
+/**
+ *	This method returns the number of bytes of the given class that are waiting
+ *	to be sent. This does not include a message that is still being streamed.
+ */
+int ClientSendScheduler::numQueuedBytes( MessageClass messageClass ) const
+{
+	return queuedBytes_[ messageClass ];
+}
+
+
+/**
+ *	This static method updates the statistics for a message that has just gone
+ *	onto a bundle.
+ */
+void ClientSendScheduler::onSent( MessageClass messageClass, int size,
+	uint64 delay )
+{
+	ClassStats & stats = s_stats[ messageClass ];
+
+	double delayInSeconds = double( delay ) / stampsPerSecondD();
+
+	stats.averageDelay = (1.0 - DELAY_AVERAGE_BIAS) * stats.averageDelay +
+		DELAY_AVERAGE_BIAS * delayInSeconds;
+	stats.maxDelay = std::max( stats.maxDelay, delayInSeconds );
+
+	++stats.numMessagesSent;
+	stats.numBytesSent += size;
+	--stats.numMessagesQueued;
+	stats.numBytesQueued -= size;
+}
+
+
+/**
+ *	This static method returns the name of a class of message.
+ */
+const char * ClientSendScheduler::className( MessageClass messageClass )
+{
+	switch (messageClass)
+	{
+		case MOVEMENT:	return "movement";
+		case PROPERTY:	return "property";
+		case METHOD:	return "method";
+		case BULK:		return "bulk";
+		default:		return "unknown";
+	}
+}
+
+
+/**
+ *	This static method adds the watchers for the scheduler. The statistics are
+ *	summed over all of the clients on this BaseApp.
+ */
+void ClientSendScheduler::addWatchers()
+{
+	MF_WATCH( "clientScheduler/defaultBytesPerTick", s_defaultBytesPerTick,
+		Watcher::WT_READ_WRITE,
+		"The number of bytes that each client may be sent per tick" );
+	MF_WATCH( "clientScheduler/maxQueueTicks", s_maxQueueTicks,
+		Watcher::WT_READ_WRITE,
+		"The number of ticks after which a message is sent ahead of higher "
+		"priority classes" );
+
+	for (int i = 0; i < NUM_CLASSES; ++i)
+	{
+		std::string path =
+			std::string( "clientScheduler/" ) +
+			className( MessageClass( i ) ) + "/";
+
+		ClassStats & stats = s_stats[i];
+
+		MF_WATCH( (path + "averageDelay").c_str(), stats.averageDelay,
+			Watcher::WT_READ_ONLY,
+			"The average time in seconds that messages are queued for" );
+		MF_WATCH( (path + "maxDelay").c_str(), stats.maxDelay,
+			Watcher::WT_READ_WRITE,
+			"The longest time in seconds that a message has been queued for" );
+		MF_WATCH( (path + "messagesSent").c_str(), stats.numMessagesSent,
+			Watcher::WT_READ_ONLY );
+		MF_WATCH( (path + "bytesSent").c_str(), stats.numBytesSent,
+			Watcher::WT_READ_ONLY );
+		MF_WATCH( (path + "messagesQueued").c_str(), stats.numMessagesQueued,
+			Watcher::WT_READ_ONLY );
+		MF_WATCH( (path + "bytesQueued").c_str(), stats.numBytesQueued,
+			Watcher::WT_READ_ONLY );
+	}
+}
+
+// client_send_scheduler.cpp
@@ -0,0 +1,186 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef CLIENT_SEND_SCHEDULER_HPP
+#define CLIENT_SEND_SCHEDULER_HPP
+
+#include "network/basictypes.hpp"
+#include "network/bundle.hpp"
+#include "cstdmf/memory_stream.hpp"
+
+#include <deque>
+#include <map>
+
+namespace Mercury
+{
+class InterfaceElement;
+}
+
+
+/**
+ *	This class schedules the messages that a Proxy sends to its client.
+ *
+ *	Messages are queued by class instead of being streamed straight onto the
+ *	client channel's bundle. Once per tick, flush moves them onto the bundle
+ *	in priority order, so that position updates never wait behind property
+ *	data, and property data never waits behind a resource download.
+ *
+ *	Priority never reorders the messages about one entity. A message that is
+ *	about to be sent first takes along every message about the same entity
+ *	that was started before it, whatever their class, so the client never
+ *	sees an entity's properties or position before the message that creates
+ *	it.
+ *
+ *	A message that has been queued for maxQueueTicks flushes is sent before
+ *	any younger message, oldest first, so a busy client still gets its lower
+ *	classes at a bounded delay.
+ *
+ *	Each client has a budget of bytes per tick. Unused budget is not carried
+ *	to the next tick, but an overrun is: the message that crosses the budget
+ *	is still sent, and the deficit is taken off the next tick's budget.
+ *	Anything that does not fit stays queued for a later tick.
+ */
+class ClientSendScheduler
+{
+public:
+	/**
+	 *	The classes of message, from highest priority to lowest.
+	 */
+	enum MessageClass
+	{
+		MOVEMENT,
+		PROPERTY,
+		METHOD,
+		BULK,
+		NUM_CLASSES
+	};
+
+	ClientSendScheduler();
+	~ClientSendScheduler();
+
+	BinaryOStream & startMessage( MessageClass messageClass, EntityID id,
+		const Mercury::InterfaceElement & ie,
+		Mercury::ReliableType reliable = Mercury::RELIABLE_DRIVER );
+
+	int flush( Mercury::Bundle & bundle );
+	void clear();
+
+	bool isEmpty() const;
+	int numQueuedMessages( MessageClass messageClass ) const;
+	int numQueuedBytes( MessageClass messageClass ) const;
+
+	int bytesPerTick() const			{ return bytesPerTick_; }
+	void bytesPerTick( int value )		{ bytesPerTick_ = value; }
+
+	int deficit() const					{ return std::max( -budget_, 0 ); }
+
+	static int defaultBytesPerTick()	{ return s_defaultBytesPerTick; }
+	static void defaultBytesPerTick( int value )
+	{
+		s_defaultBytesPerTick = value;
+	}
+
+	static int maxQueueTicks()			{ return s_maxQueueTicks; }
+	static void maxQueueTicks( int value )	{ s_maxQueueTicks = value; }
+
+	static const char * className( MessageClass messageClass );
+
+	static void addWatchers();
+
+private:
+	/**
+	 *	This structure is a message that is waiting to go onto the bundle.
+	 */
+	struct PendingMessage
+	{
+		PendingMessage( MessageClass messageClass, EntityID id,
+				const Mercury::InterfaceElement & ie,
+				Mercury::ReliableType reliable ) :
+			messageClass( messageClass ),
+			id( id ),
+			pIE( &ie ),
+			reliable( reliable ),
+			queueTime( 0 ),
+			queueTick( 0 ),
+			pNextForEntity( NULL ),
+			isSent( false )
+		{}
+
+		MessageClass						messageClass;
+		EntityID							id;
+		const Mercury::InterfaceElement *	pIE;
+		Mercury::ReliableType				reliable;
+		MemoryOStream						data;
+		uint64								queueTime;
+		uint32								queueTick;
+
+		/// The next message about the same entity, in the order started.
+		PendingMessage *					pNextForEntity;
+
+		/// Whether this has gone onto a bundle ahead of its class queue.
+		bool								isSent;
+	};
+
+	typedef std::deque< PendingMessage * > Queue;
+
+	/**
+	 *	This structure is the list of the unsent messages about one entity.
+	 */
+	struct EntityMessages
+	{
+		PendingMessage *	pFirst;
+		PendingMessage *	pLast;
+	};
+
+	typedef std::map< EntityID, EntityMessages > EntityMessagesMap;
+
+	/**
+	 *	This structure holds the statistics for a class of message, summed over
+	 *	every client on this BaseApp.
+	 */
+	struct ClassStats
+	{
+		double	averageDelay;
+		double	maxDelay;
+		uint32	numMessagesSent;
+		uint32	numBytesSent;
+		int		numMessagesQueued;
+		int		numBytesQueued;
+	};
+
+	void closeMessage();
+	PendingMessage * front( MessageClass messageClass );
+	PendingMessage * oldestAged();
+	void send( Mercury::Bundle & bundle, PendingMessage & message,
+		uint64 now );
+	void addToBundle( Mercury::Bundle & bundle, PendingMessage & message,
+		uint64 now );
+	static void onSent( MessageClass messageClass, int size, uint64 delay );
+
+	Queue			queues_[ NUM_CLASSES ];
+	int				numQueued_[ NUM_CLASSES ];
+	int				queuedBytes_[ NUM_CLASSES ];
+
+	EntityMessagesMap	entityMessages_;
+
+	PendingMessage *	pCurrent_;
+	MessageClass		currentClass_;
+
+	int				bytesPerTick_;
+	int				budget_;
+	uint32			numFlushes_;
+
+	static int			s_defaultBytesPerTick;
+	static int			s_maxQueueTicks;
+	static ClassStats	s_stats[ NUM_CLASSES ];
+};
+
+#endif // CLIENT_SEND_SCHEDULER_HPP
@@ -306,6 +306,8 @@ private:
 	Mercury::Channel *	pClientChannel_;
 	ClientBundlePrimer	clientBundlePrimer_;
 
+	/// The key for the client channel's filter. This comes from
+	/// LogOnParams::channelKey, so pass it to Mercury::createChannelFilter.
 	std::string			encryptionKey_;
 	SessionKey			sessionKey_;
 
@@ -385,12 +387,11 @@ private:
 
 	public: // From RateLimitMessageFilter::Callback
 
-		virtual BufferedMessage * createBufferedMessage(
-			const Mercury::UnpackedMessageHeader & header,
-			BinaryIStream & data, Mercury::InputMessageHandler * pHandler );
+		virtual void dispatchBuffered( const Mercury::Address & srcAddr,
+			BufferedMessage & message );
 
 		virtual void onFilterLimitsExceeded( const Mercury::Address & srcAddr,
-			BufferedMessage * pMessage );
+			BufferedMessage & message );
 
 	private:
 		Proxy * pProxy_;
@@ -398,39 +399,6 @@ private:
 	};
 
 
-	/**
-	 *	A buffered message for a proxy from a client.
-	 */
-	class ProxyBufferedMessage : public BufferedMessage
-	{
-	public:
-		/**
-		 * 	Constructor.
-		 *
-		 * 	@param header 		the message header
-		 * 	@param data 		the message data
-		 * 	@param pHandler 	the destination input message handler instance
-		 * 	@parma callback 	the associated proxy's RateLimitCallback object
-		 */
-		ProxyBufferedMessage( const Mercury::UnpackedMessageHeader & header,
-					BinaryIStream & data,
-					Mercury::InputMessageHandler * pHandler ):
-				BufferedMessage( header, data, pHandler )
-		{}
-
-		/**
-		 *	Destructor.
-		 */
-		virtual ~ProxyBufferedMessage() {}
-
-	public: // overridden from BufferedMessage
-
-		virtual void dispatch( RateLimitMessageFilter::Callback * pCallback,
-			const Mercury::Address & srcAddr );
-
-	};
-
-
 	/**
 	 *	Pass ownership of the rate limiter and its associated callback object
 	 *	to this proxy.
@@ -443,6 +411,7 @@ private:
 		if (pRateLimiter_)
 		{
 			pRateLimiter_->setCallback( &rateLimitCallback_ );
+			pRateLimiter_->addMethodLimits( this->pType()->description() );
 		}
 	}
 
@@ -0,0 +1,542 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "rate_limit_message_filter.hpp"
+
+#include "entitydef/entity_description.hpp"
+#include "entitydef/method_description.hpp"
+
+#include "network/interfaces.hpp"
+
+#include "cstdmf/debug.hpp"
+
+DECLARE_DEBUG_COMPONENT( 0 )
+
+#ifndef CODE_INLINE
+#include "rate_limit_message_filter.ipp"
+#endif
+
+namespace
+{
+/// The size of the ring if maxMessagesBuffered is not set.
+const uint DEFAULT_RING_SIZE = 256;
+
+/// The bits of a message id that mark it as a call to an exposed method on
+/// the base or the cell. The rest of the id is the method's exposed index.
+const Mercury::MessageID BASE_METHOD_MESSAGE = 0xc0;
+const Mercury::MessageID CELL_METHOD_MESSAGE = 0x80;
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: RateLimitConfig
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor. All limits start off disabled.
+ */
+RateLimitConfig::RateLimitConfig() :
+	warnMessagesPerTick( 0 ),
+	maxMessagesPerTick( 0 ),
+	warnBytesPerTick( 0 ),
+	maxBytesPerTick( 0 ),
+	warnMessagesBuffered( 0 ),
+	maxMessagesBuffered( 0 ),
+	warnBytesBuffered( 0 ),
+	maxBytesBuffered( 0 ),
+	maxMessagesBurst( 0 ),
+	maxBytesBurst( 0 )
+{
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: RateLimitMessageFilter
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ *
+ *	@param config 	The limits for this filter.
+ *	@param addr 	The address of the client that this filter is for.
+ */
+RateLimitMessageFilter::RateLimitMessageFilter( const RateLimitConfig & config,
+		const Mercury::Address & addr ):
+	config_( config ),
+	pCallback_( NULL ),
+	addr_( addr ),
+	warnFlags_( 0 ),
+	numReceivedSinceLastTick_( 0 ),
+	receivedBytesSinceLastTick_( 0 ),
+	messageBucket_( float( config.maxMessagesPerTick ),
+		float( config.maxMessagesBurst ) ),
+	byteBucket_( float( config.maxBytesPerTick ),
+		float( config.maxBytesBurst ) ),
+	messageBuckets_(),
+	ring_( config.maxMessagesBuffered ?
+		config.maxMessagesBuffered : DEFAULT_RING_SIZE ),
+	ringHead_( 0 ),
+	numBuffered_( 0 ),
+	sumBufferedSizes_( 0 ),
+	numDropped_( 0 )
+{
+}
+
+
+/**
+ *	Destructor.
+ */
+RateLimitMessageFilter::~RateLimitMessageFilter()
+{
+	while (numBuffered_ > 0)
+	{
+		if (pCallback_)
+		{
+			pCallback_->onMessageDeleted( this->front() );
+		}
+
+		this->pop_front();
+	}
+}
+
+
+/**
+ *	This method filters a message from the client. It is dispatched straight
+ *	away if the client is within its limits and nothing is already buffered,
+ *	and buffered otherwise.
+ */
+void RateLimitMessageFilter::filterMessage( const Mercury::Address & srcAddr,
+		Mercury::UnpackedMessageHeader & header,
+		BinaryIStream & data,
+		Mercury::InputMessageHandler * pHandler )
+{
+	++numReceivedSinceLastTick_;
+	receivedBytesSinceLastTick_ += header.length;
+
+	this->checkReceiveWarnings();
+
+	TokenBucket * pMessageBucket = this->findMessageBucket( header.identifier );
+
+	if (pMessageBucket)
+	{
+		if (!pMessageBucket->hasTokens())
+		{
+			++numDropped_;
+
+			// Only warn once a tick, since a client that is over its limit
+			// usually keeps sending.
+			if (!(warnFlags_ & WARN_MESSAGE_DROPPED))
+			{
+				WARNING_MSG( "RateLimitMessageFilter::filterMessage( %s ): "
+						"Dropping message %d, which is over its own limit "
+						"(%u dropped so far)\n",
+					addr_.c_str(), int( header.identifier ), numDropped_ );
+				warnFlags_ |= WARN_MESSAGE_DROPPED;
+			}
+
+			data.finish();
+			return;
+		}
+
+		pMessageBucket->take( 1.f );
+	}
+
+	if ((numBuffered_ == 0) && this->canSendNow())
+	{
+		this->takeTokens( header.length );
+		this->dispatch( header, data, pHandler );
+	}
+	else if (!this->buffer( header, data, pHandler ))
+	{
+		data.finish();
+	}
+}
+
+
+/**
+ *	This method is called once per tick. It refills the buckets and replays as
+ *	many buffered messages as they allow.
+ */
+void RateLimitMessageFilter::tick()
+{
+	messageBucket_.tick();
+	byteBucket_.tick();
+
+	for (MessageBuckets::iterator iter = messageBuckets_.begin();
+			iter != messageBuckets_.end(); ++iter)
+	{
+		iter->second.tick();
+	}
+
+	numReceivedSinceLastTick_ = 0;
+	receivedBytesSinceLastTick_ = 0;
+	warnFlags_ &=
+		~(WARN_MESSAGE_COUNT | WARN_MESSAGE_SIZE | WARN_MESSAGE_DROPPED);
+
+	this->replayAny();
+}
+
+
+/**
+ *	This method limits how often the client can send the given message.
+ *
+ *	@param messageID 	The id of the message to limit.
+ *	@param perTick 		The number of these messages allowed per tick. This can
+ *						be fractional.
+ *	@param burst 		The number of these messages allowed at once.
+ */
+void RateLimitMessageFilter::setMessageLimit( Mercury::MessageID messageID,
+	float perTick, float burst )
+{
+	MessageBuckets::iterator iter = messageBuckets_.find( messageID );
+
+	// Exposed methods that share a sub-slotted id share the strictest limit.
+	if ((iter != messageBuckets_.end()) &&
+			(iter->second.ratePerTick() <= perTick))
+	{
+		return;
+	}
+
+	messageBuckets_[ messageID ] = TokenBucket( perTick, burst );
+}
+
+
+/**
+ *	This method adds the limits for the exposed methods of the given entity
+ *	type that have a <RateLimit> section in their definition.
+ */
+void RateLimitMessageFilter::addMethodLimits(
+		const EntityDescription & description )
+{
+	typedef EntityDescription::MethodList MethodList;
+
+	const MethodList & baseMethods = description.base().internalMethods();
+
+	for (MethodList::const_iterator iter = baseMethods.begin();
+			iter != baseMethods.end(); ++iter)
+	{
+		if (iter->isExposed() && iter->hasRateLimit())
+		{
+			this->setMessageLimit(
+				Mercury::MessageID( BASE_METHOD_MESSAGE | iter->exposedIndex() ),
+				iter->rateLimitPerTick(), iter->rateLimitBurst() );
+		}
+	}
+
+	const MethodList & cellMethods = description.cell().internalMethods();
+
+	for (MethodList::const_iterator iter = cellMethods.begin();
+			iter != cellMethods.end(); ++iter)
+	{
+		if (iter->isExposed() && iter->hasRateLimit())
+		{
+			this->setMessageLimit(
+				Mercury::MessageID( CELL_METHOD_MESSAGE | iter->exposedIndex() ),
+				iter->rateLimitPerTick(), iter->rateLimitBurst() );
+		}
+	}
+}
+
+
+/**
+ *	This method replays buffered messages, oldest first, until the buffer is
+ *	empty or the client is out of tokens.
+ */
+void RateLimitMessageFilter::replayAny()
+{
+	// Dispatching may cause the proxy, and so this filter, to be destroyed.
+	RateLimitMessageFilterPtr pThis = this;
+
+	while ((numBuffered_ > 0) && this->canSendNow())
+	{
+		BufferedMessage & message = this->front();
+
+		this->takeTokens( message.size() );
+		this->dispatch( message );
+		this->pop_front();
+
+		if (this->refCount() == 1)
+		{
+			// Only we are left holding the filter.
+			break;
+		}
+	}
+}
+
+
+/**
+ *	This method returns whether the client has tokens left in its buckets.
+ */
+bool RateLimitMessageFilter::canSendNow()
+{
+	return messageBucket_.hasTokens() && byteBucket_.hasTokens();
+}
+
+
+/**
+ *	This method takes the tokens for a message from the client's buckets.
+ */
+void RateLimitMessageFilter::takeTokens( uint dataLen )
+{
+	messageBucket_.take( 1.f );
+	byteBucket_.take( float( dataLen ) );
+}
+
+
+/**
+ *	This method returns the bucket for the given message id, or NULL if it is
+ *	not limited individually.
+ */
+TokenBucket * RateLimitMessageFilter::findMessageBucket(
+		Mercury::MessageID messageID )
+{
+	if (messageBuckets_.empty())
+	{
+		return NULL;
+	}
+
+	MessageBuckets::iterator iter = messageBuckets_.find( messageID );
+
+	return (iter != messageBuckets_.end()) ? &iter->second : NULL;
+}
+
+
+/**
+ *	This method returns the oldest buffered message. The buffer must not be
+ *	empty.
+ */
+BufferedMessage & RateLimitMessageFilter::front()
+{
+	MF_ASSERT( numBuffered_ > 0 );
+	return ring_[ ringHead_ ];
+}
+
+
+/**
+ *	This method removes the oldest buffered message.
+ */
+void RateLimitMessageFilter::pop_front()
+{
+	BufferedMessage & message = this->front();
+
+	sumBufferedSizes_ -= message.size();
+	message.clear();
+
+	ringHead_ = (ringHead_ + 1) % ring_.size();
+	--numBuffered_;
+
+	if (numBuffered_ < config_.warnMessagesBuffered)
+	{
+		warnFlags_ &= ~WARN_MESSAGE_BUFFERED;
+	}
+
+	if (sumBufferedSizes_ < config_.warnBytesBuffered)
+	{
+		warnFlags_ &= ~WARN_BYTES_BUFFERED;
+	}
+}
+
+
+/**
+ *	This method dispatches a message that is not buffered.
+ */
+void RateLimitMessageFilter::dispatch( Mercury::UnpackedMessageHeader & header,
+		BinaryIStream & data, Mercury::InputMessageHandler * pHandler )
+{
+	pHandler->handleMessage( addr_, header, data );
+}
+
+
+/**
+ *	This method dispatches a buffered message.
+ */
+void RateLimitMessageFilter::dispatch( BufferedMessage & message )
+{
+	if (pCallback_)
+	{
+		pCallback_->dispatchBuffered( addr_, message );
+	}
+	else
+	{
+		message.dispatch( addr_ );
+	}
+}
+
+
+/**
+ *	This method adds a message to the end of the ring.
+ *
+ *	@return	false if the buffer limits were exceeded, in which case the message
+ *			was not buffered.
+ */
+bool RateLimitMessageFilter::buffer(
+		const Mercury::UnpackedMessageHeader & header,
+		BinaryIStream & data, Mercury::InputMessageHandler * pHandler )
+{
+	uint dataLen = uint( header.length );
+
+	if ((numBuffered_ >= ring_.size()) ||
+		(config_.maxBytesBuffered &&
+			(sumBufferedSizes_ + dataLen > config_.maxBytesBuffered)))
+	{
+		if (pCallback_)
+		{
+			BufferedMessage rejected;
+			rejected.set( header, data, pHandler );
+			pCallback_->onFilterLimitsExceeded( addr_, rejected );
+		}
+
+		return false;
+	}
+
+	BufferedMessage & message =
+		ring_[ (ringHead_ + numBuffered_) % ring_.size() ];
+	message.set( header, data, pHandler );
+
+	++numBuffered_;
+	sumBufferedSizes_ += dataLen;
+
+	if (config_.warnMessagesBuffered &&
+		(numBuffered_ >= config_.warnMessagesBuffered) &&
+		!(warnFlags_ & WARN_MESSAGE_BUFFERED))
+	{
+		WARNING_MSG( "RateLimitMessageFilter::buffer( %s ): "
+				"%u messages buffered\n",
+			addr_.c_str(), numBuffered_ );
+		warnFlags_ |= WARN_MESSAGE_BUFFERED;
+	}
+
+	if (config_.warnBytesBuffered &&
+		(sumBufferedSizes_ >= config_.warnBytesBuffered) &&
+		!(warnFlags_ & WARN_BYTES_BUFFERED))
+	{
+		WARNING_MSG( "RateLimitMessageFilter::buffer( %s ): "
+				"%u bytes buffered\n",
+			addr_.c_str(), sumBufferedSizes_ );
+		warnFlags_ |= WARN_BYTES_BUFFERED;
+	}
+
+	return true;
+}
+
+
+/**
+ *	This method warns, once per tick, if the client has sent more than the
+ *	warning limits.
+ */
+void RateLimitMessageFilter::checkReceiveWarnings()
+{
+	if (config_.warnMessagesPerTick &&
+		(numReceivedSinceLastTick_ > config_.warnMessagesPerTick) &&
+		!(warnFlags_ & WARN_MESSAGE_COUNT))
+	{
+		WARNING_MSG( "RateLimitMessageFilter::filterMessage( %s ): "
+				"Client sent %u messages this tick\n",
+			addr_.c_str(), numReceivedSinceLastTick_ );
+		warnFlags_ |= WARN_MESSAGE_COUNT;
+	}
+
+	if (config_.warnBytesPerTick &&
+		(receivedBytesSinceLastTick_ > config_.warnBytesPerTick) &&
+		!(warnFlags_ & WARN_MESSAGE_SIZE))
+	{
+		WARNING_MSG( "RateLimitMessageFilter::filterMessage( %s ): "
+				"Client sent %u bytes this tick\n",
+			addr_.c_str(), receivedBytesSinceLastTick_ );
+		warnFlags_ |= WARN_MESSAGE_SIZE;
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: BufferedMessage
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor. The message starts off empty.
+ */
+BufferedMessage::BufferedMessage() :
+	header_(),
+	pPacket_( NULL ),
+	pData_( NULL ),
+	copy_(),
+	pHandler_( NULL )
+{
+}
+
+
+/**
+ *	This method stores a message. The data is read off the stream. If it all
+ *	lies in one packet, a reference to the packet is kept instead of a copy.
+ *
+ *	@param header 		The message header.
+ *	@param data 		The message data stream.
+ *	@param pHandler 	The destination message handler.
+ */
+void BufferedMessage::set( const Mercury::UnpackedMessageHeader & header,
+		BinaryIStream & data, Mercury::InputMessageHandler * pHandler )
+{
+	int length = data.remainingLength();
+	const char * pData = (const char *)data.retrieve( length );
+
+	header_ = header;
+	header_.length = length;
+	pHandler_ = pHandler;
+
+	Mercury::Packet * pPacket = header.pPacket;
+
+	if (pPacket &&
+		(pPacket->data() <= pData) &&
+		(pData + length <= pPacket->data() + pPacket->totalSize()))
+	{
+		pPacket_ = pPacket;
+		pData_ = pData;
+	}
+	else
+	{
+		// The string keeps its capacity, so this slot only allocates when it
+		// sees a bigger message than before.
+		copy_.assign( pData, length );
+		pPacket_ = NULL;
+		pData_ = copy_.data();
+	}
+
+	header_.pPacket = pPacket_.getObject();
+}
+
+
+/**
+ *	This method releases the message's data.
+ */
+void BufferedMessage::clear()
+{
+	pPacket_ = NULL;
+	pData_ = NULL;
+	pHandler_ = NULL;
+	header_.pPacket = NULL;
+	header_.length = 0;
+}
+
+
+/**
+ *	This method passes the message to its handler.
+ *
+ *	@param srcAddr 		The source address of the message. This is passed
+ *						down from the per-address rate limiting filter.
+ */
+void BufferedMessage::dispatch( const Mercury::Address & srcAddr )
+{
+	MemoryIStream data( const_cast< char * >( pData_ ), header_.length );
+
+	pHandler_->handleMessage( srcAddr, header_, data );
+}
+
+// rate_limit_message_filter.cpp
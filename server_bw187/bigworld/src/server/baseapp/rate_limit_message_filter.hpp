@@ -18,14 +18,26 @@ criminal penalties as provided by law.
 #include "cstdmf/smartpointer.hpp"
 #include "cstdmf/memory_stream.hpp"
 
-#include <queue>
+#include <map>
+#include <string>
+#include <vector>
+
+class EntityDescription;
 
 /**
  *	This struct holds configuration parameters for the rate-limiting message
  *	filter.
+ *
+ *	The maxMessagesPerTick and maxBytesPerTick limits are the rates at which a
+ *	client's token buckets are refilled. The buckets can hold up to
+ *	maxMessagesBurst and maxBytesBurst, so that a client that has been quiet
+ *	can send a short burst. If a burst size is 0, the bucket holds one tick's
+ *	worth. A limit of 0 means no limit.
  */
 struct RateLimitConfig
 {
+	RateLimitConfig();
+
 	uint warnMessagesPerTick;
 	uint maxMessagesPerTick;
 	uint warnBytesPerTick;
@@ -34,8 +46,40 @@ struct RateLimitConfig
 	uint maxMessagesBuffered;
 	uint warnBytesBuffered;
 	uint maxBytesBuffered;
+	uint maxMessagesBurst;
+	uint maxBytesBurst;
+};
+
+
+/**
+ *	This class is a token bucket. It is refilled at a fixed rate each tick, up
+ *	to its capacity, and each thing that passes through takes tokens out.
+ *
+ *	Taking is allowed while there are any tokens left, so a message that is
+ *	bigger than the bucket still gets through eventually. The bucket then goes
+ *	into deficit, which is paid back before anything else can pass.
+ */
+class TokenBucket
+{
+public:
+	TokenBucket( float ratePerTick = 0.f, float capacity = 0.f );
+
+	void tick();
+
+	bool isLimited() const		{ return ratePerTick_ > 0.f; }
+	bool hasTokens() const		{ return !this->isLimited() || (tokens_ > 0.f); }
+	void take( float amount )	{ tokens_ -= amount; }
+
+	float tokens() const		{ return tokens_; }
+	float ratePerTick() const	{ return ratePerTick_; }
+
+private:
+	float ratePerTick_;
+	float capacity_;
+	float tokens_;
 };
 
+
 class BufferedMessage;
 
 
@@ -43,6 +87,16 @@ class BufferedMessage;
  *	All messages from external clients get passed through an instance of this
  *	class. It is responsible for enforcing rate limits on client messages,
  *	buffering and playing back messages when limits are no longer exceeded.
+ *
+ *	Each client has a token bucket for messages and one for bytes. Messages
+ *	that arrive while either is empty are buffered in a fixed size ring, and
+ *	replayed in order as the buckets refill each tick.
+ *
+ *	Messages can also be limited individually, by message id. This is used for
+ *	exposed methods that have a <RateLimit> in their entity definition. A
+ *	message that arrives while its own bucket is empty is dropped instead of
+ *	being buffered, so that a client calling one method too often does not
+ *	hold up its other messages.
  */
 class RateLimitMessageFilter : public Mercury::MessageFilter
 {
@@ -51,8 +105,8 @@ public:
 
 	/**
 	 *	Callback interface for customising the behaviour of the filter. There
-	 *	are hook methods for when messages are buffered, when they are
-	 *	dispatched, and when the filter limits are exceeded.
+	 *	are hook methods for when buffered messages are dispatched, and when
+	 *	the filter limits are exceeded.
 	 */
 	class Callback
 	{
@@ -65,19 +119,17 @@ public:
 		{}
 
 
-		virtual BufferedMessage * createBufferedMessage(
-			const Mercury::UnpackedMessageHeader & header,
-			BinaryIStream & data,
-			Mercury::InputMessageHandler * pHandler );
+		virtual void dispatchBuffered( const Mercury::Address & srcAddr,
+			BufferedMessage & message );
 
 
 		/**
 		 *	Callback for when a buffered message has been deleted from the
 		 *	buffer, and not dispatched.
 		 *
-		 *	@param pMessage 	The buffered message.
+		 *	@param message	 	The buffered message.
 		 */
-		virtual void onMessageDeleted( BufferedMessage * pMessage )
+		virtual void onMessageDeleted( BufferedMessage & message )
 		{}
 
 
@@ -85,10 +137,10 @@ public:
 		 *	Callback for when the buffer limit has been exceeded, such that we
 		 *	cannot buffer any more messages.
 		 *
-		 *	@param pMessage		The offending message that was to be buffered.
+		 *	@param message		The offending message that was to be buffered.
 		 */
 		virtual void onFilterLimitsExceeded( const Mercury::Address & srcAddr,
-			BufferedMessage * pMessage )
+			BufferedMessage & message )
 		{}
 	};
 
@@ -110,6 +162,10 @@ public:
 
 	void tick();
 
+	void setMessageLimit( Mercury::MessageID messageID, float perTick,
+		float burst );
+	void addMethodLimits( const EntityDescription & description );
+
 
 	/**
 	 *	Get the address associated with this filter.
@@ -121,6 +177,17 @@ public:
 	 */
 	void setCallback( Callback * pCallback ) { pCallback_ = pCallback; }
 
+	/**
+	 *	Return the number of messages waiting to be replayed.
+	 */
+	uint numBuffered() const { return numBuffered_; }
+
+	/**
+	 *	Return the number of messages that have been dropped because their
+	 *	own limit was exceeded.
+	 */
+	uint numDropped() const { return numDropped_; }
+
 	// Accessors for limits
 
 	/**
@@ -131,9 +198,8 @@ public:
 	{ return config_.warnMessagesPerTick; }
 
 	/**
-	 *	Return the hard maximum limit for the number of messages received per
-	 *	tick period. Messages that are received above this limit are attempted
-	 *	to be buffered.
+	 *	Return the rate, in messages per tick, at which the client's message
+	 *	bucket is refilled. Messages received while it is empty are buffered.
 	 */
 	uint maxMessagesPerTick() const
 	{ return config_.maxMessagesPerTick; }
@@ -146,9 +212,8 @@ public:
 	{ return config_.warnBytesPerTick; }
 
 	/**
-	 *	Return the hard maximum limit for the number of bytes received per
-	 *	tick period. Messages that are received above this limit are attempted
-	 *	to be buffered.
+	 *	Return the rate, in bytes per tick, at which the client's byte bucket
+	 *	is refilled. Messages received while it is empty are buffered.
 	 */
 	uint maxBytesPerTick() const
 	{ return config_.maxBytesPerTick; }
@@ -160,9 +225,9 @@ public:
 	{ return config_.warnMessagesBuffered; }
 
 	/**
-	 *	Return the hard maximum limit for the number of messages buffered. If a
-	 *	message is received, and is attempted to be buffered, the method
-	 *	Callback::onFilterLimitsExceeded() is called.
+	 *	Return the hard maximum limit for the number of messages buffered. This
+	 *	is the size of the ring. If a message is received, and is attempted to
+	 *	be buffered, the method Callback::onFilterLimitsExceeded() is called.
 	 */
 	uint maxMessagesBuffered() const
 	{ return config_.maxMessagesBuffered; }
@@ -186,25 +251,23 @@ private:
 
 	void replayAny();
 
-	bool canSendNow( uint dataLen );
-
-
-	/**
-	 *	Return the BufferedMessage at the front of the buffered message queue,
-	 *	or NULL if the queue is empty.
-	 */
-	BufferedMessage * front()
-	{ return queue_.empty() ? NULL : queue_.front(); }
+	bool canSendNow();
+	void takeTokens( uint dataLen );
 
+	TokenBucket * findMessageBucket( Mercury::MessageID messageID );
 
+	BufferedMessage & front();
 	void pop_front();
 
 	void dispatch( Mercury::UnpackedMessageHeader & header,
 		BinaryIStream & data, Mercury::InputMessageHandler * pHandler );
 
-	void dispatch( BufferedMessage * pMessage );
+	void dispatch( BufferedMessage & message );
 
-	bool buffer( BufferedMessage * pMsg );
+	bool buffer( const Mercury::UnpackedMessageHeader & header,
+		BinaryIStream & data, Mercury::InputMessageHandler * pHandler );
+
+	void checkReceiveWarnings();
 
 
 private:
@@ -229,11 +292,21 @@ private:
 	 *	the warning limit.
 	 */
 	static const uint8 WARN_BYTES_BUFFERED 		= 0x08;
+	/**
+	 *	Warn bit flag constant for when a message has been dropped this tick
+	 *	because its own limit was exceeded.
+	 */
+	static const uint8 WARN_MESSAGE_DROPPED 	= 0x10;
+
+	/**
+	 *	The ring of buffered messages. Its slots are allocated once and reused.
+	 */
+	typedef std::vector< BufferedMessage > Ring;
 
 	/**
-	 *	Message queue data type.
+	 *	The buckets for individually limited messages, by message id.
 	 */
-	typedef std::queue< BufferedMessage * > MsgQueue;
+	typedef std::map< Mercury::MessageID, TokenBucket > MessageBuckets;
 
 	// The configuration structure.
 	RateLimitConfig		config_;
@@ -256,83 +329,57 @@ private:
 	// last ticked.
 	uint 				receivedBytesSinceLastTick_;
 
-	// The number of dispatches since we were last ticked.
-	uint 				numDispatchedSinceLastTick_;
+	// The buckets that limit all of the client's messages.
+	TokenBucket			messageBucket_;
+	TokenBucket			byteBucket_;
 
-	// The total size of the dispatched messages since we were last ticked.
-	uint 				dispatchedBytesSinceLastTick_;
+	MessageBuckets		messageBuckets_;
 
-	// The buffer message queue.
-	MsgQueue			queue_;
+	// The buffered messages. The oldest is at ringHead_.
+	Ring				ring_;
+	uint				ringHead_;
+	uint				numBuffered_;
 
-	// This is always the sum of all the messages in queue_.
+	// This is always the sum of all the messages in the ring.
 	uint				sumBufferedSizes_;
 
+	uint				numDropped_;
 };
 
 typedef SmartPointer< RateLimitMessageFilter > RateLimitMessageFilterPtr;
 
 /**
  *	This class is a buffered message instance, and stores the header, data
- *	stream and the destination message handler for deferred playback.
+ *	and the destination message handler for deferred playback.
+ *
+ *	The data is not copied if it all lies in one received packet. Instead, the
+ *	message keeps a reference to that packet. Otherwise, the data is copied
+ *	into a buffer that is kept with the ring slot and reused.
  *
  *	Note that the source address is not stored, as RateLimitMessageFilters are
  *	per-address already, and it supplies that source address to the dispatch
  *	method.
- *
- *	Application code can derive from BufferedMessage for associating their own
- *	state and/or overriding the dispatch method for doing any custom actions.
- *	They can override RateLimitMessageFilter::Callback::createBufferedMessage()
- *	in order to have the filter create instances of different derived classes.
  */
 class BufferedMessage
 {
 public:
-	/**
-	 *	Constructor.
-	 *
-	 *	@param header 		The message header.
-	 *	@param data 		The message data stream.
-	 *	@param pHandler 	The destination message handler.
-	 */
-	BufferedMessage( const Mercury::UnpackedMessageHeader & header,
-				BinaryIStream & data,
-				Mercury::InputMessageHandler * pHandler ):
-			header_( header ),
-			data_( data.remainingLength() ),
-			pHandler_( pHandler )
-	{
-		data_.transfer( data, data.remainingLength() );
-	}
+	BufferedMessage();
 
+	void set( const Mercury::UnpackedMessageHeader & header,
+		BinaryIStream & data, Mercury::InputMessageHandler * pHandler );
+	void clear();
 
-	/**
-	 *	Destructor.
-	 */
-	virtual ~BufferedMessage()
-	{}
-
+	void dispatch( const Mercury::Address & srcAddr );
 
 	/**
-	 *	Dispatch a buffered message. Subclasses of BufferedMessage can override
-	 *	this method to supply custom functionality.
-	 *
-	 *	@param pCallback 	The filter's callback object.
-	 *	@param srcAddr 		The source address of the message. This is passed
-	 *						down from the per-address rate limiting filter.
+	 *	Return the data size of the message.
 	 */
-	virtual void dispatch( RateLimitMessageFilter::Callback * /*pCallback*/,
-			const Mercury::Address & srcAddr )
-	{
-		this->pHandler()->handleMessage( srcAddr, this->header(),
-			this->data() );
-	}
+	uint size() const 						{ return header_.length; }
 
 	/**
-	 *	Return the data size of the message. Note that calling this after the
-	 *	message has been dispatched will not return the original data size.
+	 *	Return whether the data is held by reference to its packet.
 	 */
-	uint size() const 						{ return data_.remainingLength(); }
+	bool isZeroCopy() const					{ return pPacket_ != NULL; }
 
 
 	/**
@@ -346,24 +393,23 @@ public:
 	 */
 	Mercury::UnpackedMessageHeader & header()	{ return header_; }
 
-protected:
-	/**
-	 *	Return the message data stream.
-	 */
-	BinaryIStream & data() 						{ return data_; }
-
 	/**
 	 *	Return the message's destination handler.
 	 */
 	Mercury::InputMessageHandler * pHandler() 	{ return pHandler_; }
 
-
 private:
 	// The message header.
 	Mercury::UnpackedMessageHeader 	header_;
 
-	// The message data.
-	MemoryOStream 					data_;
+	// The packet that holds the data, if the data is not in copy_.
+	Mercury::PacketPtr				pPacket_;
+
+	// The start of the message data.
+	const char *					pData_;
+
+	// The message data, if it was spread over more than one packet.
+	std::string						copy_;
 
 	// The destination handler for this message.
 	Mercury::InputMessageHandler * 	pHandler_;
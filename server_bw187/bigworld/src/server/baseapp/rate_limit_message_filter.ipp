@@ -16,21 +16,42 @@ criminal penalties as provided by law.
 #endif
 
 /**
- *	Creates a new BufferedMessage instance when buffering.
- *	Override this method to supply derived instances of
- *	BufferedMessage.
+ *	Dispatches a message from the buffer. Override this method to do any
+ *	custom actions when buffered messages are played back.
  *
- *	@param header 		the message header
- *	@param data 		the message data stream
- *	@param pHandler 	the destination message handler
+ *	@param srcAddr 		the source address of the message
+ *	@param message 		the buffered message
  */
 INLINE
-BufferedMessage * RateLimitMessageFilter::Callback::createBufferedMessage(
-		const Mercury::UnpackedMessageHeader & header,
-		BinaryIStream & data,
-		Mercury::InputMessageHandler * pHandler )
+void RateLimitMessageFilter::Callback::dispatchBuffered(
+		const Mercury::Address & srcAddr, BufferedMessage & message )
 {
-	return new BufferedMessage( header, data, pHandler );
+	message.dispatch( srcAddr );
+}
+
+
+/**
+ *	Constructor.
+ *
+ *	@param ratePerTick 	The number of tokens added each tick. If this is 0,
+ *						the bucket does not limit anything.
+ *	@param capacity 	The most tokens that the bucket can hold.
+ */
+INLINE
+TokenBucket::TokenBucket( float ratePerTick, float capacity ) :
+	ratePerTick_( ratePerTick ),
+	capacity_( std::max( capacity, ratePerTick ) ),
+	tokens_( capacity_ )
+{}
+
+
+/**
+ *	Refills the bucket for a new tick.
+ */
+INLINE
+void TokenBucket::tick()
+{
+	tokens_ = std::min( tokens_ + ratePerTick_, capacity_ );
 }
 
 // rate_limit_message_filter.ipp
@@ -28,6 +28,8 @@ BaseApp::BaseApp( const Mercury::Address & intAddr,
 	externalAddr_( extAddr ),
 	id_( id ),
 	load_( 0.f ),
+	pendingLoad_( 0.f ),
+	numPendingCreates_( 0 ),
 	numBases_( 0 ),
 	numProxies_( 0 ),
 	pBackup_( NULL )
@@ -37,13 +39,15 @@ BaseApp::BaseApp( const Mercury::Address & intAddr,
 
 
 /**
- *	This method estimates the cost of adding an entity to the BaseApp.
+ *	This method estimates the cost of adding an entity to the BaseApp. The
+ *	estimate is added to the last load that the BaseApp reported, until it
+ *	next reports its load.
  */
 void BaseApp::addEntity()
 {
-	// TODO: Make this configurable and consider having different costs for
-	// different entity types.
-	load_ =+ 0.01f;
+	// TODO: Consider having different costs for different entity types.
+	pendingLoad_ += BaseAppMgr::instance().createLoadCost();
+	++numPendingCreates_;
 }
 
 
@@ -65,6 +69,11 @@ Watcher * BaseApp::makeWatcher()
 		&pNullBaseApp->externalAddr_ );
 	pWatchCacheVal->addChild( "load", new DataWatcher<float>(
 		pNullBaseApp->load_, Watcher::WT_READ_ONLY ) );
+	pWatchCacheVal->addChild( "pendingLoad", new DataWatcher<float>(
+		pNullBaseApp->pendingLoad_, Watcher::WT_READ_ONLY ) );
+	pWatchCacheVal->addChild( "numPendingCreates",
+		new DataWatcher<int>( pNullBaseApp->numPendingCreates_,
+			Watcher::WT_READ_ONLY ) );
 	pWatchCacheVal->addChild( "numBases",
 		new DataWatcher<int>( pNullBaseApp->numBases_,
 			Watcher::WT_READ_ONLY ) );
@@ -26,11 +26,21 @@ public:
 
 	float load() const { return load_; }
 
+	/**
+	 *	This method returns the load that this BaseApp is expected to have,
+	 *	once the entities that have been sent to it since it last reported its
+	 *	load have been created.
+	 */
+	float estimatedLoad() const { return load_ + pendingLoad_; }
+
 	void updateLoad( float load, int numBases, int numProxies )
 	{
 		load_ = load;
 		numBases_ = numBases;
 		numProxies_ = numProxies;
+
+		pendingLoad_ = 0.f;
+		numPendingCreates_ = 0;
 	}
 
 	bool hasTimedOut( uint64 currTime, uint64 timeoutPeriod,
@@ -62,6 +72,8 @@ private:
 	long					id_;
 
 	float					load_;
+	float					pendingLoad_;
+	int						numPendingCreates_;
 	int						numBases_;
 	int						numProxies_;
 
@@ -100,6 +100,8 @@ BaseAppMgr::BaseAppMgr( Mercury::Nub & nub ) :
 	pTimeKeeper_( NULL ),
 	updateHertz_( DEFAULT_GAME_UPDATE_HERTZ ),
 	baseAppOverloadLevel_( 1.f ),
+	createLoadCost_( 0.01f ),
+	useTwoChoiceSelection_( true ),
 	createBaseRatio_( 4.f ),
 	updateCreateBaseInfoPeriod_( 1 ),
 	bestBaseAppAddr_( 0, 0 ),
@@ -132,6 +134,9 @@ BaseAppMgr::BaseAppMgr( Mercury::Nub & nub ) :
 		int( floorf( timeSyncPeriodInSeconds * updateHertz_ + 0.5f ) );
 
 	BWConfig::update( "baseAppMgr/baseAppOverloadLevel", baseAppOverloadLevel_);
+	BWConfig::update( "baseAppMgr/createLoadCost", createLoadCost_ );
+	BWConfig::update( "baseAppMgr/useTwoChoiceSelection",
+			useTwoChoiceSelection_ );
 
 	BWConfig::update( "baseAppMgr/createBaseRatio", createBaseRatio_ );
 	float updateCreateBaseInfoInSeconds =
@@ -338,12 +343,79 @@ BaseApp * BaseAppMgr::findBaseApp( const Mercury::Address & addr )
 }
 
 
+/**
+ *	This method finds the BaseApp that a new entity should be created on.
+ *
+ *	Load reports only arrive every so often, so if the least loaded BaseApp
+ *	were always chosen, every entity created between reports would go to the
+ *	same BaseApp. Instead, two BaseApps are chosen at random, and the one with
+ *	the lower estimated load is used. The estimate includes the entities that
+ *	have been sent to each BaseApp since its last load report.
+ *
+ *	@return The BaseApp to use. If none exists, NULL is returned.
+ */
+BaseApp * BaseAppMgr::findBestBaseApp() const
+{
+	if (!useTwoChoiceSelection_)
+	{
+		return this->findLeastLoadedBaseApp();
+	}
+
+	static std::vector< BaseApp * > s_candidates;
+	s_candidates.clear();
+
+	BaseAppMgr::BaseApps::const_iterator iter = baseApps_.begin();
+
+	while (iter != baseApps_.end())
+	{
+		if (reservedBaseApps_.count( iter->second->id() ) == 0)
+		{
+			s_candidates.push_back(
+				const_cast< BaseApp * >( iter->second.get() ) );
+		}
+
+		++iter;
+	}
+
+	const int numCandidates = int( s_candidates.size() );
+
+	if (numCandidates <= 2)
+	{
+		return this->findLeastLoadedBaseApp();
+	}
+
+	int first = rand() % numCandidates;
+	int second = rand() % (numCandidates - 1);
+
+	if (second >= first)
+	{
+		++second;
+	}
+
+	BaseApp * pBest = s_candidates[ first ];
+
+	if (s_candidates[ second ]->estimatedLoad() < pBest->estimatedLoad())
+	{
+		pBest = s_candidates[ second ];
+	}
+
+	// Only report that the BaseApps are overloaded if they all are. This is
+	// checked against the reported load, since the estimate is only a guess.
+	if (pBest->load() > baseAppOverloadLevel_)
+	{
+		return this->findLeastLoadedBaseApp();
+	}
+
+	return pBest;
+}
+
+
 /**
  *	This method finds the least loaded BaseApp.
  *
  *	@return The least loaded BaseApp. If none exists, NULL is returned.
  */
-BaseApp * BaseAppMgr::findBestBaseApp() const
+BaseApp * BaseAppMgr::findLeastLoadedBaseApp() const
 {
 	const BaseApp * pBest = NULL;
 
@@ -352,7 +424,7 @@ BaseApp * BaseAppMgr::findBestBaseApp() const
 
 	while (iter != baseApps_.end())
 	{
-		float currLoad = iter->second->load();
+		float currLoad = iter->second->estimatedLoad();
 
 		if (currLoad < lowestLoad && reservedBaseApps_.count( iter->second->id() ) == 0)
 		{
@@ -668,6 +740,8 @@ void BaseAppMgr::addWatchers()
 	MF_WATCH( "baseAppLoad/max", *this, &BaseAppMgr::maxBaseAppLoad );
 
 	MF_WATCH( "config/baseAppOverloadLevel", baseAppOverloadLevel_ );
+	MF_WATCH( "config/createLoadCost", createLoadCost_ );
+	MF_WATCH( "config/useTwoChoiceSelection", useTwoChoiceSelection_ );
 
 	Watcher * pBaseAppWatcher = BaseApp::makeWatcher();
 
@@ -724,7 +798,7 @@ int BaseAppMgr::handleTimeout( int /*id*/, void * arg )
 
 			// TODO: Don't really need to do this each tick.
 			{
-				BaseApp * pBest = this->findBestBaseApp();
+				BaseApp * pBest = this->findLeastLoadedBaseApp();
 
 				if ((pBest != NULL) &&
 					(bestBaseAppAddr_ != pBest->addr()) &&
@@ -2737,6 +2811,8 @@ void BaseAppMgr::createBaseEntity( const Mercury::Address & srcAddr,
 			new ForwardingReplyHandler( srcAddr, header.replyID ) );
 		bundle.transfer( data, data.remainingLength() );
 		pBest->send();
+
+		pBest->addEntity();
 	}
 	else
 	{
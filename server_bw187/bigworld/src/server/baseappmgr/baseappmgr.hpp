@@ -116,6 +116,8 @@ public:
 
 	uint64 lastInformTime() const	{ return lastInformTime_; }
 
+	float createLoadCost() const	{ return createLoadCost_; }
+
 	// ---- Message Handlers ----
 	void handleCellAppMgrBirth(
 		const BaseAppMgrInterface::handleCellAppMgrBirthArgs & args );
@@ -226,6 +228,7 @@ private:
 	ProfileGroup				pro_;
 
 	BaseApp * findBestBaseApp() const;
+	BaseApp * findLeastLoadedBaseApp() const;
 	BackupBaseApp * findBestBackup( const BaseApp & baseApp ) const;
 	BaseAppID getNextID();
 
@@ -257,6 +260,8 @@ private:
 	int				updateHertz_;
 
 	float			baseAppOverloadLevel_;
+	float			createLoadCost_;
+	bool			useTwoChoiceSelection_;
 	float			createBaseRatio_;
 	int				updateCreateBaseInfoPeriod_;
 
@@ -24,6 +24,9 @@ criminal penalties as provided by law.
 
 #include "cstdmf/memory_stream.hpp"
 #include "cstdmf/time_queue.hpp"
+#ifdef USE_TIMING_WHEEL
+#include "cstdmf/timing_wheel.hpp"
+#endif
 
 #include "entitydef/entity_description_map.hpp"
 #include "network/mercury.hpp"
@@ -41,6 +44,9 @@ criminal penalties as provided by law.
 
 #include "cell_viewer_server.hpp"
 #include "cellapp_death_listener.hpp"
+#include "witness_update_pool.hpp"
+
+#include <memory>
 
 class Cell;
 class Entity;
@@ -154,7 +160,12 @@ public:
 	CellAppMgr & cellAppMgr()				{ return cellAppMgr_; }
 	DBMgr & dbMgr()							{ return *dbMgr_.pChannelOwner(); }
 
-	TimeQueue & timeQueue()						{ return timeQueue_; }
+#ifdef USE_TIMING_WHEEL
+	typedef TimingWheel AppTimeQueue;
+#else
+	typedef TimeQueue AppTimeQueue;
+#endif
+	AppTimeQueue & timeQueue()				{ return timeQueue_; }
 	const std::string & exeName()				{ return exeName_; }
 
 	TimeStamp time() const						{ return time_; }
@@ -233,6 +244,9 @@ public:
 	bool deregisterForUpdate( Updatable * pObject );
 
 	bool nextTickPending() const;	// are we running out of time?
+
+	WitnessUpdatePool * pWitnessUpdatePool() const
+										{ return pWitnessUpdatePool_.get(); }
 	//@}
 
 	/// @name Misc
@@ -296,7 +310,7 @@ private:
 
 	TimeStamp		time_;
 	TimeStamp		shutDownTime_;
-	TimeQueue		timeQueue_;
+	AppTimeQueue	timeQueue_;
 	TimeKeeper * 	pTimeKeeper_;
 
 	Pickler * pPickler_;
@@ -357,6 +371,7 @@ private:
 	bool					versForCallIsOld_;
 
 	CellViewerServer *		pViewerServer_;
+	std::auto_ptr< WitnessUpdatePool >	pWitnessUpdatePool_;
 	CellAppID				id_;
 
 	// TODO: We could put all "global" configuration options in their own object
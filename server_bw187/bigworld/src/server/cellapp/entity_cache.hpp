@@ -112,6 +112,12 @@ public:
 	void lodEventNumber( int level, EventNumber eventNumber );
 	EventNumber lodEventNumber( int level ) const;
 
+	// Position in the owning Witness's WitnessPriorityQueue
+	uint8 queueBand() const				{ return queueBand_; }
+	int queueSlot() const				{ return queueSlot_; }
+	void queuePosition( uint8 band, int slot )
+										{ queueBand_ = band; queueSlot_ = slot; }
+
 private:
 	EntityCache & operator=( const EntityCache & );
 
@@ -136,6 +142,9 @@ private:
 
 	EventNumber		lodEventNumbers_[ MAX_LOD_LEVELS ];		// int32 * num lod levels
 
+	uint8			queueBand_;
+	int32			queueSlot_;
+
 	friend BinaryIStream & operator>>( BinaryIStream & stream,
 			EntityCache & entityCache );
 	friend BinaryOStream & operator<<( BinaryOStream & stream,
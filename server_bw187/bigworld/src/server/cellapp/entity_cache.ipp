@@ -36,7 +36,9 @@ INLINE EntityCache::EntityCache( ObjectID dummyID ) :
 	lastEventNumber_( 0 ),
 	lastVolatileUpdateNumber_( 0 ),
 	detailLevel_( 0 ),
-	idAlias_( NO_ID_ALIAS )
+	idAlias_( NO_ID_ALIAS ),
+	queueBand_( 0 ),
+	queueSlot_( -1 )
 {
 	lodEventNumbers_[0] = 0;
 
@@ -79,6 +81,8 @@ INLINE void EntityCache::construct()
 	lastVolatileUpdateNumber_ = this->pEntity()->volatileUpdateNumber() - 1;
 	detailLevel_ = this->numLoDLevels();
 	idAlias_ = NO_ID_ALIAS;
+	queueBand_ = 0;
+	queueSlot_ = -1;
 
 	this->viewportIndexData() = 0;
 
@@ -0,0 +1,163 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef ENTITY_ID_MAP_HPP
+#define ENTITY_ID_MAP_HPP
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/stdmf.hpp"
+#include "network/basictypes.hpp"
+
+#include <utility>
+#include <vector>
+
+/**
+ *	This class is a map from ObjectID to VALUE. It is an open addressing hash
+ *	table with linear probing, so a lookup is usually a single probe into a
+ *	contiguous array rather than a walk down a tree.
+ *
+ *	It has the parts of the std::map interface that are used with entity IDs.
+ *	The differences are:
+ *		- The iteration order is not sorted.
+ *		- Inserting an element may invalidate all iterators. Erasing an element
+ *		  only invalidates iterators to that element, as with std::map, so
+ *		  elements can be erased while iterating.
+ */
+template <class VALUE>
+class EntityIDMap
+{
+public:
+	typedef ObjectID key_type;
+	typedef VALUE mapped_type;
+	typedef std::pair< ObjectID, VALUE > value_type;
+	typedef size_t size_type;
+
+	/**
+	 *	This class is used to iterate over the elements of an EntityIDMap.
+	 */
+	template <class MAP, class VALUE_TYPE>
+	class IteratorT
+	{
+	public:
+		IteratorT() : pMap_( NULL ), index_( 0 ) {}
+
+		IteratorT( MAP * pMap, size_type index ) :
+			pMap_( pMap ), index_( index ) {}
+
+		/**
+		 *	This constructor allows an iterator to be converted to a
+		 *	const_iterator.
+		 */
+		template <class OTHER_MAP, class OTHER_VALUE_TYPE>
+		IteratorT( const IteratorT< OTHER_MAP, OTHER_VALUE_TYPE > & other ) :
+			pMap_( other.pMap() ), index_( other.index() ) {}
+
+		VALUE_TYPE & operator*() const	{ return pMap_->slots_[ index_ ]; }
+		VALUE_TYPE * operator->() const	{ return &pMap_->slots_[ index_ ]; }
+
+		IteratorT & operator++()
+		{
+			index_ = pMap_->nextUsed( index_ + 1 );
+			return *this;
+		}
+
+		IteratorT operator++( int )
+		{
+			IteratorT old = *this;
+			++(*this);
+			return old;
+		}
+
+		template <class OTHER_MAP, class OTHER_VALUE_TYPE>
+		bool operator==(
+			const IteratorT< OTHER_MAP, OTHER_VALUE_TYPE > & other ) const
+		{
+			return index_ == other.index();
+		}
+
+		template <class OTHER_MAP, class OTHER_VALUE_TYPE>
+		bool operator!=(
+			const IteratorT< OTHER_MAP, OTHER_VALUE_TYPE > & other ) const
+		{
+			return index_ != other.index();
+		}
+
+		MAP * pMap() const			{ return pMap_; }
+		size_type index() const		{ return index_; }
+
+	private:
+		MAP *		pMap_;
+		size_type	index_;
+	};
+
+	typedef IteratorT< EntityIDMap, value_type > iterator;
+	typedef IteratorT< const EntityIDMap, const value_type > const_iterator;
+
+	EntityIDMap();
+
+	iterator begin()				{ return iterator( this, this->nextUsed( 0 ) ); }
+	iterator end()					{ return iterator( this, slots_.size() ); }
+	const_iterator begin() const
+		{ return const_iterator( this, this->nextUsed( 0 ) ); }
+	const_iterator end() const
+		{ return const_iterator( this, slots_.size() ); }
+
+	size_type size() const			{ return size_; }
+	bool empty() const				{ return size_ == 0; }
+
+	iterator find( ObjectID id )
+		{ return iterator( this, this->findSlot( id ) ); }
+	const_iterator find( ObjectID id ) const
+		{ return const_iterator( this, this->findSlot( id ) ); }
+	size_type count( ObjectID id ) const
+		{ return (this->findSlot( id ) != slots_.size()) ? 1 : 0; }
+
+	std::pair< iterator, bool > insert( const value_type & value );
+	VALUE & operator[]( ObjectID id );
+
+	void erase( iterator it );
+	size_type erase( ObjectID id );
+	void clear();
+
+	void reserve( size_type numElements );
+
+private:
+	/**
+	 *	The state of each slot. An erased slot has to be kept distinct from an
+	 *	empty one so that probing for the elements after it still works.
+	 */
+	enum
+	{
+		SLOT_EMPTY,
+		SLOT_USED,
+		SLOT_ERASED
+	};
+
+	/**
+	 *	The capacity of an empty map. This must be a power of 2.
+	 */
+	static const size_type MIN_CAPACITY = 16;
+
+	size_type findSlot( ObjectID id ) const;
+	size_type nextUsed( size_type index ) const;
+	size_type homeSlot( ObjectID id ) const;
+	void rehash( size_type capacity );
+
+	std::vector< value_type >	slots_;
+	std::vector< uint8 >		states_;
+	size_type					size_;
+	size_type					numErased_;
+	int							shift_;
+};
+
+#include "entity_id_map.ipp"
+
+#endif // ENTITY_ID_MAP_HPP
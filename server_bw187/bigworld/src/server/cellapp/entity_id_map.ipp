@@ -0,0 +1,264 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+// entity_id_map.ipp
+
+// -----------------------------------------------------------------------------
+// Section: EntityIDMap
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ */
+template <class VALUE>
+EntityIDMap< VALUE >::EntityIDMap() :
+	slots_(),
+	states_(),
+	size_( 0 ),
+	numErased_( 0 ),
+	shift_( 0 )
+{
+	this->rehash( MIN_CAPACITY );
+}
+
+
+/**
+ *	This method inserts an element if there is not already one with the same
+ *	ID.
+ *
+ *	@return	The iterator for the element with the value's ID, and whether the
+ *			value was inserted.
+ */
+template <class VALUE>
+std::pair< typename EntityIDMap< VALUE >::iterator, bool >
+	EntityIDMap< VALUE >::insert( const value_type & value )
+{
+	size_type index = this->findSlot( value.first );
+
+	if (index != slots_.size())
+	{
+		return std::make_pair( iterator( this, index ), false );
+	}
+
+	// Keep the table no more than 3/4 full, counting the erased slots since
+	// they lengthen the probe sequences as much as used ones.
+	if ((size_ + numErased_ + 1) * 4 > slots_.size() * 3)
+	{
+		this->rehash( ((size_ + 1) * 2 > slots_.size()) ?
+			slots_.size() * 2 : slots_.size() );
+	}
+
+	size_type mask = slots_.size() - 1;
+	index = this->homeSlot( value.first );
+
+	while (states_[ index ] == SLOT_USED)
+	{
+		index = (index + 1) & mask;
+	}
+
+	if (states_[ index ] == SLOT_ERASED)
+	{
+		--numErased_;
+	}
+
+	states_[ index ] = SLOT_USED;
+	slots_[ index ] = value;
+	++size_;
+
+	return std::make_pair( iterator( this, index ), true );
+}
+
+
+/**
+ *	This method returns a reference to the value for the given ID. A default
+ *	value is inserted if there is no element with the ID.
+ */
+template <class VALUE>
+VALUE & EntityIDMap< VALUE >::operator[]( ObjectID id )
+{
+	return this->insert( value_type( id, VALUE() ) ).first->second;
+}
+
+
+/**
+ *	This method erases the element that the iterator refers to.
+ */
+template <class VALUE>
+void EntityIDMap< VALUE >::erase( iterator it )
+{
+	size_type index = it.index();
+
+	MF_ASSERT( states_[ index ] == SLOT_USED );
+
+	states_[ index ] = SLOT_ERASED;
+	slots_[ index ] = value_type();
+	--size_;
+	++numErased_;
+}
+
+
+/**
+ *	This method erases the element with the given ID.
+ *
+ *	@return	The number of elements erased.
+ */
+template <class VALUE>
+typename EntityIDMap< VALUE >::size_type
+	EntityIDMap< VALUE >::erase( ObjectID id )
+{
+	size_type index = this->findSlot( id );
+
+	if (index == slots_.size())
+	{
+		return 0;
+	}
+
+	this->erase( iterator( this, index ) );
+
+	return 1;
+}
+
+
+/**
+ *	This method erases all elements.
+ */
+template <class VALUE>
+void EntityIDMap< VALUE >::clear()
+{
+	slots_.clear();
+	states_.clear();
+	size_ = 0;
+	numErased_ = 0;
+	this->rehash( MIN_CAPACITY );
+}
+
+
+/**
+ *	This method makes sure that the given number of elements can be held
+ *	without rehashing.
+ */
+template <class VALUE>
+void EntityIDMap< VALUE >::reserve( size_type numElements )
+{
+	size_type capacity = slots_.size();
+
+	while (numElements * 4 > capacity * 3)
+	{
+		capacity *= 2;
+	}
+
+	if (capacity != slots_.size())
+	{
+		this->rehash( capacity );
+	}
+}
+
+
+/**
+ *	This method returns the index of the slot holding the given ID, or the
+ *	capacity if there is no such element.
+ */
+template <class VALUE>
+typename EntityIDMap< VALUE >::size_type
+	EntityIDMap< VALUE >::findSlot( ObjectID id ) const
+{
+	size_type mask = slots_.size() - 1;
+	size_type index = this->homeSlot( id );
+
+	while (states_[ index ] != SLOT_EMPTY)
+	{
+		if ((states_[ index ] == SLOT_USED) && (slots_[ index ].first == id))
+		{
+			return index;
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	return slots_.size();
+}
+
+
+/**
+ *	This method returns the index of the first used slot at or after the given
+ *	index, or the capacity if there is none.
+ */
+template <class VALUE>
+typename EntityIDMap< VALUE >::size_type
+	EntityIDMap< VALUE >::nextUsed( size_type index ) const
+{
+	size_type capacity = states_.size();
+
+	while ((index < capacity) && (states_[ index ] != SLOT_USED))
+	{
+		++index;
+	}
+
+	return index;
+}
+
+
+/**
+ *	This method returns the slot that probing for the given ID starts at.
+ *	IDs are allocated in consecutive ranges, so they are spread out with a
+ *	multiplicative (Fibonacci) hash and the top bits are used.
+ */
+template <class VALUE>
+inline typename EntityIDMap< VALUE >::size_type
+	EntityIDMap< VALUE >::homeSlot( ObjectID id ) const
+{
+	return size_type( ((uint32( id ) * 2654435769U) & 0xffffffffU) >> shift_ );
+}
+
+
+/**
+ *	This method moves all elements into a table with the given capacity. This
+ *	also removes all of the erased slots.
+ */
+template <class VALUE>
+void EntityIDMap< VALUE >::rehash( size_type capacity )
+{
+	MF_ASSERT( (capacity & (capacity - 1)) == 0 );
+
+	std::vector< value_type > oldSlots( capacity );
+	std::vector< uint8 > oldStates( capacity, uint8( SLOT_EMPTY ) );
+	oldSlots.swap( slots_ );
+	oldStates.swap( states_ );
+
+	shift_ = 32;
+
+	for (size_type i = capacity; i > 1; i >>= 1)
+	{
+		--shift_;
+	}
+
+	size_type mask = capacity - 1;
+
+	for (size_type i = 0; i < oldStates.size(); ++i)
+	{
+		if (oldStates[ i ] == SLOT_USED)
+		{
+			size_type index = this->homeSlot( oldSlots[ i ].first );
+
+			while (states_[ index ] == SLOT_USED)
+			{
+				index = (index + 1) & mask;
+			}
+
+			states_[ index ] = SLOT_USED;
+			slots_[ index ] = oldSlots[ i ];
+		}
+	}
+
+	numErased_ = 0;
+}
+
+// entity_id_map.ipp
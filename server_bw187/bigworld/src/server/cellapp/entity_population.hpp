@@ -13,6 +13,7 @@ criminal penalties as provided by law.
 #define ENTITY_POPULATION_HPP
 
 #include <map>
+#include "entity_id_map.hpp"
 #include "network/basictypes.hpp"
 #include "cellapp_death_listener.hpp"
 #include "network/bundle.hpp"
@@ -23,9 +24,13 @@ class CellAppChannel;
 
 /**
  *	This class is used to store all of the entities in the application.
+ *
+ *	It is looked up for almost every message that is received for an entity,
+ *	so it is an EntityIDMap rather than a std::map. Note that adding an entity
+ *	invalidates any iterators into the population.
  */
 class EntityPopulation :
-	public std::map< ObjectID, Entity * >,
+	public EntityIDMap< Entity * >,
 	public CellAppDeathListener
 {
 public:
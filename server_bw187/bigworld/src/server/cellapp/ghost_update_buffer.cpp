@@ -0,0 +1,320 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "ghost_update_buffer.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "network/bundle.hpp"
+#include "server/bwconfig.hpp"
+
+DECLARE_DEBUG_COMPONENT(0)
+
+namespace
+{
+/// The property index that avatar updates are replaced by.
+const int AVATAR_UPDATE_INDEX = 0;
+}
+
+bool GhostUpdateBuffer::s_isEnabled = true;
+
+
+// -----------------------------------------------------------------------------
+// Section: GhostUpdateBuffer
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ */
+GhostUpdateBuffer::GhostUpdateBuffer() :
+	entityIndices_(),
+	entities_(),
+	updates_(),
+	data_(),
+	numMessagesThisTick_( 0 ),
+	numBytesThisTick_( 0 ),
+	numMessagesLastTick_( 0 ),
+	numBytesLastTick_( 0 ),
+	numMessagesSent_( 0 ),
+	numBytesSent_( 0 ),
+	numUpdatesReplaced_( 0 )
+{
+}
+
+
+/**
+ *	This method adds an avatar update for the ghost of the given entity. It
+ *	replaces any avatar update already pending for the entity.
+ */
+void GhostUpdateBuffer::addAvatarUpdate( EntityID id,
+		const CellAppInterface::ghostAvatarUpdateArgs & args )
+{
+	this->addDataUpdate( id, CellAppInterface::ghostAvatarUpdate,
+		&args, sizeof( args ), AVATAR_UPDATE_INDEX );
+}
+
+
+/**
+ *	This method adds a variable length update for the ghost of the given
+ *	entity.
+ *
+ *	@param id		The id of the entity.
+ *	@param ie		The message to send. The entity id is sent before the data.
+ *	@param pData	The message data.
+ *	@param length	The length of the message data.
+ *	@param propertyIndex	If not NOT_REPLACEABLE, this update replaces a
+ *					pending update of the same message with the same index.
+ *					Only updates whose intermediate values the ghost has no use
+ *					for should be replaceable.
+ */
+void GhostUpdateBuffer::addDataUpdate( EntityID id,
+		const Mercury::InterfaceElement & ie, const void * pData, int length,
+		int propertyIndex )
+{
+	PendingEntity & entity = this->findOrAdd( id );
+
+	if (propertyIndex != NOT_REPLACEABLE)
+	{
+		int index = entity.firstUpdate;
+
+		while (index != -1)
+		{
+			PendingUpdate & update = updates_[ index ];
+
+			if ((update.pIE == &ie) && (update.propertyIndex == propertyIndex))
+			{
+				update.pIE = NULL;
+				++numUpdatesReplaced_;
+				break;
+			}
+
+			index = update.next;
+		}
+	}
+
+	PendingUpdate update;
+	update.pIE = &ie;
+	update.propertyIndex = propertyIndex;
+	update.offset = int( data_.size() );
+	update.length = length;
+	update.next = -1;
+
+	const char * pBytes = static_cast< const char * >( pData );
+	data_.insert( data_.end(), pBytes, pBytes + length );
+
+	int index = int( updates_.size() );
+	updates_.push_back( update );
+
+	if (entity.lastUpdate == -1)
+	{
+		entity.firstUpdate = index;
+	}
+	else
+	{
+		updates_[ entity.lastUpdate ].next = index;
+	}
+
+	entity.lastUpdate = index;
+}
+
+
+/**
+ *	This method adds the pending updates of the given entity to the bundle.
+ */
+void GhostUpdateBuffer::flush( EntityID id, Mercury::Bundle & bundle )
+{
+	EntityIDMap< int >::iterator iter = entityIndices_.find( id );
+
+	if (iter == entityIndices_.end())
+	{
+		return;
+	}
+
+	this->addToBundle( entities_[ iter->second ], bundle );
+	entityIndices_.erase( iter );
+
+	if (entityIndices_.empty())
+	{
+		this->clear();
+	}
+}
+
+
+/**
+ *	This method adds all pending updates to the bundle.
+ */
+void GhostUpdateBuffer::flush( Mercury::Bundle & bundle )
+{
+	if (entityIndices_.empty())
+	{
+		return;
+	}
+
+	for (std::vector< PendingEntity >::iterator iter = entities_.begin();
+			iter != entities_.end(); ++iter)
+	{
+		if (!iter->isFlushed)
+		{
+			this->addToBundle( *iter, bundle );
+			entityIndices_.erase( iter->id );
+		}
+	}
+
+	this->clear();
+}
+
+
+/**
+ *	This method should be called once a tick, after the updates have been
+ *	flushed, to update the statistics.
+ */
+void GhostUpdateBuffer::tick()
+{
+	numMessagesLastTick_ = numMessagesThisTick_;
+	numBytesLastTick_ = numBytesThisTick_;
+
+	numMessagesThisTick_ = 0;
+	numBytesThisTick_ = 0;
+}
+
+
+/**
+ *	This method returns the pending updates of the given entity, adding them if
+ *	there are none.
+ */
+GhostUpdateBuffer::PendingEntity & GhostUpdateBuffer::findOrAdd( EntityID id )
+{
+	std::pair< EntityIDMap< int >::iterator, bool > result =
+		entityIndices_.insert( std::make_pair( id, int( entities_.size() ) ) );
+
+	if (result.second)
+	{
+		PendingEntity entity;
+		entity.id = id;
+		entity.firstUpdate = -1;
+		entity.lastUpdate = -1;
+		entity.isFlushed = false;
+
+		entities_.push_back( entity );
+	}
+
+	return entities_[ result.first->second ];
+}
+
+
+/**
+ *	This method adds the pending updates of an entity to the bundle.
+ */
+void GhostUpdateBuffer::addToBundle( PendingEntity & entity,
+		Mercury::Bundle & bundle )
+{
+	MF_ASSERT( !entity.isFlushed );
+
+	int index = entity.firstUpdate;
+
+	while (index != -1)
+	{
+		const PendingUpdate & update = updates_[ index ];
+
+		if (update.pIE != NULL)
+		{
+			bundle.startMessage( *update.pIE );
+			bundle << entity.id;
+
+			if (update.length > 0)
+			{
+				bundle.addBlob( &data_[ update.offset ], update.length );
+			}
+
+			this->countMessage( sizeof( EntityID ) + update.length );
+		}
+
+		index = update.next;
+	}
+
+	entity.isFlushed = true;
+}
+
+
+/**
+ *	This method adds a message of the given size to the statistics.
+ */
+void GhostUpdateBuffer::countMessage( int numBytes )
+{
+	++numMessagesThisTick_;
+	numBytesThisTick_ += numBytes;
+
+	++numMessagesSent_;
+	numBytesSent_ += numBytes;
+}
+
+
+/**
+ *	This method empties the storage once there are no pending updates. The
+ *	vectors keep their capacity for the next tick.
+ */
+void GhostUpdateBuffer::clear()
+{
+	MF_ASSERT( entityIndices_.empty() );
+
+	entities_.clear();
+	updates_.clear();
+	data_.clear();
+}
+
+
+/**
+ *	This static method reads the configuration and adds the watchers that are
+ *	shared by all buffers.
+ */
+void GhostUpdateBuffer::init()
+{
+	s_isEnabled = BWConfig::get( "cellApp/coalesceGhostUpdates", s_isEnabled );
+
+	INFO_MSG( "GhostUpdateBuffer::init: Ghost update coalescing is %s\n",
+		s_isEnabled ? "enabled" : "disabled" );
+
+	MF_WATCH( "ghostUpdates/isEnabled", s_isEnabled, Watcher::WT_READ_WRITE,
+		"Whether ghost updates are coalesced until the end of each tick" );
+}
+
+
+/**
+ *	This static method returns the watcher for the statistics of a buffer. The
+ *	owner of each buffer should add it relative to the buffer.
+ */
+WatcherPtr GhostUpdateBuffer::pWatcher()
+{
+	static DirectoryWatcherPtr pWatcher = NULL;
+
+#if ENABLE_WATCHERS
+	if (pWatcher == NULL)
+	{
+		pWatcher = new DirectoryWatcher();
+
+		GhostUpdateBuffer * pNull = NULL;
+
+#define ADD_WATCHER( PATH, MEMBER )		\
+		pWatcher->addChild( #PATH, makeWatcher( pNull->MEMBER ) );
+
+		ADD_WATCHER( messagesPerTick,	numMessagesLastTick_ );
+		ADD_WATCHER( bytesPerTick,		numBytesLastTick_ );
+		ADD_WATCHER( messagesSent,		numMessagesSent_ );
+		ADD_WATCHER( bytesSent,			numBytesSent_ );
+		ADD_WATCHER( updatesReplaced,	numUpdatesReplaced_ );
+
+#undef ADD_WATCHER
+	}
+#endif /* ENABLE_WATCHERS */
+
+	return pWatcher;
+}
+
+// ghost_update_buffer.cpp
@@ -0,0 +1,121 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef GHOST_UPDATE_BUFFER_HPP
+#define GHOST_UPDATE_BUFFER_HPP
+
+#include "cellapp_interface.hpp"
+#include "entity_id_map.hpp"
+
+#include "cstdmf/watcher.hpp"
+
+#include <vector>
+
+namespace Mercury
+{
+class Bundle;
+class InterfaceElement;
+}
+
+
+/**
+ *	This class collects the ghost updates that real entities send to a single
+ *	CellApp during a game tick. They are added to the channel's bundle just
+ *	before it is sent, grouped by entity.
+ *
+ *	Only the latest avatar update of each entity is sent. A data update that is
+ *	given a property index replaces an earlier update of the same property of
+ *	the same entity. A replacing update takes the place of the last one in the
+ *	order, so the updates that are sent keep the order they were added in.
+ *
+ *	The owner must flush an entity's updates onto the bundle before any other
+ *	message to its ghost, so that the ghost sees them in the same order as
+ *	before. When isEnabled() is false, the owner should flush each update as
+ *	soon as it is added.
+ *
+ *	The updates are kept in vectors that are reused from tick to tick, so a
+ *	steady stream of updates does not allocate memory.
+ */
+class GhostUpdateBuffer
+{
+public:
+	/// The property index of data updates that must not be replaced.
+	static const int NOT_REPLACEABLE = -1;
+
+	GhostUpdateBuffer();
+
+	void addAvatarUpdate( EntityID id,
+		const CellAppInterface::ghostAvatarUpdateArgs & args );
+	void addDataUpdate( EntityID id, const Mercury::InterfaceElement & ie,
+		const void * pData, int length,
+		int propertyIndex = NOT_REPLACEABLE );
+
+	void flush( EntityID id, Mercury::Bundle & bundle );
+	void flush( Mercury::Bundle & bundle );
+
+	void tick();
+
+	bool isEmpty() const			{ return entityIndices_.empty(); }
+
+	static bool isEnabled()			{ return s_isEnabled; }
+
+	static void init();
+	static WatcherPtr pWatcher();
+
+private:
+	/**
+	 *	This structure holds the pending updates of an entity.
+	 */
+	struct PendingEntity
+	{
+		EntityID	id;
+		int			firstUpdate;
+		int			lastUpdate;
+		bool		isFlushed;
+	};
+
+	/**
+	 *	This structure describes a pending update. Its data is in data_. A
+	 *	replaced update has a NULL pIE.
+	 */
+	struct PendingUpdate
+	{
+		const Mercury::InterfaceElement * pIE;
+		int			propertyIndex;
+		int			offset;
+		int			length;
+		int			next;
+	};
+
+	PendingEntity & findOrAdd( EntityID id );
+	void addToBundle( PendingEntity & entity, Mercury::Bundle & bundle );
+	void countMessage( int numBytes );
+	void clear();
+
+	EntityIDMap< int >				entityIndices_;
+	std::vector< PendingEntity >	entities_;
+	std::vector< PendingUpdate >	updates_;
+	std::vector< char >				data_;
+
+	uint32	numMessagesThisTick_;
+	uint32	numBytesThisTick_;
+
+	uint32	numMessagesLastTick_;
+	uint32	numBytesLastTick_;
+
+	uint32	numMessagesSent_;
+	uint32	numBytesSent_;
+	uint32	numUpdatesReplaced_;
+
+	static bool s_isEnabled;
+};
+
+#endif // GHOST_UPDATE_BUFFER_HPP
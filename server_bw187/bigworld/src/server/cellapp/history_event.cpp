@@ -0,0 +1,404 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "history_event.hpp"
+
+#include "common/client_interface.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/watcher.hpp"
+
+#include <algorithm>
+#include <new>
+
+DECLARE_DEBUG_COMPONENT(0)
+
+#ifndef CODE_INLINE
+#include "history_event.ipp"
+#endif
+
+namespace
+{
+
+class WatcherIniter
+{
+public:
+	WatcherIniter()
+	{
+		HistoryEventArena::addWatchers();
+	}
+};
+
+WatcherIniter s_watcherIniter_;
+
+} // anonymous namespace
+
+// -----------------------------------------------------------------------------
+// Section: HistoryEvent
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor. The message is copied into a buffer owned by this event.
+ */
+HistoryEvent::HistoryEvent( Mercury::MessageID msgID, EventNumber number,
+		void * msg, int msgLen, Level level, const std::string * pName ) :
+	level_( level ),
+	msgIE_( ClientInterface::entityMessage ),
+	number_( number ),
+	msg_( new char[ msgLen ] ),
+	msgLen_( msgLen ),
+	pName_( pName ),
+	isInArena_( false )
+{
+	msgIE_.id( msgID );
+	memcpy( msg_, msg, msgLen );
+}
+
+
+/**
+ *	Constructor. The message is copied into the given storage, which was
+ *	allocated with this event by an EventHistory's arena.
+ */
+HistoryEvent::HistoryEvent( Mercury::MessageID msgID, EventNumber number,
+		void * msg, int msgLen, Level level, const std::string * pName,
+		char * pMsgStorage ) :
+	level_( level ),
+	msgIE_( ClientInterface::entityMessage ),
+	number_( number ),
+	msg_( pMsgStorage ),
+	msgLen_( msgLen ),
+	pName_( pName ),
+	isInArena_( true )
+{
+	msgIE_.id( msgID );
+	memcpy( msg_, msg, msgLen );
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: HistoryEventArena
+// -----------------------------------------------------------------------------
+
+int HistoryEventArena::s_maxChunksPerEntity = 64;
+int HistoryEventArena::s_maxFreeChunks = 4096;
+int HistoryEventArena::s_maxEntityBytes = 0;
+
+HistoryEventArena::Chunk * HistoryEventArena::s_pFreeChunks = NULL;
+int HistoryEventArena::s_numFreeChunks = 0;
+int HistoryEventArena::s_numChunksInUse = 0;
+uint32 HistoryEventArena::s_numOverflows = 0;
+
+
+/**
+ *	Constructor.
+ */
+HistoryEventArena::HistoryEventArena() :
+	pHead_( NULL ),
+	pTail_( NULL ),
+	numChunks_( 0 )
+{
+}
+
+
+/**
+ *	Destructor. Everything allocated should have been released by now.
+ */
+HistoryEventArena::~HistoryEventArena()
+{
+	MF_ASSERT_DEV( pHead_ == NULL );
+
+	while (pHead_)
+	{
+		Chunk * pChunk = pHead_;
+		pHead_ = pChunk->pNext;
+		deleteChunk( pChunk );
+	}
+}
+
+
+/**
+ *	This method allocates the given number of bytes.
+ *
+ *	@return	The allocated memory, or NULL if it could not be allocated from
+ *			the arena.
+ */
+void * HistoryEventArena::allocate( int size )
+{
+	// Keep the events aligned.
+	size = (size + 7) & ~7;
+
+	if (size > capacity())
+	{
+		++s_numOverflows;
+		return NULL;
+	}
+
+	if ((pTail_ == NULL) || (pTail_->used + size > capacity()))
+	{
+		if (numChunks_ >= s_maxChunksPerEntity)
+		{
+			++s_numOverflows;
+			return NULL;
+		}
+
+		Chunk * pChunk = newChunk();
+
+		if (pTail_)
+		{
+			pTail_->pNext = pChunk;
+		}
+		else
+		{
+			pHead_ = pChunk;
+		}
+
+		pTail_ = pChunk;
+		++numChunks_;
+
+		s_maxEntityBytes = std::max( s_maxEntityBytes, this->numBytes() );
+	}
+
+	void * pData = data( pTail_ ) + pTail_->used;
+	pTail_->used += size;
+	++pTail_->numLive;
+
+	return pData;
+}
+
+
+/**
+ *	This method releases memory returned by allocate(). Memory must be
+ *	released in the same order that it was allocated.
+ */
+void HistoryEventArena::release( void * pData )
+{
+	Chunk * pChunk = pHead_;
+
+	MF_ASSERT( pChunk != NULL );
+	MF_ASSERT( (static_cast< char * >( pData ) >= data( pChunk )) &&
+		(static_cast< char * >( pData ) < data( pChunk ) + pChunk->used) );
+
+	if (--pChunk->numLive == 0)
+	{
+		pHead_ = pChunk->pNext;
+
+		if (pHead_ == NULL)
+		{
+			pTail_ = NULL;
+		}
+
+		--numChunks_;
+		deleteChunk( pChunk );
+	}
+}
+
+
+/**
+ *	This static method returns an empty chunk, from the free list if there is
+ *	one.
+ */
+HistoryEventArena::Chunk * HistoryEventArena::newChunk()
+{
+	Chunk * pChunk = s_pFreeChunks;
+
+	if (pChunk)
+	{
+		s_pFreeChunks = pChunk->pNext;
+		--s_numFreeChunks;
+	}
+	else
+	{
+		pChunk = reinterpret_cast< Chunk * >( new char[ CHUNK_SIZE ] );
+	}
+
+	pChunk->pNext = NULL;
+	pChunk->used = 0;
+	pChunk->numLive = 0;
+
+	++s_numChunksInUse;
+
+	return pChunk;
+}
+
+
+/**
+ *	This static method puts a chunk on the free list, or frees it if the free
+ *	list is full.
+ */
+void HistoryEventArena::deleteChunk( Chunk * pChunk )
+{
+	--s_numChunksInUse;
+
+	if (s_numFreeChunks < s_maxFreeChunks)
+	{
+		pChunk->pNext = s_pFreeChunks;
+		s_pFreeChunks = pChunk;
+		++s_numFreeChunks;
+	}
+	else
+	{
+		delete [] reinterpret_cast< char * >( pChunk );
+	}
+}
+
+
+/**
+ *	This static method adds the watchers for the event history arenas.
+ */
+void HistoryEventArena::addWatchers()
+{
+	static int chunkSize = CHUNK_SIZE;
+
+	MF_WATCH( "eventHistory/chunkSize", chunkSize, Watcher::WT_READ_ONLY,
+		"The size in bytes of each chunk of entity event history" );
+	MF_WATCH( "eventHistory/maxChunksPerEntity", s_maxChunksPerEntity,
+		Watcher::WT_READ_WRITE,
+		"The number of chunks an entity can use for its event history. "
+			"Events after that are allocated individually" );
+	MF_WATCH( "eventHistory/maxFreeChunks", s_maxFreeChunks,
+		Watcher::WT_READ_WRITE,
+		"The number of unused chunks that are kept for reuse" );
+	MF_WATCH( "eventHistory/numChunksInUse", s_numChunksInUse,
+		Watcher::WT_READ_ONLY,
+		"The number of chunks holding the event history of entities" );
+	MF_WATCH( "eventHistory/numFreeChunks", s_numFreeChunks,
+		Watcher::WT_READ_ONLY,
+		"The number of unused chunks kept for reuse" );
+	MF_WATCH( "eventHistory/numOverflows", s_numOverflows,
+		Watcher::WT_READ_ONLY,
+		"The number of events that did not fit in their entity's chunks" );
+	MF_WATCH( "eventHistory/maxEntityBytes", s_maxEntityBytes,
+		Watcher::WT_READ_WRITE,
+		"The most bytes of chunks that one entity's event history has held" );
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: EventHistory
+// -----------------------------------------------------------------------------
+
+/**
+ *	Destructor.
+ */
+EventHistory::~EventHistory()
+{
+	this->clear();
+}
+
+
+/**
+ *	This static method returns the watcher for an entity's event history. It
+ *	is added under each entity's watcher, relative to its eventHistory_.
+ */
+WatcherPtr EventHistory::pWatcher()
+{
+	static DirectoryWatcherPtr pWatcher = NULL;
+
+#if ENABLE_WATCHERS
+	if (pWatcher == NULL)
+	{
+		pWatcher = new DirectoryWatcher();
+
+		EventHistory * pNull = NULL;
+
+		pWatcher->addChild( "numEvents",
+				makeWatcher( *pNull, &EventHistory::numEvents ) );
+		pWatcher->addChild( "numArenaBytes",
+				makeWatcher( *pNull, &EventHistory::numArenaBytes ) );
+	}
+#endif /* ENABLE_WATCHERS */
+
+	return pWatcher;
+}
+
+
+/**
+ *	This method adds a new event to the event history. The event and a copy of
+ *	its message are stored together in this history's arena.
+ *
+ *	@return	The new event. It remains valid until it is trimmed.
+ */
+HistoryEvent * EventHistory::add( Mercury::MessageID msgID,
+		EventNumber number, void * msg, int msgLen,
+		HistoryEvent::Level level, const std::string * pName )
+{
+	void * pData = arena_.allocate( sizeof( HistoryEvent ) + msgLen );
+
+	HistoryEvent * pEvent;
+
+	if (pData)
+	{
+		pEvent = new (pData) HistoryEvent( msgID, number, msg, msgLen, level,
+			pName, static_cast< char * >( pData ) + sizeof( HistoryEvent ) );
+	}
+	else
+	{
+		pEvent = new HistoryEvent( msgID, number, msg, msgLen, level, pName );
+	}
+
+	container_.push_back( pEvent );
+
+	return pEvent;
+}
+
+
+/**
+ *	This method removes the events that were already in the history when this
+ *	method was last called.
+ */
+void EventHistory::trim()
+{
+	Container::size_type numToTrim = std::min( trimSize_, container_.size() );
+
+	while (numToTrim > 0)
+	{
+		this->popFront();
+		--numToTrim;
+	}
+
+	trimSize_ = container_.size();
+}
+
+
+/**
+ *	This method removes all events from the history.
+ */
+void EventHistory::clear()
+{
+	while (!container_.empty())
+	{
+		this->popFront();
+	}
+
+	trimSize_ = 0;
+}
+
+
+/**
+ *	This method removes and frees the oldest event.
+ */
+void EventHistory::popFront()
+{
+	HistoryEvent * pEvent = container_.front();
+	container_.pop_front();
+
+	if (pEvent->isInArena_)
+	{
+		pEvent->~HistoryEvent();
+		arena_.release( pEvent );
+	}
+	else
+	{
+		delete pEvent;
+	}
+}
+
+// history_event.cpp
@@ -16,6 +16,8 @@ criminal penalties as provided by law.
 #include "network/bundle.hpp"
 #include "network/interface_element.hpp"
 
+#include "cstdmf/watcher.hpp"
+
 #include <deque>
 
 /**
@@ -75,6 +77,88 @@ public:
 
 	/// __glenc__ Hack to hold onto the name for event tracking.
 	const std::string * pName_;
+
+private:
+	HistoryEvent( Mercury::MessageID msgID, EventNumber number,
+		void * msg, int msgLen, Level level,
+		const std::string * pName, char * pMsgStorage );
+
+	/// Whether this event and its message were allocated by the arena of an
+	/// EventHistory, rather than by new.
+	bool isInArena_;
+
+	friend class EventHistory;
+};
+
+
+/**
+ *	This class allocates the history events of a single entity, and their
+ *	messages, from a queue of fixed size chunks. An event is stored next to
+ *	its message, so there is one allocation per event instead of two, and
+ *	the events of an entity are mostly contiguous.
+ *
+ *	Events are always freed in the order they were allocated, so each chunk
+ *	only needs a count of its live allocations. A chunk is returned to a free
+ *	list shared by all entities once everything in it has been freed.
+ *
+ *	allocate() returns NULL when an event is bigger than a chunk or the entity
+ *	already has s_maxChunksPerEntity chunks. The caller then allocates the
+ *	event on the heap, so the bound limits memory rather than losing events.
+ */
+class HistoryEventArena
+{
+public:
+	HistoryEventArena();
+	~HistoryEventArena();
+
+	void * allocate( int size );
+	void release( void * pData );
+
+	/**
+	 *	This method returns the number of bytes held by this arena.
+	 */
+	int numBytes() const	{ return numChunks_ * CHUNK_SIZE; }
+
+	static void addWatchers();
+
+	enum
+	{
+		/// The size of each chunk, including its header.
+		CHUNK_SIZE = 1024
+	};
+
+private:
+	HistoryEventArena( const HistoryEventArena & );
+	HistoryEventArena & operator=( const HistoryEventArena & );
+
+	/**
+	 *	This is the header at the start of each chunk.
+	 */
+	struct Chunk
+	{
+		Chunk *	pNext;
+		int		used;
+		int		numLive;
+	};
+
+	static char * data( Chunk * pChunk );
+	static int capacity();
+
+	static Chunk * newChunk();
+	static void deleteChunk( Chunk * pChunk );
+
+	Chunk *	pHead_;
+	Chunk *	pTail_;
+	int		numChunks_;
+
+	static int s_maxChunksPerEntity;
+	static int s_maxFreeChunks;
+	static int s_maxEntityBytes;
+
+	static Chunk * s_pFreeChunks;
+	static int s_numFreeChunks;
+	static int s_numChunksInUse;
+	static uint32 s_numOverflows;
 };
 
 
@@ -92,6 +176,9 @@ public:
 	EventHistory();
 	~EventHistory();
 
+	HistoryEvent * add( Mercury::MessageID msgID, EventNumber number,
+		void * msg, int msgLen, HistoryEvent::Level level,
+		const std::string * pName = NULL );
 	void add( HistoryEvent * pEvent );
 	void trim();
 	void clear();
@@ -104,9 +191,20 @@ public:
 
 	size_t size() const 					{ return container_.size(); }
 
+	int numEvents() const					{ return int( container_.size() ); }
+	int numArenaBytes() const				{ return arena_.numBytes(); }
+
+	static WatcherPtr pWatcher();
+
 private:
+	EventHistory( const EventHistory & );
+	EventHistory & operator=( const EventHistory & );
+
+	void popFront();
+
 	Container container_;
 	Container::size_type trimSize_;
+	HistoryEventArena arena_;
 };
 
 #ifdef CODE_INLINE
@@ -27,7 +27,10 @@ criminal penalties as provided by law.
 INLINE
 HistoryEvent::~HistoryEvent()
 {
-	delete [] msg_;
+	if (!isInArena_)
+	{
+		delete [] msg_;
+	}
 }
 
 
@@ -75,6 +78,29 @@ INLINE bool HistoryEvent::shouldSend( float threshold, int detailLevel ) const
 		(threshold < level_.priority);
 }
 
+// -----------------------------------------------------------------------------
+// Section: HistoryEventArena
+// -----------------------------------------------------------------------------
+
+/**
+ *	This method returns the start of the data in the given chunk.
+ */
+INLINE char * HistoryEventArena::data( Chunk * pChunk )
+{
+	return reinterpret_cast< char * >( pChunk ) +
+		((sizeof( Chunk ) + 7) & ~7);
+}
+
+
+/**
+ *	This method returns the number of bytes of data that a chunk can hold.
+ */
+INLINE int HistoryEventArena::capacity()
+{
+	return CHUNK_SIZE - int( (sizeof( Chunk ) + 7) & ~7 );
+}
+
+
 // -----------------------------------------------------------------------------
 // Section: EventHistory
 // -----------------------------------------------------------------------------
@@ -0,0 +1,716 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "range_grid.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "server/bwconfig.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <math.h>
+
+DECLARE_DEBUG_COMPONENT(0)
+
+namespace
+{
+/// Grid coordinates are clamped to this so that terminator positions of
+/// +/- FLT_MAX still map to a cell.
+const int MAX_CELL_COORD = 1 << 30;
+
+/**
+ *	This function packs a pair of grid coordinates into a single key.
+ */
+inline uint64 cellKey( int x, int z )
+{
+	return (uint64( (unsigned int)x ) << 32) | uint64( (unsigned int)z );
+}
+
+
+/**
+ *	This function returns whether pos is within range of centre. It uses the
+ *	same bounds, and the same volatile trick, as RangeTrigger::isInXRange so
+ *	that both agree on entities that lie exactly on an edge.
+ */
+inline bool isInRange( float centre, float range, float pos )
+{
+	volatile float lowerBound = centre - range;
+	volatile float upperBound = centre + range;
+	return (lowerBound < pos) && (pos <= upperBound);
+}
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: RangeGrid
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ *
+ *	@param cellSize	The width of each grid cell, in metres.
+ */
+RangeGrid::RangeGrid( float cellSize ) :
+	cellSize_( cellSize ),
+	invCellSize_( 1.f / cellSize ),
+	stamp_( 0 ),
+	inUpdate_( false )
+{
+}
+
+
+/**
+ *	Destructor.
+ */
+RangeGrid::~RangeGrid()
+{
+	for (uint i = 0; i < entityNodes_.size(); ++i)
+	{
+		if (entityNodes_[i] != NULL)
+		{
+			entityNodes_[i]->gridIndex( -1 );
+		}
+	}
+
+	for (uint i = 0; i < triggers_.size(); ++i)
+	{
+		if (triggers_[i] != NULL)
+		{
+			triggers_[i]->gridIndex( -1 );
+		}
+	}
+}
+
+
+/**
+ *	This static method creates a RangeGrid if the cellApp/rangeGrid/enabled
+ *	configuration option is set. Otherwise it returns NULL, and the space
+ *	should use its RangeList.
+ */
+RangeGrid * RangeGrid::createFromConfig()
+{
+	if (!BWConfig::get( "cellApp/rangeGrid/enabled", false ))
+	{
+		return NULL;
+	}
+
+	float cellSize = BWConfig::get( "cellApp/rangeGrid/cellSize", 50.f );
+
+	if (cellSize <= 0.f)
+	{
+		ERROR_MSG( "RangeGrid::createFromConfig: "
+				"Invalid cellSize %f. Using 50.0\n", cellSize );
+		cellSize = 50.f;
+	}
+
+	return new RangeGrid( cellSize );
+}
+
+
+/**
+ *	This method adds an entity to the grid. Triggers learn about it on the
+ *	next call to update().
+ */
+void RangeGrid::addEntity( RangeListNode * pEntity )
+{
+	MF_ASSERT( pEntity->gridIndex() == -1 );
+
+	int index;
+
+	if (!freeEntities_.empty())
+	{
+		index = freeEntities_.back();
+		freeEntities_.pop_back();
+	}
+	else
+	{
+		index = int( entityNodes_.size() );
+		entityNodes_.push_back( NULL );
+		entityX_.push_back( 0.f );
+		entityZ_.push_back( 0.f );
+		entityCells_.push_back( -1 );
+		entitySlots_.push_back( -1 );
+		entityMoveStamps_.push_back( 0 );
+	}
+
+	pEntity->gridIndex( index );
+	entityNodes_[ index ] = pEntity;
+	entityX_[ index ] = pEntity->x();
+	entityZ_[ index ] = pEntity->z();
+	entityMoveStamps_[ index ] = 0;
+
+	this->insertIntoCell( index, this->findOrCreateCell(
+		this->cellCoord( entityX_[ index ] ),
+		this->cellCoord( entityZ_[ index ] ) ) );
+
+	this->entityMoved( pEntity );
+}
+
+
+/**
+ *	This method removes an entity from the grid. Any trigger that contains it
+ *	is told that it has left.
+ */
+void RangeGrid::removeEntity( RangeListNode * pEntity )
+{
+	int index = pEntity->gridIndex();
+
+	if (index < 0)
+	{
+		return;
+	}
+
+	for (uint i = 0; i < triggers_.size(); ++i)
+	{
+		RangeTrigger * pTrigger = triggers_[i];
+
+		if (pTrigger == NULL)
+			continue;
+
+		Nodes & members = triggerMembers_[i];
+		Nodes::iterator iter =
+			std::lower_bound( members.begin(), members.end(), pEntity );
+
+		if ((iter != members.end()) && (*iter == pEntity))
+		{
+			members.erase( iter );
+			pTrigger->triggerLeave( pEntity );
+		}
+	}
+
+	this->removeFromCell( index );
+
+	entityNodes_[ index ] = NULL;
+	entityMoveStamps_[ index ] = 0;
+	freeEntities_.push_back( index );
+	pEntity->gridIndex( -1 );
+}
+
+
+/**
+ *	This method flags that an entity has moved. The grid and any affected
+ *	triggers are brought up to date on the next call to update().
+ */
+void RangeGrid::entityMoved( RangeListNode * pEntity )
+{
+	int index = pEntity->gridIndex();
+
+	if ((index >= 0) && (entityMoveStamps_[ index ] != stamp_ + 1))
+	{
+		entityMoveStamps_[ index ] = stamp_ + 1;
+		dirtyEntities_.push_back( index );
+	}
+}
+
+
+/**
+ *	This method adds a trigger to the grid. As with RangeTrigger::insert, the
+ *	trigger is told immediately about every entity already inside it.
+ */
+void RangeGrid::addTrigger( RangeTrigger * pTrigger )
+{
+	MF_ASSERT( pTrigger->gridIndex() == -1 );
+
+	int index;
+
+	if (!freeTriggers_.empty())
+	{
+		index = freeTriggers_.back();
+		freeTriggers_.pop_back();
+	}
+	else
+	{
+		index = int( triggers_.size() );
+		triggers_.push_back( NULL );
+		triggerMembers_.push_back( Nodes() );
+		triggerDirty_.push_back( false );
+	}
+
+	pTrigger->gridIndex( index );
+	triggers_[ index ] = pTrigger;
+	triggerMembers_[ index ].clear();
+	triggerDirty_[ index ] = false;
+
+	this->evaluateTrigger( index );
+}
+
+
+/**
+ *	This method removes a trigger from the grid.
+ *
+ *	@param pTrigger			The trigger to remove.
+ *	@param shouldContract	If true, the trigger is told that every entity
+ *							inside it has left, as with RangeTrigger::remove.
+ *							Otherwise it is removed silently, as with
+ *							RangeTrigger::removeWithoutContracting.
+ */
+void RangeGrid::removeTrigger( RangeTrigger * pTrigger, bool shouldContract )
+{
+	int index = pTrigger->gridIndex();
+
+	if (index < 0)
+	{
+		return;
+	}
+
+	Nodes members;
+	members.swap( triggerMembers_[ index ] );
+
+	triggers_[ index ] = NULL;
+	triggerDirty_[ index ] = false;
+	freeTriggers_.push_back( index );
+	pTrigger->gridIndex( -1 );
+
+	if (shouldContract)
+	{
+		for (Nodes::iterator iter = members.begin();
+				iter != members.end(); ++iter)
+		{
+			pTrigger->triggerLeave( *iter );
+		}
+	}
+}
+
+
+/**
+ *	This method flags that a trigger's range has changed.
+ */
+void RangeGrid::triggerChanged( RangeTrigger * pTrigger )
+{
+	int index = pTrigger->gridIndex();
+
+	if (index >= 0)
+	{
+		triggerDirty_[ index ] = true;
+	}
+}
+
+
+/**
+ *	This method applies all of the moves flagged since the last call and sends
+ *	the resulting enter and leave notifications. It should be called once per
+ *	game tick.
+ */
+void RangeGrid::update()
+{
+	if (inUpdate_)
+	{
+		WARNING_MSG( "RangeGrid::update: Called recursively\n" );
+		return;
+	}
+
+	inUpdate_ = true;
+	++stamp_;
+	dirtyCells_.clear();
+
+	this->updateEntityCells();
+
+	// Triggers may be added or removed by the callbacks, so the size is
+	// checked each time round.
+	for (uint i = 0; i < triggers_.size(); ++i)
+	{
+		if ((triggers_[i] != NULL) && this->needsUpdate( i ))
+		{
+			this->evaluateTrigger( i );
+		}
+	}
+
+	this->releaseEmptyCells();
+
+	inUpdate_ = false;
+}
+
+
+/**
+ *	This method visits every entity in the square of the given range around
+ *	the given point.
+ */
+void RangeGrid::visitSquare( float x, float z, float range,
+		Visitor & visitor ) const
+{
+	// Collect first so that the visitor is free to move entities.
+	Nodes found;
+	this->collectInSquare( x, z, range, NULL, found );
+
+	for (Nodes::iterator iter = found.begin(); iter != found.end(); ++iter)
+	{
+		visitor.visit( *iter );
+	}
+}
+
+
+/**
+ *	This method returns the grid coordinate of the given position.
+ */
+int RangeGrid::cellCoord( float pos ) const
+{
+	float coord = floorf( pos * invCellSize_ );
+
+	if (coord < -MAX_CELL_COORD) return -MAX_CELL_COORD;
+	if (coord > MAX_CELL_COORD) return MAX_CELL_COORD;
+
+	return int( coord );
+}
+
+
+/**
+ *	This method calculates the grid cells covered by a square.
+ */
+void RangeGrid::calcBounds( float x, float z, float range,
+		CellBounds & bounds ) const
+{
+	bounds.minX = this->cellCoord( x - range );
+	bounds.minZ = this->cellCoord( z - range );
+	bounds.maxX = this->cellCoord( x + range );
+	bounds.maxZ = this->cellCoord( z + range );
+}
+
+
+/**
+ *	This method returns the index of the cell at the given grid coordinates,
+ *	or -1 if no entity has ever been in it.
+ */
+int RangeGrid::findCell( int x, int z ) const
+{
+	uint64 key = cellKey( x, z );
+	std::map< uint64, int >::const_iterator iter = cellMap_.find( key );
+
+	return (iter != cellMap_.end()) ? iter->second : -1;
+}
+
+
+/**
+ *	This method returns the index of the cell at the given grid coordinates,
+ *	creating it if necessary.
+ */
+int RangeGrid::findOrCreateCell( int x, int z )
+{
+	uint64 key = cellKey( x, z );
+	std::map< uint64, int >::iterator iter = cellMap_.find( key );
+
+	if (iter != cellMap_.end())
+	{
+		return iter->second;
+	}
+
+	int index;
+
+	if (!freeCells_.empty())
+	{
+		index = freeCells_.back();
+		freeCells_.pop_back();
+	}
+	else
+	{
+		index = int( cells_.size() );
+		cells_.push_back( Cell() );
+	}
+
+	Cell & cell = cells_[ index ];
+	cell.x = x;
+	cell.z = z;
+	cell.dirtyStamp = 0;
+
+	cellMap_[ key ] = index;
+
+	return index;
+}
+
+
+/**
+ *	This method adds an entity to a cell's list.
+ */
+void RangeGrid::insertIntoCell( int entityIndex, int cellIndex )
+{
+	Indices & entities = cells_[ cellIndex ].entities;
+
+	entityCells_[ entityIndex ] = cellIndex;
+	entitySlots_[ entityIndex ] = int( entities.size() );
+	entities.push_back( entityIndex );
+}
+
+
+/**
+ *	This method removes an entity from its cell's list. The last entity in the
+ *	list takes its place.
+ */
+void RangeGrid::removeFromCell( int entityIndex )
+{
+	Indices & entities = cells_[ entityCells_[ entityIndex ] ].entities;
+	int slot = entitySlots_[ entityIndex ];
+
+	entities[ slot ] = entities.back();
+	entitySlots_[ entities[ slot ] ] = slot;
+	entities.pop_back();
+
+	if (entities.empty())
+	{
+		emptyCells_.push_back( entityCells_[ entityIndex ] );
+	}
+
+	entityCells_[ entityIndex ] = -1;
+	entitySlots_[ entityIndex ] = -1;
+}
+
+
+/**
+ *	This method records that the membership of a cell has changed this tick.
+ */
+void RangeGrid::markCellDirty( int cellIndex )
+{
+	Cell & cell = cells_[ cellIndex ];
+
+	if (cell.dirtyStamp != stamp_)
+	{
+		cell.dirtyStamp = stamp_;
+		dirtyCells_.push_back( cellIndex );
+	}
+}
+
+
+/**
+ *	This method returns the cells that have been emptied since the last update
+ *	to the free list, so that the grid does not keep a cell for every square
+ *	that an entity has ever passed through. It is called at the end of update()
+ *	so that dirtyCells_ is never left referring to a released cell.
+ */
+void RangeGrid::releaseEmptyCells()
+{
+	for (uint i = 0; i < emptyCells_.size(); ++i)
+	{
+		int cellIndex = emptyCells_[i];
+		Cell & cell = cells_[ cellIndex ];
+
+		// The cell may have been refilled, or listed more than once.
+		if (!cell.entities.empty())
+			continue;
+
+		std::map< uint64, int >::iterator iter =
+			cellMap_.find( cellKey( cell.x, cell.z ) );
+
+		if ((iter == cellMap_.end()) || (iter->second != cellIndex))
+			continue;
+
+		cellMap_.erase( iter );
+		freeCells_.push_back( cellIndex );
+	}
+
+	emptyCells_.clear();
+}
+
+
+/**
+ *	This method moves each entity flagged since the last update into the cell
+ *	for its current position.
+ */
+void RangeGrid::updateEntityCells()
+{
+	Indices dirtyEntities;
+	dirtyEntities.swap( dirtyEntities_ );
+
+	for (uint i = 0; i < dirtyEntities.size(); ++i)
+	{
+		int index = dirtyEntities[i];
+		RangeListNode * pNode = entityNodes_[ index ];
+
+		// It may have been removed since it was flagged.
+		if ((pNode == NULL) || (entityMoveStamps_[ index ] != stamp_))
+			continue;
+
+		entityX_[ index ] = pNode->x();
+		entityZ_[ index ] = pNode->z();
+
+		int oldCell = entityCells_[ index ];
+		int newCell = this->findOrCreateCell(
+			this->cellCoord( entityX_[ index ] ),
+			this->cellCoord( entityZ_[ index ] ) );
+
+		// Moving within a cell can still cross a trigger's edge.
+		this->markCellDirty( oldCell );
+
+		if (newCell != oldCell)
+		{
+			this->removeFromCell( index );
+			this->insertIntoCell( index, newCell );
+			this->markCellDirty( newCell );
+		}
+	}
+}
+
+
+/**
+ *	This method returns whether anything has happened this tick that could
+ *	change the membership of the given trigger.
+ */
+bool RangeGrid::needsUpdate( int triggerIndex ) const
+{
+	if (triggerDirty_[ triggerIndex ])
+	{
+		return true;
+	}
+
+	RangeTrigger * pTrigger = triggers_[ triggerIndex ];
+	RangeListNode * pSubject = pTrigger->pSubject();
+
+	int subjectIndex = pSubject->gridIndex();
+
+	if ((subjectIndex >= 0) && (entityMoveStamps_[ subjectIndex ] == stamp_))
+	{
+		return true;
+	}
+
+	if (dirtyCells_.empty())
+	{
+		return false;
+	}
+
+	CellBounds bounds;
+	this->calcBounds( pSubject->x(), pSubject->z(), pTrigger->range(), bounds );
+
+	for (uint i = 0; i < dirtyCells_.size(); ++i)
+	{
+		const Cell & cell = cells_[ dirtyCells_[i] ];
+
+		if ((bounds.minX <= cell.x) && (cell.x <= bounds.maxX) &&
+			(bounds.minZ <= cell.z) && (cell.z <= bounds.maxZ))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ *	This method recalculates the entities inside a trigger and sends it enter
+ *	and leave notifications for the differences.
+ */
+void RangeGrid::evaluateTrigger( int triggerIndex )
+{
+	RangeTrigger * pTrigger = triggers_[ triggerIndex ];
+	triggerDirty_[ triggerIndex ] = false;
+
+	Nodes members;
+	this->collectMembers( pTrigger, members );
+
+	Nodes & oldMembers = triggerMembers_[ triggerIndex ];
+	Nodes left;
+	Nodes entered;
+
+	std::set_difference( oldMembers.begin(), oldMembers.end(),
+		members.begin(), members.end(), std::back_inserter( left ) );
+	std::set_difference( members.begin(), members.end(),
+		oldMembers.begin(), oldMembers.end(), std::back_inserter( entered ) );
+
+	oldMembers.swap( members );
+
+	// The callbacks may remove this trigger or the entities involved, so
+	// check before each one.
+	for (Nodes::iterator iter = left.begin(); iter != left.end(); ++iter)
+	{
+		if (triggers_[ triggerIndex ] != pTrigger)
+			return;
+
+		pTrigger->triggerLeave( *iter );
+	}
+
+	for (Nodes::iterator iter = entered.begin(); iter != entered.end(); ++iter)
+	{
+		if (triggers_[ triggerIndex ] != pTrigger)
+			return;
+
+		const Nodes & current = triggerMembers_[ triggerIndex ];
+
+		if (std::binary_search( current.begin(), current.end(), *iter ))
+		{
+			pTrigger->triggerEnter( *iter );
+		}
+	}
+}
+
+
+/**
+ *	This method finds the entities, other than its subject, that are currently
+ *	inside the given trigger. The result is sorted.
+ */
+void RangeGrid::collectMembers( RangeTrigger * pTrigger,
+		Nodes & members ) const
+{
+	RangeListNode * pSubject = pTrigger->pSubject();
+
+	this->collectInSquare( pSubject->x(), pSubject->z(), pTrigger->range(),
+		pSubject, members );
+
+	std::sort( members.begin(), members.end() );
+}
+
+
+/**
+ *	This method finds the entities in the square of the given range around the
+ *	given point.
+ *
+ *	@param pExclude	An entity to leave out of the results, or NULL.
+ */
+void RangeGrid::collectInSquare( float x, float z, float range,
+		const RangeListNode * pExclude, Nodes & found ) const
+{
+	CellBounds bounds;
+	this->calcBounds( x, z, range, bounds );
+
+	double numCovered = (double( bounds.maxX ) - bounds.minX + 1) *
+		(double( bounds.maxZ ) - bounds.minZ + 1);
+
+	if (numCovered > double( cellMap_.size() ))
+	{
+		// The square covers more of the grid than exists, so it is quicker
+		// to check every entity.
+		for (uint index = 0; index < entityNodes_.size(); ++index)
+		{
+			if ((entityNodes_[ index ] != NULL) &&
+				(entityNodes_[ index ] != pExclude) &&
+				isInRange( x, range, entityX_[ index ] ) &&
+				isInRange( z, range, entityZ_[ index ] ))
+			{
+				found.push_back( entityNodes_[ index ] );
+			}
+		}
+
+		return;
+	}
+
+	for (int cz = bounds.minZ; cz <= bounds.maxZ; ++cz)
+	{
+		for (int cx = bounds.minX; cx <= bounds.maxX; ++cx)
+		{
+			int cellIndex = this->findCell( cx, cz );
+
+			if (cellIndex < 0)
+				continue;
+
+			const Indices & entities = cells_[ cellIndex ].entities;
+
+			for (uint i = 0; i < entities.size(); ++i)
+			{
+				int index = entities[i];
+
+				if ((entityNodes_[ index ] != pExclude) &&
+					isInRange( x, range, entityX_[ index ] ) &&
+					isInRange( z, range, entityZ_[ index ] ))
+				{
+					found.push_back( entityNodes_[ index ] );
+				}
+			}
+		}
+	}
+}
+
+// range_grid.cpp
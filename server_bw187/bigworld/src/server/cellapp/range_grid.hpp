@@ -0,0 +1,147 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef RANGE_GRID_HPP
+#define RANGE_GRID_HPP
+
+#include "range_list_node.hpp"
+
+#include <map>
+#include <vector>
+
+
+/**
+ *	This class is a uniform grid spatial index that can be used by a space in
+ *	place of its RangeList. It gives RangeTriggers the same enter and leave
+ *	notifications, but rather than shuffling nodes along linked lists every
+ *	time an entity moves, moves are flagged and resolved once per tick in
+ *	update().
+ *
+ *	Entity and trigger data are kept in parallel arrays indexed by the node's
+ *	gridIndex(), so the per-tick passes walk contiguous memory. Each grid cell
+ *	holds the indices of the entities inside it. A trigger is only
+ *	re-evaluated when its subject moves, its range changes, or an entity has
+ *	moved into, out of or within one of the cells its square overlaps.
+ *
+ *	Because membership is resolved per tick, an entity that passes into and
+ *	back out of a trigger between two updates generates no notifications.
+ */
+class RangeGrid
+{
+public:
+	RangeGrid( float cellSize );
+	~RangeGrid();
+
+	static RangeGrid * createFromConfig();
+
+	void addEntity( RangeListNode * pEntity );
+	void removeEntity( RangeListNode * pEntity );
+	void entityMoved( RangeListNode * pEntity );
+
+	void addTrigger( RangeTrigger * pTrigger );
+	void removeTrigger( RangeTrigger * pTrigger, bool shouldContract = true );
+	void triggerChanged( RangeTrigger * pTrigger );
+
+	void update();
+
+	/**
+	 *	This interface is used to visit the entities found by visitSquare.
+	 */
+	class Visitor
+	{
+	public:
+		virtual ~Visitor() {};
+		virtual void visit( RangeListNode * pEntity ) = 0;
+	};
+
+	void visitSquare( float x, float z, float range,
+			Visitor & visitor ) const;
+
+	float cellSize() const		{ return cellSize_; }
+	int numEntities() const
+		{ return int( entityNodes_.size() - freeEntities_.size() ); }
+	int numTriggers() const
+		{ return int( triggers_.size() - freeTriggers_.size() ); }
+
+private:
+	typedef std::vector< RangeListNode * > Nodes;
+	typedef std::vector< int > Indices;
+
+	/**
+	 *	This structure is a single square of the grid.
+	 */
+	struct Cell
+	{
+		int			x;
+		int			z;
+		uint32		dirtyStamp;
+		Indices		entities;
+	};
+
+	/**
+	 *	This structure is the range of grid cells covered by a square.
+	 */
+	struct CellBounds
+	{
+		int minX;
+		int minZ;
+		int maxX;
+		int maxZ;
+	};
+
+	int cellCoord( float pos ) const;
+	void calcBounds( float x, float z, float range, CellBounds & bounds ) const;
+
+	int findCell( int x, int z ) const;
+	int findOrCreateCell( int x, int z );
+
+	void insertIntoCell( int entityIndex, int cellIndex );
+	void removeFromCell( int entityIndex );
+	void markCellDirty( int cellIndex );
+	void releaseEmptyCells();
+
+	void updateEntityCells();
+	bool needsUpdate( int triggerIndex ) const;
+	void evaluateTrigger( int triggerIndex );
+	void collectMembers( RangeTrigger * pTrigger, Nodes & members ) const;
+	void collectInSquare( float x, float z, float range,
+			const RangeListNode * pExclude, Nodes & found ) const;
+
+	float			cellSize_;
+	float			invCellSize_;
+
+	// Per-entity data, indexed by RangeListNode::gridIndex().
+	Nodes			entityNodes_;
+	std::vector< float >	entityX_;
+	std::vector< float >	entityZ_;
+	Indices			entityCells_;
+	Indices			entitySlots_;
+	std::vector< uint32 >	entityMoveStamps_;
+	Indices			freeEntities_;
+	Indices			dirtyEntities_;
+
+	// Per-trigger data, indexed by RangeTrigger::gridIndex().
+	std::vector< RangeTrigger * >	triggers_;
+	std::vector< Nodes >	triggerMembers_;
+	std::vector< uint8 >	triggerDirty_;
+	Indices			freeTriggers_;
+
+	std::vector< Cell >		cells_;
+	std::map< uint64, int >	cellMap_;
+	Indices			dirtyCells_;
+	Indices			emptyCells_;
+	Indices			freeCells_;
+
+	uint32			stamp_;
+	bool			inUpdate_;
+};
+
+#endif // RANGE_GRID_HPP
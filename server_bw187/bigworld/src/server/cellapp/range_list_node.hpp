@@ -45,7 +45,8 @@ public:
 		pPrevZ_( NULL ),
 		pNextZ_( NULL ),
 		flags_( flags ),
-		order_( order )
+		order_( order ),
+		gridIndex_( -1 )
 	{ }
 	virtual ~RangeListNode()	{}
 
@@ -77,6 +78,10 @@ public:
 
 	bool isEntity() const	{ return flags_ & FLAG_MAKES_CROSSINGS; }
 
+	/// The index of this node in its space's RangeGrid, or -1 if none.
+	int gridIndex() const				{ return gridIndex_; }
+	void gridIndex( int index )			{ gridIndex_ = index; }
+
 	void removeFromRangeList();
 	void insertBeforeX( RangeListNode* entry );
 	void insertBeforeZ( RangeListNode* entry );
@@ -103,6 +108,7 @@ protected:
 	RangeListNode *pNextZ_;
 	uint16			flags_;
 	uint16			order_;
+	int				gridIndex_;
 };
 
 
@@ -239,6 +245,11 @@ public:
 	}
 
 	float range() const	{ return upperBound_.range(); }
+
+	/// The index of this trigger in its space's RangeGrid, or -1 if none.
+	int gridIndex() const			{ return upperBound_.gridIndex(); }
+	void gridIndex( int index )		{ upperBound_.gridIndex( index ); }
+
 protected:
 	RangeListNode *		pSubject_;
 	RangeTriggerNode	upperBound_;
@@ -16,10 +16,12 @@ criminal penalties as provided by law.
 
 #include "cell_range_list.hpp"
 #include "cell_app_channel.hpp"
+#include "range_grid.hpp"
 
 #include "math/math_extra.hpp"
 #include "network/basictypes.hpp"
 
+#include <memory>
 #include <vector>
 
 class BinaryIStream;
@@ -211,6 +213,10 @@ public:
 	int dataRecencyLevel( int32 seq ) const;
 
 	const RangeList & rangeList() const	{ return rangeList_; }
+
+	/// The grid used instead of the range list when cellApp/rangeGrid/enabled
+	/// is set, otherwise NULL.
+	RangeGrid * pRangeGrid() const		{ return pRangeGrid_.get(); }
 	bool getRealEntitiesBoundary( BW::Rect & boundary,
 		   int numToSkip = 0 ) const;
 
@@ -263,6 +269,7 @@ private:
 	CellInfos		cellInfos_;
 
 	RangeList	rangeList_;
+	std::auto_ptr< RangeGrid >	pRangeGrid_;
 
 	int32	begDataSeq_;
 	int32	endDataSeq_;
@@ -206,6 +206,8 @@ private:
 	//SpaceViewport			ownEyes_;
 	bool					viewportsArrayChanged_;
 
+	friend class WitnessUpdatePool;
+
 	friend BinaryIStream & operator>>( BinaryIStream & stream,
 			EntityCache & entityCache );
 	friend BinaryOStream & operator<<( BinaryOStream & stream,
@@ -0,0 +1,304 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "witness_priority_queue.hpp"
+
+#include "entity.hpp"
+
+#include "cstdmf/debug.hpp"
+
+#include <math.h>
+
+DECLARE_DEBUG_COMPONENT(0)
+
+
+// -----------------------------------------------------------------------------
+// Section: WitnessPriorityQueue
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ */
+WitnessPriorityQueue::WitnessPriorityQueue() :
+	bandWidth_( 0.f ),
+	invBandWidth_( 0.f ),
+	numVisitedLastTick_( 0 )
+{
+	this->bandWidth( 500.f / NUM_BANDS );
+}
+
+
+/**
+ *	This method sets the width of each distance band. This is normally the
+ *	witness's AoI radius divided by NUM_BANDS. Entities keep their current
+ *	band until their next turn comes up.
+ */
+void WitnessPriorityQueue::bandWidth( float width )
+{
+	if (width <= 0.f)
+	{
+		ERROR_MSG( "WitnessPriorityQueue::bandWidth: "
+				"Invalid width %f\n", width );
+		return;
+	}
+
+	bandWidth_ = width;
+	invBandWidth_ = 1.f / width;
+}
+
+
+/**
+ *	This method adds an entity to the queue. It will be returned by the next
+ *	call to collectDue.
+ */
+void WitnessPriorityQueue::add( EntityCache * pCache )
+{
+	this->append( pCache, OVERDUE );
+}
+
+
+/**
+ *	This method removes an entity from the queue.
+ */
+void WitnessPriorityQueue::remove( EntityCache * pCache )
+{
+	this->removeAt( pCache->queueBand(), pCache->queueSlot() );
+	pCache->queuePosition( 0, -1 );
+}
+
+
+/**
+ *	This method finds the entities that should be updated this tick. It
+ *	should be called once per witness update.
+ *
+ *	@param origin	The position of the witness.
+ *	@param due		The due entities are appended to this, overdue ones first,
+ *					then nearest band to furthest.
+ */
+void WitnessPriorityQueue::collectDue( const Vector3 & origin, Caches & due )
+{
+	MF_ASSERT( moves_.empty() );
+
+	// Overdue entities are taken off their list here and put into their
+	// band below, after the bands have been visited, so that they are not
+	// returned twice.
+	Caches & overdue = bands_[ OVERDUE ].caches;
+
+	for (uint i = 0; i < overdue.size(); ++i)
+	{
+		EntityCache * pCache = overdue[i];
+
+		Move move;
+		move.pCache = pCache;
+		move.band = this->bandFor( pCache, origin );
+		moves_.push_back( move );
+
+		due.push_back( pCache );
+	}
+
+	overdue.clear();
+
+	for (int bandIndex = 0; bandIndex < NUM_BANDS; ++bandIndex)
+	{
+		Band & band = bands_[ bandIndex ];
+		uint size = band.caches.size();
+
+		if (size == 0)
+		{
+			continue;
+		}
+
+		if (band.cursor >= size)
+		{
+			band.cursor = 0;
+		}
+
+		// Entities that change band are left in place until the pass is
+		// over, so that each slot is visited at most once.
+		uint period = bandIndex + 1;
+		uint count = (size + period - 1) / period;
+		uint numLeaving = 0;
+
+		for (uint i = 0; i < count; ++i)
+		{
+			uint slot = (band.cursor + i) % size;
+			EntityCache * pCache = band.caches[ slot ];
+			int newBand = this->bandFor( pCache, origin );
+
+			if (newBand != bandIndex)
+			{
+				pCache->queuePosition( uint8( bandIndex ), -1 );
+				++numLeaving;
+
+				Move move;
+				move.pCache = pCache;
+				move.band = newBand;
+				moves_.push_back( move );
+			}
+
+			due.push_back( pCache );
+		}
+
+		band.cursor = (band.cursor + count) % size;
+
+		if (numLeaving > 0)
+		{
+			this->compact( bandIndex );
+		}
+	}
+
+	for (uint i = 0; i < moves_.size(); ++i)
+	{
+		this->append( moves_[i].pCache, moves_[i].band );
+	}
+
+	moves_.clear();
+
+	numVisitedLastTick_ = int( due.size() );
+}
+
+
+/**
+ *	This method is called for an entity returned by collectDue that the
+ *	witness did not get to this tick, for example because it ran out of
+ *	bandwidth. It will be returned first on the next tick.
+ */
+void WitnessPriorityQueue::defer( EntityCache * pCache )
+{
+	if (pCache->queueBand() != OVERDUE)
+	{
+		this->removeAt( pCache->queueBand(), pCache->queueSlot() );
+		this->append( pCache, OVERDUE );
+	}
+}
+
+
+/**
+ *	This method returns the number of entities in the queue.
+ */
+int WitnessPriorityQueue::size() const
+{
+	int total = 0;
+
+	for (int i = 0; i <= NUM_BANDS; ++i)
+	{
+		total += int( bands_[i].caches.size() );
+	}
+
+	return total;
+}
+
+
+/**
+ *	This method returns the number of entities in the given band. Passing
+ *	NUM_BANDS gives the number of overdue entities.
+ */
+int WitnessPriorityQueue::numInBand( int band ) const
+{
+	MF_ASSERT( (0 <= band) && (band <= NUM_BANDS) );
+
+	return int( bands_[ band ].caches.size() );
+}
+
+
+/**
+ *	This method returns the band that an entity belongs in.
+ */
+int WitnessPriorityQueue::bandFor( const EntityCache * pCache,
+		const Vector3 & origin ) const
+{
+	const Entity * pEntity = pCache->pEntity().get();
+
+	if (pEntity == NULL)
+	{
+		return 0;
+	}
+
+	float diffX = pEntity->position().x - origin.x;
+	float diffZ = pEntity->position().z - origin.z;
+
+	float scaledDistance = sqrtf( diffX * diffX + diffZ * diffZ ) *
+		invBandWidth_;
+
+	if (pEntity->aoiPriority() > 0.f)
+	{
+		scaledDistance /= pEntity->aoiPriority();
+	}
+
+	return (scaledDistance < float( NUM_BANDS - 1 )) ?
+		int( scaledDistance ) : NUM_BANDS - 1;
+}
+
+
+/**
+ *	This method removes the entities in a band that collectDue has marked as
+ *	leaving it. The order of the others is kept, and the cursor is moved back
+ *	so that it still points at the next entity due.
+ */
+void WitnessPriorityQueue::compact( int bandIndex )
+{
+	Band & band = bands_[ bandIndex ];
+	Caches & caches = band.caches;
+
+	uint numKept = 0;
+	uint cursor = band.cursor;
+
+	for (uint i = 0; i < caches.size(); ++i)
+	{
+		EntityCache * pCache = caches[i];
+
+		if (pCache->queueSlot() < 0)
+		{
+			if (i < band.cursor)
+			{
+				--cursor;
+			}
+		}
+		else
+		{
+			pCache->queuePosition( uint8( bandIndex ), int( numKept ) );
+			caches[ numKept++ ] = pCache;
+		}
+	}
+
+	caches.resize( numKept );
+	band.cursor = cursor;
+}
+
+
+/**
+ *	This method adds an entity to the end of a band.
+ */
+void WitnessPriorityQueue::append( EntityCache * pCache, int band )
+{
+	Caches & caches = bands_[ band ].caches;
+
+	pCache->queuePosition( uint8( band ), int( caches.size() ) );
+	caches.push_back( pCache );
+}
+
+
+/**
+ *	This method removes the entity at the given position. The last entity in
+ *	the band takes its place.
+ */
+void WitnessPriorityQueue::removeAt( int band, int slot )
+{
+	Caches & caches = bands_[ band ].caches;
+
+	MF_ASSERT( (0 <= slot) && (slot < int( caches.size() )) );
+
+	caches[ slot ] = caches.back();
+	caches[ slot ]->queuePosition( uint8( band ), slot );
+	caches.pop_back();
+}
+
+// witness_priority_queue.cpp
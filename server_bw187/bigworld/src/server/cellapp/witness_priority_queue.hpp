@@ -0,0 +1,102 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef WITNESS_PRIORITY_QUEUE_HPP
+#define WITNESS_PRIORITY_QUEUE_HPP
+
+#include "entity_cache.hpp"
+
+#include "math/vector3.hpp"
+
+#include <vector>
+
+
+/**
+ *	This class schedules the entities in a witness's AoI for update. It is an
+ *	alternative to keeping every EntityCache in a heap and recalculating every
+ *	priority each tick.
+ *
+ *	Entities are kept in distance bands. Band n is visited round-robin so that
+ *	each of its entities comes up once every n + 1 ticks, which roughly
+ *	follows the inverse-distance update rate of the priority heap. Distance
+ *	is only recalculated for an entity when its turn comes up, and it only
+ *	moves between bands when that distance puts it in a different band. An
+ *	entity's aoiPriority scales its distance, as it does in
+ *	EntityCache::updatePriority.
+ *
+ *	New entities, and due entities that the witness could not afford to send
+ *	(see defer), are kept on an overdue list that is returned ahead of
+ *	everything else on the next tick.
+ */
+class WitnessPriorityQueue
+{
+public:
+	typedef std::vector< EntityCache * > Caches;
+
+	static const int NUM_BANDS = 8;
+
+	WitnessPriorityQueue();
+
+	void bandWidth( float width );
+	float bandWidth() const				{ return bandWidth_; }
+
+	void add( EntityCache * pCache );
+	void remove( EntityCache * pCache );
+
+	void collectDue( const Vector3 & origin, Caches & due );
+	void defer( EntityCache * pCache );
+
+	int size() const;
+	int numInBand( int band ) const;
+	int numVisitedLastTick() const		{ return numVisitedLastTick_; }
+
+private:
+	/// The index of the overdue list. It is kept alongside the bands.
+	static const int OVERDUE = NUM_BANDS;
+
+	/**
+	 *	This structure is a list of entities that is visited round-robin.
+	 */
+	struct Band
+	{
+		Band() : cursor( 0 ) {}
+
+		Caches	caches;
+		uint	cursor;
+	};
+
+	/**
+	 *	This structure records an entity that needs to move to another band
+	 *	once the current pass is complete.
+	 */
+	struct Move
+	{
+		EntityCache *	pCache;
+		int				band;
+	};
+
+	int bandFor( const EntityCache * pCache, const Vector3 & origin ) const;
+
+	void append( EntityCache * pCache, int band );
+	void removeAt( int band, int slot );
+	void compact( int bandIndex );
+
+	Band	bands_[ NUM_BANDS + 1 ];
+
+	float	bandWidth_;
+	float	invBandWidth_;
+
+	int		numVisitedLastTick_;
+
+	std::vector< Move >	moves_;
+};
+
+#endif // WITNESS_PRIORITY_QUEUE_HPP
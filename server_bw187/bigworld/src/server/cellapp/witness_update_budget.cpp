@@ -0,0 +1,263 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "witness_update_budget.hpp"
+
+#include "cellapp.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/timestamp.hpp"
+#include "cstdmf/watcher.hpp"
+#include "server/bwconfig.hpp"
+
+DECLARE_DEBUG_COMPONENT(0)
+
+namespace
+{
+/// The weight given to the newest sample in each witness's average cost.
+const float AVERAGE_COST_BIAS = 0.1f;
+
+/// How often, in ticks, costs are checked for witnesses that have gone.
+const uint32 PRUNE_PERIOD = 100;
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: WitnessUpdateBudget
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ */
+WitnessUpdateBudget::WitnessUpdateBudget() :
+	hasReadConfig_( false ),
+	budgetFraction_( 0.5f ),
+	maxStride_( 4 ),
+	budgetStamps_( 0 ),
+	spentStamps_( 0 ),
+	lastSpentStamps_( 0 ),
+	stride_( 1 ),
+	tickCount_( 0 )
+{
+}
+
+
+/**
+ *	This static method returns the CellApp's witness update budget.
+ */
+WitnessUpdateBudget & WitnessUpdateBudget::instance()
+{
+	static WitnessUpdateBudget s_instance;
+	return s_instance;
+}
+
+
+/**
+ *	This method should be called once per game tick, before the witnesses
+ *	are updated. It adjusts the update stride based on what the witnesses
+ *	cost during the last tick.
+ */
+void WitnessUpdateBudget::tick()
+{
+	if (!hasReadConfig_)
+	{
+		this->readConfig();
+	}
+
+	lastSpentStamps_ = spentStamps_;
+	spentStamps_ = 0;
+	++tickCount_;
+
+	if (tickCount_ % PRUNE_PERIOD == 0)
+	{
+		this->pruneCosts();
+	}
+
+	if (budgetStamps_ == 0)
+	{
+		return;
+	}
+
+	if (lastSpentStamps_ > budgetStamps_)
+	{
+		if (stride_ < maxStride_)
+		{
+			++stride_;
+			INFO_MSG( "WitnessUpdateBudget::tick: "
+					"Witnesses took %.2fms of a %.2fms budget. "
+					"Now updating each witness every %d ticks\n",
+				this->lastTickCostMs(), this->budgetMs(), stride_ );
+		}
+	}
+	else if (stride_ > 1)
+	{
+		// Only one witness in stride_ was updated last tick. Estimate what
+		// they would all cost at the next smaller stride.
+		uint64 projected = lastSpentStamps_ * stride_ / (stride_ - 1);
+
+		if (projected < budgetStamps_)
+		{
+			--stride_;
+		}
+	}
+}
+
+
+/**
+ *	This method returns whether the witness of the given entity should be
+ *	updated this tick.
+ */
+bool WitnessUpdateBudget::shouldUpdate( ObjectID id ) const
+{
+	return (stride_ <= 1) || ((uint32( id ) + tickCount_) % stride_ == 0);
+}
+
+
+/**
+ *	This method should be called before a witness is updated. The result is
+ *	passed to endUpdate.
+ */
+uint64 WitnessUpdateBudget::startUpdate() const
+{
+	return timestamp();
+}
+
+
+/**
+ *	This method should be called after a witness has been updated. It records
+ *	what that update cost.
+ */
+void WitnessUpdateBudget::endUpdate( ObjectID id, uint64 startStamp )
+{
+	uint64 cost = timestamp() - startStamp;
+	spentStamps_ += cost;
+
+	Cost & entry = costs_[ id ];
+	entry.lastUs = float( double( cost ) * 1000000.0 / stampsPerSecondD() );
+
+	if (entry.numUpdates == 0)
+	{
+		entry.averageUs = entry.lastUs;
+	}
+	else
+	{
+		entry.averageUs += AVERAGE_COST_BIAS *
+			(entry.lastUs - entry.averageUs);
+	}
+
+	++entry.numUpdates;
+	entry.lastTick = tickCount_;
+}
+
+
+/**
+ *	This method should be called when a witness is destroyed.
+ */
+void WitnessUpdateBudget::removeWitness( ObjectID id )
+{
+	costs_.erase( id );
+}
+
+
+/**
+ *	This method forgets the costs of witnesses that have not been updated
+ *	for more than two of the longest strides. A witness that still exists
+ *	would have been updated in that time.
+ */
+void WitnessUpdateBudget::pruneCosts()
+{
+	uint32 maxAge = 2 * uint32( std::max( stride_, maxStride_ ) ) + 1;
+
+	Costs::iterator iter = costs_.begin();
+
+	while (iter != costs_.end())
+	{
+		if (tickCount_ - iter->second.lastTick > maxAge)
+		{
+			costs_.erase( iter++ );
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+
+/**
+ *	This method reads the budget from the configuration.
+ */
+void WitnessUpdateBudget::readConfig()
+{
+	hasReadConfig_ = true;
+
+	budgetFraction_ = BWConfig::get( "cellApp/witnessUpdateBudget",
+		budgetFraction_ );
+	maxStride_ = std::max( 1,
+		BWConfig::get( "cellApp/maxWitnessUpdateStride", maxStride_ ) );
+
+	int updateHertz = CellApp::instance().updateHertz();
+
+	budgetStamps_ = (budgetFraction_ > 0.f) && (updateHertz > 0) ?
+		uint64( stampsPerSecondD() * budgetFraction_ / updateHertz ) : 0;
+}
+
+
+/**
+ *	This method returns the time that the witnesses took during the last
+ *	tick, in milliseconds.
+ */
+float WitnessUpdateBudget::lastTickCostMs() const
+{
+	return float( double( lastSpentStamps_ ) * 1000.0 / stampsPerSecondD() );
+}
+
+
+/**
+ *	This method returns the budget, in milliseconds.
+ */
+float WitnessUpdateBudget::budgetMs() const
+{
+	return float( double( budgetStamps_ ) * 1000.0 / stampsPerSecondD() );
+}
+
+
+/**
+ *	This static method adds the watchers associated with this class.
+ */
+void WitnessUpdateBudget::addWatchers()
+{
+	WitnessUpdateBudget & budget = WitnessUpdateBudget::instance();
+
+	MF_WATCH( "witnesses/budget/stride", budget.stride_,
+		Watcher::WT_READ_ONLY );
+	MF_WATCH( "witnesses/budget/maxStride", budget.maxStride_ );
+	MF_WATCH( "witnesses/budget/budgetMs", budget,
+		&WitnessUpdateBudget::budgetMs );
+	MF_WATCH( "witnesses/budget/lastTickCostMs", budget,
+		&WitnessUpdateBudget::lastTickCostMs );
+
+	Watcher * pCostWatcher = new DirectoryWatcher();
+	Cost * pNullCost = NULL;
+
+	pCostWatcher->addChild( "lastUs", new DataWatcher<float>(
+		pNullCost->lastUs, Watcher::WT_READ_ONLY ) );
+	pCostWatcher->addChild( "averageUs", new DataWatcher<float>(
+		pNullCost->averageUs, Watcher::WT_READ_ONLY ) );
+	pCostWatcher->addChild( "numUpdates", new DataWatcher<uint32>(
+		pNullCost->numUpdates, Watcher::WT_READ_ONLY ) );
+
+	Watcher::rootWatcher().addChild( "witnesses/costs",
+		new MapWatcher<Costs>( budget.costs_ ) );
+	Watcher::rootWatcher().addChild( "witnesses/costs/*", pCostWatcher );
+}
+
+// witness_update_budget.cpp
@@ -0,0 +1,93 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef WITNESS_UPDATE_BUDGET_HPP
+#define WITNESS_UPDATE_BUDGET_HPP
+
+#include "network/basictypes.hpp"
+
+#include <map>
+
+
+/**
+ *	This class limits the CPU time the CellApp spends updating witnesses.
+ *
+ *	When the witnesses together take longer than the budget, the update
+ *	stride is increased so that each witness is only updated every stride
+ *	ticks, with the witnesses spread evenly across those ticks by entity id.
+ *	The stride drops back again once the projected cost fits the budget. This
+ *	lowers the update rate for every client a little, rather than letting the
+ *	game tick overrun.
+ *
+ *	The budget is cellApp/witnessUpdateBudget, as a fraction of a game tick,
+ *	and the stride is capped at cellApp/maxWitnessUpdateStride. The cost of
+ *	each witness is available under witnesses/costs in the watcher tree.
+ *	Witnesses that have not been updated for several strides are dropped
+ *	from there, in case removeWitness was not called for them.
+ */
+class WitnessUpdateBudget
+{
+public:
+	WitnessUpdateBudget();
+
+	static WitnessUpdateBudget & instance();
+
+	void tick();
+
+	bool shouldUpdate( ObjectID id ) const;
+
+	uint64 startUpdate() const;
+	void endUpdate( ObjectID id, uint64 startStamp );
+
+	void removeWitness( ObjectID id );
+
+	int stride() const					{ return stride_; }
+
+	static void addWatchers();
+
+private:
+	/**
+	 *	This structure records the cost of updating a single witness.
+	 */
+	struct Cost
+	{
+		Cost() : lastUs( 0.f ), averageUs( 0.f ), numUpdates( 0 ),
+			lastTick( 0 ) {}
+
+		float	lastUs;
+		float	averageUs;
+		uint32	numUpdates;
+		uint32	lastTick;
+	};
+
+	typedef std::map< ObjectID, Cost > Costs;
+
+	void readConfig();
+	void pruneCosts();
+
+	float lastTickCostMs() const;
+	float budgetMs() const;
+
+	bool	hasReadConfig_;
+	float	budgetFraction_;
+	int		maxStride_;
+
+	uint64	budgetStamps_;
+	uint64	spentStamps_;
+	uint64	lastSpentStamps_;
+
+	int		stride_;
+	uint32	tickCount_;
+
+	Costs	costs_;
+};
+
+#endif // WITNESS_UPDATE_BUDGET_HPP
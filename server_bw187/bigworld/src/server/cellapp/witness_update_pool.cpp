@@ -0,0 +1,355 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "witness_update_pool.hpp"
+
+#include "witness.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/timestamp.hpp"
+#include "cstdmf/watcher.hpp"
+#include "server/bwconfig.hpp"
+
+DECLARE_DEBUG_COMPONENT(0)
+
+namespace
+{
+/// The number of witnesses that a thread claims at a time.
+const int CHUNK_SIZE = 4;
+
+/// The worker that the current thread is acting as, if any.
+static THREADLOCAL( void * ) s_pCurrentWorker( NULL );
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: WitnessUpdatePool
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor.
+ *
+ *	@param numThreads	The number of threads to create. The main thread also
+ *						updates witnesses, so this does not include it.
+ */
+WitnessUpdatePool::WitnessUpdatePool( int numThreads ) :
+	workers_(),
+	mainThreadWorker_( *this, /* isMainThread */ true ),
+	doneSemaphore_(),
+	isStopping_( false ),
+	pWitnesses_( NULL ),
+	nextIndex_( 0 ),
+	lastParallelTime_( 0 ),
+	lastSerialTime_( 0 )
+{
+	for (int i = 0; i < numThreads; ++i)
+	{
+		workers_.push_back( new Worker( *this, /* isMainThread */ false ) );
+	}
+}
+
+
+/**
+ *	Destructor.
+ */
+WitnessUpdatePool::~WitnessUpdatePool()
+{
+	isStopping_ = true;
+
+	for (Workers::iterator iter = workers_.begin();
+			iter != workers_.end(); ++iter)
+	{
+		(*iter)->start();
+	}
+
+	for (Workers::iterator iter = workers_.begin();
+			iter != workers_.end(); ++iter)
+	{
+		delete *iter;
+	}
+
+	workers_.clear();
+}
+
+
+/**
+ *	This static method creates a WitnessUpdatePool if
+ *	cellApp/witnessUpdateThreads is greater than zero. Otherwise it returns
+ *	NULL, and witnesses should be updated on the main thread as usual.
+ */
+WitnessUpdatePool * WitnessUpdatePool::createFromConfig()
+{
+	int numThreads = BWConfig::get( "cellApp/witnessUpdateThreads", 0 );
+
+	if (numThreads <= 0)
+	{
+		return NULL;
+	}
+
+	INFO_MSG( "WitnessUpdatePool::createFromConfig: "
+			"Updating witnesses on %d extra threads\n", numThreads );
+
+	return new WitnessUpdatePool( numThreads );
+}
+
+
+/**
+ *	This method updates the given witnesses, and then sends their bundles.
+ *	It returns once this is complete.
+ */
+void WitnessUpdatePool::update( const Witnesses & witnesses )
+{
+	MF_ASSERT( !WitnessUpdatePool::inWorkerThread() );
+
+	if (witnesses.empty())
+	{
+		return;
+	}
+
+	uint64 startTime = timestamp();
+
+	pWitnesses_ = &witnesses;
+	nextIndex_ = 0;
+
+	for (Workers::iterator iter = workers_.begin();
+			iter != workers_.end(); ++iter)
+	{
+		(*iter)->start();
+	}
+
+	s_pCurrentWorker = &mainThreadWorker_;
+	mainThreadWorker_.work();
+	s_pCurrentWorker = NULL;
+
+	for (uint i = 0; i < workers_.size(); ++i)
+	{
+		doneSemaphore_.pull();
+	}
+
+	pWitnesses_ = NULL;
+
+	uint64 parallelEndTime = timestamp();
+	lastParallelTime_ = parallelEndTime - startTime;
+
+	mainThreadWorker_.runDeferred();
+
+	for (Workers::iterator iter = workers_.begin();
+			iter != workers_.end(); ++iter)
+	{
+		(*iter)->runDeferred();
+	}
+
+	this->sendAll( witnesses );
+
+	lastSerialTime_ = timestamp() - parallelEndTime;
+}
+
+
+/**
+ *	This static method returns whether the current thread is updating
+ *	witnesses for a WitnessUpdatePool. This is also true for the main thread
+ *	while it is helping the workers.
+ */
+bool WitnessUpdatePool::inWorkerThread()
+{
+	return s_pCurrentWorker != NULL;
+}
+
+
+/**
+ *	This static method arranges for the given task to be run on the main
+ *	thread once all witnesses have been updated. If the current thread is not
+ *	updating witnesses for a pool, the task is run straight away.
+ */
+void WitnessUpdatePool::deferToMainThread( MainThreadTask * pTask )
+{
+	Worker * pWorker = static_cast< Worker * >( (void *)s_pCurrentWorker );
+
+	if (pWorker != NULL)
+	{
+		pWorker->defer( pTask );
+	}
+	else
+	{
+		pTask->run();
+		delete pTask;
+	}
+}
+
+
+/**
+ *	This method sends the bundle of each of the given witnesses.
+ */
+void WitnessUpdatePool::sendAll( const Witnesses & witnesses )
+{
+	for (Witnesses::const_iterator iter = witnesses.begin();
+			iter != witnesses.end(); ++iter)
+	{
+		(*iter)->sendToClient();
+	}
+}
+
+
+/**
+ *	This method claims the next chunk of witnesses to update. It returns the
+ *	index of the first witness in the chunk.
+ */
+int WitnessUpdatePool::claimChunk()
+{
+	return atomic_add( nextIndex_, CHUNK_SIZE );
+}
+
+
+/**
+ *	This method returns how long the parallel part of the last update took,
+ *	in milliseconds.
+ */
+double WitnessUpdatePool::lastParallelTimeMs() const
+{
+	return double( lastParallelTime_ ) * 1000.0 / stampsPerSecondD();
+}
+
+
+/**
+ *	This method returns how long the main thread spent running deferred tasks
+ *	and sending bundles after the last update, in milliseconds.
+ */
+double WitnessUpdatePool::lastSerialTimeMs() const
+{
+	return double( lastSerialTime_ ) * 1000.0 / stampsPerSecondD();
+}
+
+
+/**
+ *	This method adds the watchers associated with this pool.
+ */
+void WitnessUpdatePool::addWatchers()
+{
+	MF_WATCH( "witnesses/pool/numThreads", *this,
+		&WitnessUpdatePool::numThreads );
+	MF_WATCH( "witnesses/pool/lastParallelTimeMs", *this,
+		&WitnessUpdatePool::lastParallelTimeMs );
+	MF_WATCH( "witnesses/pool/lastSerialTimeMs", *this,
+		&WitnessUpdatePool::lastSerialTimeMs );
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: WitnessUpdatePool::Worker
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor. Unless this is the main thread's worker, a thread is started
+ *	that waits to be told to work.
+ */
+WitnessUpdatePool::Worker::Worker( WitnessUpdatePool & pool,
+		bool isMainThread ) :
+	pool_( pool ),
+	startSemaphore_(),
+	pThread_( NULL ),
+	deferred_()
+{
+	if (!isMainThread)
+	{
+		pThread_ = new SimpleThread( &Worker::s_run, this );
+	}
+}
+
+
+/**
+ *	Destructor. The pool must already have told this worker to stop.
+ */
+WitnessUpdatePool::Worker::~Worker()
+{
+	// This joins the thread.
+	delete pThread_;
+
+	for (Tasks::iterator iter = deferred_.begin();
+			iter != deferred_.end(); ++iter)
+	{
+		delete *iter;
+	}
+}
+
+
+/**
+ *	This method updates chunks of witnesses until there are none left.
+ */
+void WitnessUpdatePool::Worker::work()
+{
+	const Witnesses & witnesses = *pool_.pWitnesses_;
+	const int numWitnesses = int( witnesses.size() );
+
+	int begin = pool_.claimChunk();
+
+	while (begin < numWitnesses)
+	{
+		int end = std::min( begin + CHUNK_SIZE, numWitnesses );
+
+		for (int i = begin; i < end; ++i)
+		{
+			witnesses[i]->update();
+		}
+
+		begin = pool_.claimChunk();
+	}
+}
+
+
+/**
+ *	This method runs and deletes the tasks that this worker deferred during
+ *	the last update. It must be called from the main thread.
+ */
+void WitnessUpdatePool::Worker::runDeferred()
+{
+	for (Tasks::iterator iter = deferred_.begin();
+			iter != deferred_.end(); ++iter)
+	{
+		(*iter)->run();
+		delete *iter;
+	}
+
+	deferred_.clear();
+}
+
+
+/**
+ *	This static method is the entry point of a worker thread.
+ */
+void WitnessUpdatePool::Worker::s_run( void * arg )
+{
+	static_cast< Worker * >( arg )->run();
+}
+
+
+/**
+ *	This method is the body of a worker thread.
+ */
+void WitnessUpdatePool::Worker::run()
+{
+	s_pCurrentWorker = this;
+
+	while (true)
+	{
+		startSemaphore_.pull();
+
+		if (pool_.isStopping_)
+		{
+			break;
+		}
+
+		this->work();
+
+		pool_.doneSemaphore_.push();
+	}
+}
+
+// witness_update_pool.cpp
@@ -0,0 +1,123 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef WITNESS_UPDATE_POOL_HPP
+#define WITNESS_UPDATE_POOL_HPP
+
+#include "cstdmf/concurrency.hpp"
+
+#include <vector>
+
+class Witness;
+
+
+/**
+ *	This class updates the witnesses for a game tick on a pool of worker
+ *	threads.
+ *
+ *	The witnesses are handed out to the workers, and to the main thread, in
+ *	small chunks until none are left. Each witness only writes to its own
+ *	client bundle, so the workers do not need to lock each other out. Once
+ *	every witness has been updated, the main thread runs anything that was
+ *	deferred with deferToMainThread, in worker order, and then sends each
+ *	witness's bundle in the order that the witnesses were passed in.
+ *
+ *	Code run by Witness::update must not touch Python while on a worker
+ *	thread. This includes copying an EntityPtr, since that changes the
+ *	entity's reference count. Anything that does, such as the aoiUpdates_
+ *	callbacks, should be wrapped in a MainThreadTask and passed to
+ *	deferToMainThread. Witness::update should also leave the sending of its
+ *	bundle to this class when inWorkerThread returns true.
+ *
+ *	This is enabled by setting cellApp/witnessUpdateThreads to the number of
+ *	extra threads to use.
+ */
+class WitnessUpdatePool
+{
+public:
+	typedef std::vector< Witness * > Witnesses;
+
+	/**
+	 *	This class is work that a witness update needs done on the main
+	 *	thread. It is deleted once it has been run.
+	 */
+	class MainThreadTask
+	{
+	public:
+		virtual ~MainThreadTask() {}
+		virtual void run() = 0;
+	};
+
+	WitnessUpdatePool( int numThreads );
+	~WitnessUpdatePool();
+
+	static WitnessUpdatePool * createFromConfig();
+
+	void update( const Witnesses & witnesses );
+
+	static bool inWorkerThread();
+	static void deferToMainThread( MainThreadTask * pTask );
+
+	int numThreads() const			{ return int( workers_.size() ); }
+
+	void addWatchers();
+
+private:
+	/**
+	 *	This class is a thread in the pool, or the main thread while it is
+	 *	helping out.
+	 */
+	class Worker
+	{
+	public:
+		Worker( WitnessUpdatePool & pool, bool isMainThread );
+		~Worker();
+
+		void start()				{ startSemaphore_.push(); }
+		void work();
+		void runDeferred();
+
+		void defer( MainThreadTask * pTask )	{ deferred_.push_back( pTask ); }
+
+	private:
+		static void s_run( void * arg );
+		void run();
+
+		typedef std::vector< MainThreadTask * > Tasks;
+
+		WitnessUpdatePool &	pool_;
+		SimpleSemaphore		startSemaphore_;
+		SimpleThread *		pThread_;
+		Tasks				deferred_;
+	};
+
+	typedef std::vector< Worker * > Workers;
+
+	void sendAll( const Witnesses & witnesses );
+	int claimChunk();
+
+	Workers				workers_;
+	Worker				mainThreadWorker_;
+
+	SimpleSemaphore		doneSemaphore_;
+	volatile bool		isStopping_;
+
+	const Witnesses *	pWitnesses_;
+	volatile int		nextIndex_;
+
+	uint64				lastParallelTime_;
+	uint64				lastSerialTime_;
+
+	double lastParallelTimeMs() const;
+	double lastSerialTimeMs() const;
+};
+
+#endif // WITNESS_UPDATE_POOL_HPP
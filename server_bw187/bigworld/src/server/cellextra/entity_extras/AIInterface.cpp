@@ -1,6 +1,9 @@
 #include "AIInterface.hpp"
 #include "../utils/py_array_proxy.hpp"
 
+#include "cstdmf/timestamp.hpp"
+#include "cstdmf/watcher.hpp"
+
 DECLARE_DEBUG_COMPONENT( 0 )
 
 PY_TYPEOBJECT( AIInterface )
@@ -16,12 +19,122 @@ PY_END_ATTRIBUTES()
 const AIInterface::Instance<AIInterface>
 	AIInterface::instance( &AIInterface::s_attributes_.di_ );
 
+/**
+* The names of the methods that the heartbeat calls. They are interned once
+* and called with PyObject_CallMethodObjArgs, so that no format string is
+* parsed and no attribute string is built on each call.
+*/
+namespace
+{
+	PyObject * s_pIntonating = NULL;
+	PyObject * s_pInHomingSpell = NULL;
+	PyObject * s_pDoComboAI = NULL;
+	PyObject * s_pComboAICheck = NULL;
+	PyObject * s_pOnSpecialAINotDo = NULL;
+	PyObject * s_pSetAITargetID = NULL;
+	PyObject * s_pIsEAI = NULL;
+	PyObject * s_pDo = NULL;
+	PyObject * s_pCheck = NULL;
+	PyObject * s_pGetID = NULL;
+	PyObject * s_pGetActiveRate = NULL;
+	PyObject * s_pZero = NULL;
+
+	// Heartbeat cost, for benchmarking with many monsters.
+	int s_numAIInterfaces = 0;
+	uint32 s_numHeartbeats = 0;
+	uint32 s_numActiveHeartbeats = 0;
+	uint64 s_heartbeatStamps = 0;
+
+	void initInternedNames()
+	{
+		if (s_pIntonating != NULL)
+			return;
+
+		s_pIntonating = PyString_InternFromString( "intonating" );
+		s_pInHomingSpell = PyString_InternFromString( "inHomingSpell" );
+		s_pDoComboAI = PyString_InternFromString( "doComboAI" );
+		s_pComboAICheck = PyString_InternFromString( "comboAICheck" );
+		s_pOnSpecialAINotDo = PyString_InternFromString( "onSpecialAINotDo" );
+		s_pSetAITargetID = PyString_InternFromString( "setAITargetID" );
+		s_pIsEAI = PyString_InternFromString( "isEAI" );
+		s_pDo = PyString_InternFromString( "do" );
+		s_pCheck = PyString_InternFromString( "check" );
+		s_pGetID = PyString_InternFromString( "getID" );
+		s_pGetActiveRate = PyString_InternFromString( "getActiveRate" );
+		s_pZero = PyInt_FromLong( 0 );
+	}
+
+	double heartbeatTotalMs()
+	{
+		return double( s_heartbeatStamps ) * 1000.0 / stampsPerSecondD();
+	}
+
+	double heartbeatAverageUs()
+	{
+		return s_numHeartbeats ?
+			double( s_heartbeatStamps ) * 1000000.0 /
+				stampsPerSecondD() / s_numHeartbeats : 0.0;
+	}
+
+	void addHeartbeatWatchers()
+	{
+		MF_WATCH( "cellextra/aiHeartbeat/numMonsters", s_numAIInterfaces,
+			Watcher::WT_READ_ONLY,
+			"The number of entities with an AIInterface extra" );
+		MF_WATCH( "cellextra/aiHeartbeat/numHeartbeats", s_numHeartbeats,
+			Watcher::WT_READ_ONLY,
+			"The number of heartbeats since the stats were reset" );
+		MF_WATCH( "cellextra/aiHeartbeat/numActiveHeartbeats",
+			s_numActiveHeartbeats, Watcher::WT_READ_ONLY,
+			"The number of those heartbeats that got past the fight checks" );
+		MF_WATCH( "cellextra/aiHeartbeat/totalMs", &heartbeatTotalMs );
+		MF_WATCH( "cellextra/aiHeartbeat/averageUs", &heartbeatAverageUs );
+	}
+}
+
 AIInterface::AIInterface( Entity &e ): EntityExtra( e )
 {
+	static bool s_addedWatchers = false;
+	if (!s_addedWatchers)
+	{
+		addHeartbeatWatchers();
+		s_addedWatchers = true;
+	}
+
+	initInternedNames();
+	++s_numAIInterfaces;
+
+	this->bindProperty( state_.fightStateAICount, "fightStateAICount" );
+	this->bindProperty( state_.fightStartTime, "fightStartTime" );
+	this->bindProperty( state_.attrAINowLevel, "attrAINowLevel" );
+	this->bindProperty( state_.attrAINowLevelTemp, "attrAINowLevelTemp" );
+	this->bindProperty( state_.attrAttackStateGenericAIs,
+		"attrAttackStateGenericAIs" );
+	this->bindProperty( state_.attrSchemeAIs, "attrSchemeAIs" );
+	this->bindProperty( state_.attrSpecialAIs, "attrSpecialAIs" );
+	this->bindProperty( state_.comboAIArray, "comboAIArray" );
+	this->bindProperty( state_.comboAIState, "comboAIState" );
+	this->bindProperty( state_.insert_ai, "insert_ai" );
+	this->bindProperty( state_.saiArray, "saiArray" );
 }
 
 AIInterface::~AIInterface()
 {
+	--s_numAIInterfaces;
+
+	// The names are interned, so they are kept alive by the interned string
+	// table. This only drops the references taken by bindProperty.
+	Py_XDECREF( state_.fightStateAICount.pName );
+	Py_XDECREF( state_.fightStartTime.pName );
+	Py_XDECREF( state_.attrAINowLevel.pName );
+	Py_XDECREF( state_.attrAINowLevelTemp.pName );
+	Py_XDECREF( state_.attrAttackStateGenericAIs.pName );
+	Py_XDECREF( state_.attrSchemeAIs.pName );
+	Py_XDECREF( state_.attrSpecialAIs.pName );
+	Py_XDECREF( state_.comboAIArray.pName );
+	Py_XDECREF( state_.comboAIState.pName );
+	Py_XDECREF( state_.insert_ai.pName );
+	Py_XDECREF( state_.saiArray.pName );
 }
 
 
@@ -37,45 +150,158 @@ int AIInterface::pySetAttribute( const char * attr, PyObject * value )
 	return this->EntityExtra::pySetAttribute( attr, value );
 }
 
+/**
+* Reset the heartbeat benchmark counters. The number of monsters is not reset.
+*/
+void AIInterface::resetHeartbeatStats()
+{
+	s_numHeartbeats = 0;
+	s_numActiveHeartbeats = 0;
+	s_heartbeatStamps = 0;
+}
+
+void resetAIHeartbeatStats_csol()
+{
+	AIInterface::resetHeartbeatStats();
+}
+PY_AUTO_MODULE_FUNCTION( RETVOID, resetAIHeartbeatStats_csol, END, BigWorld )
+
+/**
+* Bind an AI attribute. Unlike GameObject::getPropertyLocalIndex, a missing
+* def property is not an error, since most AI attributes are script-only.
+*/
+void AIInterface::bindProperty( AIProperty & property, const char * name )
+{
+	DataDescription * pDescription = entity_.pType()->description( name );
+	property.localIndex = (pDescription != NULL) ?
+		pDescription->localIndex() : -1;
+	property.pName = PyString_InternFromString( name );
+}
+
+/**
+* Get the value of an AI attribute. Returns a new reference, or NULL with the
+* Python error set.
+*/
+PyObject * AIInterface::getProperty( const AIProperty & property )
+{
+	if (property.localIndex != -1)
+	{
+		PyObject * pValue =
+			entity_.propertyByLocalIndex( property.localIndex ).getObject();
+		if (pValue != NULL)
+		{
+			Py_INCREF( pValue );
+			return pValue;
+		}
+	}
+
+	return PyObject_GetAttr( ( PyObject * )&entity_, property.pName );
+}
+
+/**
+* Set an AI attribute. This always goes through the entity so that def
+* properties are propagated as usual.
+*/
+void AIInterface::setProperty( const AIProperty & property, PyObject * pValue )
+{
+	if (PyObject_SetAttr( ( PyObject * )&entity_, property.pName, pValue ) == -1)
+	{
+		PyErr_Print();
+	}
+}
+
+/**
+* Call a method on this entity. Returns a new reference.
+*/
+PyObject * AIInterface::callMethod( PyObject * pName, PyObject * pArg )
+{
+	return PyObject_CallMethodObjArgs( ( PyObject * )&entity_, pName,
+		pArg, NULL );
+}
+
+/**
+* Run an AI object against this entity.
+*/
+void AIInterface::runAI( PyObject * pAI )
+{
+	PyObject * pResult = PyObject_CallMethodObjArgs( pAI, s_pDo,
+		( PyObject * )&entity_, NULL );
+	Py_XDECREF( pResult );
+}
+
+/**
+* Run the first AI in the list that passes its checks. Returns whether one
+* was run.
+*/
+bool AIInterface::runFirstAI( PyObject * pAIList )
+{
+	Py_ssize_t size = PyList_Size( pAIList );
+	for (Py_ssize_t index = 0; index < size; index++)
+	{
+		PyObject * pAI = PyList_GetItem( pAIList, index );
+		if( aiCommonCheck_AIInterface_cpp( pAI ) )
+		{
+			this->runAI( pAI );
+			return true;
+		}
+	}
+	return false;
+}
+
 void AIInterface::onFightAIHeartbeat_AIInterface_cpp()
 {
-	PyObject * pySelfEntityPtr = ( PyObject * )&entity_;
-	PyObject *pTempObjRef1, *pTempObjRef2, *pTempObjRef3;
+	uint64 startStamp = timestamp();
 
-	pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr, "fightStateAICount" );
-	if( PyInt_AS_LONG( pTempObjRef1 ) <= 0 ){
-		Py_XDECREF( pTempObjRef1 );
+	this->onFightAIHeartbeat();
+
+	s_heartbeatStamps += timestamp() - startStamp;
+	++s_numHeartbeats;
+}
+
+void AIInterface::onFightAIHeartbeat()
+{
+	PyObject *pTempObjRef1, *pTempObjRef2;
+
+	pTempObjRef1 = this->getProperty( state_.fightStateAICount );
+	if( pTempObjRef1 == NULL ){
+		PyErr_Print();
 		return;
 	}
-	Py_XDECREF( pTempObjRef1 );
+	if( PyInt_AsLong( pTempObjRef1 ) <= 0 ){
+		Py_DECREF( pTempObjRef1 );
+		return;
+	}
+	Py_DECREF( pTempObjRef1 );
 
-	pTempObjRef1 = PyObject_CallMethod( pySelfEntityPtr, "intonating", NULL );
+	pTempObjRef1 = this->callMethod( s_pIntonating );
 	if( pTempObjRef1 == Py_True )
 	{
-		Py_XDECREF( pTempObjRef1 );
+		Py_DECREF( pTempObjRef1 );
 		return;
 	}
 	Py_XDECREF( pTempObjRef1 );
 
-	pTempObjRef1 = PyObject_CallMethod( pySelfEntityPtr, "inHomingSpell", NULL );
+	pTempObjRef1 = this->callMethod( s_pInHomingSpell );
 	if( pTempObjRef1 == Py_True )
 	{
-		Py_XDECREF( pTempObjRef1 );
+		Py_DECREF( pTempObjRef1 );
 		return;
 	}
 	Py_XDECREF( pTempObjRef1 );
 
-	pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr, "fightStartTime" );
-	if( PyFloat_AsDouble( pTempObjRef1 ) == 0.0 ){
+	++s_numActiveHeartbeats;
+
+	pTempObjRef1 = this->getProperty( state_.fightStartTime );
+	if( pTempObjRef1 != NULL && PyFloat_AsDouble( pTempObjRef1 ) == 0.0 ){
 		pTempObjRef2 = PyFloat_FromDouble( time( NULL ) );
-		PyObject_SetAttrString( pySelfEntityPtr, "fightStartTime", pTempObjRef2 );
+		this->setProperty( state_.fightStartTime, pTempObjRef2 );
 		Py_XDECREF( pTempObjRef2 );
 	}
 	Py_XDECREF( pTempObjRef1 );
 
 	//ƥAIеȼ
-	pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr, "attrAINowLevelTemp" );
-	PyObject *pAINowLevel = PyObject_GetAttrString( pySelfEntityPtr, "attrAINowLevel" );
+	pTempObjRef1 = this->getProperty( state_.attrAINowLevelTemp );
+	PyObject *pAINowLevel = this->getProperty( state_.attrAINowLevel );
 
 	/*
 	PyObject *tmp = PyInt_FromLong(10);
@@ -92,176 +318,170 @@ void AIInterface::onFightAIHeartbeat_AIInterface_cpp()
 	PyObject_GetAttrString»ȡԵֵȵPyObject_GetAttrString
 	õָָĶ󽫲޸ĵֵ
 	*/
+	if( pTempObjRef1 == NULL || pAINowLevel == NULL )
+	{
+		PyErr_Print();
+		Py_XDECREF( pTempObjRef1 );
+		Py_XDECREF( pAINowLevel );
+		return;
+	}
 
 	if(PyInt_AS_LONG( pTempObjRef1 ) != PyInt_AS_LONG( pAINowLevel )){
-		PyObject_SetAttrString( pySelfEntityPtr, "attrAINowLevel", pTempObjRef1 );
-		Py_XDECREF( pAINowLevel );
-		pAINowLevel = PyObject_GetAttrString( pySelfEntityPtr, "attrAINowLevel" );
+		this->setProperty( state_.attrAINowLevel, pTempObjRef1 );
+		Py_DECREF( pAINowLevel );
+		pAINowLevel = this->getProperty( state_.attrAINowLevel );
+		if( pAINowLevel == NULL )
+		{
+			PyErr_Print();
+			Py_DECREF( pTempObjRef1 );
+			return;
+		}
 	}
-	Py_XDECREF( pTempObjRef1 );
+	Py_DECREF( pTempObjRef1 );
+
+	// Held for the rest of the heartbeat, since a script can change the
+	// attribute while the AIs run.
+	PyObjectPtr pNowLevel( pAINowLevel, PyObjectPtr::STEAL_REFERENCE );
 
 	//ִͨAIѭ
-	pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr,"attrAttackStateGenericAIs" );
-	pTempObjRef2 = PyDict_GetItem( pTempObjRef1, pAINowLevel );
-	Py_XDECREF( pTempObjRef1 );
+	pTempObjRef1 = this->getProperty( state_.attrAttackStateGenericAIs );
+	pTempObjRef2 = pTempObjRef1 ? PyDict_GetItem( pTempObjRef1, pAINowLevel ) : NULL;
 	if( pTempObjRef2 != NULL ){
 		int16 commonAIListSize = PyList_Size( pTempObjRef2 );
 		int16 index = 0;
 		while( commonAIListSize > index ){
 			if( entity().isDestroyed() && !entity().isReal() ){
-				Py_XDECREF( pAINowLevel );
+				Py_XDECREF( pTempObjRef1 );
 				return;
 			}
-			pTempObjRef1 = PyList_GetItem( pTempObjRef2, index );
-			if( aiCommonCheck_AIInterface_cpp( pTempObjRef1 ) ){
-				pTempObjRef3 = PyObject_CallMethod( pTempObjRef1, "do", "O", pySelfEntityPtr );
-				Py_XDECREF( pTempObjRef3 );
+			PyObject * pAI = PyList_GetItem( pTempObjRef2, index );
+			if( aiCommonCheck_AIInterface_cpp( pAI ) ){
+				this->runAI( pAI );
 			}
 			index++;
 		}
 	}
+	Py_XDECREF( pTempObjRef1 );
 
 	//AIִAI
-	pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr, "comboAIArray" );
-	PyArrayProxy comboAIArray = PyArrayProxy(pTempObjRef1);
-	if (comboAIArray.length() > 0)
+	pTempObjRef1 = this->getProperty( state_.comboAIArray );
+	if( pTempObjRef1 != NULL )
 	{
-		pTempObjRef2 = PyObject_CallMethod( pySelfEntityPtr, "doComboAI", NULL );
-		Py_XDECREF( pTempObjRef2 );
+		PyArrayProxy comboAIArray( pTempObjRef1 );
+		if (comboAIArray.length() > 0)
+		{
+			pTempObjRef2 = this->callMethod( s_pDoComboAI );
+			Py_XDECREF( pTempObjRef2 );
+		}
+		Py_DECREF( pTempObjRef1 );
 	}
-	Py_XDECREF( pTempObjRef1 );
 
 	//AIִ״̬
-	PyObject * pComboAIState = PyObject_GetAttrString( pySelfEntityPtr, "comboAIState" );
+	PyObject * pComboAIState = this->getProperty( state_.comboAIState );
 	if( pComboAIState == Py_False )
 	{
-		Py_XDECREF( pComboAIState );
-
 		//ִAIѭ
 		bool tempAICheckResult = false;
-		pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr,"insert_ai" );
-		if(pTempObjRef1 != Py_None){
+		pTempObjRef1 = this->getProperty( state_.insert_ai );
+		if( pTempObjRef1 != NULL && pTempObjRef1 != Py_None ){
 			if( aiCommonCheck_AIInterface_cpp( pTempObjRef1 ) ){
-				pTempObjRef3 = PyObject_CallMethod( pTempObjRef1, "do", "O", pySelfEntityPtr );
-				Py_XDECREF( pTempObjRef3 );
+				this->runAI( pTempObjRef1 );
 				tempAICheckResult = true;
 			}
 		}
 		Py_XDECREF( pTempObjRef1 );
 
 		if( tempAICheckResult == false ){
-			pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr,"attrSchemeAIs" );
-			pTempObjRef2 = PyDict_GetItem( pTempObjRef1, pAINowLevel );
-			Py_XDECREF( pTempObjRef1 );
+			pTempObjRef1 = this->getProperty( state_.attrSchemeAIs );
+			pTempObjRef2 = pTempObjRef1 ? PyDict_GetItem( pTempObjRef1, pAINowLevel ) : NULL;
 			if(pTempObjRef2 != NULL ){
-				int16 schemeAIListSize = PyList_Size( pTempObjRef2 );
-				for(int index = 0; index < schemeAIListSize; index++){
-					pTempObjRef1 = PyList_GetItem( pTempObjRef2, index );
-					if( aiCommonCheck_AIInterface_cpp( pTempObjRef1 ) ){
-						pTempObjRef3 = PyObject_CallMethod( pTempObjRef1, "do", "O", pySelfEntityPtr );
-						Py_XDECREF( pTempObjRef3 );
-						break;
-					}
-				}
+				this->runFirstAI( pTempObjRef2 );
 			}
+			Py_XDECREF( pTempObjRef1 );
 		}
 
 		if( entity().isDestroyed() ){
-			Py_XDECREF( pAINowLevel );
+			Py_DECREF( pComboAIState );
 			return;
 		}
 
 		//AIִм
-		pTempObjRef1 = PyObject_CallMethod( pySelfEntityPtr, "comboAICheck", NULL );
-		long comboID = PyInt_AS_LONG( pTempObjRef1 );
-		Py_XDECREF( pTempObjRef1 );
-
-		if( comboID > 0 )
+		pTempObjRef1 = this->callMethod( s_pComboAICheck );
+		if( pTempObjRef1 != NULL && PyInt_AsLong( pTempObjRef1 ) > 0 )
 		{
-			pTempObjRef1 = PyObject_CallMethod( pySelfEntityPtr, "doComboAI", "i", comboID );
-			Py_XDECREF( pTempObjRef1 );
+			pTempObjRef2 = this->callMethod( s_pDoComboAI, pTempObjRef1 );
+			Py_XDECREF( pTempObjRef2 );
 		}
+		Py_XDECREF( pTempObjRef1 );
 
 		//ٴμAIִ״̬
-		PyObject * pInnerComboAIState = PyObject_GetAttrString( pySelfEntityPtr, "comboAIState" );
+		PyObject * pInnerComboAIState = this->getProperty( state_.comboAIState );
 		if( pInnerComboAIState == Py_False )
 		{
-			Py_XDECREF( pInnerComboAIState );
-
 			//ִAIѭ
 			tempAICheckResult = false;
 
-			pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr, "saiArray" );
-			PyArrayProxy * pSaiArray = new PyArrayProxy( pTempObjRef1 );
-
-			if( pSaiArray->length() > 0 )
+			pTempObjRef1 = this->getProperty( state_.saiArray );
+			if( pTempObjRef1 != NULL )
 			{
-				pTempObjRef2 = pSaiArray->pop( 0 );
-				if( aiCommonCheck_AIInterface_cpp( pTempObjRef2 ) )
-				{
-					pTempObjRef3 = PyObject_CallMethod( pTempObjRef2, "do", "O", pySelfEntityPtr );
-					Py_XDECREF( pTempObjRef3 );
-					tempAICheckResult = true;
-				}
-				else
+				PyArrayProxy saiArray( pTempObjRef1 );
+
+				if( saiArray.length() > 0 )
 				{
-					pSaiArray->clear();
+					pTempObjRef2 = saiArray.pop( 0 );
+					if( aiCommonCheck_AIInterface_cpp( pTempObjRef2 ) )
+					{
+						this->runAI( pTempObjRef2 );
+						tempAICheckResult = true;
+					}
+					else
+					{
+						saiArray.clear();
+					}
+					Py_XDECREF( pTempObjRef2 );
 				}
-				Py_XDECREF( pTempObjRef2 );
-			}
 
-			delete pSaiArray;
-			Py_XDECREF( pTempObjRef1 );
+				Py_DECREF( pTempObjRef1 );
+			}
 
 			if( tempAICheckResult == false )
 			{
 				bool doSuccess = false;
 
-				pTempObjRef1 = PyObject_GetAttrString( pySelfEntityPtr,"attrSpecialAIs" );
-				pTempObjRef2 = PyDict_GetItem( pTempObjRef1, pAINowLevel );
-				Py_XDECREF( pTempObjRef1 );
+				pTempObjRef1 = this->getProperty( state_.attrSpecialAIs );
+				pTempObjRef2 = pTempObjRef1 ? PyDict_GetItem( pTempObjRef1, pAINowLevel ) : NULL;
 
 				if(pTempObjRef2 != NULL)
 				{
-					int16 schemeAIListSize = PyList_Size( pTempObjRef2 );
-					for(int index = 0; index < schemeAIListSize; index++)
-					{
-						pTempObjRef1 = PyList_GetItem( pTempObjRef2, index );
-						if( aiCommonCheck_AIInterface_cpp( pTempObjRef1 ) )
-						{
-							pTempObjRef3 = PyObject_CallMethod( pTempObjRef1, "do", "O", pySelfEntityPtr );
-							Py_XDECREF( pTempObjRef3 );
-							doSuccess = true;
-							break;
-						}
-					}
+					doSuccess = this->runFirstAI( pTempObjRef2 );
 				}
+				Py_XDECREF( pTempObjRef1 );
 
 				if( !doSuccess )
 				{
-					pTempObjRef1 = PyObject_CallMethod( pySelfEntityPtr, "onSpecialAINotDo", NULL );
+					pTempObjRef1 = this->callMethod( s_pOnSpecialAINotDo );
 					Py_XDECREF( pTempObjRef1 );
 				}
 			}
-			Py_XDECREF( pAINowLevel );
 			if( entity().isDestroyed() ){
+				Py_XDECREF( pInnerComboAIState );
+				Py_DECREF( pComboAIState );
 				return;
 			}
 		}
-		else
-		{
-			Py_XDECREF( pInnerComboAIState );
-		}
-	}
-	else
-	{
-		Py_XDECREF( pComboAIState );
+		Py_XDECREF( pInnerComboAIState );
 	}
+	Py_XDECREF( pComboAIState );
 
-	pTempObjRef1 = PyObject_CallMethod( pySelfEntityPtr, "setAITargetID", "i", 0 );
+	pTempObjRef1 = this->callMethod( s_pSetAITargetID, s_pZero );
 	Py_XDECREF( pTempObjRef1 );
 
-	PyObject_SetAttrString( pySelfEntityPtr, "comboAIState", Py_False );
+	this->setProperty( state_.comboAIState, Py_False );
+
+	if( PyErr_Occurred() )
+	{
+		PyErr_Print();
+	}
 }
 
 
@@ -270,20 +490,30 @@ bool AIInterface::aiCommonCheck_AIInterface_cpp( PyObject *pAIObj )
 	PyObject *pySelfEntityPtr = (PyObject *)(&entity_);
 	PyObject *pTempObjRef1, *pTempObjRef2;
 
+	if( pAIObj == NULL )
+	{
+		return false;
+	}
+
 	// aiǷһeai ǵĻ
-	pTempObjRef1 = PyObject_CallMethod( pAIObj, "getID", NULL );
-	pTempObjRef2 = PyObject_CallMethod( pySelfEntityPtr, "isEAI", "i", PyInt_AsLong( pTempObjRef1 ) );
-	Py_XDECREF( pTempObjRef1 );
+	pTempObjRef1 = PyObject_CallMethodObjArgs( pAIObj, s_pGetID, NULL );
+	if( pTempObjRef1 == NULL )
+	{
+		PyErr_Print();
+		return false;
+	}
+	pTempObjRef2 = this->callMethod( s_pIsEAI, pTempObjRef1 );
+	Py_DECREF( pTempObjRef1 );
 	if( pTempObjRef2 == Py_True )
 	{
-		Py_XDECREF( pTempObjRef2 );
+		Py_DECREF( pTempObjRef2 );
 		return false;
 	}
 	Py_XDECREF( pTempObjRef2 );
 
 	//ִaiĻ
-	pTempObjRef1 = PyObject_CallMethod( pAIObj, "getActiveRate", NULL );
-	long activeRate = PyInt_AsLong( pTempObjRef1 );
+	pTempObjRef1 = PyObject_CallMethodObjArgs( pAIObj, s_pGetActiveRate, NULL );
+	long activeRate = pTempObjRef1 ? PyInt_AsLong( pTempObjRef1 ) : 0;
 	Py_XDECREF( pTempObjRef1 );
 	if(activeRate < 100)
 	{
@@ -292,10 +522,11 @@ bool AIInterface::aiCommonCheck_AIInterface_cpp( PyObject *pAIObj )
 	}
 
 	// ai
-	pTempObjRef1 = PyObject_CallMethod( pAIObj, "check", "O", pySelfEntityPtr );
+	pTempObjRef1 = PyObject_CallMethodObjArgs( pAIObj, s_pCheck,
+		pySelfEntityPtr, NULL );
 	if(pTempObjRef1 == Py_False)
 	{
-		Py_XDECREF( pTempObjRef1 );
+		Py_DECREF( pTempObjRef1 );
 		return false;
 	}
 	Py_XDECREF( pTempObjRef1 );
@@ -23,11 +23,57 @@ public:
 	PY_AUTO_METHOD_DECLARE( RETDATA, aiCommonCheck_AIInterface_cpp, ARG( PyObject*, END ) );
 	bool aiCommonCheck_AIInterface_cpp( PyObject* );
 
+	static void resetHeartbeatStats();
+
 	static const Instance<AIInterface> instance;
+
+private:
+	/**
+	 *	An entity attribute that the heartbeat reads. Attributes that are
+	 *	defined in the entity's def file are read straight from the entity's
+	 *	property list by local index, the same way GameObject reads state,
+	 *	utype and flags. Script-only attributes, and all writes, go through
+	 *	the interned name.
+	 */
+	struct AIProperty
+	{
+		int			localIndex;
+		PyObject *	pName;
+	};
+
+	/**
+	 *	The AI state that the heartbeat uses. It is bound once, when the
+	 *	extra is created.
+	 */
+	struct AIState
+	{
+		AIProperty	fightStateAICount;
+		AIProperty	fightStartTime;
+		AIProperty	attrAINowLevel;
+		AIProperty	attrAINowLevelTemp;
+		AIProperty	attrAttackStateGenericAIs;
+		AIProperty	attrSchemeAIs;
+		AIProperty	attrSpecialAIs;
+		AIProperty	comboAIArray;
+		AIProperty	comboAIState;
+		AIProperty	insert_ai;
+		AIProperty	saiArray;
+	};
+
+	void bindProperty( AIProperty & property, const char * name );
+	PyObject * getProperty( const AIProperty & property );
+	void setProperty( const AIProperty & property, PyObject * pValue );
+
+	PyObject * callMethod( PyObject * pName, PyObject * pArg = NULL );
+	void runAI( PyObject * pAI );
+	bool runFirstAI( PyObject * pAIList );
+
+	void onFightAIHeartbeat();
+
+	AIState state_;
 };
 
 #undef PY_METHOD_ATTRIBUTE
 #define PY_METHOD_ATTRIBUTE PY_METHOD_ATTRIBUTE_BASE
 
 #endif //AIINTERFACEEXTRA_HPP
-
@@ -15,6 +15,9 @@ PY_BEGIN_METHODS( CsolExtra )
 	PY_METHOD( moveToPointObstacle_cpp )
 	PY_METHOD( isSamePlanesExt )
 	PY_METHOD( entitiesInRangeExt )
+	PY_METHOD( entitiesInRangeQuery_cpp )
+	PY_METHOD( queryRelation_cpp )
+	PY_METHOD( queryRelations_cpp )
 PY_END_METHODS()
 
 PY_BEGIN_ATTRIBUTES( CsolExtra )
@@ -127,3 +130,46 @@ PyObject* CsolExtra::entitiesInRangeExt( float fRange, PyObjectPtr pEntityName,
 {
 	return mapInstancePtr->entitiesInRangeExt( fRange, pEntityName, pPos );
 }
+
+/**
+ *  Find the entities in range that match the given filters. See
+ *  GameObject::entitiesInRangeQuery_cpp.
+ */
+PyObject * CsolExtra::entitiesInRangeQuery_cpp( float range, uint64 typeMask,
+	int planesID, int relation, int maxCount, bool closestFirst )
+{
+	return mapInstancePtr->entitiesInRangeQuery_cpp( range, typeMask,
+		planesID, relation, maxCount, closestFirst );
+}
+
+/**
+ *  Query the relation of this entity to another. Only Monster extras
+ *  support this.
+ */
+PyObject * CsolExtra::queryRelation_cpp( PyObjectPtr pEntity )
+{
+	Monster * pMonster = dynamic_cast<Monster *>( mapInstancePtr );
+	if( pMonster == NULL || !Entity::Check( pEntity.getObject() ) )
+	{
+		PyErr_SetString( PyExc_TypeError,
+			"queryRelation_cpp: needs a Monster extra and an entity" );
+		return NULL;
+	}
+	return PyInt_FromLong( pMonster->queryRelation_Monster_cpp( pEntity ) );
+}
+
+/**
+ *  Query the relation of this entity to each entity in a sequence. Returns
+ *  a list of relations in the same order.
+ */
+PyObject * CsolExtra::queryRelations_cpp( PyObjectPtr pEntities )
+{
+	Monster * pMonster = dynamic_cast<Monster *>( mapInstancePtr );
+	if( pMonster == NULL )
+	{
+		PyErr_SetString( PyExc_TypeError,
+			"queryRelations_cpp: needs a Monster extra" );
+		return NULL;
+	}
+	return pMonster->queryRelations_Monster_cpp( pEntities );
+}
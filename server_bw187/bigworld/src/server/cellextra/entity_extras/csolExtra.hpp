@@ -12,6 +12,7 @@
 #define CSOL_CELL_EXTRA_CSOLEXTRA_HPP
 
 #include "gameobject.hpp"
+#include "../csdefine.h"
 #include "cellapp/entity_extra.hpp"
 #include <string>
 
@@ -59,6 +60,18 @@ public:
 	PY_AUTO_METHOD_DECLARE( RETOWN, entitiesInRangeExt,ARG( float, OPTARG( PyObjectPtr, NULL, OPTARG( PyObjectPtr, NULL, END ) ) ) );
 	PyObject* entitiesInRangeExt( float fRange, PyObjectPtr pEntityName=NULL, PyObjectPtr pPos = NULL);
 
+	PY_AUTO_METHOD_DECLARE( RETOWN, entitiesInRangeQuery_cpp, ARG( float,
+		OPTARG( uint64, 0, OPTARG( int, -1, OPTARG( int, RELATION_NONE,
+		OPTARG( int, 0, OPTARG( bool, false, END ) ) ) ) ) ) );
+	PyObject * entitiesInRangeQuery_cpp( float range, uint64 typeMask,
+		int planesID, int relation, int maxCount, bool closestFirst );
+
+	PY_AUTO_METHOD_DECLARE( RETOWN, queryRelation_cpp, ARG( PyObjectPtr, END ) );
+	PyObject * queryRelation_cpp( PyObjectPtr pEntity );
+
+	PY_AUTO_METHOD_DECLARE( RETOWN, queryRelations_cpp, ARG( PyObjectPtr, END ) );
+	PyObject * queryRelations_cpp( PyObjectPtr pEntities );
+
 	static const Instance<CsolExtra> instance;
 
 	void initMapInstancePtr();
@@ -110,6 +110,158 @@ PyObject* GameObject::entitiesInRangeExt( float fRange, PyObjectPtr pEntityName=
 	return pNewList;
 }
 
+namespace
+{
+	/**
+	 * Collects the entities within range of a point for
+	 * GameObject::entitiesInRangeQuery_cpp. Only filters that do not call
+	 * script are applied here, since the range list must not change while
+	 * it is being walked.
+	 */
+	class RangeQueryVisitor : public EntityVisitor
+	{
+	public:
+		typedef std::vector< std::pair< float, EntityPtr > > Candidates;
+
+		RangeQueryVisitor( Entity & self, float range, uint64 typeMask,
+				long planesID, Candidates & candidates ) :
+			self_( self ),
+			rangeSq_( range * range ),
+			typeMask_( typeMask ),
+			planesID_( planesID ),
+			candidates_( candidates )
+		{
+		}
+
+		virtual void visit( Entity * pEntity )
+		{
+			if( pEntity == &self_ || pEntity->isDestroyed() )
+				return;
+
+			float distSq =
+				(pEntity->position() - self_.position()).lengthSquared();
+			if( distSq > rangeSq_ )
+				return;
+
+			GameObject * pObject = CsolExtra::extraProxy<GameObject *>( pEntity );
+			if( pObject == NULL )
+				return;
+
+			if( typeMask_ != 0 &&
+					(typeMask_ & (uint64( 1 ) << pObject->utype())) == 0 )
+				return;
+
+			if( pObject->getPlanesID() != planesID_ )
+				return;
+
+			candidates_.push_back( std::make_pair( distSq, EntityPtr( pEntity ) ) );
+		}
+
+	private:
+		Entity & self_;
+		float rangeSq_;
+		uint64 typeMask_;
+		long planesID_;
+		Candidates & candidates_;
+	};
+
+	bool closerThan( const std::pair< float, EntityPtr > & a,
+			const std::pair< float, EntityPtr > & b )
+	{
+		return a.first < b.first;
+	}
+}
+
+/**
+ * Find the entities in range that match the given filters, in one walk of
+ * the range list. This is the native form of entitiesInRangeExt for AoE and
+ * aggro scans.
+ *
+ * @param range			Search radius
+ * @param typeMask		Bit (1 << utype) set for each wanted utype, or 0 for all
+ * @param planesID		The wanted planesID, or -1 for the same as this entity
+ * @param relation		The wanted RELATION_ value, or RELATION_NONE for any.
+ *						Only entities with a Monster extra can filter by
+ *						relation.
+ * @param maxCount		The maximum number of entities to return, or 0 for all
+ * @param closestFirst	Whether to sort by distance, and so keep the closest
+ *						maxCount rather than the first found
+ *
+ * @return A tuple of entities, or NULL with a Python exception set
+ */
+PyObject* GameObject::entitiesInRangeQuery_cpp( float range, uint64 typeMask,
+	int planesID, int relation, int maxCount, bool closestFirst )
+{
+	if( relation != RELATION_NONE && !this->canQueryRelation() )
+	{
+		PyErr_SetString( PyExc_TypeError, "entitiesInRangeQuery_cpp: "
+			"filtering by relation needs a Monster extra" );
+		return NULL;
+	}
+
+	// Taking the buffer keeps this safe if a relation check calls back into
+	// script that runs another query on this entity.
+	RangeQueryBuffer candidates;
+	candidates.swap( rangeQueryBuffer_ );
+	candidates.clear();
+
+	RangeQueryVisitor visitor( entity_, range, typeMask,
+		(planesID == -1) ? this->getPlanesID() : planesID, candidates );
+	entity_.findEntitiesInSquare( range, visitor );
+
+	if( relation != RELATION_NONE )
+	{
+		RangeQueryBuffer::iterator iNew = candidates.begin();
+		for( RangeQueryBuffer::iterator it = candidates.begin();
+				it != candidates.end(); ++it )
+		{
+			if( !it->second->isDestroyed() &&
+					this->queryRelationTo( it->second.get() ) == relation )
+			{
+				*iNew++ = *it;
+			}
+		}
+		candidates.erase( iNew, candidates.end() );
+	}
+
+	size_t count = candidates.size();
+	if( maxCount > 0 && count > size_t( maxCount ) )
+	{
+		count = maxCount;
+		if( closestFirst )
+		{
+			std::partial_sort( candidates.begin(), candidates.begin() + count,
+				candidates.end(), closerThan );
+		}
+	}
+	else if( closestFirst )
+	{
+		std::sort( candidates.begin(), candidates.end(), closerThan );
+	}
+
+	PyObject * pResult = PyTuple_New( count );
+	for( size_t i = 0; pResult != NULL && i < count; i++ )
+	{
+		PyObject * pEntity = candidates[i].second.get();
+		Py_INCREF( pEntity );
+		PyTuple_SET_ITEM( pResult, i, pEntity );
+	}
+
+	candidates.clear();
+	rangeQueryBuffer_.swap( candidates );
+
+	return pResult;
+}
+
+/**
+ * The relation of this entity to another, for entitiesInRangeQuery_cpp.
+ * Only Monster knows about relations, and says so with canQueryRelation.
+ */
+int GameObject::queryRelationTo( Entity * pEntity )
+{
+	return RELATION_NONE;
+}
+
 // תpositionΪǰentityڿռĵ
 void GameObject::transToGroundPosition( Vector3 &position )
 {
@@ -94,6 +94,11 @@ public:
 	long getPlanesID();
 	bool isSamePlanesExt( Entity * pEntity );
 	PyObject* entitiesInRangeExt( float fRange, PyObjectPtr pEntityName, PyObjectPtr pPos );
+	PyObject* entitiesInRangeQuery_cpp( float range, uint64 typeMask,
+		int planesID, int relation, int maxCount, bool closestFirst );
+
+	virtual bool canQueryRelation() const		{ return false; }
+	virtual int queryRelationTo( Entity * pEntity );
 
     //ȡdef
     int getPropertyIndex(const std::string &name);
@@ -117,6 +122,9 @@ protected:
 
 	Entity & entity_;
 
+private:
+	typedef std::vector< std::pair< float, EntityPtr > > RangeQueryBuffer;
+	RangeQueryBuffer rangeQueryBuffer_;						//reused by entitiesInRangeQuery_cpp
 
 };
 
@@ -9,6 +9,7 @@ Monster::Monster(Entity& e) : NPCObject(e)
 {
 	INFO_MSG("init Monster extra (Entity: %d)\n", entity_.id());
     pGetOwnerStr_   = NULL;
+    relationCacheTime_ = 0;
     index_Monster_state_= getPropertyLocalIndex("state");
     index_Monster_effect_state_ = getPropertyLocalIndex("effect_state");
     index_Monster_battleCamp_ = getPropertyLocalIndex("battleCamp");
@@ -186,7 +187,147 @@ int Monster::queryRelation_Monster_cpp(PyObjectPtr pEntity)
 
     Entity *pArgsEnt = static_cast<Entity *>(pEntity.getObject());
 
-    return queryRelation_Monster1(pArgsEnt);
+    SelfRelationInputs selfInputs;
+    selfRelationInputs(selfInputs);
 
+    return queryRelationCached(pArgsEnt, selfInputs);
+
+}
+
+/**
+ * Query the relation to each entity in a sequence, in one call from script.
+ * Returns a new list of relations in the same order, or NULL with a
+ * TypeError set if an item is not an entity.
+ */
+PyObject *Monster::queryRelations_Monster_cpp(PyObjectPtr pEntities)
+{
+    PyObject *pSeq = PySequence_Fast(pEntities.getObject(),
+            "queryRelations_cpp: expected a sequence of entities");
+    if(pSeq == NULL)
+        return NULL;
+
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(pSeq);
+    PyObject *pResult = PyList_New(size);
+    if(pResult == NULL)
+    {
+        Py_DECREF(pSeq);
+        return NULL;
+    }
+
+    SelfRelationInputs selfInputs;
+    selfRelationInputs(selfInputs);
+
+    for(Py_ssize_t i = 0; i < size; i++)
+    {
+        PyObject *pItem = PySequence_Fast_GET_ITEM(pSeq, i);
+        if(!Entity::Check(pItem))
+        {
+            PyErr_Format(PyExc_TypeError,
+                    "queryRelations_cpp: item %d is not an entity", int(i));
+            Py_DECREF(pResult);
+            Py_DECREF(pSeq);
+            return NULL;
+        }
+
+        int relation = queryRelationCached(static_cast<Entity *>(pItem),
+                selfInputs);
+        PyList_SET_ITEM(pResult, i, PyInt_FromLong(relation));
+    }
+
+    Py_DECREF(pSeq);
+    return pResult;
+}
+
+/**
+ * The relation of this entity to another, using the relation cache.
+ */
+int Monster::queryRelationTo(Entity *pEntity)
+{
+    SelfRelationInputs selfInputs;
+    selfRelationInputs(selfInputs);
+
+    return queryRelationCached(pEntity, selfInputs);
+}
+
+/**
+ * Read the properties of this entity, as the queried side, that a cacheable
+ * relation depends on.
+ */
+void Monster::relationInputs(int8 utype, RelationInputs &inputs)
+{
+    inputs.utype = utype;
+    inputs.state = state();
+    inputs.effectState = effect_state();
+    inputs.battleCamp = battleCamp();
+    inputs.flags = flags();
+}
+
+/**
+ * Read the properties of this entity, as the querying side, that a
+ * cacheable relation depends on.
+ */
+void Monster::selfRelationInputs(SelfRelationInputs &inputs)
+{
+    inputs.effectState = effect_state();
+    inputs.battleCamp = battleCamp();
+    inputs.flags = flags();
+}
+
+/**
+ * Whether the relation to an entity of the given utype only depends on the
+ * properties in RelationInputs and SelfRelationInputs. Relations to pets
+ * and owned monsters also depend on the owner, and on this entity's
+ * temporary data, so they are always worked out in full.
+ */
+bool Monster::isRelationCacheable(int8 utype)
+{
+    return utype != ENTITY_TYPE_PET &&
+        utype != ENTITY_TYPE_SLAVE_MONSTER &&
+        utype != ENTITY_TYPE_VEHICLE_DART &&
+        utype != ENTITY_TYPE_PANGU_NAGUAL;
+}
+
+/**
+ * Query the relation to an entity, using the relation worked out earlier in
+ * this game tick if neither side's properties have changed since. A hit
+ * reads the target's utype and the four properties in RelationInputs.
+ */
+int Monster::queryRelationCached(Entity *pEntity,
+        const SelfRelationInputs &selfInputs)
+{
+    Monster *monster = CsolExtra::extraProxy<Monster *>( pEntity );
+    if(monster == NULL || isDestroyed() || monster->isDestroyed())
+        return queryRelation_Monster1(pEntity);
+
+    int8 utype = monster->utype();
+    if(!isRelationCacheable(utype))
+        return queryRelation_Monster1(pEntity);
+
+    TimeStamp now = CellApp::instance().time();
+    if(now != relationCacheTime_)
+    {
+        relationCache_.clear();
+        relationCacheTime_ = now;
+    }
+
+    RelationInputs otherInputs;
+    monster->relationInputs(utype, otherInputs);
+
+    RelationCache::iterator iter = relationCache_.find(pEntity->id());
+    if(iter != relationCache_.end() &&
+            iter->second.selfInputs == selfInputs &&
+            iter->second.otherInputs == otherInputs)
+    {
+        return iter->second.relation;
+    }
+
+    int relation = queryRelation_Monster1(pEntity);
+
+    CachedRelation &entry = relationCache_[pEntity->id()];
+    entry.selfInputs = selfInputs;
+    entry.otherInputs = otherInputs;
+    entry.relation = relation;
+
+    return relation;
 }
 
@@ -14,6 +14,9 @@ public:
 
 	//PY_AUTO_METHOD_DECLARE(RETDATA, queryRelation_Monster_cpp, ARG(PyObjectPtr, END));
     int queryRelation_Monster_cpp(PyObjectPtr pEntity);
+    PyObject *queryRelations_Monster_cpp(PyObjectPtr pEntities);
+    virtual bool canQueryRelation() const { return true; }
+    virtual int queryRelationTo(Entity *pEntity);
 
     inline int state()
     {
@@ -137,10 +140,70 @@ public:
     }
 
 private:
+    /**
+     *  The properties of the queried entity that a cacheable relation
+     *  depends on. A cached relation is only used while the entity still
+     *  has the values it was worked out with.
+     */
+    struct RelationInputs
+    {
+        int8 utype;
+        int32 state;
+        uint32 effectState;
+        uint16 battleCamp;
+        int64 flags;
+
+        bool operator==(const RelationInputs &other) const
+        {
+            return utype == other.utype &&
+                state == other.state &&
+                effectState == other.effectState &&
+                battleCamp == other.battleCamp &&
+                flags == other.flags;
+        }
+    };
+
+    /**
+     *  The properties of the querying entity that a cacheable relation
+     *  depends on.
+     */
+    struct SelfRelationInputs
+    {
+        uint32 effectState;
+        uint16 battleCamp;
+        int64 flags;
+
+        bool operator==(const SelfRelationInputs &other) const
+        {
+            return effectState == other.effectState &&
+                battleCamp == other.battleCamp &&
+                flags == other.flags;
+        }
+    };
+
+    struct CachedRelation
+    {
+        SelfRelationInputs selfInputs;
+        RelationInputs otherInputs;
+        int relation;
+    };
+
+    typedef std::map<ObjectID, CachedRelation> RelationCache;
+
+    void relationInputs(int8 utype, RelationInputs &inputs);
+    void selfRelationInputs(SelfRelationInputs &inputs);
+    static bool isRelationCacheable(int8 utype);
+    int queryRelationCached(Entity *pEntity,
+            const SelfRelationInputs &selfInputs);
+
     int commonRelationCheck(Monster *extra, uint32 args_effect);
     int queryRelation_Monster1(Entity *pEntity);
     int queryRelation_Monster2(Entity *pEntity, long args_utype);
 
+    //relations worked out during relationCacheTime_, by entity id
+    RelationCache relationCache_;
+    TimeStamp relationCacheTime_;
+
     PyObject *pGetOwnerStr_;
 
     bool hasQueryTemp_;
@@ -34,7 +34,8 @@ PyArrayProxy::~PyArrayProxy()
 */
 Py_ssize_t PyArrayProxy::length()
 {
-	PyObject * pLen = PyObject_CallMethod( pPyArray_, "__len__", NULL );
+	static PyObject * s_pLenName = PyString_InternFromString( "__len__" );
+	PyObject * pLen = PyObject_CallMethodObjArgs( pPyArray_, s_pLenName, NULL );
 	Py_ssize_t len = PyInt_AsLong( pLen );
 	Py_XDECREF( pLen );
 	return len;
@@ -119,6 +119,11 @@ LDLIBS += -lssl -lcrypto -ldl
 CPPFLAGS += -DUSE_OPENSSL
 endif
 
+# The CellApp and BaseApp keep their timers in a TimeQueue unless this is set.
+ifdef USE_TIMING_WHEEL
+CPPFLAGS += -DUSE_TIMING_WHEEL
+endif
+
 # Use backwards compatible hash table style. This is because Fedora Core 6
 # defaults to using "gnu" style hash tables which produces incompatible
 # binaries with FC5 and before.
@@ -2141,7 +2141,7 @@ void Database::onLogOnLoggedOnUser( EntityTypeID typeID, DatabaseID dbID,
 
 			bundle << pExistingBase->id;
 			bundle << clientAddr;
-			bundle << pParams->encryptionKey();
+			bundle << pParams->channelKey();
 
 			bool hasPassword =
 				this->getEntityDefs().entityTypeHasPassword( typeID );
@@ -2250,7 +2250,7 @@ DatabaseID* Database::prepareCreateEntityBundle( EntityTypeID typeID,
 	// This is the client address. It is used if we are making a proxy.
 	bundle << addrForProxy;
 
-	bundle << ((pParams != NULL) ? pParams->encryptionKey() : "");
+	bundle << ((pParams != NULL) ? pParams->channelKey() : "");
 
 	bundle << true;		// Has persistent data only
 
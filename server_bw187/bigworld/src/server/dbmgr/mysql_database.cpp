@@ -2450,6 +2450,111 @@ private:
 };
 
 
+// -----------------------------------------------------------------------------
+// Section: PutEntityBatch
+// -----------------------------------------------------------------------------
+
+/**
+ *	This struct is a putEntity() operation that is waiting in a PutEntityBatch.
+ *	The entity data is copied since it is only bound when the batch is run in
+ *	a worker thread.
+ */
+struct PutEntityBatchItem
+{
+	enum BaseRefAction
+	{
+		BaseRefActionNone,
+		BaseRefActionWrite,
+		BaseRefActionRemove
+	};
+
+	PutEntityBatchItem( const EntityDBKey& ekey, EntityDBRecordIn& erec,
+			IDatabase::IPutEntityHandler& handler,
+			BufferedEntityTasks * pBufferedEntityTasks );
+
+	EntityDBKey						ekey;
+	bool							writeEntityData;
+	BaseRefAction					baseRefAction;
+	EntityMailBoxRef				baseMB;
+	MemoryOStream					stream;
+	IDatabase::IPutEntityHandler&	handler;
+	BufferedEntityTasks *			pBufferedEntityTasks;
+
+	// Results of the write.
+	DatabaseID						dbID;
+	bool							isOK;
+	std::string						exceptionStr;
+};
+
+/**
+ *	Constructor.
+ */
+PutEntityBatchItem::PutEntityBatchItem( const EntityDBKey& ekey,
+		EntityDBRecordIn& erec, IDatabase::IPutEntityHandler& handler,
+		BufferedEntityTasks * pBufferedEntityTasks ) :
+	ekey( ekey ),
+	writeEntityData( false ),
+	baseRefAction( BaseRefActionNone ),
+	baseMB(),
+	stream(),
+	handler( handler ),
+	pBufferedEntityTasks( pBufferedEntityTasks ),
+	dbID( ekey.dbID ),
+	isOK( false )
+{
+	if (erec.isStrmProvided())
+	{
+		BinaryIStream & strm = erec.getStrm();
+		stream.transfer( strm, strm.remainingLength() );
+		writeEntityData = true;
+	}
+
+	if (erec.isBaseMBProvided())
+	{
+		EntityMailBoxRef* pBaseMB = erec.getBaseMB();
+		if (pBaseMB)
+		{
+			baseMB = *pBaseMB;
+			baseRefAction = BaseRefActionWrite;
+		}
+		else
+		{
+			baseRefAction = BaseRefActionRemove;
+		}
+	}
+}
+
+typedef std::vector< PutEntityBatchItem * > PutEntityBatchItems;
+
+
+/**
+ *	This class collects putEntity() operations until they are written to the
+ *	database together.
+ */
+class PutEntityBatch
+{
+public:
+	void add( PutEntityBatchItem * pItem )
+	{
+		items_.container.push_back( pItem );
+	}
+
+	int size() const	{ return int( items_.container.size() ); }
+	bool empty() const	{ return items_.container.empty(); }
+
+	/**
+	 *	This method moves all the items in this batch into the given vector.
+	 */
+	void swapItems( PutEntityBatchItems & items )
+	{
+		items_.container.swap( items );
+	}
+
+private:
+	auto_container< PutEntityBatchItems >	items_;
+};
+
+
 // -----------------------------------------------------------------------------
 // Section: class MySqlDatabase
 // -----------------------------------------------------------------------------
@@ -2464,7 +2569,15 @@ MySqlDatabase::MySqlDatabase() :
 	reconnectCount_( 0 ),
 	pMigrationTask_( 0 ),
 	pOldDatabase_( 0 ),
-	pBufferedEntityTasks_( new BufferedEntityTasks )
+	pBufferedEntityTasks_( new BufferedEntityTasks ),
+	pPutEntityBatch_( new PutEntityBatch ),
+	maxPutEntityBatchSize_( 1 ),
+	maxPutEntityBatchDelay_( 20 ),
+	putEntityBatchTimerID_( -1 ),
+	numPutEntityBatchesInProgress_( 0 ),
+	numPutEntityBatches_( 0 ),
+	numBatchedPutEntities_( 0 ),
+	lastPutEntityBatchSize_( 0 )
 {
 	MF_WATCH( "performance/numBusyThreads", *this,
 				&MySqlDatabase::watcherGetNumBusyThreads );
@@ -2474,6 +2587,24 @@ MySqlDatabase::MySqlDatabase() :
 				&MySqlDatabase::watcherGetAllOpsCountPerSec );
 	MF_WATCH( "performance/allOperations/duration", *this,
 				&MySqlDatabase::watcherGetAllOpsAvgDurationSecs );
+
+	MF_WATCH( "performance/groupCommit/maxEntities", maxPutEntityBatchSize_,
+		Watcher::WT_READ_WRITE,
+		"The maximum number of entity writes committed together. "
+			"1 disables group commit" );
+	MF_WATCH( "performance/groupCommit/maxDelay", maxPutEntityBatchDelay_,
+		Watcher::WT_READ_WRITE,
+		"The maximum time in milliseconds that an entity write waits for "
+			"others to join its batch" );
+	MF_WATCH( "performance/groupCommit/numBatches", numPutEntityBatches_,
+		Watcher::WT_READ_ONLY,
+		"The number of batches of entity writes that have been committed" );
+	MF_WATCH( "performance/groupCommit/numEntities", numBatchedPutEntities_,
+		Watcher::WT_READ_ONLY,
+		"The number of entity writes that have been committed in batches" );
+	MF_WATCH( "performance/groupCommit/lastBatchSize", lastPutEntityBatchSize_,
+		Watcher::WT_READ_ONLY,
+		"The number of entity writes in the last batch" );
 }
 
 MySqlDatabase * MySqlDatabase::create()
@@ -2491,6 +2622,9 @@ MySqlDatabase * MySqlDatabase::create()
 
 MySqlDatabase::~MySqlDatabase()
 {
+	delete pPutEntityBatch_;
+	pPutEntityBatch_ = NULL;
+
 	delete pBufferedEntityTasks_;
 	pBufferedEntityTasks_ = NULL;
 }
@@ -2708,6 +2842,17 @@ bool MySqlDatabase::startup( const EntityDefs& entityDefs,
 
 		INFO_MSG( "\tMySql: Number of connections = %d.\n", numConnections_ );
 
+		maxPutEntityBatchSize_ = std::max( BWConfig::get(
+			"dbMgr/groupCommit/maxEntities", maxPutEntityBatchSize_ ), 1 );
+		maxPutEntityBatchDelay_ = std::max( BWConfig::get(
+			"dbMgr/groupCommit/maxDelay", maxPutEntityBatchDelay_ ), 1 );
+
+		if (this->isGroupCommitEnabled())
+		{
+			INFO_MSG( "\tMySql: Group commit = %d entities, %d ms.\n",
+				maxPutEntityBatchSize_, maxPutEntityBatchDelay_ );
+		}
+
 		// Create threads and thread resources.
 		pThreadResPool_ =
 			new MySqlThreadResPool( Database::instance().getWorkerThreadMgr(),
@@ -2737,6 +2882,12 @@ bool MySqlDatabase::shutDown()
 {
 	try
 	{
+		if (pThreadResPool_)
+		{
+			// Do not leave any entity writes behind.
+			this->flushPutEntityBatch();
+		}
+
 		delete pThreadResPool_;
 		pThreadResPool_ = NULL;
 		if (pOldDatabase_)
@@ -2903,6 +3054,15 @@ bool MySqlDatabase::restoreConnectionToDb()
  */
 int MySqlDatabase::handleTimeout( int id, void * arg )
 {
+	if (id == putEntityBatchTimerID_)
+	{
+		// The timer is a callback, so it has already been cancelled.
+		putEntityBatchTimerID_ = -1;
+		this->flushPutEntityBatch();
+
+		return 0;
+	}
+
 	this->restoreConnectionToDb();
 
 	return 0;
@@ -3638,6 +3798,12 @@ public:
 			IDatabase::IPutEntityHandler & handler,
 			BufferedEntityTasks * pBufferedEntityTasks )
 	{
+		if (owner.isGroupCommitEnabled())
+		{
+			owner.putEntityInBatch( ekey, erec, handler, pBufferedEntityTasks );
+			return;
+		}
+
 		PutEntityTask<MySqlThreadTask>* pTask =
 			new PutEntityTask<MySqlThreadTask>( owner, ekey, erec, handler,
 				   pBufferedEntityTasks );
@@ -3704,6 +3870,328 @@ private:
 };
 
 
+// -----------------------------------------------------------------------------
+// Section: PutEntityBatchTask
+// -----------------------------------------------------------------------------
+
+/**
+ *	This class writes a batch of entities into the database in a single
+ *	transaction, so that the whole batch costs one commit instead of one per
+ *	entity.
+ *
+ *	If the batch transaction fails, the entities are written again one per
+ *	transaction so that one bad entity does not cause the others to be lost.
+ */
+class PutEntityBatchTask : public MySqlThreadTask
+{
+	auto_container< PutEntityBatchItems >	items_;
+
+public:
+	PutEntityBatchTask( MySqlDatabase& owner, PutEntityBatch& batch );
+
+	// WorkerThread::ITask overrides
+	virtual void run();
+	virtual void onRunComplete();
+
+private:
+	void writeItem( MySqlTransaction& transaction, PutEntityBatchItem& item );
+	void writeItemOnItsOwn( PutEntityBatchItem& item );
+};
+
+/**
+ *	Constructor. Takes all the items out of the given batch.
+ */
+PutEntityBatchTask::PutEntityBatchTask( MySqlDatabase& owner,
+		PutEntityBatch& batch ) :
+	MySqlThreadTask( owner )
+{
+	this->startThreadTaskTiming();
+	batch.swapItems( items_.container );
+}
+
+/**
+ *	This method writes the batch into the database. May be executed in a
+ *	separate thread.
+ */
+void PutEntityBatchTask::run()
+{
+	MySqlThreadData& threadData = this->getThreadData();
+	PutEntityBatchItems& items = items_.container;
+
+	std::string exceptionStr;
+	bool isCommitted = false;
+	bool retry;
+	do
+	{
+		retry = false;
+		try
+		{
+			MySqlTransaction transaction( threadData.connection );
+
+			for (PutEntityBatchItems::iterator iItem = items.begin();
+					iItem != items.end(); ++iItem)
+			{
+				this->writeItem( transaction, **iItem );
+			}
+
+			transaction.commit();
+			isCommitted = true;
+		}
+		catch (MySqlRetryTransactionException& e)
+		{
+			retry = true;
+		}
+		catch (std::exception& e)
+		{
+			exceptionStr = e.what();
+		}
+	} while (retry);
+
+	if (isCommitted || threadData.connection.hasFatalError())
+	{
+		return;
+	}
+
+	if (items.size() > 1)
+	{
+		WARNING_MSG( "PutEntityBatchTask::run: Failed to write a batch of %d "
+				"entities (%s). Writing them one at a time.\n",
+			int( items.size() ), exceptionStr.c_str() );
+
+		for (PutEntityBatchItems::iterator iItem = items.begin();
+				iItem != items.end(); ++iItem)
+		{
+			this->writeItemOnItsOwn( **iItem );
+		}
+	}
+	else
+	{
+		items.front()->exceptionStr = exceptionStr;
+		items.front()->isOK = false;
+	}
+}
+
+/**
+ *	This method writes a single entity as part of the given transaction. It
+ *	does the same as PutEntityTask::run(), except that the entity data is bound
+ *	here rather than in the main thread.
+ */
+void PutEntityBatchTask::writeItem( MySqlTransaction& transaction,
+		PutEntityBatchItem& item )
+{
+	MySqlTypeMapping& typeMapping = this->getThreadData().typeMapping;
+
+	EntityTypeID typeID = item.ekey.typeID;
+	DatabaseID dbID = item.ekey.dbID;
+	bool isOK = true;
+	bool definitelyExists = false;
+
+	item.exceptionStr.clear();
+
+	if (item.writeEntityData)
+	{
+		MemoryIStream stream( item.stream.data(), item.stream.size() );
+		typeMapping.streamToBound( typeID, dbID, stream );
+
+		if (dbID)
+		{
+			isOK = typeMapping.updateEntity( transaction, typeID, dbID );
+		}
+		else
+		{
+			dbID = typeMapping.newEntity( transaction, typeID );
+			isOK = (dbID != 0);
+		}
+
+		definitelyExists = isOK;
+	}
+
+	if (isOK && (item.baseRefAction != PutEntityBatchItem::BaseRefActionNone))
+	{
+		if (!definitelyExists)
+		{
+			isOK = typeMapping.checkEntityExists( transaction, typeID, dbID );
+		}
+
+		if (isOK)
+		{
+			if (item.baseRefAction == PutEntityBatchItem::BaseRefActionWrite)
+			{
+				typeMapping.baseRefToBound( item.baseMB );
+				typeMapping.addLogOnRecord( transaction, typeID, dbID );
+			}
+			else
+			{
+				typeMapping.removeLogOnRecord( transaction, typeID, dbID );
+				if (transaction.affectedRows() == 0)
+				{
+					// Not really an error. See PutEntityTask::run().
+					item.exceptionStr = "Failed to remove logon record";
+				}
+			}
+		}
+	}
+
+	item.dbID = dbID;
+	item.isOK = isOK;
+}
+
+/**
+ *	This method writes a single entity in a transaction of its own.
+ */
+void PutEntityBatchTask::writeItemOnItsOwn( PutEntityBatchItem& item )
+{
+	MySqlThreadData& threadData = this->getThreadData();
+
+	bool retry;
+	do
+	{
+		retry = false;
+		try
+		{
+			MySqlTransaction transaction( threadData.connection );
+			this->writeItem( transaction, item );
+			transaction.commit();
+		}
+		catch (MySqlRetryTransactionException& e)
+		{
+			retry = true;
+		}
+		catch (std::exception& e)
+		{
+			item.exceptionStr = e.what();
+			item.isOK = false;
+		}
+	} while (retry);
+}
+
+/**
+ *	This method is called in the main thread after run() is complete.
+ */
+void PutEntityBatchTask::onRunComplete()
+{
+	bool hasFatalError = this->getThreadData().connection.hasFatalError();
+
+	uint64 duration = this->stopThreadTaskTiming();
+	if (duration > THREAD_TASK_WARNING_DURATION)
+		WARNING_MSG( "PutEntityBatchTask for %d entities took %f seconds\n",
+					int( items_.container.size() ),
+					double(duration)/stampsPerSecondD() );
+
+	// Release thread resources before the callbacks, for the same reason as
+	// in PutEntityTask::onRunComplete().
+	auto_container< PutEntityBatchItems > items;
+	items.container.swap( items_.container );
+	MySqlDatabase& owner = this->getOwner();
+	delete this;
+
+	owner.onPutEntityBatchComplete();
+
+	for (PutEntityBatchItems::iterator iItem = items.container.begin();
+			iItem != items.container.end(); ++iItem)
+	{
+		PutEntityBatchItem& item = **iItem;
+
+		if (item.exceptionStr.length())
+			ERROR_MSG( "MySqlDatabase::putEntity: %s\n",
+					item.exceptionStr.c_str() );
+		else if (hasFatalError)
+			item.isOK = false;
+		else if (!item.isOK)
+			WARNING_MSG( "MySqlDatabase::putEntity: Failed to write entity "
+					"%"FMT_DBID" of type %d into MySQL database.\n",
+					item.dbID, item.ekey.typeID );
+
+		if (item.writeEntityData)
+			owner.onPutEntityOpCompleted( item.ekey.typeID, item.dbID );
+
+		item.handler.onPutEntityComplete( item.isOK, item.dbID );
+
+		if (item.pBufferedEntityTasks)
+		{
+			item.pBufferedEntityTasks->onFinished( item.dbID );
+		}
+	}
+}
+
+
+/**
+ *	This method adds a putEntity() operation to the current batch.
+ *
+ *	The batch is written straight away if a worker thread is free or no other
+ *	batch is being written, so that writes are not delayed when the database
+ *	is keeping up. Otherwise, writes collect in the batch until it is full, a
+ *	batch finishes, or the first write has waited for dbMgr/groupCommit/maxDelay
+ *	milliseconds.
+ */
+void MySqlDatabase::putEntityInBatch( const EntityDBKey& ekey,
+		EntityDBRecordIn& erec, IPutEntityHandler& handler,
+		BufferedEntityTasks * pBufferedEntityTasks )
+{
+	PutEntityBatchItem * pItem =
+		new PutEntityBatchItem( ekey, erec, handler, pBufferedEntityTasks );
+
+	if (pItem->writeEntityData)
+	{
+		this->onPutEntityOpStarted( ekey.typeID, ekey.dbID );
+	}
+
+	pPutEntityBatch_->add( pItem );
+
+	if ((numPutEntityBatchesInProgress_ == 0) ||
+		(pThreadResPool_->getThreadPool().getNumFreeThreads() > 0) ||
+		(pPutEntityBatch_->size() >= maxPutEntityBatchSize_))
+	{
+		this->flushPutEntityBatch();
+	}
+	else if (putEntityBatchTimerID_ == -1)
+	{
+		putEntityBatchTimerID_ = Database::instance().nub().registerCallback(
+				maxPutEntityBatchDelay_ * 1000, this );
+	}
+}
+
+
+/**
+ *	This method starts writing the current batch of putEntity() operations.
+ */
+void MySqlDatabase::flushPutEntityBatch()
+{
+	if (putEntityBatchTimerID_ != -1)
+	{
+		Database::instance().nub().cancelTimer( putEntityBatchTimerID_ );
+		putEntityBatchTimerID_ = -1;
+	}
+
+	if (pPutEntityBatch_->empty())
+	{
+		return;
+	}
+
+	lastPutEntityBatchSize_ = pPutEntityBatch_->size();
+	++numPutEntityBatches_;
+	numBatchedPutEntities_ += lastPutEntityBatchSize_;
+	++numPutEntityBatchesInProgress_;
+
+	PutEntityBatchTask * pTask =
+		new PutEntityBatchTask( *this, *pPutEntityBatch_ );
+	pTask->doTask();
+}
+
+
+/**
+ *	This method is called when a batch of putEntity() operations has been
+ *	written. The writes that collected while it was in progress are written
+ *	now, rather than waiting for the timer.
+ */
+void MySqlDatabase::onPutEntityBatchComplete()
+{
+	--numPutEntityBatchesInProgress_;
+
+	this->flushPutEntityBatch();
+}
+
+
 /**
  *	Override from IDatabase
  */
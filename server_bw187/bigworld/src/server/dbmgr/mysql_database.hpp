@@ -16,6 +16,7 @@ criminal penalties as provided by law.
 #include "idatabase.hpp"
 
 class BufferedEntityTasks;
+class PutEntityBatch;
 
 class MySql;
 class MySqlTransaction;
@@ -96,6 +97,18 @@ public:
 	void onWriteSpaceOpStarted()	{	++numWriteSpaceOpsInProgress_;	}
 	void onWriteSpaceOpCompleted()	{	--numWriteSpaceOpsInProgress_;	}
 
+	void putEntityInBatch( const EntityDBKey& ekey, EntityDBRecordIn& erec,
+		IPutEntityHandler& handler,
+		BufferedEntityTasks * pBufferedEntityTasks );
+	void flushPutEntityBatch();
+	void onPutEntityBatchComplete();
+
+	/**
+	 *	This method returns whether entity writes are grouped into batches
+	 *	that are committed together.
+	 */
+	bool isGroupCommitEnabled() const	{ return maxPutEntityBatchSize_ > 1; }
+
 	void setupUpdateTemporaryTables();
 
 	void onOldDatabaseDestroy()		{ 	pOldDatabase_ = 0; 	}
@@ -120,6 +133,16 @@ private:
 	MigrateToNewDefsTask* 	pMigrationTask_;
 	OldMySqlDatabase* 		pOldDatabase_;
 	BufferedEntityTasks *	pBufferedEntityTasks_;
+
+	PutEntityBatch *		pPutEntityBatch_;
+	int						maxPutEntityBatchSize_;
+	int						maxPutEntityBatchDelay_;
+	int						putEntityBatchTimerID_;
+	int						numPutEntityBatchesInProgress_;
+
+	uint32					numPutEntityBatches_;
+	uint32					numBatchedPutEntities_;
+	int						lastPutEntityBatchSize_;
 };
 
 #endif
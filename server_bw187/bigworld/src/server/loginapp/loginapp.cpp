@@ -12,6 +12,7 @@ criminal penalties as provided by law.
 #include "loginapp.hpp"
 
 #include <sys/types.h>
+#include <math.h>
 
 #ifndef _WIN32
 #include <sys/signal.h>
@@ -32,6 +33,7 @@ criminal penalties as provided by law.
 
 #include "network/msgtypes.hpp"	// for angleToInt8
 #include "network/watcher_glue.hpp"
+#include "network/aes_gcm_filter.hpp"
 #include "network/encryption_filter.hpp"
 
 #include "./webserver/soapGameAccountBindingProxy.h"
@@ -57,6 +59,25 @@ LoginApp * LoginApp::pInstance_ = NULL;
 // Section: Misc
 // -----------------------------------------------------------------------------
 
+namespace
+{
+/**
+ *	This class makes OpenSSL safe for the login threads, which decrypt logins
+ *	concurrently. It is done at static initialisation time so that it happens
+ *	before loginThreadPool_ is started.
+ */
+class OpenSSLThreadingIniter
+{
+public:
+	OpenSSLThreadingIniter()
+	{
+		Mercury::PublicKeyCipher::initThreading();
+	}
+};
+
+OpenSSLThreadingIniter s_openSSLThreadingIniter;
+}
+
 extern "C" void interruptHandler( int )
 {
 	if (LoginApp::pInstance())
@@ -572,10 +593,18 @@ LoginApp::LoginApp( uint16 loginPort ) :
 	allowLogin_( true ),
 	allowProbe_( true ),
 	logProbes_( false ),
+	allowAesGcm_( false ),
 	autoRegister_( false ),
 	registerTimeout_( 10 ),
     workerThreadMgr_( intNub_ ),
     threadPool_( workerThreadMgr_, BWConfig::get( "loginApp/registerThreadNumber", 2)),
+	numLoginThreads_( BWConfig::get( "loginApp/numLoginThreads", 2 ) ),
+	loginThreadPool_( workerThreadMgr_, numLoginThreads_ ),
+	maxLoginQueueSize_( BWConfig::get( "loginApp/maxLoginQueueSize", 1000 ) ),
+	averageDecryptTime_( 0.005f ),
+	loginRatePeriodStart_( 0 ),
+	numLoginsThisPeriod_( 0 ),
+	loginsPerSecond_( 0.f ),
     validateServer_(""),
     registerServer_(""),
 	lastRateLimitCheckTime_( 0 ),
@@ -729,6 +758,7 @@ bool LoginApp::init( int argc, char * argv[], uint16 loginPort )
 	allowLogin_ = BWConfig::get( "loginApp/allowLogin", allowLogin_ );
 	allowProbe_ = BWConfig::get( "loginApp/allowProbe", allowProbe_ );
 	logProbes_ = BWConfig::get( "loginApp/logProbes", logProbes_ );
+	allowAesGcm_ = BWConfig::get( "loginApp/allowAesGcm", allowAesGcm_ );
 	autoRegister_ = BWConfig::get( "loginApp/autoRegister", autoRegister_ );
 	registerTimeout_ = BWConfig::get( "loginApp/registerTimeout", registerTimeout_ );
     validateServer_ = BWConfig::get( "loginApp/validateServer", "http://transfer.gyyx.cn:81" );
@@ -737,6 +767,7 @@ bool LoginApp::init( int argc, char * argv[], uint16 loginPort )
 	MF_WATCH( "allowLogin", allowLogin_ );
 	MF_WATCH( "allowProbe", allowProbe_ );
 	MF_WATCH( "logProbes", logProbes_ );
+	MF_WATCH( "allowAesGcm", allowAesGcm_ );
 	MF_WATCH( "autoRegister", autoRegister_);
 	MF_WATCH( "registerTimeout", registerTimeout_);
 
@@ -771,6 +802,18 @@ bool LoginApp::init( int argc, char * argv[], uint16 loginPort )
 			&LoginApp::rateLimitSeconds, &LoginApp::rateLimitSeconds );
 	MF_WATCH( "rateLimit/loginLimit", loginRateLimit_ );
 
+	loginRatePeriodStart_ = timestamp();
+	MF_WATCH( "loginsPerSecond", loginsPerSecond_, Watcher::WT_READ_ONLY,
+			"The number of logins decrypted per second" );
+	MF_WATCH( "loginQueue/numThreads", numLoginThreads_,
+			Watcher::WT_READ_ONLY );
+	MF_WATCH( "loginQueue/depth", *this, &LoginApp::loginQueueDepth );
+	MF_WATCH( "loginQueue/maxSize", maxLoginQueueSize_ );
+	MF_WATCH( "loginQueue/averageDecryptTime", averageDecryptTime_,
+			Watcher::WT_READ_ONLY );
+	MF_WATCH( "loginQueue/estimatedWait", *this,
+			&LoginApp::estimatedLoginWait );
+
 	Mercury::Reason reason =
 		LoginIntInterface::registerWithMachined( intNub_, 0 );
 
@@ -1081,6 +1124,8 @@ void LoginApp::webServicesRegister( const Mercury::Address & source,
 		return;
 	}
 
+	this->negotiateChannelFilter( *pParams );
+
 
     RegisterTask* pTask = 
 		new RegisterTask( source, header.replyID, pParams );
@@ -1110,6 +1155,61 @@ void LoginApp::webServicesRegister( const Mercury::Address & source,
     
 }
 
+/**
+ *	This class decrypts and destreams the parameters of a login on one of the
+ *	login threads. The login is then continued on the main thread.
+ */
+class LoginDecryptTask : public WorkerThread::ITask
+{
+public:
+	LoginDecryptTask( const Mercury::Address & source,
+			Mercury::ReplyID replyID, BinaryIStream & data ) :
+		source_( source ),
+		replyID_( replyID ),
+		pParams_( new LogOnParams() ),
+		isOkay_( false ),
+		decryptTime_( 0 )
+	{
+		data_.transfer( data, data.remainingLength() );
+	}
+
+	virtual ~LoginDecryptTask() {}
+
+	virtual void run()
+	{
+		LoginApp & app = LoginApp::instance();
+
+		uint64 startTime = timestamp();
+
+		Mercury::PublicKeyCipher * pKey = app.acquirePrivateKey();
+		isOkay_ = pParams_->readFromStream( data_, pKey );
+		app.releasePrivateKey( pKey );
+
+		decryptTime_ = timestamp() - startTime;
+	}
+
+	virtual void onRunComplete()
+	{
+		LoginApp::instance().onLoginDecrypted( *this );
+		delete this;
+	}
+
+	const Mercury::Address & source() const	{ return source_; }
+	Mercury::ReplyID replyID() const			{ return replyID_; }
+	LogOnParamsPtr pParams() const				{ return pParams_; }
+	bool isOkay() const							{ return isOkay_; }
+	uint64 decryptTime() const					{ return decryptTime_; }
+
+private:
+	Mercury::Address	source_;
+	Mercury::ReplyID	replyID_;
+	MemoryOStream		data_;
+	LogOnParamsPtr		pParams_;
+	bool				isOkay_;
+	uint64				decryptTime_;
+};
+
+
 /**
  *	This method is the one that actually receives the login requests.
  */
@@ -1239,31 +1339,236 @@ void LoginApp::login( const Mercury::Address & source,
 		return;
 	}
 
-	// Read off login parameters
-	LogOnParamsPtr pParams = new LogOnParams();
+	if (pendingDecrypts_.count( source ) != 0)
+	{
+		DEBUG_MSG( "LoginApp::login: Ignoring repeat attempt from %s "
+				"while its last attempt is queued\n",
+			source.c_str() );
+		data.finish();
+		return;
+	}
 
-	if (!pParams->readFromStream( data, &privateKey_ ))
+	// The login parameters are decrypted on a login thread. If they are all
+	// busy, the login waits in the queue for one to become free.
+	bool canStartNow = loginQueue_.empty() &&
+		(loginThreadPool_.getNumFreeThreads() > 0);
+
+	if ((numLoginThreads_ > 0) && !canStartNow &&
+			(int( loginQueue_.size() ) >= maxLoginQueueSize_))
 	{
-		this->sendFailure( source, header.replyID,
+		int estimatedWait = this->estimatedLoginWait();
+
+		NOTICE_MSG( "LoginApp::login: "
+				"Login from %s rejected as the login queue is full "
+				"(estimated wait %d seconds)\n",
+			source.c_str(), estimatedWait );
+
+		char msg[BUFSIZ];
+		snprintf( msg, sizeof( msg ),
+			"Login queue is full. Estimated wait: %d seconds",
+			estimatedWait );
+
+		LogOnStatus status = (version < LOGIN_VERSION_RATE_LIMIT_STATUS) ?
+				LogOnStatus::LOGIN_REJECTED_LOGINS_NOT_ALLOWED :
+				LogOnStatus::LOGIN_REJECTED_RATE_LIMITED;
+		this->sendFailure( source, header.replyID, status, msg );
+		data.finish();
+		return;
+	}
+
+	// The login counts towards the rate limit from when it is admitted, so
+	// that the logins waiting for decryption cannot exceed it. It is given
+	// back if it fails before the login is attempted.
+	if (rateLimitDuration_)
+	{
+		--numAllowedLoginsLeft_;
+	}
+
+	pendingDecrypts_.insert( source );
+
+	LoginDecryptTask * pTask =
+		new LoginDecryptTask( source, header.replyID, data );
+
+	if (numLoginThreads_ <= 0)
+	{
+		WorkerThreadPool::doTaskInCurrentThread( *pTask );
+	}
+	else if (!canStartNow || !loginThreadPool_.doTask( *pTask ))
+	{
+		loginQueue_.push_back( pTask );
+	}
+}
+
+
+/**
+ *	This method is called on the main thread once a login's parameters have
+ *	been decrypted.
+ */
+void LoginApp::onLoginDecrypted( LoginDecryptTask & task )
+{
+	pendingDecrypts_.erase( task.source() );
+
+	const float DECRYPT_TIME_BIAS = 0.1f;
+	averageDecryptTime_ = (1.f - DECRYPT_TIME_BIAS) * averageDecryptTime_ +
+		DECRYPT_TIME_BIAS * float( task.decryptTime() / stampsPerSecondD() );
+
+	++numLoginsThisPeriod_;
+
+	uint64 now = timestamp();
+
+	if (now - loginRatePeriodStart_ >= stampsPerSecond())
+	{
+		loginsPerSecond_ = float( numLoginsThisPeriod_ /
+			((now - loginRatePeriodStart_) / stampsPerSecondD()) );
+		numLoginsThisPeriod_ = 0;
+		loginRatePeriodStart_ = now;
+	}
+
+	if (task.isOkay())
+	{
+		this->continueLogin( task.source(), task.replyID(), task.pParams() );
+	}
+	else
+	{
+		this->refundLogin();
+		this->sendFailure( task.source(), task.replyID(),
 			LogOnStatus::LOGIN_MALFORMED_REQUEST,
 			"Could not destream login parameters" );
+	}
+
+	this->startQueuedLogins();
+}
+
+
+/**
+ *	This method gives back the rate limit allowance that login took for a
+ *	login that was not attempted. The allowance is not raised above the limit,
+ *	in case it was reset while the login was queued.
+ */
+void LoginApp::refundLogin()
+{
+	if (rateLimitDuration_ &&
+			(numAllowedLoginsLeft_ < uint( loginRateLimit_ )))
+	{
+		++numAllowedLoginsLeft_;
+	}
+}
 
+
+/**
+ *	This method hands queued logins to any login threads that are free.
+ */
+void LoginApp::startQueuedLogins()
+{
+	while (!loginQueue_.empty() &&
+			loginThreadPool_.doTask( *loginQueue_.front() ))
+	{
+		loginQueue_.pop_front();
+	}
+}
+
+
+/**
+ *	This method returns roughly how long, in seconds, a login that was queued
+ *	now would wait to be decrypted.
+ */
+int LoginApp::estimatedLoginWait() const
+{
+	float wait = averageDecryptTime_ * (loginQueue_.size() + 1) /
+		std::max( numLoginThreads_, 1 );
+
+	return std::max( int( ceilf( wait ) ), 1 );
+}
+
+
+/**
+ *	This method is called by a login thread to get a copy of the private key
+ *	that no other thread is using.
+ */
+Mercury::PublicKeyCipher * LoginApp::acquirePrivateKey()
+{
+	if (numLoginThreads_ <= 0)
+	{
+		return &privateKey_;
+	}
+
+	SimpleMutexHolder smh( privateKeysLock_ );
+
+	MF_ASSERT( !freePrivateKeys_.empty() );
+	Mercury::PublicKeyCipher * pKey = freePrivateKeys_.back();
+	freePrivateKeys_.pop_back();
+
+	return pKey;
+}
+
+
+/**
+ *	This method is called by a login thread when it has finished with the
+ *	private key from acquirePrivateKey.
+ */
+void LoginApp::releasePrivateKey( Mercury::PublicKeyCipher * pKey )
+{
+	if (pKey == &privateKey_)
+	{
 		return;
 	}
 
-	// First check whether this is a repeat attempt from a recent
-	// resolved login before attempting to log in.
-	if (this->handleResentCachedAttempt( source, pParams, header.replyID ))
+	SimpleMutexHolder smh( privateKeysLock_ );
+	freePrivateKeys_.push_back( pKey );
+}
+
+
+/**
+ *	Destructor.
+ */
+LoginApp::~LoginApp()
+{
+	// Logins that are still queued are dropped. Those on a login thread are
+	// waited for, so that no thread is using a private key when they are
+	// deleted.
+	while (!loginQueue_.empty())
 	{
-		// ignore this one, we've seen it recently
+		delete loginQueue_.front();
+		loginQueue_.pop_front();
+	}
+
+	loginThreadPool_.waitForAllTasks();
+
+	for (PrivateKeys::iterator iter = privateKeys_.begin();
+			iter != privateKeys_.end(); ++iter)
+	{
+		delete *iter;
+	}
+
+	privateKeys_.clear();
+	freePrivateKeys_.clear();
+}
+
+
+/**
+ *	This method continues a login once its parameters have been decrypted.
+ */
+void LoginApp::continueLogin( const Mercury::Address & source,
+		Mercury::ReplyID replyID, LogOnParamsPtr pParams )
+{
+	// The DBMgr may have gone away while the login was queued.
+	if (!this->isDBReady())
+	{
+		this->refundLogin();
+		this->sendFailure( source, replyID,
+			LogOnStatus::LOGIN_REJECTED_DB_NOT_READY, "DB not ready" );
 		return;
 	}
 
-	if (rateLimitDuration_)
+	this->negotiateChannelFilter( *pParams );
+
+	// First check whether this is a repeat attempt from a recent
+	// resolved login before attempting to log in.
+	if (this->handleResentCachedAttempt( source, pParams, replyID ))
 	{
-		// We've done the hard work of decrypting the logon parameters now, so
-		// we count this as a login with regards to rate-limiting.
-		--numAllowedLoginsLeft_;
+		// ignore this one, we've seen it recently
+		this->refundLogin();
+		return;
 	}
 
 
@@ -1279,16 +1584,16 @@ void LoginApp::login( const Mercury::Address & source,
 
     if(useWGS_)
     {
-        int ret = wgsAuth_->sendAuthentication( source, header.replyID, pParams );
+        int ret = wgsAuth_->sendAuthentication( source, replyID, pParams );
         switch(ret)
         {
             case WGSServerAuthentication::WGS_SERVER_NOT_CONNECT:
-                this->sendFailure(source, header.replyID, LogOnStatus::LOGIN_CUSTOM_DEFINED_ERROR, 
+                this->sendFailure(source, replyID, LogOnStatus::LOGIN_CUSTOM_DEFINED_ERROR, 
                     "101 wgs server not connect", pParams);
                 break;
 
             case WGSServerAuthentication::WGS_INPUT_FORMAT_ERROR:
-                this->sendFailure(source, header.replyID, LogOnStatus::LOGIN_CUSTOM_DEFINED_ERROR, 
+                this->sendFailure(source, replyID, LogOnStatus::LOGIN_CUSTOM_DEFINED_ERROR, 
                     "104 data format error", pParams);
                 break;
 
@@ -1299,7 +1604,7 @@ void LoginApp::login( const Mercury::Address & source,
     }
 
 	DatabaseReplyHandler * pDBHandler =
-		new DatabaseReplyHandler( source, header.replyID, pParams );
+		new DatabaseReplyHandler( source, replyID, pParams );
 
 	Mercury::Bundle	& dbBundle = this->dbMgr().bundle();
 	dbBundle.startRequest( DBInterface::logOn, pDBHandler, NULL,
@@ -1566,7 +1871,7 @@ void LoginApp::sendAndCacheSuccess( const Mercury::Address & addr,
     if(!useWGS_)
     {
 	    this->sendSuccess( addr, replyID, replyRecord,
-		    pParams->encryptionKey() );
+		    pParams->channelKey() );
     }
     else
     {
@@ -1603,17 +1908,16 @@ void LoginApp::sendAndCacheSuccess( const Mercury::Address & addr,
  */
 void LoginApp::sendSuccess( const Mercury::Address & addr,
 	Mercury::ReplyID replyID, const LoginReplyRecord & replyRecord,
-	const std::string & encryptionKey )
+	const std::string & channelKey )
 {
 	Mercury::Bundle b;
 	b.startReply( replyID );
 	b << (int8)LogOnStatus::LOGGED_ON;
 
 	// We have to encrypt the reply record because it contains the session key
-	Mercury::EncryptionFilter filter( encryptionKey );
 	MemoryOStream clearText;
 	clearText << replyRecord;
-	filter.encryptStream( clearText, b );
+	this->encryptReply( channelKey, clearText, b );
 
 	this->extNub().send( addr, b );
 }
@@ -1627,14 +1931,62 @@ void LoginApp::sendSuccess( const Mercury::Address & addr,
 	b << (int8)LogOnStatus::LOGGED_ON;
 
 	// We have to encrypt the reply record because it contains the session key
-	Mercury::EncryptionFilter filter( pParams->encryptionKey() );
 	MemoryOStream clearText;
     clearText << replyRecord << pParams->password();
-    filter.encryptStream( clearText, b );
+	this->encryptReply( pParams->channelKey(), clearText, b );
 
 	this->extNub().send( addr, b );
 }
 
+
+/**
+ *	This method encrypts a login reply with the same cipher that the client's
+ *	channel to the BaseApp will use. A client that asked for AES-GCM finds out
+ *	whether it was agreed to by whether the reply passes its tag check.
+ */
+void LoginApp::encryptReply( const std::string & channelKey,
+	MemoryOStream & clearText, BinaryOStream & cipherText )
+{
+#ifdef MERCURY_HAS_AES_GCM
+	if (Mercury::AesGcmFilter::isTaggedKey( channelKey ))
+	{
+		Mercury::AesGcmFilter filter(
+			Mercury::AesGcmFilter::untagKey( channelKey ),
+			Mercury::AesGcmFilter::LOGIN_APP, Mercury::AesGcmFilter::CLIENT );
+		filter.encryptStream( clearText, cipherText );
+		return;
+	}
+#endif
+
+	Mercury::EncryptionFilter filter( channelKey );
+	filter.encryptStream( clearText, cipherText );
+}
+
+
+/**
+ *	This method clears a client's request for an AES-GCM channel filter if
+ *	this LoginApp cannot or should not agree to it. The flag is passed on to
+ *	the DBMgr with the rest of the parameters, so the BaseApp gets the same
+ *	answer through LogOnParams::channelKey.
+ */
+void LoginApp::negotiateChannelFilter( LogOnParams & params ) const
+{
+	if (!params.wantsAesGcm())
+	{
+		return;
+	}
+
+#ifdef MERCURY_HAS_AES_GCM
+	if (allowAesGcm_ &&
+		(params.encryptionKey().size() == Mercury::AesGcmFilter::KEY_SIZE))
+	{
+		return;
+	}
+#endif
+
+	params.flags( params.flags() & ~LogOnParams::WANTS_AES_GCM );
+}
+
 /**
  *	This method checks whether there is a login in progress from this
  *	address.
@@ -1678,7 +2030,7 @@ bool LoginApp::handleResentCachedAttempt( const Mercury::Address & addr,
 		if (!cache.isTooOld() && *cache.pParams() == *pParams)
 		{
 			this->sendSuccess( addr, replyID, cache.replyRecord(),
-				cache.pParams()->encryptionKey() );
+				cache.pParams()->channelKey() );
 
 			return true;
 		}
@@ -1739,7 +2091,29 @@ bool LoginApp::setKeyFromResource( const std::string & path )
 		BinaryPtr pBinData = pSection->asBinary();
 		std::string keyStr( pBinData->cdata(), pBinData->len() );
 
-		return privateKey_.setKey( keyStr );
+		if (!privateKey_.setKey( keyStr ))
+		{
+			return false;
+		}
+
+		// OpenSSL's RSA objects cannot be shared between threads, so each
+		// login thread gets its own.
+		for (int i = 0; i < numLoginThreads_; ++i)
+		{
+			Mercury::PublicKeyCipher * pKey =
+				new Mercury::PublicKeyCipher( /* hasPrivate: */ true );
+
+			if (!pKey->setKey( keyStr ))
+			{
+				delete pKey;
+				return false;
+			}
+
+			privateKeys_.push_back( pKey );
+			freePrivateKeys_.push_back( pKey );
+		}
+
+		return true;
 	}
 	else
 	{
@@ -28,6 +28,11 @@ criminal penalties as provided by law.
 
 #include "dbmgr/worker_thread.hpp"
 
+#include <deque>
+#include <set>
+
+class LoginDecryptTask;
+
 typedef Mercury::ChannelOwner DBMgr;
 
 class KeepWGSHeartbeat : public Mercury::TimerExpiryHandler
@@ -119,6 +124,7 @@ class LoginApp
 {
 public:
 	LoginApp( uint16 loginPort = 0 );
+	~LoginApp();
 
 	bool init( int argc, char * argv[], uint16 loginPort );
 	void run();
@@ -224,6 +230,19 @@ private:
 		LoginReplyRecord replyRecord_;
 	};
 
+	void continueLogin( const Mercury::Address & source,
+		Mercury::ReplyID replyID, LogOnParamsPtr pParams );
+
+	void onLoginDecrypted( LoginDecryptTask & task );
+	void startQueuedLogins();
+	void refundLogin();
+
+	Mercury::PublicKeyCipher * acquirePrivateKey();
+	void releasePrivateKey( Mercury::PublicKeyCipher * pKey );
+
+	int loginQueueDepth() const		{ return int( loginQueue_.size() ); }
+	int estimatedLoginWait() const;
+
 	bool handleResentPendingAttempt( const Mercury::Address & addr,
 		Mercury::ReplyID replyID );
 	bool handleResentCachedAttempt( const Mercury::Address & addr,
@@ -231,10 +250,14 @@ private:
 
 	void sendSuccess( const Mercury::Address & addr,
 		Mercury::ReplyID replyID, const LoginReplyRecord & replyRecord,
-		const std::string & encryptionKey );
+		const std::string & channelKey );
         void sendSuccess( const Mercury::Address & addr,
                 Mercury::ReplyID replyID, const LoginReplyRecord & replyRecord,
                 LogOnParamsPtr pParams );
+	void encryptReply( const std::string & channelKey,
+		MemoryOStream & clearText, BinaryOStream & cipherText );
+
+	void negotiateChannelFilter( LogOnParams & params ) const;
 
 	void rateLimitSeconds( uint newPeriod )
 	{ rateLimitDuration_ = newPeriod * stampsPerSecond(); }
@@ -258,6 +281,7 @@ private:
 	bool				allowLogin_;
 	bool				allowProbe_;
 	bool				logProbes_;
+	bool				allowAesGcm_;
 	bool				autoRegister_;
     int                 registerTimeout_;
 
@@ -272,6 +296,35 @@ private:
     WorkerThreadMgr		workerThreadMgr_;
     WorkerThreadPool	threadPool_;
 
+	// Login decryption state
+
+	// The login parameters are decrypted on these threads, so that the RSA
+	// decryption does not hold up the main thread.
+	int					numLoginThreads_;
+	WorkerThreadPool	loginThreadPool_;
+
+	// Each login thread needs its own copy of the private key.
+	typedef std::vector< Mercury::PublicKeyCipher * > PrivateKeys;
+	PrivateKeys			privateKeys_;
+	PrivateKeys			freePrivateKeys_;
+	SimpleMutex			privateKeysLock_;
+
+	// The logins that are waiting for a login thread.
+	typedef std::deque< LoginDecryptTask * > LoginQueue;
+	LoginQueue			loginQueue_;
+	int					maxLoginQueueSize_;
+
+	// The addresses of the logins that are queued or being decrypted.
+	typedef std::set< Mercury::Address > PendingDecrypts;
+	PendingDecrypts		pendingDecrypts_;
+
+	// The average time taken to decrypt a login, in seconds.
+	float				averageDecryptTime_;
+
+	uint64				loginRatePeriodStart_;
+	uint				numLoginsThisPeriod_;
+	float				loginsPerSecond_;
+
 	AnonymousChannelClient dbMgr_;
 
 	uint64 				maxLoginDelay_;
@@ -292,6 +345,8 @@ private:
 	uint64				rateLimitDuration_;
 
 	static LoginApp * pInstance_;
+
+	friend class LoginDecryptTask;
         bool    useWGS_;
         WGSServerAuthentication *wgsAuth_;
         KeepWGSHeartbeat *wgsHearbeat_;
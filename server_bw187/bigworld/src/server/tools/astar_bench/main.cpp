@@ -0,0 +1,321 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+/**
+ *	This program compares the IndexedAStar engine that Navigators use with the
+ *	AStar engine that it replaced.
+ *
+ *	The searches are on a grid of rooms joined by doorways, with scattered
+ *	obstacles, which is roughly the shape of the waypoint graphs in a chunk.
+ *	Both engines search for the same paths, and the number of states each
+ *	expands and the time each takes per path are printed.
+ *
+ *	To compare the engines on the waypoints of a real space, set the CellApp
+ *	watcher navigation/astar/compareWithLegacy, and read the results from
+ *	navigation/astar/comparison.
+ *
+ *	Usage: astar_bench [gridSize] [numPaths]
+ */
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/timestamp.hpp"
+
+#include "waypoint/astar.hpp"
+#include "waypoint/indexed_astar.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+DECLARE_DEBUG_COMPONENT(0)
+
+namespace
+{
+
+const int ROOM_SIZE = 12;
+const float DIAGONAL = 1.41421356f;
+
+const int DX[] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+const int DY[] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+/**
+ *	This class is the grid that is searched. A cell is either open or blocked.
+ */
+class Grid
+{
+public:
+	void create( int size, int obstaclePercent );
+
+	int size() const						{ return size_; }
+	bool isOpen( int x, int y ) const
+	{
+		return (x >= 0) && (y >= 0) && (x < size_) && (y < size_) &&
+			(cells_[ y * size_ + x ] == 0);
+	}
+
+private:
+	void block( int x, int y )				{ cells_[ y * size_ + x ] = 1; }
+	void unblock( int x, int y )			{ cells_[ y * size_ + x ] = 0; }
+
+	int size_;
+	std::vector< char > cells_;
+};
+
+Grid s_grid;
+
+
+/**
+ *	This method creates a grid of rooms. Each wall has a doorway to the next
+ *	room, and the given percentage of the other cells are blocked.
+ */
+void Grid::create( int size, int obstaclePercent )
+{
+	size_ = size;
+	cells_.assign( size * size, 0 );
+
+	for (int y = 0; y < size; ++y)
+	{
+		for (int x = 0; x < size; ++x)
+		{
+			if ((x % ROOM_SIZE == 0) || (y % ROOM_SIZE == 0) ||
+					(rand() % 100 < obstaclePercent))
+			{
+				this->block( x, y );
+			}
+		}
+	}
+
+	for (int y = 0; y < size; y += ROOM_SIZE)
+	{
+		for (int x = 0; x < size; x += ROOM_SIZE)
+		{
+			int doorX = x + 1 + rand() % (ROOM_SIZE - 3);
+			int doorY = y + 1 + rand() % (ROOM_SIZE - 3);
+
+			for (int i = 0; (i < 2) && (doorX + i < size); ++i)
+			{
+				this->unblock( doorX + i, y );
+			}
+
+			for (int i = 0; (i < 2) && (doorY + i < size); ++i)
+			{
+				this->unblock( x, doorY + i );
+			}
+		}
+	}
+}
+
+
+/**
+ *	This class is a search state on the grid. Moves are to any of the eight
+ *	neighbouring cells that are open, without cutting corners.
+ */
+class GridState
+{
+public:
+	typedef int adjacency_iterator;
+
+	GridState( int x = 0, int y = 0 ) :
+		x_( x ), y_( y ), distanceFromParent_( 0.f ) {}
+
+	int compare( const GridState & other ) const
+	{
+		return (y_ != other.y_) ? (y_ - other.y_) : (x_ - other.x_);
+	}
+
+	int hash() const						{ return y_ * s_grid.size() + x_; }
+
+	bool isGoal( const GridState & goal ) const
+	{
+		return this->compare( goal ) == 0;
+	}
+
+	adjacency_iterator adjacenciesBegin() const		{ return 0; }
+	adjacency_iterator adjacenciesEnd() const		{ return 8; }
+
+	bool getAdjacency( adjacency_iterator i, GridState & adj,
+		const GridState & goal ) const
+	{
+		int x = x_ + DX[i];
+		int y = y_ + DY[i];
+
+		if (!s_grid.isOpen( x, y ) ||
+				!s_grid.isOpen( x, y_ ) || !s_grid.isOpen( x_, y ))
+		{
+			return false;
+		}
+
+		adj.x_ = x;
+		adj.y_ = y;
+		adj.distanceFromParent_ = (i & 1) ? DIAGONAL : 1.f;
+
+		return true;
+	}
+
+	float distanceFromParent() const		{ return distanceFromParent_; }
+
+	float distanceToGoal( const GridState & goal ) const
+	{
+		float dx = float( x_ - goal.x_ );
+		float dy = float( y_ - goal.y_ );
+
+		return sqrtf( dx * dx + dy * dy );
+	}
+
+private:
+	int x_;
+	int y_;
+	float distanceFromParent_;
+};
+
+
+/**
+ *	This structure holds the totals for one engine.
+ */
+struct Result
+{
+	Result() : numFound( 0 ), numExpanded( 0 ), cost( 0.0 ), time( 0.0 ) {}
+
+	int numFound;
+	double numExpanded;
+	double cost;
+	double time;
+};
+
+
+/**
+ *	This function returns the number of microseconds since the given time.
+ */
+double microsecondsSince( uint64 startTime )
+{
+	return double( timestamp() - startTime ) * 1000000.0 / stampsPerSecondD();
+}
+
+
+/**
+ *	This function returns the cost of the path found by the given search.
+ */
+template <class ASTAR>
+float pathCost( ASTAR & astar )
+{
+	float cost = 0.f;
+
+	for (const GridState * pState = astar.first(); pState != NULL;
+			pState = astar.next())
+	{
+		cost += pState->distanceFromParent();
+	}
+
+	return cost;
+}
+
+
+/**
+ *	This function runs the searches with one engine. The engine is created for
+ *	each search, as Navigator does.
+ */
+template <class ASTAR>
+void run( const std::vector< GridState > & srcs,
+		const std::vector< GridState > & dsts, Result & result )
+{
+	for (size_t i = 0; i < srcs.size(); ++i)
+	{
+		uint64 startTime = timestamp();
+
+		ASTAR astar;
+		bool found = astar.search( srcs[i], dsts[i], -1.f );
+
+		result.time += microsecondsSince( startTime );
+		result.numExpanded += astar.numExpanded();
+
+		if (found)
+		{
+			++result.numFound;
+			result.cost += pathCost( astar );
+		}
+	}
+}
+
+
+/**
+ *	This function prints the results of one engine.
+ */
+void print( const char * name, const Result & result, int numPaths )
+{
+	printf( "%-14s %8.1f expansions/path  %8.2f us/path  "
+			"(%d found, mean cost %.2f)\n",
+		name,
+		result.numExpanded / numPaths,
+		result.time / numPaths,
+		result.numFound,
+		result.numFound ? result.cost / result.numFound : 0.0 );
+}
+
+
+/**
+ *	This function returns a random open cell.
+ */
+GridState randomOpenState()
+{
+	for (;;)
+	{
+		int x = rand() % s_grid.size();
+		int y = rand() % s_grid.size();
+
+		if (s_grid.isOpen( x, y ))
+		{
+			return GridState( x, y );
+		}
+	}
+}
+
+} // anonymous namespace
+
+
+int main( int argc, char * argv[] )
+{
+	int gridSize = (argc > 1) ? atoi( argv[1] ) : 96;
+	int numPaths = (argc > 2) ? atoi( argv[2] ) : 2000;
+
+	if ((gridSize < ROOM_SIZE) || (numPaths < 1))
+	{
+		printf( "Usage: %s [gridSize] [numPaths]\n", argv[0] );
+		return 1;
+	}
+
+	srand( 1 );
+	s_grid.create( gridSize, 15 );
+
+	std::vector< GridState > srcs;
+	std::vector< GridState > dsts;
+
+	for (int i = 0; i < numPaths; ++i)
+	{
+		srcs.push_back( randomOpenState() );
+		dsts.push_back( randomOpenState() );
+	}
+
+	printf( "%dx%d grid, %d paths\n", gridSize, gridSize, numPaths );
+
+	Result legacy;
+	Result indexed;
+
+	run< AStar< GridState > >( srcs, dsts, legacy );
+	run< IndexedAStar< GridState > >( srcs, dsts, indexed );
+
+	print( "AStar", legacy, numPaths );
+	print( "IndexedAStar", indexed, numPaths );
+
+	return 0;
+}
+
+// main.cpp
@@ -0,0 +1,173 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+/**
+ *	This program compares the EntityIDMap that the CellApp uses for its entity
+ *	population with the std::map that it replaced.
+ *
+ *	The IDs are allocated in ranges, as the CellAppMgr hands them out, and are
+ *	then looked up in a random order, as incoming entity messages are. The
+ *	churn pass erases and inserts entities, as ghosts come and go.
+ *
+ *	Usage: entity_map_bench [numEntities] [numLookups]
+ */
+
+#include "cellapp/entity_id_map.hpp"
+
+#include "cstdmf/timestamp.hpp"
+
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+
+const int ID_RANGE_SIZE = 1000;
+
+/**
+ *	This function returns the IDs of the entities, in ranges of consecutive IDs
+ *	that are spread over the ID space.
+ */
+void makeIDs( int numEntities, std::vector< ObjectID > & ids )
+{
+	ids.clear();
+
+	ObjectID rangeStart = 1;
+
+	while (int( ids.size() ) < numEntities)
+	{
+		for (int i = 0; (i < ID_RANGE_SIZE) &&
+				(int( ids.size() ) < numEntities); ++i)
+		{
+			ids.push_back( rangeStart + i );
+		}
+
+		rangeStart += ID_RANGE_SIZE * (1 + rand() % 20);
+	}
+}
+
+
+/**
+ *	This function returns the number of microseconds since the given time.
+ */
+double microsecondsSince( uint64 startTime )
+{
+	return double( timestamp() - startTime ) * 1000000.0 / stampsPerSecondD();
+}
+
+
+/**
+ *	This function runs the benchmark on one type of map.
+ */
+template <class MAP>
+void run( const char * name, const std::vector< ObjectID > & ids,
+		const std::vector< ObjectID > & lookups )
+{
+	static int s_entity;
+
+	MAP population;
+	int numEntities = int( ids.size() );
+	int numLookups = int( lookups.size() );
+
+	uint64 startTime = timestamp();
+
+	for (int i = 0; i < numEntities; ++i)
+	{
+		population.insert( std::make_pair( ids[i], &s_entity ) );
+	}
+
+	double insertTime = microsecondsSince( startTime );
+
+	startTime = timestamp();
+	int numFound = 0;
+
+	for (int i = 0; i < numLookups; ++i)
+	{
+		if (population.find( lookups[i] ) != population.end())
+		{
+			++numFound;
+		}
+	}
+
+	double findTime = microsecondsSince( startTime );
+
+	// Replace a quarter of the entities, a few at a time.
+	startTime = timestamp();
+	ObjectID nextID = ids.back() + ID_RANGE_SIZE;
+
+	for (int i = 0; i < numEntities / 4; ++i)
+	{
+		population.erase( ids[ (i * 4) % numEntities ] );
+		population.insert( std::make_pair( nextID++, &s_entity ) );
+	}
+
+	double churnTime = microsecondsSince( startTime );
+
+	startTime = timestamp();
+	int numVisited = 0;
+
+	for (typename MAP::const_iterator iter = population.begin();
+			iter != population.end(); ++iter)
+	{
+		++numVisited;
+	}
+
+	double iterateTime = microsecondsSince( startTime );
+
+	printf( "%-12s insert %6.1f ns  find %6.1f ns  erase+insert %6.1f ns  "
+			"iterate %6.1f ns  (%d found, %d visited)\n",
+		name,
+		insertTime * 1000.0 / numEntities,
+		findTime * 1000.0 / numLookups,
+		churnTime * 1000.0 / (numEntities / 4),
+		iterateTime * 1000.0 / numVisited,
+		numFound, numVisited );
+}
+
+} // anonymous namespace
+
+
+int main( int argc, char * argv[] )
+{
+	int numEntities = (argc > 1) ? atoi( argv[1] ) : 60000;
+	int numLookups = (argc > 2) ? atoi( argv[2] ) : 10000000;
+
+	if ((numEntities < 4) || (numLookups < 1))
+	{
+		printf( "Usage: %s [numEntities] [numLookups]\n", argv[0] );
+		return 1;
+	}
+
+	srand( 1 );
+
+	std::vector< ObjectID > ids;
+	makeIDs( numEntities, ids );
+
+	// Mostly hits, with some misses for entities that have just left.
+	std::vector< ObjectID > lookups( numLookups );
+
+	for (int i = 0; i < numLookups; ++i)
+	{
+		lookups[i] = (rand() % 10 == 0) ?
+			ids.back() + 1 + rand() % numEntities :
+			ids[ rand() % numEntities ];
+	}
+
+	printf( "%d entities, %d lookups\n", numEntities, numLookups );
+
+	run< std::map< ObjectID, int * > >( "std::map", ids, lookups );
+	run< EntityIDMap< int * > >( "EntityIDMap", ids, lookups );
+
+	return 0;
+}
+
+// main.cpp
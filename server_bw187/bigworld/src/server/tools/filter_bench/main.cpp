@@ -0,0 +1,182 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+/**
+ *	This program compares the throughput of the AesGcmFilter that clients can
+ *	negotiate at login with the Blowfish EncryptionFilter that it replaces.
+ *
+ *	The same packets are sealed by the client's filter and opened by the
+ *	BaseApp's, and the time each takes per packet is printed. The filters are
+ *	driven through encryptStream and decryptStream, which do the same cipher
+ *	work as send and recv without a Nub. EncryptionFilter::encryptStream pads
+ *	to a multiple of its maxSpareSize, so the default packet size is a
+ *	multiple of that, and neither filter pads.
+ *
+ *	AES-GCM needs OpenSSL 1.0.1 or later. Builds against an older OpenSSL only
+ *	time Blowfish.
+ *
+ *	Usage: filter_bench [packetSize] [numPackets]
+ */
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/memory_stream.hpp"
+#include "cstdmf/timestamp.hpp"
+
+#include "network/aes_gcm_filter.hpp"
+#include "network/encryption_filter.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+DECLARE_DEBUG_COMPONENT(0)
+
+namespace
+{
+
+/**
+ *	This function returns the number of microseconds since the given time.
+ */
+double microsecondsSince( uint64 startTime )
+{
+	return double( timestamp() - startTime ) * 1000000.0 / stampsPerSecondD();
+}
+
+
+/**
+ *	These functions open a sealed packet. Only AesGcmFilter can tell whether
+ *	the packet was sealed with its key.
+ */
+bool open( Mercury::EncryptionFilter & filter, BinaryIStream & cipherText,
+	BinaryOStream & clearText )
+{
+	filter.decryptStream( cipherText, clearText );
+	return true;
+}
+
+#ifdef MERCURY_HAS_AES_GCM
+bool open( Mercury::AesGcmFilter & filter, BinaryIStream & cipherText,
+	BinaryOStream & clearText )
+{
+	return filter.decryptStream( cipherText, clearText );
+}
+#endif
+
+
+/**
+ *	This function seals the given packets with one filter and opens them with
+ *	the other, and prints the time taken.
+ */
+template <class FILTER>
+void run( const char * name, FILTER & sealer, FILTER & opener,
+		const std::vector< std::string > & packets )
+{
+	int numPackets = int( packets.size() );
+	int packetSize = int( packets[0].size() );
+
+	std::vector< std::string > sealed( numPackets );
+
+	uint64 startTime = timestamp();
+
+	for (int i = 0; i < numPackets; ++i)
+	{
+		MemoryOStream clearText( packetSize );
+		clearText.addBlob( packets[i].data(), packetSize );
+
+		MemoryOStream cipherText( packetSize + sealer.maxSpareSize() );
+		sealer.encryptStream( clearText, cipherText );
+
+		sealed[i].assign( (char *)cipherText.data(), cipherText.size() );
+	}
+
+	double sealTime = microsecondsSince( startTime );
+
+	int numFailed = 0;
+
+	startTime = timestamp();
+
+	for (int i = 0; i < numPackets; ++i)
+	{
+		MemoryIStream cipherText( (char *)sealed[i].data(),
+			int( sealed[i].size() ) );
+		MemoryOStream clearText( int( sealed[i].size() ) );
+
+		if (!open( opener, cipherText, clearText ) ||
+				(clearText.size() < packetSize) ||
+				(memcmp( clearText.data(), packets[i].data(),
+					packetSize ) != 0))
+		{
+			++numFailed;
+		}
+	}
+
+	double openTime = microsecondsSince( startTime );
+
+	printf( "%-10s seal %7.2f us (%7.1f MB/s)  open %7.2f us (%7.1f MB/s)  "
+			"%d bytes sent  (%d failed)\n",
+		name,
+		sealTime / numPackets,
+		double( packetSize ) * numPackets / sealTime,
+		openTime / numPackets,
+		double( packetSize ) * numPackets / openTime,
+		int( sealed[0].size() ),
+		numFailed );
+}
+
+} // anonymous namespace
+
+
+int main( int argc, char * argv[] )
+{
+	int packetSize = (argc > 1) ? atoi( argv[1] ) : 1248;
+	int numPackets = (argc > 2) ? atoi( argv[2] ) : 20000;
+
+	if ((packetSize < 1) || (numPackets < 1))
+	{
+		printf( "Usage: %s [packetSize] [numPackets]\n", argv[0] );
+		return 1;
+	}
+
+	srand( 1 );
+
+	std::vector< std::string > packets( numPackets );
+
+	for (int i = 0; i < numPackets; ++i)
+	{
+		packets[i].resize( packetSize );
+
+		for (int j = 0; j < packetSize; ++j)
+		{
+			packets[i][j] = char( rand() );
+		}
+	}
+
+	printf( "%d packets of %d bytes\n", numPackets, packetSize );
+
+	Mercury::EncryptionFilter blowfish;
+	run( "Blowfish", blowfish, blowfish, packets );
+
+#ifdef MERCURY_HAS_AES_GCM
+	Mercury::AesGcmFilter client( blowfish.key(),
+		Mercury::AesGcmFilter::CLIENT, Mercury::AesGcmFilter::BASE_APP );
+	Mercury::AesGcmFilter baseApp( blowfish.key(),
+		Mercury::AesGcmFilter::BASE_APP, Mercury::AesGcmFilter::CLIENT );
+	run( "AES-GCM", client, baseApp, packets );
+#else
+	printf( "AES-GCM is not supported by this build's OpenSSL\n" );
+#endif
+
+	return 0;
+}
+
+// main.cpp
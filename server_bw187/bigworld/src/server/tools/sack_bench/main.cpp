@@ -0,0 +1,281 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+/**
+ *	This program compares selective ACKs on internal channels with the plain
+ *	ACKs that they replace.
+ *
+ *	Two Nubs on the loopback interface are joined by an internal channel. The
+ *	sender sends a burst of reliable packets each tick, and both Nubs drop the
+ *	given percentage of the packets that they send, ACKs included. Each run is
+ *	done once with each kind of ACK, from the same random seed. The bytes that
+ *	the receiver sent to ACK the packets, the number of resends and the time
+ *	from the last send until every packet was ACKed are averaged over the runs
+ *	and printed. The recovery time depends on which packets are dropped, so
+ *	it takes a few runs for it to settle.
+ *
+ *	The CellApp and BaseApp turn selective ACKs on with the
+ *	networking/selectiveAcks option in bw.xml.
+ *
+ *	Usage: sack_bench [lossPercent] [numPackets] [packetsPerTick] [numRuns]
+ */
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/timestamp.hpp"
+
+#include "network/channel.hpp"
+#include "network/interfaces.hpp"
+#include "network/nub.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+DECLARE_DEBUG_COMPONENT(0)
+
+namespace
+{
+
+const Mercury::MessageID BENCH_MESSAGE_ID = 100;
+const int MESSAGE_SIZE = 64;
+const int TICK_MICROSECONDS = 10000;
+const double TIMEOUT_SECONDS = 60.0;
+
+/**
+ *	This class counts the messages that arrive at the receiver.
+ */
+class CountingHandler : public Mercury::InputMessageHandler
+{
+public:
+	CountingHandler() : numReceived( 0 ) {}
+
+	virtual void handleMessage( const Mercury::Address & source,
+		Mercury::UnpackedMessageHeader & header,
+		BinaryIStream & data )
+	{
+		data.retrieve( header.length );
+		++numReceived;
+	}
+
+	int numReceived;
+};
+
+
+/**
+ *	This structure holds the totals for one kind of ACK.
+ */
+struct Result
+{
+	Result() :
+		numReceived( 0.0 ),
+		numPacketsResent( 0.0 ),
+		numAckPackets( 0.0 ),
+		numAckBytes( 0.0 ),
+		recoveryTime( 0.0 ),
+		numTimedOut( 0 )
+	{}
+
+	double numReceived;
+	double numPacketsResent;
+	double numAckPackets;
+	double numAckBytes;
+	double recoveryTime;
+	int numTimedOut;
+};
+
+
+/**
+ *	This function returns the number of seconds since the given time.
+ */
+double secondsSince( uint64 startTime )
+{
+	return double( timestamp() - startTime ) / stampsPerSecondD();
+}
+
+
+/**
+ *	This function processes the pending events of the given Nub.
+ */
+void processEvents( Mercury::Nub & nub )
+{
+	try
+	{
+		while (nub.processPendingEvents())
+		{
+			; // Drain incoming events
+		}
+	}
+	catch (Mercury::NubException & ne)
+	{
+		nub.reportException( ne );
+	}
+}
+
+
+/**
+ *	This function processes the events of both Nubs for one tick.
+ */
+void processTick( Mercury::Nub & sender, Mercury::Nub & receiver )
+{
+	uint64 endTime = timestamp() +
+		uint64( stampsPerSecondD() * TICK_MICROSECONDS / 1000000.0 );
+
+	while (timestamp() < endTime)
+	{
+		processEvents( sender );
+		processEvents( receiver );
+
+		usleep( 500 );
+	}
+}
+
+
+/**
+ *	This function runs the benchmark once with one kind of ACK, and adds the
+ *	results to the totals. The random number generator, which decides which
+ *	packets are dropped, starts from the given seed.
+ */
+void run( bool useSelectiveAcks, float lossRatio, int numPackets,
+		int packetsPerTick, unsigned int seed, Result & result )
+{
+	Mercury::Channel::useInternalSelectiveAcks( useSelectiveAcks );
+	srand( seed );
+
+	Mercury::Nub sender( 0, "127.0.0.1" );
+	Mercury::Nub receiver( 0, "127.0.0.1" );
+
+	CountingHandler handler;
+	Mercury::InterfaceElement ie( "benchMessage", BENCH_MESSAGE_ID,
+		Mercury::FIXED_LENGTH_MESSAGE, MESSAGE_SIZE );
+	receiver.serveInterfaceElement( ie, BENCH_MESSAGE_ID, &handler );
+
+	sender.setLossRatio( lossRatio );
+	receiver.setLossRatio( lossRatio );
+
+	// Both ends have a regular channel, as the server components do. The
+	// receiver sends once a tick, which is when its ACKs go.
+	Mercury::Channel * pChannel = new Mercury::Channel( sender,
+		receiver.address(), Mercury::Channel::INTERNAL );
+	Mercury::Channel * pAckChannel = new Mercury::Channel( receiver,
+		sender.address(), Mercury::Channel::INTERNAL );
+
+	char data[ MESSAGE_SIZE ] = { 0 };
+	int numSent = 0;
+
+	while (numSent < numPackets)
+	{
+		for (int i = 0; (i < packetsPerTick) && (numSent < numPackets); ++i)
+		{
+			Mercury::Bundle & bundle = pChannel->bundle();
+			bundle.startMessage( ie, Mercury::RELIABLE_DRIVER );
+			bundle.addBlob( data, MESSAGE_SIZE );
+			pChannel->send();
+
+			++numSent;
+		}
+
+		processTick( sender, receiver );
+		pAckChannel->send();
+	}
+
+	uint64 startTime = timestamp();
+
+	while (pChannel->hasUnackedPackets() &&
+			(secondsSince( startTime ) < TIMEOUT_SECONDS))
+	{
+		// Sending an empty bundle does the resends that are due.
+		pChannel->send();
+		processTick( sender, receiver );
+		pAckChannel->send();
+	}
+
+	result.recoveryTime += secondsSince( startTime );
+	result.numReceived += handler.numReceived;
+	result.numPacketsResent += pChannel->numPacketsResent();
+	result.numAckPackets += pAckChannel->numPacketsSent();
+	result.numAckBytes += pAckChannel->numBytesSent();
+
+	if (pChannel->hasUnackedPackets())
+	{
+		++result.numTimedOut;
+	}
+
+	pAckChannel->destroy();
+	pChannel->destroy();
+}
+
+
+/**
+ *	This function prints the results of one kind of ACK, per run.
+ */
+void print( const char * name, const Result & result, int numRuns )
+{
+	printf( "%-16s %8.0f ACK bytes in %6.0f packets  %6.0f resends  "
+			"%8.1f ms recovery  (%.0f received, %d timed out)\n",
+		name,
+		result.numAckBytes / numRuns,
+		result.numAckPackets / numRuns,
+		result.numPacketsResent / numRuns,
+		result.recoveryTime * 1000.0 / numRuns,
+		result.numReceived / numRuns,
+		result.numTimedOut );
+}
+
+} // anonymous namespace
+
+
+int main( int argc, char * argv[] )
+{
+	int lossPercent = (argc > 1) ? atoi( argv[1] ) : 5;
+	int numPackets = (argc > 2) ? atoi( argv[2] ) : 5000;
+	int packetsPerTick = (argc > 3) ? atoi( argv[3] ) : 100;
+	int numRuns = (argc > 4) ? atoi( argv[4] ) : 10;
+
+	if ((lossPercent < 0) || (lossPercent >= 100) ||
+			(numPackets < 1) || (packetsPerTick < 1) || (numRuns < 1))
+	{
+		printf( "Usage: %s [lossPercent] [numPackets] [packetsPerTick] "
+				"[numRuns]\n",
+			argv[0] );
+		return 1;
+	}
+
+	// The artificial loss is reported for every packet dropped.
+	DebugFilter::instance().filterThreshold( MESSAGE_PRIORITY_ERROR );
+
+	printf( "%d%% loss, %d packets, %d packets per tick, %d runs\n",
+		lossPercent, numPackets, packetsPerTick, numRuns );
+
+	Result plain;
+	Result selective;
+	float lossRatio = lossPercent / 100.f;
+
+	for (int i = 0; i < numRuns; ++i)
+	{
+		run( false, lossRatio, numPackets, packetsPerTick, i + 1, plain );
+		run( true, lossRatio, numPackets, packetsPerTick, i + 1, selective );
+	}
+
+	print( "ACKs", plain, numRuns );
+	print( "Selective ACKs", selective, numRuns );
+
+	if (plain.numAckBytes > 0.0)
+	{
+		printf( "Selective ACKs saved %.0f bytes per run (%.1f%%)\n",
+			(plain.numAckBytes - selective.numAckBytes) / numRuns,
+			100.0 * (plain.numAckBytes - selective.numAckBytes) /
+				plain.numAckBytes );
+	}
+
+	return 0;
+}
+
+// main.cpp
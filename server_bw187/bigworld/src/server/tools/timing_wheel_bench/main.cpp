@@ -0,0 +1,167 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+/**
+ *	This program compares the TimingWheel that the CellApp and BaseApp use for
+ *	their timers with the TimeQueue heap that it replaced.
+ *
+ *	The timers are repeating, with intervals of up to a few seconds of game
+ *	ticks, as entity timers are. Each tick some timers are cancelled and new
+ *	ones added, as entities come and go, and then the queue is processed.
+ *
+ *	Usage: timing_wheel_bench [numTimers] [numTicks] [churnPerTick]
+ */
+
+#include "cstdmf/time_queue.hpp"
+#include "cstdmf/timing_wheel.hpp"
+#include "cstdmf/timestamp.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+
+const int MAX_INTERVAL = 100;
+
+/**
+ *	This class counts the timers that fire.
+ */
+class CountingHandler : public TimeQueueHandler
+{
+public:
+	CountingHandler() : numFired( 0 ) {}
+
+	virtual void handleTimeout( TimeQueueId id, void * pUser )
+	{
+		++numFired;
+	}
+
+	virtual void onRelease( TimeQueueId id, void * pUser ) {}
+
+	int numFired;
+};
+
+
+/**
+ *	This structure describes a timer to add.
+ */
+struct TimerSpec
+{
+	uint32 start;
+	uint32 interval;
+};
+
+
+/**
+ *	This function returns the number of microseconds since the given time.
+ */
+double microsecondsSince( uint64 startTime )
+{
+	return double( timestamp() - startTime ) * 1000000.0 / stampsPerSecondD();
+}
+
+
+/**
+ *	This function runs the benchmark on one type of time queue. The same
+ *	timers are added and cancelled in the same order for each type.
+ */
+template <class QUEUE>
+void run( const char * name, const std::vector< TimerSpec > & timers,
+		const std::vector< int > & victims, int numTicks, int churnPerTick )
+{
+	CountingHandler handler;
+	QUEUE queue;
+
+	int numTimers = int( timers.size() ) - numTicks * churnPerTick;
+	std::vector< TimeQueueId > ids( numTimers );
+
+	uint64 startTime = timestamp();
+
+	for (int i = 0; i < numTimers; ++i)
+	{
+		ids[i] = queue.add( timers[i].start, timers[i].interval,
+			&handler, NULL );
+	}
+
+	double addTime = microsecondsSince( startTime );
+
+	startTime = timestamp();
+	int nextTimer = numTimers;
+	int nextVictim = 0;
+
+	for (uint32 tick = 1; tick <= uint32( numTicks ); ++tick)
+	{
+		for (int i = 0; i < churnPerTick; ++i)
+		{
+			int victim = victims[ nextVictim++ ];
+			queue.cancel( ids[ victim ] );
+
+			const TimerSpec & spec = timers[ nextTimer++ ];
+			ids[ victim ] = queue.add( tick + spec.start, spec.interval,
+				&handler, NULL );
+		}
+
+		queue.process( tick );
+	}
+
+	double tickTime = microsecondsSince( startTime );
+
+	printf( "%-12s add %6.1f ns  tick %8.2f us  (%d fired)\n",
+		name,
+		addTime * 1000.0 / numTimers,
+		tickTime / numTicks,
+		handler.numFired );
+}
+
+} // anonymous namespace
+
+
+int main( int argc, char * argv[] )
+{
+	int numTimers = (argc > 1) ? atoi( argv[1] ) : 200000;
+	int numTicks = (argc > 2) ? atoi( argv[2] ) : 1000;
+	int churnPerTick = (argc > 3) ? atoi( argv[3] ) : 40;
+
+	if ((numTimers < 1) || (numTicks < 1) || (churnPerTick < 0))
+	{
+		printf( "Usage: %s [numTimers] [numTicks] [churnPerTick]\n", argv[0] );
+		return 1;
+	}
+
+	srand( 1 );
+
+	std::vector< TimerSpec > timers( numTimers + numTicks * churnPerTick );
+
+	for (size_t i = 0; i < timers.size(); ++i)
+	{
+		timers[i].start = 1 + rand() % MAX_INTERVAL;
+		timers[i].interval = 1 + rand() % MAX_INTERVAL;
+	}
+
+	std::vector< int > victims( numTicks * churnPerTick );
+
+	for (size_t i = 0; i < victims.size(); ++i)
+	{
+		victims[i] = rand() % numTimers;
+	}
+
+	printf( "%d timers, %d ticks, %d cancels and adds per tick\n",
+		numTimers, numTicks, churnPerTick );
+
+	run< TimeQueue >( "TimeQueue", timers, victims, numTicks, churnPerTick );
+	run< TimingWheel >( "TimingWheel", timers, victims, numTicks, churnPerTick );
+
+	return 0;
+}
+
+// main.cpp
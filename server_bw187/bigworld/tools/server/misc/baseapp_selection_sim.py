@@ -0,0 +1,182 @@
+#!/usr/bin/env python
+
+"""
+Replays a login wave against the ways that the BaseAppMgr can choose a BaseApp
+for each new entity, and reports how evenly the entities were spread.
+
+The login wave is a file with the time in seconds of each login, one per line.
+Only the first field of each line is used, and lines starting with '#' are
+ignored, so a column cut from a log will do. Without a file, a synthetic wave
+is generated.
+
+The policies follow BaseAppMgr::findBestBaseApp and
+BaseAppMgr::findLeastLoadedBaseApp:
+
+  leastLoaded   The lowest reported load, ignoring creates since the report.
+  pending       The lowest reported load plus the createLoadCost of each
+                entity sent since the report.
+  twoChoices    The lower estimated load of two BaseApps chosen at random,
+                falling back to pending if its reported load is over the
+                overload level.
+
+As in the BaseAppMgr, a login is only rejected if the chosen BaseApp's reported
+load is over the overload level.
+"""
+
+import optparse
+import random
+import sys
+
+POLICIES = ("leastLoaded", "pending", "twoChoices")
+
+
+class BaseApp( object ):
+
+	def __init__( self, reportPhase ):
+		self.numEntities = 0
+		self.load = 0.0
+		self.reportedLoad = 0.0
+		self.pendingLoad = 0.0
+		self.nextReport = reportPhase
+		self.peakLoad = 0.0
+
+	def estimatedLoad( self ):
+		return self.reportedLoad + self.pendingLoad
+
+
+def leastLoaded( apps, key ):
+	best = apps[0]
+	for app in apps[1:]:
+		if key( app ) < key( best ):
+			best = app
+	return best
+
+
+def choose( policy, apps, overloadLevel ):
+	if policy == "leastLoaded":
+		return leastLoaded( apps, lambda app: app.reportedLoad )
+
+	if policy == "pending" or len( apps ) <= 2:
+		return leastLoaded( apps, BaseApp.estimatedLoad )
+
+	first, second = random.sample( apps, 2 )
+	best = first
+	if second.estimatedLoad() < first.estimatedLoad():
+		best = second
+
+	if best.reportedLoad > overloadLevel:
+		return leastLoaded( apps, BaseApp.estimatedLoad )
+
+	return best
+
+
+def simulate( policy, logins, options ):
+	random.seed( options.seed )
+
+	apps = [BaseApp( random.uniform( 0, options.reportPeriod ) )
+			for i in range( options.numBaseApps )]
+
+	numRejected = 0
+
+	for loginTime in logins:
+		# Deliver any load reports that are due before this login.
+		for app in apps:
+			while app.nextReport <= loginTime:
+				app.reportedLoad = app.load
+				app.pendingLoad = 0.0
+				app.nextReport += options.reportPeriod
+
+		app = choose( policy, apps, options.overloadLevel )
+
+		if app.reportedLoad > options.overloadLevel:
+			numRejected += 1
+			continue
+
+		app.numEntities += 1
+		app.load += options.entityCost
+		app.pendingLoad += options.createLoadCost
+		app.peakLoad = max( app.peakLoad, app.load )
+
+	return apps, numRejected
+
+
+def report( policy, apps, numRejected ):
+	counts = [app.numEntities for app in apps]
+	average = float( sum( counts ) ) / len( counts )
+	peak = max( [app.peakLoad for app in apps] )
+
+	print( "%-12s min %6d  max %6d  avg %9.1f  max/avg %5.2f  "
+			"peak load %5.2f  rejected %d" %
+		(policy, min( counts ), max( counts ), average,
+			max( counts ) / max( average, 1.0 ), peak, numRejected) )
+
+
+def readLogins( filename ):
+	logins = []
+	for line in open( filename ):
+		fields = line.split()
+		if fields and not fields[0].startswith( "#" ):
+			logins.append( float( fields[0] ) )
+	logins.sort()
+	return logins
+
+
+def main():
+	opt = optparse.OptionParser(
+		"Usage: %prog [options] [login_times_file]" )
+	opt.add_option( "-b", "--baseapps", dest = "numBaseApps", type = "int",
+					default = 8, help = "Number of BaseApps" )
+	opt.add_option( "-p", "--policy", dest = "policy", default = "all",
+					help = "One of %s, or all" % ", ".join( POLICIES ) )
+	opt.add_option( "--report-period", dest = "reportPeriod", type = "float",
+					default = 1.0,
+					help = "Seconds between each BaseApp's load reports" )
+	opt.add_option( "--entity-cost", dest = "entityCost", type = "float",
+					default = 0.0001,
+					help = "Actual load added by each entity" )
+	opt.add_option( "--create-load-cost", dest = "createLoadCost",
+					type = "float", default = 0.01,
+					help = "baseAppMgr/createLoadCost" )
+	opt.add_option( "--overload-level", dest = "overloadLevel",
+					type = "float", default = 1.0,
+					help = "baseAppMgr/baseAppOverloadLevel" )
+	opt.add_option( "-n", "--logins", dest = "numLogins", type = "int",
+					default = 5000,
+					help = "Number of logins in a synthetic wave" )
+	opt.add_option( "-d", "--duration", dest = "duration", type = "float",
+					default = 10.0,
+					help = "Length in seconds of a synthetic wave" )
+	opt.add_option( "-s", "--seed", dest = "seed", type = "int",
+					default = 1, help = "Random seed" )
+	(options, args) = opt.parse_args()
+
+	if args:
+		logins = readLogins( args[0] )
+	else:
+		random.seed( options.seed )
+		logins = sorted( [random.uniform( 0, options.duration )
+						for i in range( options.numLogins )] )
+
+	if not logins:
+		print( "No logins to replay" )
+		return 1
+
+	if options.policy == "all":
+		policies = POLICIES
+	elif options.policy in POLICIES:
+		policies = (options.policy,)
+	else:
+		opt.error( "Unknown policy '%s'" % options.policy )
+
+	print( "%d logins over %.1f seconds, %d BaseApps" %
+		(len( logins ), logins[-1] - logins[0], options.numBaseApps) )
+
+	for policy in policies:
+		apps, numRejected = simulate( policy, logins, options )
+		report( policy, apps, numRejected )
+
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit( main() )
@@ -0,0 +1,142 @@
+#!/usr/bin/env python
+
+"""
+Replays a shutdown-sized burst of entity writes against a MySQL server, with
+and without group commit, and reports the write rate of each.
+
+Each write does what the DBMgr does for an entity with one sequence property:
+an UPDATE of the entity's row, a DELETE of its rows in the sequence's table and
+an INSERT of each element. Without group commit, each write is committed on
+its own. With group commit, writes are committed in batches of
+dbMgr/groupCommit/maxEntities, as MySqlDatabase does when it is behind.
+
+This measures MySQL only. It issues the same statements with the same commit
+pattern as MySqlDatabase's PutEntityBatchTask, but does not run the DBMgr, so
+it shows how much of the commit cost batching can remove, not the throughput
+of the DBMgr itself. To measure the DBMgr, drive a real shutdown burst and
+read the performance/groupCommit watchers.
+
+The tables are created in the given database with a prefix that the DBMgr does
+not use, and are dropped afterwards. Do not run this against a live database.
+"""
+
+import optparse
+import random
+import sys
+import time
+
+import bwsetup
+bwsetup.addPath( "../pycommon/redist/mysql_python" )
+
+import MySQLdb
+
+TABLE = "bigworldBenchEntity"
+SEQUENCE_TABLE = "bigworldBenchEntity_items"
+
+
+def createTables( cursor, numEntities ):
+	dropTables( cursor )
+
+	cursor.execute( "CREATE TABLE %s (id BIGINT NOT NULL PRIMARY KEY, "
+			"sm_level INT, sm_data BLOB) TYPE=InnoDB" % TABLE )
+	cursor.execute( "CREATE TABLE %s (id BIGINT AUTO_INCREMENT PRIMARY KEY, "
+			"parentID BIGINT, sm_value INT, INDEX parentIDIndex (parentID)) "
+			"TYPE=InnoDB" % SEQUENCE_TABLE )
+
+	for first in range( 1, numEntities + 1, 1000 ):
+		ids = range( first, min( first + 1000, numEntities + 1 ) )
+		cursor.executemany( "INSERT INTO " + TABLE +
+				" (id, sm_level, sm_data) VALUES (%s, 0, '')",
+			[(id,) for id in ids] )
+		cursor.execute( "COMMIT" )
+
+
+def dropTables( cursor ):
+	cursor.execute( "DROP TABLE IF EXISTS %s" % TABLE )
+	cursor.execute( "DROP TABLE IF EXISTS %s" % SEQUENCE_TABLE )
+
+
+def writeEntity( cursor, dbID, data, numItems ):
+	cursor.execute( "UPDATE " + TABLE +
+			" SET sm_level=%s, sm_data=%s WHERE id=%s",
+		(random.randint( 1, 100 ), data, dbID) )
+	cursor.execute( "DELETE FROM " + SEQUENCE_TABLE + " WHERE parentID=%s",
+		(dbID,) )
+
+	for i in range( numItems ):
+		cursor.execute( "INSERT INTO " + SEQUENCE_TABLE +
+				" (parentID, sm_value) VALUES (%s, %s)", (dbID, i) )
+
+
+def replay( cursor, options, batchSize ):
+	data = "x" * options.entitySize
+	dbIDs = list( range( 1, options.numEntities + 1 ) )
+	random.shuffle( dbIDs )
+
+	startTime = time.time()
+
+	for first in range( 0, len( dbIDs ), batchSize ):
+		cursor.execute( "START TRANSACTION" )
+
+		for dbID in dbIDs[ first : first + batchSize ]:
+			writeEntity( cursor, dbID, data, options.numItems )
+
+		cursor.execute( "COMMIT" )
+
+	return time.time() - startTime
+
+
+def main():
+	opt = optparse.OptionParser( "Usage: %prog [options] <database>" )
+	opt.add_option( "-H", "--host", dest = "host", default = "localhost",
+					help = "MySQL server" )
+	opt.add_option( "-u", "--user", dest = "user", default = "bigworld",
+					help = "MySQL user" )
+	opt.add_option( "-p", "--password", dest = "password",
+					default = "bigworld", help = "MySQL password" )
+	opt.add_option( "-n", "--entities", dest = "numEntities", type = "int",
+					default = 20000,
+					help = "Number of entities written in the burst" )
+	opt.add_option( "-s", "--entity-size", dest = "entitySize", type = "int",
+					default = 512,
+					help = "Bytes of blob data in each entity" )
+	opt.add_option( "-i", "--items", dest = "numItems", type = "int",
+					default = 4,
+					help = "Number of sequence elements in each entity" )
+	opt.add_option( "-b", "--batch-sizes", dest = "batchSizes",
+					default = "1,10,50,200",
+					help = "Comma separated list of batch sizes to replay. "
+						"1 is the same as group commit being disabled" )
+	(options, args) = opt.parse_args()
+
+	if len( args ) != 1:
+		opt.error( "The database to use must be given" )
+
+	try:
+		batchSizes = [int( size ) for size in options.batchSizes.split( "," )]
+	except ValueError:
+		opt.error( "Invalid batch sizes '%s'" % options.batchSizes )
+
+	connection = MySQLdb.connect( host = options.host, user = options.user,
+			passwd = options.password, db = args[0] )
+	cursor = connection.cursor()
+
+	print( "%d entity writes, %d bytes and %d sequence elements each" %
+		(options.numEntities, options.entitySize, options.numItems) )
+
+	try:
+		createTables( cursor, options.numEntities )
+
+		for batchSize in batchSizes:
+			duration = replay( cursor, options, max( batchSize, 1 ) )
+			print( "maxEntities %4d  %7.2f seconds  %8.1f writes/second" %
+				(batchSize, duration, options.numEntities / duration) )
+	finally:
+		dropTables( cursor )
+		connection.close()
+
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit( main() )
@@ -47,6 +47,14 @@ public:
 		cacheChain_.pNext_ = &cacheChain_;
 	}
 
+	/**
+	 *	Destructor
+	 */
+	~Cache()
+	{
+		this->clear();
+	}
+
 	/**
 	 *	This method inserts a new element into the cache.
 	 *	It will replace an existing element with the same key,
@@ -113,6 +121,25 @@ public:
 		}
 	}
 
+	/**
+	 *	This method erases all elements in the cache.
+	 */
+	void clear()
+	{
+		CacheNode* pNode = cacheChain_.pNext_;
+
+		while(pNode != &cacheChain_)
+		{
+			CacheNode* pNext = pNode->pNext_;
+			delete pNode;
+			pNode = pNext;
+		}
+
+		cacheChain_.pPrev_ = &cacheChain_;
+		cacheChain_.pNext_ = &cacheChain_;
+		cacheMap_.clear();
+	}
+
 private:
 
 	void addToChain(CacheNode* pNode)
@@ -159,6 +159,17 @@ inline char atomic_swap( void *& dst, void * curVal, void * newVal )
 }
 
 
+/**
+ *	Adds value to dst. Returns the value that dst had before.
+ */
+inline int atomic_add( volatile int & dst, int value )
+{
+	__asm mov eax, value
+	__asm mov ecx, dst
+	__asm lock xadd [ecx], eax
+}
+
+
 #if BWCLIENT_AS_PYTHON_MODULE
 
 int tlsGetOffSet(int size);
@@ -565,6 +576,21 @@ inline bool atomic_swap( void *& dst, void * curVal, void * newVal )
 }
 
 
+/**
+ *	Adds value to dst. Returns the value that dst had before.
+ */
+inline int atomic_add( volatile int & dst, int value )
+{
+	__asm__ volatile (
+			"lock xadd %0, %1\n"	// (atomically) Exchange and Add
+		:	"+r"	(value),	// %0 is value, and dst's old value on output
+			"+m"	(dst)		// %1 is dst
+		:
+		: "memory" );			// memory is modified
+	return value;
+}
+
+
 #endif // _WIN32
 
 /**
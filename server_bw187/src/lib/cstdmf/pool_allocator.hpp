@@ -108,4 +108,208 @@ private:
 };
 
 
+/**
+ *  A LockFreePoolAllocator is a PoolAllocator whose free list is a lock-free
+ *  stack, so threads that allocate and free instances never block each other.
+ *  It also counts live, peak and recycled instances so that users can size
+ *  their pools from the watcher tree.
+ *
+ *  A generation count is stored beside the head pointer so that a pop cannot
+ *  succeed against a head that has been popped and pushed again in the
+ *  meantime (the ABA problem). Memory is never returned to the system while
+ *  the allocator exists, so it is always safe to read the link out of a stale
+ *  head.
+ */
+class LockFreePoolAllocator
+{
+public:
+	/**
+	 *  Initialise a new empty Pool.
+	 */
+	LockFreePoolAllocator() :
+		head_( 0 ),
+		totalInstances_( 0 ),
+		numLive_( 0 ),
+		peakLive_( 0 ),
+		numRecycled_( 0 )
+	{}
+
+	/**
+	 *  This method frees all memory used in this pool.  This is just for
+	 *  completeness, as typically this should only be called on exit.
+	 */
+	~LockFreePoolAllocator()
+	{
+		void ** pHead = pointerOf( head_ );
+
+		while (pHead)
+		{
+			void * pNext = *pHead;
+			delete [] (char*)pHead;
+			pHead = (void**)pNext;
+		}
+	}
+
+	/// This method returns the total number of instances spawned.
+	int totalInstances() const	{ return totalInstances_; }
+
+	/// This method returns the number of instances currently in use.
+	int numLive() const			{ return numLive_; }
+
+	/// This method returns the most instances that have been in use at once.
+	int peakLive() const		{ return peakLive_; }
+
+	/// This method returns the number of allocations served from the pool.
+	int numRecycled() const		{ return numRecycled_; }
+
+	/**
+	 *  This method returns a pointer to an available instance, allocating
+	 *  memory for a new one if necessary.
+	 */
+	void * allocate( size_t size )
+	{
+		void * ret = NULL;
+		TaggedHead oldHead = head_;
+
+		while (pointerOf( oldHead ))
+		{
+			void ** pNode = pointerOf( oldHead );
+			TaggedHead newHead = makeHead( *pNode, tagOf( oldHead ) + 1 );
+			TaggedHead seenHead = compareAndSwap( head_, oldHead, newHead );
+
+			if (seenHead == oldHead)
+			{
+				ret = pNode;
+				break;
+			}
+
+			oldHead = seenHead;
+		}
+
+		if (ret)
+		{
+			atomicAdd( numRecycled_, 1 );
+		}
+		else
+		{
+			ret = (void*)new char[ size ];
+			atomicAdd( totalInstances_, 1 );
+		}
+
+		int numLive = atomicAdd( numLive_, 1 ) + 1;
+		int peakLive = peakLive_;
+
+		while (numLive > peakLive)
+		{
+			int seenPeak = compareAndSwap( peakLive_, peakLive, numLive );
+
+			if (seenPeak == peakLive)
+				break;
+
+			peakLive = seenPeak;
+		}
+
+		return ret;
+	}
+
+	/**
+	 *  This method returns a deleted instance to the pool.
+	 */
+	void deallocate( void * pInstance )
+	{
+		void ** pNode = (void**)pInstance;
+		TaggedHead oldHead = head_;
+
+		for (;;)
+		{
+			*pNode = pointerOf( oldHead );
+			TaggedHead newHead = makeHead( pNode, tagOf( oldHead ) + 1 );
+			TaggedHead seenHead = compareAndSwap( head_, oldHead, newHead );
+
+			if (seenHead == oldHead)
+				break;
+
+			oldHead = seenHead;
+		}
+
+		atomicAdd( numLive_, -1 );
+	}
+
+private:
+	/// The head pointer in the low bits and a generation count in the high
+	/// bits. On 64-bit platforms only the low 48 bits of an address are
+	/// significant, leaving 16 bits for the count.
+	typedef uint64 TaggedHead;
+
+	static const int TAG_SHIFT = (sizeof( void * ) == 4) ? 32 : 48;
+
+	static void ** pointerOf( TaggedHead head )
+	{
+		return (void**)uintptr( head & ((TaggedHead( 1 ) << TAG_SHIFT) - 1) );
+	}
+
+	static TaggedHead tagOf( TaggedHead head )
+	{
+		return head >> TAG_SHIFT;
+	}
+
+	static TaggedHead makeHead( void * pNode, TaggedHead tag )
+	{
+		return TaggedHead( uintptr( pNode ) ) | (tag << TAG_SHIFT);
+	}
+
+	/**
+	 *  These methods atomically replace dst with newVal if it still equals
+	 *  curVal, returning the value that was in dst.
+	 */
+	static TaggedHead compareAndSwap( volatile TaggedHead & dst,
+		TaggedHead curVal, TaggedHead newVal )
+	{
+#ifdef _WIN32
+		return InterlockedCompareExchange64(
+			(volatile LONGLONG *)&dst, newVal, curVal );
+#else
+		return __sync_val_compare_and_swap( &dst, curVal, newVal );
+#endif
+	}
+
+	static int compareAndSwap( volatile int & dst, int curVal, int newVal )
+	{
+#ifdef _WIN32
+		return InterlockedCompareExchange(
+			(volatile LONG *)&dst, newVal, curVal );
+#else
+		return __sync_val_compare_and_swap( &dst, curVal, newVal );
+#endif
+	}
+
+	/**
+	 *  This method atomically adds to dst, returning its previous value.
+	 */
+	static int atomicAdd( volatile int & dst, int value )
+	{
+#ifdef _WIN32
+		return InterlockedExchangeAdd( (volatile LONG *)&dst, value );
+#else
+		return __sync_fetch_and_add( &dst, value );
+#endif
+	}
+
+	/// The linked-list of memory chunks in the pool.
+	volatile TaggedHead head_;
+
+	/// The total number of instances ever spawned.
+	volatile int totalInstances_;
+
+	/// The number of instances currently allocated.
+	volatile int numLive_;
+
+	/// The highest value numLive_ has reached.
+	volatile int peakLive_;
+
+	/// The number of allocations that reused an instance from the pool.
+	volatile int numRecycled_;
+};
+
+
 #endif // POOLED_OBJECT_HPP
@@ -0,0 +1,162 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef TIMING_WHEEL_HEADER
+#define TIMING_WHEEL_HEADER
+
+#include "stdmf.hpp"
+#include "pool_allocator.hpp"
+#include "time_queue.hpp"
+
+/**
+ *	This class implements a hierarchical timing wheel. It has the same
+ *	interface and semantics as TimeQueueT, so either can be used wherever a
+ *	time queue is needed, but add and cancel are O(1) rather than O(log n).
+ *
+ *	Timers are kept on intrusive lists hanging off NUM_LEVELS wheels of
+ *	NUM_SLOTS slots each. A timer due within NUM_SLOTS ticks lives on the
+ *	innermost wheel, in the slot for its exact time. Timers further out live
+ *	on a coarser wheel and are moved inwards (cascaded) as time reaches their
+ *	slot. Timers too far out for the outermost wheel are kept on an overflow
+ *	list. Nodes are drawn from a pool, so steady timer churn does not touch
+ *	the heap.
+ *
+ *	As with TimeQueueT, cancelling a timer only marks it. Cancelled timers are
+ *	freed when they come due, or all at once when more than half of the wheel
+ *	has been cancelled.
+ */
+template< class TIME_STAMP >
+class TimingWheelT
+{
+public:
+	TimingWheelT();
+	~TimingWheelT();
+
+	void clear();
+
+	/// This is the unit of time used by the timing wheel
+	typedef TIME_STAMP TimeStamp;
+
+	/// Schedule an event
+	TimeQueueId	add( TimeStamp startTime, TimeStamp interval,
+						TimeQueueHandler* pHandler, void * pUser );
+
+	/// Cancel the event with the given id
+	void		cancel( TimeQueueId id );
+
+	/// Process all events older than or equal to now
+	void		process( TimeStamp now );
+
+	/// Determine whether or not the given id is legal (slow)
+	bool		legal( TimeQueueId id ) const;
+
+	/// Return the number of timestamps until the first node expires.  This will
+	/// return 0 if size() == 0, so you must check this first
+	TIME_STAMP nextExp( TimeStamp now ) const;
+
+	/// Returns the number of timers in the wheel, including cancelled ones
+	inline uint32 size() const { return numNodes_; }
+
+	bool		getTimerInfo( TimeQueueId id,
+					TimeStamp &			time,
+					TimeStamp &			interval,
+					TimeQueueHandler *&	pHandler,
+					void * &			pUser ) const;
+
+	/// This enumeration is used to describe the current state of an element in
+	/// the wheel.
+	enum State
+	{
+		STATE_PENDING,
+		STATE_EXECUTING,
+		STATE_CANCELLED
+	};
+
+private:
+	static const int SLOT_BITS = 8;
+	static const int NUM_SLOTS = 1 << SLOT_BITS;
+	static const int SLOT_MASK = NUM_SLOTS - 1;
+	static const int NUM_LEVELS = 4;
+
+	/// This structure links a node into a slot's circular list. Each slot
+	/// holds one as the list head.
+	class Link
+	{
+	public:
+		Link() : pNext( this ), pPrev( this ) {}
+
+		bool isEmpty() const	{ return pNext == this; }
+
+		Link *	pNext;
+		Link *	pPrev;
+
+	private:
+		Link( const Link & );
+		Link & operator=( const Link & );
+	};
+
+	/// This structure represents one event in the timing wheel.
+	class Node : public Link
+	{
+	public:
+		Node( TimeStamp startTime, TimeStamp interval,
+			TimeQueueHandler * pHandler, void * pUser );
+
+		void cancel( TimeQueueId id );
+
+		bool isCancelled() const	{ return this->state == STATE_CANCELLED; }
+
+		TimeStamp			time;
+		TimeStamp			interval;
+		State				state;
+		int					level;
+		TimeQueueHandler *	pHandler;
+		void *				pUser;
+	};
+
+	void link( Node * pNode );
+	void unlink( Node * pNode );
+	void freeNode( Node * pNode );
+	void purgeCancelledNodes();
+	static void moveList( Link & from, Link & to );
+
+	void cascade( int level );
+	void skipEmptyTicks( TimeStamp now );
+	void fire( Node * pNode, TimeStamp now );
+
+	static bool findEarliest( const Link & slot, TimeStamp & earliest );
+
+	void checkTimeSanity( TimeStamp now );
+
+	Link		slots_[ NUM_LEVELS ][ NUM_SLOTS ];
+	Link		overflow_;
+	uint32		levelCounts_[ NUM_LEVELS + 1 ];
+	uint32		numNodes_;
+	uint32		numCancelled_;
+
+	/// The next tick that has not yet been processed.
+	TimeStamp	currTime_;
+
+	Node *		pProcessingNode_;
+	TimeStamp	lastProcessTime_;
+
+	PoolAllocator<>	nodePool_;
+
+	TimingWheelT( const TimingWheelT & );
+	TimingWheelT & operator=( const TimingWheelT & );
+};
+
+typedef TimingWheelT< uint32 > TimingWheel;
+typedef TimingWheelT< uint64 > TimingWheel64;
+
+#include "timing_wheel.ipp"
+
+#endif // TIMING_WHEEL_HEADER
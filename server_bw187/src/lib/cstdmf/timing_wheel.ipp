@@ -0,0 +1,697 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "pch.hpp"
+
+#include "timing_wheel.hpp"
+#include "cstdmf/debug.hpp"
+#include <new>
+
+// -----------------------------------------------------------------------------
+// Section: TimingWheelT
+// -----------------------------------------------------------------------------
+
+/**
+ *	This is the constructor.
+ */
+template< class TIME_STAMP >
+TimingWheelT< TIME_STAMP >::TimingWheelT() :
+	numNodes_( 0 ),
+	numCancelled_( 0 ),
+	currTime_( 0 ),
+	pProcessingNode_( NULL ),
+	lastProcessTime_( 0 )
+{
+	for (int i = 0; i <= NUM_LEVELS; ++i)
+	{
+		levelCounts_[i] = 0;
+	}
+}
+
+
+/**
+ *	This is the destructor. It cancels all outstanding events.
+ */
+template <class TIME_STAMP>
+TimingWheelT< TIME_STAMP >::~TimingWheelT()
+{
+	this->clear();
+}
+
+
+/**
+ *	This method cancels all events in this wheel.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::clear()
+{
+	int count = 0;
+
+	while (numNodes_ > 0)
+	{
+		uint32 oldSize = numNodes_;
+
+		for (int level = 0; level <= NUM_LEVELS; ++level)
+		{
+			int numSlots = (level < NUM_LEVELS) ? NUM_SLOTS : 1;
+
+			for (int i = 0; i < numSlots; ++i)
+			{
+				Link & slot =
+					(level < NUM_LEVELS) ? slots_[ level ][ i ] : overflow_;
+
+				if (slot.isEmpty())
+					continue;
+
+				// Timers added by onRelease callbacks are left for the next
+				// round rather than extending this one. Nodes stay in the
+				// wheel until they are freed below.
+				Link pending;
+				moveList( slot, pending );
+
+				while (!pending.isEmpty())
+				{
+					Node * pNode = static_cast< Node * >( pending.pNext );
+					this->unlink( pNode );
+					pNode->cancel( (TimeQueueId)pNode );
+					this->link( pNode );
+				}
+			}
+		}
+
+		if (oldSize == numNodes_) break;
+
+		if (++count >= 16)
+		{
+			dprintf( "TimingWheel::clear: "
+				"Unable to cancel whole wheel after 16 rounds!\n" );
+			break;
+		}
+	}
+
+	// Now free everything, cancelled or not.
+	for (int level = 0; level <= NUM_LEVELS; ++level)
+	{
+		int numSlots = (level < NUM_LEVELS) ? NUM_SLOTS : 1;
+
+		for (int i = 0; i < numSlots; ++i)
+		{
+			Link & slot =
+				(level < NUM_LEVELS) ? slots_[ level ][ i ] : overflow_;
+
+			while (!slot.isEmpty())
+			{
+				Node * pNode = static_cast< Node * >( slot.pNext );
+				this->unlink( pNode );
+				this->freeNode( pNode );
+			}
+		}
+	}
+
+	numCancelled_ = 0;
+}
+
+
+/**
+ *	This method adds an event to the timing wheel. If interval is zero,
+ *	the event will happen once and will then be deleted. Otherwise,
+ *	the event will be fired repeatedly.
+ *
+ *	@param startTime	Time of the initial event, in game ticks
+ *	@param interval		Number of game ticks between subsequent events
+ *	@param pHandler 	Object that is to receive the event
+ *	@param pUser		User data to be passed with the event.
+ *	@return				Id of the new event.
+ */
+template <class TIME_STAMP>
+TimeQueueId TimingWheelT< TIME_STAMP >::add( TimeStamp startTime,
+		TimeStamp interval, TimeQueueHandler* pHandler, void * pUser )
+{
+	this->checkTimeSanity( startTime );
+
+	Node * pNode = new (nodePool_.allocate( sizeof( Node ) ))
+		Node( startTime, interval, pHandler, pUser );
+	this->link( pNode );
+
+	return (TimeQueueId)pNode;
+}
+
+
+/**
+ *	This method cancels an existing event. It is safe to call it
+ *	from within a timing wheel callback. As with TimeQueueT, the node is only
+ *	marked as cancelled; it is freed when it comes due or when the wheel is
+ *	purged.
+ *
+ *	@param id		Id of the timer event
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::cancel( TimeQueueId id )
+{
+	Node * pNode = (Node*)id;
+
+	if (pNode->isCancelled())
+	{
+		return;
+	}
+
+	pNode->cancel( id );
+
+	++numCancelled_;
+
+	// If more than half of the wheel is cancelled, free those nodes now.
+	// Purging visits every slot, so the slot count is added in to keep a
+	// nearly empty wheel from being purged on every cancel.
+	if (numCancelled_ * 2 > numNodes_ + NUM_SLOTS)
+	{
+		this->purgeCancelledNodes();
+	}
+}
+
+
+/**
+ *	This method frees all of the cancelled nodes still in the wheel. The node
+ *	being processed, if any, is not in a slot and is left to fire().
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::purgeCancelledNodes()
+{
+	for (int level = 0; level <= NUM_LEVELS; ++level)
+	{
+		if (levelCounts_[ level ] == 0)
+			continue;
+
+		int numSlots = (level < NUM_LEVELS) ? NUM_SLOTS : 1;
+
+		for (int i = 0; i < numSlots; ++i)
+		{
+			Link & slot =
+				(level < NUM_LEVELS) ? slots_[ level ][ i ] : overflow_;
+
+			Link * pLink = slot.pNext;
+
+			while (pLink != &slot)
+			{
+				Node * pNode = static_cast< Node * >( pLink );
+				pLink = pLink->pNext;
+
+				if (pNode->isCancelled())
+				{
+					this->unlink( pNode );
+					this->freeNode( pNode );
+					--numCancelled_;
+				}
+			}
+		}
+	}
+
+	MF_ASSERT( (numCancelled_ == 0) ||
+		((numCancelled_ == 1) && (pProcessingNode_ != NULL)) );
+}
+
+
+/**
+ *	This method processes the timing wheel and dispatches events.
+ *	All events with a timestamp earlier than the given one are
+ *	processed.
+ *
+ *	@param now		Process events earlier than or exactly on this.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::process( TimeStamp now )
+{
+	this->checkTimeSanity( now );
+
+	while (currTime_ <= now)
+	{
+		if (numNodes_ == 0)
+		{
+			currTime_ = now + 1;
+			break;
+		}
+
+		this->skipEmptyTicks( now );
+
+		if (currTime_ > now)
+			break;
+
+		int index = int( currTime_ & SLOT_MASK );
+
+		if (index == 0)
+		{
+			this->cascade( 1 );
+		}
+
+		// Take the whole slot and move on before dispatching, so that timers
+		// added or rescheduled by callbacks cannot land on the list being
+		// walked.
+		Link due;
+		moveList( slots_[ 0 ][ index ], due );
+		++currTime_;
+
+		while (!due.isEmpty())
+		{
+			Node * pNode = static_cast< Node * >( due.pNext );
+			this->unlink( pNode );
+
+			if (pNode->isCancelled())
+			{
+				--numCancelled_;
+				this->freeNode( pNode );
+			}
+			else
+			{
+				this->fire( pNode, now );
+			}
+		}
+	}
+
+	lastProcessTime_ = now;
+}
+
+
+/**
+ *	This method calls the handler of a node that has come due, then either
+ *	reschedules it or frees it.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::fire( Node * pNode, TimeStamp now )
+{
+	pProcessingNode_ = pNode;
+
+	pNode->state = STATE_EXECUTING;
+	pNode->pHandler->handleTimeout( (TimeQueueId)pNode, pNode->pUser );
+
+	if ((pNode->interval == 0) && !pNode->isCancelled())
+	{
+		this->cancel( (TimeQueueId)pNode );
+	}
+
+	pProcessingNode_ = NULL;
+
+	if (pNode->isCancelled())
+	{
+		MF_ASSERT( numCancelled_ > 0 );
+		--numCancelled_;
+		this->freeNode( pNode );
+	}
+	else
+	{
+		// As with TimeQueueT, reschedule relative to now rather than to the
+		// old expiry time.
+		pNode->time = now + pNode->interval;
+		pNode->state = STATE_PENDING;
+		this->link( pNode );
+	}
+}
+
+
+/**
+ *	This method moves every node in the current slot of the given wheel onto
+ *	the finer wheels. When that slot is the wheel's first, the next coarser
+ *	wheel is cascaded too.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::cascade( int level )
+{
+	Link * pSlot = &overflow_;
+	int index = 0;
+
+	if (level < NUM_LEVELS)
+	{
+		index = int( (currTime_ >> (SLOT_BITS * level)) & SLOT_MASK );
+		pSlot = &slots_[ level ][ index ];
+	}
+
+	// Nodes a whole revolution away go back into the same slot, so work
+	// from a copy of the list.
+	Link moving;
+	moveList( *pSlot, moving );
+
+	while (!moving.isEmpty())
+	{
+		Node * pNode = static_cast< Node * >( moving.pNext );
+		this->unlink( pNode );
+		this->link( pNode );
+	}
+
+	if ((index == 0) && (level < NUM_LEVELS))
+	{
+		this->cascade( level + 1 );
+	}
+}
+
+
+/**
+ *	This method advances the current time over ticks that cannot have any
+ *	timers due. It never moves past a tick where a non-empty wheel needs to
+ *	be cascaded, nor past now + 1.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::skipEmptyTicks( TimeStamp now )
+{
+	TimeStamp newTime = currTime_;
+	TimeStamp mask = SLOT_MASK;
+
+	for (int level = 0;
+		(level < NUM_LEVELS) && (levelCounts_[ level ] == 0);
+		++level)
+	{
+		TimeStamp boundary = (currTime_ | mask) + 1;
+
+		// The outermost wheel spans the whole range of a 32-bit time stamp.
+		if (boundary == 0)
+			break;
+
+		if ((currTime_ & mask) != 0)
+		{
+			newTime = boundary;
+		}
+
+		mask = (mask << SLOT_BITS) | SLOT_MASK;
+	}
+
+	currTime_ = std::min( newTime, TimeStamp( now + 1 ) );
+}
+
+
+/**
+ *	This method puts a node in the slot for its expiry time.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::link( Node * pNode )
+{
+	// Anything already due goes in the next slot to be processed.
+	TimeStamp time = std::max( pNode->time, currTime_ );
+	TimeStamp remaining = (time - currTime_) >> SLOT_BITS;
+
+	int level = 0;
+
+	while ((remaining != 0) && (level < NUM_LEVELS))
+	{
+		remaining >>= SLOT_BITS;
+		++level;
+	}
+
+	Link * pSlot = &overflow_;
+
+	if (level < NUM_LEVELS)
+	{
+		pSlot = &slots_[ level ][ (time >> (SLOT_BITS * level)) & SLOT_MASK ];
+	}
+
+	pNode->level = level;
+	pNode->pNext = pSlot;
+	pNode->pPrev = pSlot->pPrev;
+	pSlot->pPrev->pNext = pNode;
+	pSlot->pPrev = pNode;
+
+	++levelCounts_[ level ];
+	++numNodes_;
+}
+
+
+/**
+ *	This method takes a node out of whichever list it is on.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::unlink( Node * pNode )
+{
+	pNode->pPrev->pNext = pNode->pNext;
+	pNode->pNext->pPrev = pNode->pPrev;
+	pNode->pNext = pNode->pPrev = pNode;
+
+	MF_ASSERT( levelCounts_[ pNode->level ] > 0 );
+	--levelCounts_[ pNode->level ];
+	--numNodes_;
+}
+
+
+/**
+ *	This method moves all of the nodes on one list onto another, empty list.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::moveList( Link & from, Link & to )
+{
+	MF_ASSERT( to.isEmpty() );
+
+	if (from.isEmpty())
+		return;
+
+	to.pNext = from.pNext;
+	to.pPrev = from.pPrev;
+	to.pNext->pPrev = &to;
+	to.pPrev->pNext = &to;
+	from.pNext = from.pPrev = &from;
+}
+
+
+/**
+ *	This method returns a node's memory to the pool.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::freeNode( Node * pNode )
+{
+	pNode->~Node();
+	nodePool_.deallocate( pNode );
+}
+
+
+/**
+ *	This method determines whether or not the given id is legal.
+ */
+template <class TIME_STAMP>
+bool TimingWheelT< TIME_STAMP >::legal( TimeQueueId id ) const
+{
+	const Link * pNode = (const Node*)id;
+
+	if (pNode == NULL) return false;
+	if (pNode == pProcessingNode_) return true;
+
+	for (int level = 0; level <= NUM_LEVELS; ++level)
+	{
+		int numSlots = (level < NUM_LEVELS) ? NUM_SLOTS : 1;
+
+		for (int i = 0; i < numSlots; ++i)
+		{
+			const Link & slot =
+				(level < NUM_LEVELS) ? slots_[ level ][ i ] : overflow_;
+
+			for (const Link * pLink = slot.pNext;
+					pLink != &slot; pLink = pLink->pNext)
+			{
+				if (pLink == pNode) return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ *	This method finds the earliest expiry time of the nodes in a slot.
+ *
+ *	@return	True if the slot was not empty and earliest was updated.
+ */
+template <class TIME_STAMP>
+bool TimingWheelT< TIME_STAMP >::findEarliest( const Link & slot,
+		TimeStamp & earliest )
+{
+	bool found = false;
+
+	for (const Link * pLink = slot.pNext; pLink != &slot; pLink = pLink->pNext)
+	{
+		const Node * pNode = static_cast< const Node * >( pLink );
+
+		if (!found || pNode->time < earliest)
+		{
+			earliest = pNode->time;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+
+template <class TIME_STAMP>
+TIME_STAMP TimingWheelT< TIME_STAMP >::nextExp( TimeStamp now ) const
+{
+	if (numNodes_ == 0)
+		return 0;
+
+	TimeStamp earliest = 0;
+	bool found = false;
+
+	// On each wheel, the current slot may hold timers due soon or (after
+	// wrapping) a whole revolution away. The first non-empty slot after it
+	// holds the earliest of the rest.
+	for (int level = 0; level < NUM_LEVELS; ++level)
+	{
+		if (levelCounts_[ level ] == 0)
+			continue;
+
+		int current = int( (currTime_ >> (SLOT_BITS * level)) & SLOT_MASK );
+
+		TimeStamp candidate;
+
+		if (findEarliest( slots_[ level ][ current ], candidate ) &&
+				(!found || candidate < earliest))
+		{
+			earliest = candidate;
+			found = true;
+		}
+
+		for (int i = 1; i < NUM_SLOTS; ++i)
+		{
+			if (findEarliest( slots_[ level ][ (current + i) & SLOT_MASK ],
+					candidate ))
+			{
+				if (!found || candidate < earliest)
+				{
+					earliest = candidate;
+					found = true;
+				}
+
+				break;
+			}
+		}
+	}
+
+	TimeStamp candidate;
+
+	if (findEarliest( overflow_, candidate ) &&
+			(!found || candidate < earliest))
+	{
+		earliest = candidate;
+	}
+
+	return earliest - now;
+}
+
+
+/**
+ *	This method returns information associated with the timer with the input id.
+ */
+template <class TIME_STAMP>
+bool TimingWheelT< TIME_STAMP >::getTimerInfo( TimeQueueId id,
+					TimeStamp &			time,
+					TimeStamp &			interval,
+					TimeQueueHandler *&	pHandler,
+					void * &			pUser ) const
+{
+	Node * pNode = (Node*)id;
+
+	if (!pNode->isCancelled())
+	{
+		time = pNode->time;
+		interval = pNode->interval;
+		pHandler = pNode->pHandler;
+		pUser = pNode->pUser;
+
+		return true;
+	}
+
+	return false;
+}
+
+
+/**
+ *  This method rebuilds the wheel if it is detected that time has gone
+ *  backwards somehow. As with TimeQueueT, the earliest timer is used as the
+ *  basis for all time offsets.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::checkTimeSanity( TimeStamp now )
+{
+	if (!lastProcessTime_ || now >= lastProcessTime_ ||
+			(numNodes_ == 0) || (pProcessingNode_ != NULL))
+	{
+		return;
+	}
+
+	// Drain the existing wheel
+	std::vector< Node* > nodes;
+	nodes.reserve( numNodes_ );
+
+	for (int level = 0; level <= NUM_LEVELS; ++level)
+	{
+		int numSlots = (level < NUM_LEVELS) ? NUM_SLOTS : 1;
+
+		for (int i = 0; i < numSlots; ++i)
+		{
+			Link & slot =
+				(level < NUM_LEVELS) ? slots_[ level ][ i ] : overflow_;
+
+			while (!slot.isEmpty())
+			{
+				Node * pNode = static_cast< Node * >( slot.pNext );
+				this->unlink( pNode );
+				nodes.push_back( pNode );
+			}
+		}
+	}
+
+	TimeStamp baseTime = nodes[0]->time;
+
+	for (uint i = 1; i < nodes.size(); i++)
+	{
+		baseTime = std::min( baseTime, nodes[i]->time );
+	}
+
+	// Re-queue all nodes relative to the new time
+	currTime_ = now;
+
+	for (uint i = 0; i < nodes.size(); i++)
+	{
+		nodes[i]->time = now + nodes[i]->time - baseTime;
+		this->link( nodes[i] );
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Section: TimingWheelT::Node
+// -----------------------------------------------------------------------------
+
+/**
+ *	Constructor
+ */
+template <class TIME_STAMP>
+TimingWheelT< TIME_STAMP >::Node::Node( TimeStamp _startTime,
+		TimeStamp _interval, TimeQueueHandler * _pHandler, void * _pUser ) :
+	time( _startTime ),
+	interval( _interval ),
+	state( STATE_PENDING ),
+	level( 0 ),
+	pHandler( _pHandler ),
+	pUser( _pUser )
+{
+}
+
+
+/**
+ *	This method cancels the timing wheel node.
+ */
+template <class TIME_STAMP>
+void TimingWheelT< TIME_STAMP >::Node::cancel( TimeQueueId id )
+{
+	state = STATE_CANCELLED;
+
+	if (pHandler)
+	{
+		pHandler->onRelease( id, pUser );
+		pHandler = NULL;
+	}
+}
+
+// timing_wheel.ipp
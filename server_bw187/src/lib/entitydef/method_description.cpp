@@ -51,7 +51,9 @@ MethodDescription::MethodDescription() :
 	internalIndex_( -1 ),
 	exposedIndex_( -1 ),
 	exposedSubIndex_( -1 ),
-	priority_( FLT_MAX )
+	priority_( FLT_MAX ),
+	rateLimitPerTick_( 0.f ),
+	rateLimitBurst_( 0.f )
 {
 }
 
@@ -91,6 +93,8 @@ MethodDescription & MethodDescription::operator=(
 		exposedIndex_	= description.exposedIndex_;
 		exposedSubIndex_= description.exposedSubIndex_;
 		priority_		= description.priority_;
+		rateLimitPerTick_	= description.rateLimitPerTick_;
+		rateLimitBurst_		= description.rateLimitBurst_;
 	}
 
 	return *this;
@@ -163,6 +167,26 @@ bool MethodDescription::parse( DataSectionPtr pSection, Component component )
 		priority_ *= priority_;
 	}
 
+	// An optional limit on how often a client may call this method, e.g.
+	//	<RateLimit> <PerTick> 0.5 </PerTick> <Burst> 3 </Burst> </RateLimit>
+	DataSectionPtr pRateLimit = pSection->openSection( "RateLimit" );
+
+	if (pRateLimit)
+	{
+		if (this->isExposed())
+		{
+			rateLimitPerTick_ = pRateLimit->readFloat( "PerTick", 0.f );
+			rateLimitBurst_ = std::max( rateLimitPerTick_,
+				pRateLimit->readFloat( "Burst", rateLimitPerTick_ ) );
+		}
+		else
+		{
+			WARNING_MSG( "MethodDescription::parse: "
+					"Ignoring <RateLimit> on %s since it is not exposed\n",
+				name_.c_str() );
+		}
+	}
+
 	return result;
 }
 
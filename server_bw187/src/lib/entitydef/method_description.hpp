@@ -108,6 +108,12 @@ public:
 
 	float priority() const;
 
+	/// This method returns whether the client's calls to this method are
+	/// rate limited (see RateLimitMessageFilter on the BaseApp).
+	bool hasRateLimit() const				{ return rateLimitPerTick_ > 0.f; }
+	float rateLimitPerTick() const			{ return rateLimitPerTick_; }
+	float rateLimitBurst() const			{ return rateLimitBurst_; }
+
 private:
 	enum
 	{
@@ -133,6 +139,9 @@ private:
 
 	float priority_;
 
+	float rateLimitPerTick_;				///< Calls allowed per tick, or 0
+	float rateLimitBurst_;					///< Calls allowed at once
+
 	// NOTE: If adding data, check the assignment operator.
 };
 
@@ -0,0 +1,434 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "pch.hpp"
+
+#include "aes_gcm_filter.hpp"
+#include "encryption_filter.hpp"
+#include "packet.hpp"
+
+#include "cstdmf/debug.hpp"
+
+#ifdef MERCURY_HAS_AES_GCM
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+#endif
+
+DECLARE_DEBUG_COMPONENT2( "Network", 0 )
+
+namespace Mercury
+{
+
+namespace
+{
+/// This is put in front of a key to show that it is for an AesGcmFilter.
+const char KEY_TAG[] = "AES-GCM:";
+const int KEY_TAG_SIZE = sizeof( KEY_TAG ) - 1;
+}
+
+
+/**
+ *	This static method returns the form of the key that is passed from the
+ *	LoginApp to the BaseApp when the client has agreed to use AES-GCM.
+ */
+std::string AesGcmFilter::tagKey( const Key & key )
+{
+	return std::string( KEY_TAG, KEY_TAG_SIZE ) + key;
+}
+
+
+/**
+ *	This static method returns whether the given key was made by tagKey.
+ */
+bool AesGcmFilter::isTaggedKey( const std::string & channelKey )
+{
+	return (channelKey.size() == KEY_TAG_SIZE + KEY_SIZE) &&
+		(channelKey.compare( 0, KEY_TAG_SIZE, KEY_TAG ) == 0);
+}
+
+
+/**
+ *	This static method returns the raw key from one that was made by tagKey.
+ */
+AesGcmFilter::Key AesGcmFilter::untagKey( const std::string & channelKey )
+{
+	MF_ASSERT( isTaggedKey( channelKey ) );
+	return channelKey.substr( KEY_TAG_SIZE );
+}
+
+
+#ifdef MERCURY_HAS_AES_GCM
+
+namespace
+{
+/// The labels that each sender's key is derived with.
+const char * SENDER_LABELS[ AesGcmFilter::NUM_SENDERS ] =
+{
+	"BigWorld AES-GCM client",
+	"BigWorld AES-GCM LoginApp",
+	"BigWorld AES-GCM BaseApp"
+};
+
+/**
+ *	This function derives the key that the given sender seals with from the
+ *	key that both ends share. It is the start of an HMAC-SHA256 of the
+ *	sender's label.
+ *
+ *	@return	false if the key could not be derived.
+ */
+bool deriveSenderKey( const AesGcmFilter::Key & key,
+	AesGcmFilter::Sender sender, unsigned char * senderKey )
+{
+	unsigned char digest[ EVP_MAX_MD_SIZE ];
+	unsigned int digestLen = 0;
+
+	const char * label = SENDER_LABELS[ sender ];
+
+	if (!HMAC( EVP_sha256(), key.data(), int( key.size() ),
+			(const unsigned char*)label, strlen( label ),
+			digest, &digestLen ) ||
+		(digestLen < unsigned( AesGcmFilter::KEY_SIZE )))
+	{
+		return false;
+	}
+
+	memcpy( senderKey, digest, AesGcmFilter::KEY_SIZE );
+
+	return true;
+}
+}
+
+
+/**
+ *	Constructor.
+ *
+ *	@param key		The 128-bit key. This is the same key that the client sent
+ *					for its EncryptionFilter.
+ *	@param sender	The process that this filter is in.
+ *	@param peer		The process at the other end.
+ */
+AesGcmFilter::AesGcmFilter( const Key & key, Sender sender, Sender peer ) :
+	key_( key ),
+	isGood_( false ),
+	sender_( sender ),
+	numSealed_( 0 ),
+	pEncryptContext_( NULL ),
+	pDecryptContext_( NULL )
+{
+	MF_ASSERT( (sender != peer) &&
+		(sender < NUM_SENDERS) && (peer < NUM_SENDERS) );
+
+	if (key_.size() != KEY_SIZE)
+	{
+		ERROR_MSG( "AesGcmFilter::AesGcmFilter: "
+			"Tried to initialise filter with key of invalid length %d\n",
+			int( key_.size() ) );
+		return;
+	}
+
+	unsigned char sendKey[ KEY_SIZE ];
+	unsigned char recvKey[ KEY_SIZE ];
+
+	EVP_CIPHER_CTX * pEncrypt = EVP_CIPHER_CTX_new();
+	EVP_CIPHER_CTX * pDecrypt = EVP_CIPHER_CTX_new();
+
+	pEncryptContext_ = pEncrypt;
+	pDecryptContext_ = pDecrypt;
+
+	isGood_ = pEncrypt && pDecrypt &&
+		deriveSenderKey( key_, sender, sendKey ) &&
+		deriveSenderKey( key_, peer, recvKey ) &&
+		EVP_EncryptInit_ex( pEncrypt, EVP_aes_128_gcm(), NULL,
+			sendKey, NULL ) &&
+		EVP_DecryptInit_ex( pDecrypt, EVP_aes_128_gcm(), NULL,
+			recvKey, NULL );
+
+	memset( sendKey, 0, sizeof( sendKey ) );
+	memset( recvKey, 0, sizeof( recvKey ) );
+
+	if (!isGood_)
+	{
+		ERROR_MSG( "AesGcmFilter::AesGcmFilter: "
+			"Could not initialise cipher contexts\n" );
+	}
+}
+
+
+/**
+ *	Destructor.
+ */
+AesGcmFilter::~AesGcmFilter()
+{
+	if (pEncryptContext_)
+	{
+		EVP_CIPHER_CTX_free( (EVP_CIPHER_CTX*)pEncryptContext_ );
+	}
+
+	if (pDecryptContext_)
+	{
+		EVP_CIPHER_CTX_free( (EVP_CIPHER_CTX*)pDecryptContext_ );
+	}
+}
+
+
+/**
+ *	This method seals the packet and sends it to the provided address.
+ */
+Reason AesGcmFilter::send( Nub & nub, const Address & addr, Packet * pPacket )
+{
+	if (!isGood_)
+	{
+		WARNING_MSG( "AesGcmFilter::send: "
+			"Dropping packet to %s due to invalid filter\n",
+			addr.c_str() );
+
+		return REASON_GENERAL_NETWORK;
+	}
+
+	// Remember we have to leave the packet in its original state, since it
+	// may need to be resent.
+	PacketPtr toSend = new Packet();
+
+	int sealedLen = this->seal( (const unsigned char*)pPacket->data(),
+		(unsigned char*)toSend->data(), pPacket->totalSize() );
+
+	if (sealedLen == -1)
+	{
+		return REASON_GENERAL_NETWORK;
+	}
+
+	toSend->msgEndOffset( sealedLen );
+
+	return this->PacketFilter::send( nub, addr, toSend.getObject() );
+}
+
+
+/**
+ *	This method checks and decrypts an incoming sealed packet.
+ */
+Reason AesGcmFilter::recv( Nub & nub, const Address & addr, Packet * pPacket )
+{
+	if (!isGood_)
+	{
+		WARNING_MSG( "AesGcmFilter::recv: "
+			"Dropping packet from %s due to invalid filter\n",
+			addr.c_str() );
+
+		return REASON_GENERAL_NETWORK;
+	}
+
+	int clearLen = this->unseal( (unsigned char*)pPacket->data(),
+		pPacket->totalSize() );
+
+	if (clearLen == -1)
+	{
+		WARNING_MSG( "AesGcmFilter::recv: "
+			"Dropping packet from %s that failed authentication\n",
+			addr.c_str() );
+
+		return REASON_CORRUPTED_PACKET;
+	}
+
+	pPacket->shrink( pPacket->totalSize() - clearLen );
+
+	return this->PacketFilter::recv( nub, addr, pPacket );
+}
+
+
+/**
+ *	This method seals the data in the input stream and writes it to the output
+ *	stream. It takes a MemoryOStream so that it has the same signature as
+ *	EncryptionFilter::encryptStream. No padding is needed.
+ */
+void AesGcmFilter::encryptStream( MemoryOStream & clearStream,
+	BinaryOStream & cipherStream )
+{
+	int size = clearStream.remainingLength();
+	unsigned char * cipherText = (unsigned char*)cipherStream.reserve(
+		NONCE_SIZE + size + TAG_SIZE );
+
+	if (this->seal( (const unsigned char*)clearStream.retrieve( size ),
+			cipherText, size ) == -1)
+	{
+		// Leave something that will fail to unseal rather than the clear text.
+		memset( cipherText, 0, NONCE_SIZE + size + TAG_SIZE );
+	}
+}
+
+
+/**
+ *	This method checks and decrypts data from the input stream and writes it to
+ *	the output stream. Nothing is written unless the data passes its tag check.
+ *
+ *	@return	true if the data was sealed with this key.
+ */
+bool AesGcmFilter::decryptStream( BinaryIStream & cipherStream,
+	BinaryOStream & clearStream )
+{
+	int size = cipherStream.remainingLength();
+	MemoryOStream buffer( size );
+	unsigned char * data = (unsigned char*)buffer.reserve( size );
+	memcpy( data, cipherStream.retrieve( size ), size );
+
+	int clearLen = this->unseal( data, size );
+
+	if (clearLen == -1)
+	{
+		return false;
+	}
+
+	clearStream.addBlob( data, clearLen );
+
+	return true;
+}
+
+
+/**
+ *	This method returns the number of extra bytes that might be required when
+ *	sending through this filter.
+ */
+int AesGcmFilter::maxSpareSize()
+{
+	// The same allowance as EncryptionFilter for networks that cannot handle
+	// "full-sized" UDP packets.
+	const int MTU_ALLOWANCE = 200;
+
+	return NONCE_SIZE + TAG_SIZE + MTU_ALLOWANCE;
+}
+
+
+/**
+ *	This method writes the nonce for the next message to be sealed. This is the
+ *	sender's id, then the number of messages sealed before this one.
+ */
+void AesGcmFilter::nextNonce( unsigned char * nonce )
+{
+	uint64 count = numSealed_++;
+
+	nonce[0] = 0;
+	nonce[1] = 0;
+	nonce[2] = 0;
+	nonce[3] = (unsigned char)sender_;
+
+	for (int i = 0; i < NONCE_SIZE - 4; ++i)
+	{
+		nonce[ NONCE_SIZE - 1 - i ] = (unsigned char)(count >> (8 * i));
+	}
+}
+
+
+/**
+ *	This method encrypts and authenticates the provided data.
+ *
+ *	@param src		The data to seal.
+ *	@param dest		Where to write the sealed data. There must be room for
+ *					NONCE_SIZE + length + TAG_SIZE bytes.
+ *	@param length	The length of src.
+ *
+ *	@return	The length of the sealed data, or -1 on error.
+ */
+int AesGcmFilter::seal( const unsigned char * src, unsigned char * dest,
+	int length )
+{
+	EVP_CIPHER_CTX * pContext = (EVP_CIPHER_CTX*)pEncryptContext_;
+
+	unsigned char * nonce = dest;
+	unsigned char * cipherText = dest + NONCE_SIZE;
+	unsigned char * tag = cipherText + length;
+
+	this->nextNonce( nonce );
+
+	int outLen = 0;
+	int finalLen = 0;
+
+	if (!EVP_EncryptInit_ex( pContext, NULL, NULL, NULL, nonce ) ||
+		!EVP_EncryptUpdate( pContext, cipherText, &outLen, src, length ) ||
+		!EVP_EncryptFinal_ex( pContext, cipherText + outLen, &finalLen ) ||
+		!EVP_CIPHER_CTX_ctrl( pContext, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag ))
+	{
+		ERROR_MSG( "AesGcmFilter::seal: Encryption failed\n" );
+		return -1;
+	}
+
+	return NONCE_SIZE + length + TAG_SIZE;
+}
+
+
+/**
+ *	This method checks and decrypts sealed data in place. On success, the clear
+ *	text is moved to the start of data.
+ *
+ *	@return	The length of the clear text, or -1 if the data is too short or
+ *			fails its tag check.
+ */
+int AesGcmFilter::unseal( unsigned char * data, int length )
+{
+	EVP_CIPHER_CTX * pContext = (EVP_CIPHER_CTX*)pDecryptContext_;
+
+	int clearLen = length - NONCE_SIZE - TAG_SIZE;
+
+	if (clearLen < 0)
+	{
+		return -1;
+	}
+
+	unsigned char * nonce = data;
+	unsigned char * cipherText = data + NONCE_SIZE;
+	unsigned char * tag = cipherText + clearLen;
+
+	int outLen = 0;
+	int finalLen = 0;
+
+	if (!EVP_DecryptInit_ex( pContext, NULL, NULL, NULL, nonce ) ||
+		!EVP_DecryptUpdate( pContext, cipherText, &outLen,
+			cipherText, clearLen ) ||
+		!EVP_CIPHER_CTX_ctrl( pContext, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag ) ||
+		EVP_DecryptFinal_ex( pContext, cipherText + outLen, &finalLen ) <= 0)
+	{
+		return -1;
+	}
+
+	memmove( data, cipherText, clearLen );
+
+	return clearLen;
+}
+
+#endif // MERCURY_HAS_AES_GCM
+
+
+/**
+ *	This function creates the BaseApp's filter for a client channel from the
+ *	key that the LoginApp passed on. This is an AesGcmFilter if the key was
+ *	tagged, and a Blowfish EncryptionFilter otherwise.
+ *
+ *	@return	The filter, or NULL if the key asks for a filter that this build
+ *			does not support.
+ */
+PacketFilterPtr createChannelFilter( const std::string & channelKey )
+{
+	if (AesGcmFilter::isTaggedKey( channelKey ))
+	{
+#ifdef MERCURY_HAS_AES_GCM
+		return new AesGcmFilter( AesGcmFilter::untagKey( channelKey ),
+			AesGcmFilter::BASE_APP, AesGcmFilter::CLIENT );
+#else
+		ERROR_MSG( "createChannelFilter: "
+			"AES-GCM was negotiated but is not supported by this build\n" );
+		return NULL;
+#endif
+	}
+
+	return new EncryptionFilter( channelKey );
+}
+
+} // namespace Mercury
+
+// aes_gcm_filter.cpp
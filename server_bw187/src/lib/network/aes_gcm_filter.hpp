@@ -0,0 +1,126 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef AES_GCM_FILTER_HPP
+#define AES_GCM_FILTER_HPP
+
+#include "packet_filter.hpp"
+#include "cstdmf/smartpointer.hpp"
+#include "cstdmf/memory_stream.hpp"
+#include "network/basictypes.hpp"
+
+#include "openssl/opensslv.h"
+#include <string>
+
+// GCM was added to the EVP interface in OpenSSL 1.0.1.
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+#define MERCURY_HAS_AES_GCM
+#endif
+
+namespace Mercury
+{
+
+/**
+ *	A PacketFilter that seals each packet with AES-128 in GCM mode.
+ *
+ *	Unlike EncryptionFilter, which runs Blowfish one 64-bit block at a time,
+ *	this encrypts and authenticates a packet in a single pass through
+ *	OpenSSL's EVP interface, which uses AES-NI and carry-less multiply where
+ *	the CPU has them. A packet that has been tampered with, or that was sealed
+ *	with another key, fails its tag check and is dropped.
+ *
+ *	Each sealed packet is laid out as:
+ *
+ *		nonce (12 bytes) | ciphertext (same size as the packet) | tag (16 bytes)
+ *
+ *	Both ends of a channel are given the same key, but nothing is sealed with
+ *	it directly. Each sender seals with a key of its own that is derived from
+ *	it, and the nonce is the sender's id followed by a count of the packets it
+ *	has sealed. So long as a sender has only one filter for each key, no nonce
+ *	is used twice with the same key.
+ *
+ *	The filter is chosen at login. The client sets LogOnParams::WANTS_AES_GCM
+ *	and, if the LoginApp agrees, the login reply is sealed with this filter
+ *	and the key that is passed on to the BaseApp is tagged (see tagKey) so
+ *	that createChannelFilter builds the same filter for the proxy's channel.
+ */
+class AesGcmFilter : public PacketFilter
+{
+public:
+	static const int KEY_SIZE = 128 / NETWORK_BITS_PER_BYTE;
+	static const int NONCE_SIZE = 96 / NETWORK_BITS_PER_BYTE;
+	static const int TAG_SIZE = 128 / NETWORK_BITS_PER_BYTE;
+
+	typedef std::string Key;
+
+	/**
+	 *	The process at one end of a filtered connection. The LoginApp only
+	 *	seals the login reply, and the BaseApp seals the rest.
+	 */
+	enum Sender
+	{
+		CLIENT,
+		LOGIN_APP,
+		BASE_APP,
+		NUM_SENDERS
+	};
+
+	static std::string tagKey( const Key & key );
+	static bool isTaggedKey( const std::string & channelKey );
+	static Key untagKey( const std::string & channelKey );
+
+#ifdef MERCURY_HAS_AES_GCM
+	AesGcmFilter( const Key & key, Sender sender, Sender peer );
+	~AesGcmFilter();
+
+	virtual Reason send( Nub & nub, const Address & addr, Packet * pPacket );
+	virtual Reason recv( Nub & nub, const Address & addr, Packet * pPacket );
+
+	virtual int maxSpareSize();
+
+	const Key & key() const { return key_; }
+	bool isGood() const { return isGood_; }
+
+	void encryptStream( MemoryOStream & clearStream,
+		BinaryOStream & cipherStream );
+
+	bool decryptStream( BinaryIStream & cipherStream,
+		BinaryOStream & clearStream );
+
+private:
+	int seal( const unsigned char * src, unsigned char * dest, int length );
+	int unseal( unsigned char * data, int length );
+
+	void nextNonce( unsigned char * nonce );
+
+	Key key_;
+	bool isGood_;
+
+	Sender sender_;
+	uint64 numSealed_;
+
+	// These are EVP_CIPHER_CTX pointers. The encrypt context has this end's
+	// key and the decrypt context the peer's. Each is keyed once, so that
+	// only the nonce needs to be set for each packet.
+	void * pEncryptContext_;
+	void * pDecryptContext_;
+#endif // MERCURY_HAS_AES_GCM
+};
+
+#ifdef MERCURY_HAS_AES_GCM
+typedef SmartPointer< AesGcmFilter > AesGcmFilterPtr;
+#endif
+
+PacketFilterPtr createChannelFilter( const std::string & channelKey );
+
+} // namespace Mercury
+
+#endif // AES_GCM_FILTER_HPP
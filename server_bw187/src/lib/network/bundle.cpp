@@ -879,6 +879,7 @@ UnpackedMessageHeader & Bundle::iterator::unpack( const InterfaceElement & ie )
 	}
 
 	curHeader_.identifier = this->msgID();
+	curHeader_.pPacket = NULL;
 	curHeader_.length = ie.expandLength( cursor_->data() + msgbeg, cursor_ );
 
 	// If length is -1, then chances are we've had an overflow
@@ -963,6 +964,7 @@ const char * Bundle::iterator::data()
 	if (dataOffset_ + dataLength_ <= bodyEndOffset_)
 	{
 		// no, ok, we're safe
+		curHeader_.pPacket = cursor_;
 		return cursor_->data() + dataOffset_;
 	}
 
@@ -978,11 +980,13 @@ const char * Bundle::iterator::data()
 		Packet::HEADER_SIZE + dataLength_ <= cursor_->next()->msgEndOffset())
 	{
 		// yes, easy then
+		curHeader_.pPacket = cursor_->next();
 		return cursor_->next()->body();
 	}
 
 	// ok, it's half here and half there, time to make a temporary buffer.
 	// note that a better idea might be to return a stream from this function.
+	curHeader_.pPacket = NULL;
 	dataBuffer_ = new char[dataLength_];
 	Packet *thisPack = cursor_;
 	uint16 thisOff = dataOffset_;
@@ -54,9 +54,16 @@ public:
 	Nub *			pNub;			///< The nub that received this message.
 	Channel *		pChannel;		///< The channel that received this message.
 
+	/// The packet that holds all of this message's data, or NULL if the data
+	/// was copied out of more than one packet. A handler that needs to keep
+	/// the data after it returns can hold a reference to this instead of
+	/// copying it.
+	Packet *		pPacket;
+
 	UnpackedMessageHeader() :
 		identifier( 0 ), flags( 0 ),
-		replyID( REPLY_ID_NONE ), length( 0 ), pNub( NULL ), pChannel( NULL )
+		replyID( REPLY_ID_NONE ), length( 0 ), pNub( NULL ), pChannel( NULL ),
+		pPacket( NULL )
 	{}
 
 	const char * msgName() const;
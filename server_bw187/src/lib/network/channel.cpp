@@ -36,6 +36,15 @@ uint Channel::s_maxOverflowPackets_[] =
 
 bool Channel::s_assertOnMaxOverflowPackets = false;
 
+bool Channel::s_useCongestionControl = true;
+
+bool Channel::s_useInternalSelectiveAcks = false;
+
+// The congestion window, in packets, that a new channel starts with and the
+// smallest that it can be cut to.
+const float INITIAL_CONGESTION_WINDOW = 16.f;
+const float MIN_CONGESTION_WINDOW = 2.f;
+
 int Channel::s_sendWindowWarnThresholds_[] =
 	{ INTERNAL_CHANNEL_SIZE / 4, INDEXED_CHANNEL_SIZE / 4 };
 
@@ -99,6 +108,12 @@ Channel::Channel( Nub & nub, const Address & address, Traits traits,
 		stampsPerSecond() / 10 : stampsPerSecond() ),
 	minInactivityResendDelay_(
 		uint64( minInactivityResendDelay * stampsPerSecond() ) ),
+	roundTripTimeVar_( 0 ),
+	congestionWindow_( 0.f ),
+	slowStartThreshold_( 0.f ),
+	resendCredit_( 0.f ),
+	lastResendCreditTime_( 0 ),
+	lastCongestionEventTime_( 0 ),
 	unackedPackets_( windowSize_ ),
 	hasSeenOverflowWarning_( false ),
 	inSeqAt_( 0 ),
@@ -117,6 +132,8 @@ Channel::Channel( Nub & nub, const Address & address, Traits traits,
 	unackedCriticalSeq_( SEQ_NULL ),
 	pushUnsentAcksThreshold_( 0 ),
 	shouldAutoSwitchToSrcAddr_( false ),
+	shouldUseSelectiveAcks_(
+		(traits == INTERNAL) && s_useInternalSelectiveAcks ),
 	wantsFirstPacket_( false ),
 	shouldDropNextSend_( false ),
 
@@ -127,10 +144,14 @@ Channel::Channel( Nub & nub, const Address & address, Traits traits,
 	numBytesReceived_( 0 ),
 	numPacketsResent_( 0 ),
 	numReliablePacketsSent_( 0 ),
+	numCongestionEvents_( 0 ),
+	numResendsDeferred_( 0 ),
 
 	// Message filter
 	pMessageFilter_( NULL )
 {
+	this->resetCongestionState();
+
 	// This corresponds to the decRef in Channel::destroy.
 	this->incRef();
 
@@ -168,6 +189,10 @@ void Channel::staticInit()
 
 	MF_WATCH( "indexedSendWindowSizeThreshold",
 		s_sendWindowWarnThresholds_[ 1 ] );
+
+	MF_WATCH( "channelCongestionControl", s_useCongestionControl );
+
+	MF_WATCH( "internalSelectiveAcks", s_useInternalSelectiveAcks );
 }
 
 
@@ -437,6 +462,7 @@ void Channel::initFromStream( BinaryIStream & data,
 	}
 
 	SeqNum seq = firstMissing_;
+	SeqNum prevSeq = firstMissing_;
 	UnackedPacket * pPrev = unackedPackets_[ firstMissing_ ];
 
 	while (seq != lastMissing_)
@@ -448,7 +474,9 @@ void Channel::initFromStream( BinaryIStream & data,
 		if (pCurr)
 		{
 			pPrev->nextMissing_ = seq;
+			pCurr->prevMissing_ = prevSeq;
 			pPrev = pCurr;
+			prevSeq = seq;
 		}
 	}
 
@@ -468,6 +496,7 @@ void Channel::initFromStream( BinaryIStream & data,
 	lastReliableResendTime_ = timeNow;
 
 	roundTripTime_ = minInactivityResendDelay_ / 2;
+	this->resetCongestionState();
 
 	// Now we destream the buffered receives.
 	data >> inSeqAt_;
@@ -861,6 +890,7 @@ bool Channel::addResendTimer( SeqNum seq, Packet * p,
 
 	pUnackedPacket->wasResent_ = false;
 	pUnackedPacket->nextMissing_ = SEQ_NULL;
+	pUnackedPacket->prevMissing_ = SEQ_NULL;
 
 	if (roBeg != roEnd)
 	{
@@ -959,15 +989,7 @@ bool Channel::delResendTimer( SeqNum seq )
 		return true;
 	}
 
-	// Update the average RTT for this channel, if this packet hadn't already
-	// been resent.
-	if (!pUnackedPacket->wasResent_)
-	{
-		const uint64 RTT_AVERAGE_DENOM = 10;
-
-		roundTripTime_ = ((roundTripTime_ * (RTT_AVERAGE_DENOM - 1)) +
-			(timestamp() - pUnackedPacket->lastSentTime_)) / RTT_AVERAGE_DENOM;
-	}
+	this->onPacketAcked( *pUnackedPacket );
 
 	// If this packet was the critical one, we're no longer in a critical state!
 	if (unackedCriticalSeq_ == seq)
@@ -1013,29 +1035,19 @@ bool Channel::delResendTimer( SeqNum seq )
 	if (lastMissing_ != SEQ_NULL &&				// we have missing packets &&
 		seqMask( lastMissing_ - seq ) < windowSize_)	// seq <= lastMissing_
 	{
-		SeqNum preLook = SEQ_NULL;
-		UnackedPacket * pPreLookRR = NULL;
-
-		// find the parent of the missing packet in the list ...
-		SeqNum look = firstMissing_;
-		UnackedPacket * pLookRR = unackedPackets_[look];
-		while (look != SEQ_NULL && look != seq)
-		{
-			preLook = look;
-			pPreLookRR = pLookRR;
+		// unlink it from the missing list
+		SeqNum prevMissing = pUnackedPacket->prevMissing_;
+		SeqNum nextMissing = pUnackedPacket->nextMissing_;
 
-			look = pLookRR->nextMissing_;
-			pLookRR = unackedPackets_[look];
-		}
-
-		// and unlink it
-		if (pPreLookRR == NULL)
-			firstMissing_ = pLookRR->nextMissing_;
+		if (prevMissing == SEQ_NULL)
+			firstMissing_ = nextMissing;
 		else
-			pPreLookRR->nextMissing_ = pLookRR->nextMissing_;
+			unackedPackets_[ prevMissing ]->nextMissing_ = nextMissing;
 
-		if (seq == lastMissing_)
-			lastMissing_ = preLook;
+		if (nextMissing == SEQ_NULL)
+			lastMissing_ = prevMissing;
+		else
+			unackedPackets_[ nextMissing ]->prevMissing_ = prevMissing;
 
 		if (this->isInternal())
 		{
@@ -1062,9 +1074,12 @@ bool Channel::delResendTimer( SeqNum seq )
 				break;
 
 			pLookRR->nextMissing_ = nextNewMissing;
+			pLookRR->prevMissing_ = SEQ_NULL;
 
 			if (nextNewMissing == SEQ_NULL)
 				lastMissing_ = look;
+			else
+				unackedPackets_[ nextNewMissing ]->prevMissing_ = look;
 
 			nextNewMissing = look;
 		}
@@ -1090,6 +1105,8 @@ bool Channel::delResendTimer( SeqNum seq )
 			{
 				unackedPackets_[ oldLastMissing ]->nextMissing_ =
 					nextNewMissing;
+				unackedPackets_[ nextNewMissing ]->prevMissing_ =
+					oldLastMissing;
 			}
 		}
 	}
@@ -1171,6 +1188,17 @@ void Channel::checkResendTimers()
 		// needs to be sent again
 		if (seqLessThan( missing.lastSentAtOutSeq_, lastAck_ ))
 		{
+			// The rest will be resent once the congestion window allows.
+			if (!this->takeResendCredit())
+			{
+				break;
+			}
+
+			if (!resentMissing)
+			{
+				this->onPacketLoss( /* isTimeout */ false );
+			}
+
 			this->resend( seq );
 
 			resentMissing = true;
@@ -1187,13 +1215,14 @@ void Channel::checkResendTimers()
 	}
 
 	// If we have unacked packets that are getting a bit old, then resend the
-	// ones that are older than we'd like.  Anything that has taken more than
-	// twice the RTT on the channel to come back is considered to be too old.
+	// ones that are older than we'd like.  Anything that has taken longer than
+	// the resend timeout to come back is considered to be too old.
 	if (oldestUnackedSeq_ != SEQ_NULL)
 	{
 		uint64 now = timestamp();
-		uint64 thresh = std::max( roundTripTime_*2, minInactivityResendDelay_ );
+		uint64 thresh = this->resendTimeout();
 		uint64 lastReliableSendTime = this->lastReliableSendOrResendTime();
+		bool hasTimedOut = false;
 
 		// We resend all unacked packets that haven't been (re)sent recently,
 		// up until the first acked packet.
@@ -1205,6 +1234,18 @@ void Channel::checkResendTimers()
 
 			if (now - unacked.lastSentTime_ > thresh)
 			{
+				// The rest will be resent once the congestion window allows.
+				if (!this->takeResendCredit())
+				{
+					break;
+				}
+
+				if (!hasTimedOut)
+				{
+					this->onPacketLoss( /* isTimeout */ true );
+					hasTimedOut = true;
+				}
+
 				if (this->nub().isVerbose())
 				{
 					WARNING_MSG( "Channel::checkResendTimers( %s ): "
@@ -1226,6 +1267,138 @@ void Channel::checkResendTimers()
 }
 
 
+/**
+ *	This method returns how long an unacked packet is left before it is
+ *	resent due to inactivity. This is the smoothed round trip time plus four
+ *	times its average deviation, but no less than minInactivityResendDelay_.
+ */
+uint64 Channel::resendTimeout() const
+{
+	return std::max( roundTripTime_ + 4 * roundTripTimeVar_,
+		minInactivityResendDelay_ );
+}
+
+
+/**
+ *	This method returns the proportion of the reliable packets sent on this
+ *	channel that had to be resent.
+ */
+double Channel::lossRatio() const
+{
+	return (numReliablePacketsSent_ > 0) ?
+		double( numPacketsResent_ ) / numReliablePacketsSent_ : 0.0;
+}
+
+
+/**
+ *	This method puts the congestion window and RTT deviation back to how they
+ *	are for a new channel. roundTripTime_ should already have been set.
+ */
+void Channel::resetCongestionState()
+{
+	roundTripTimeVar_ = roundTripTime_ / 4;
+	congestionWindow_ = std::min( INITIAL_CONGESTION_WINDOW,
+		float( windowSize_ ) );
+	slowStartThreshold_ = float( windowSize_ );
+	resendCredit_ = congestionWindow_;
+	lastResendCreditTime_ = ::timestamp();
+	lastCongestionEventTime_ = 0;
+}
+
+
+/**
+ *	This method updates the round trip time estimates and opens the congestion
+ *	window when a packet is acknowledged.
+ */
+void Channel::onPacketAcked( const UnackedPacket & unacked )
+{
+	// Only packets that were not resent give a sample that is known to be
+	// for the right send (Karn's algorithm).
+	if (!unacked.wasResent_)
+	{
+		const uint64 RTT_AVERAGE_DENOM = 10;
+		const uint64 RTT_VAR_DENOM = 4;
+
+		uint64 sample = timestamp() - unacked.lastSentTime_;
+		uint64 deviation = (sample > roundTripTime_) ?
+			sample - roundTripTime_ : roundTripTime_ - sample;
+
+		roundTripTimeVar_ = ((roundTripTimeVar_ * (RTT_VAR_DENOM - 1)) +
+			deviation) / RTT_VAR_DENOM;
+
+		roundTripTime_ = ((roundTripTime_ * (RTT_AVERAGE_DENOM - 1)) +
+			sample) / RTT_AVERAGE_DENOM;
+	}
+
+	if (congestionWindow_ < slowStartThreshold_)
+	{
+		congestionWindow_ += 1.f;
+	}
+	else
+	{
+		congestionWindow_ += 1.f / congestionWindow_;
+	}
+
+	congestionWindow_ = std::min( congestionWindow_, float( windowSize_ ) );
+}
+
+
+/**
+ *	This method shrinks the congestion window because packets need to be
+ *	resent. A loss found through later ACKs halves the window. A resend due
+ *	to inactivity suggests that the link is badly congested, and drops it to
+ *	the minimum.
+ */
+void Channel::onPacketLoss( bool isTimeout )
+{
+	uint64 now = ::timestamp();
+
+	// Losses within a round trip of the last cut are part of the same event.
+	if (now - lastCongestionEventTime_ < roundTripTime_)
+	{
+		return;
+	}
+
+	lastCongestionEventTime_ = now;
+	++numCongestionEvents_;
+
+	slowStartThreshold_ =
+		std::max( congestionWindow_ / 2.f, MIN_CONGESTION_WINDOW );
+	congestionWindow_ = isTimeout ? MIN_CONGESTION_WINDOW : slowStartThreshold_;
+	resendCredit_ = std::min( resendCredit_, congestionWindow_ );
+}
+
+
+/**
+ *	This method returns whether the congestion window allows a packet to be
+ *	resent now, and if so, uses up the credit for it.
+ */
+bool Channel::takeResendCredit()
+{
+	if (!s_useCongestionControl)
+	{
+		return true;
+	}
+
+	uint64 now = ::timestamp();
+
+	resendCredit_ += congestionWindow_ *
+		float( double( now - lastResendCreditTime_ ) /
+			double( std::max( roundTripTime_, uint64( 1 ) ) ) );
+	resendCredit_ = std::min( resendCredit_, congestionWindow_ );
+	lastResendCreditTime_ = now;
+
+	if (resendCredit_ < 1.f)
+	{
+		++numResendsDeferred_;
+		return false;
+	}
+
+	resendCredit_ -= 1.f;
+	return true;
+}
+
+
 /**
  *  Resends an un-acked packet by the most sensible method available.
  */
@@ -1733,6 +1906,7 @@ void Channel::reset( const Address & newAddr, bool warnOnDiscard,
 	lastReliableResendTime_ = 0;
 	roundTripTime_ =
 		this->isInternal() ? stampsPerSecond() / 10 : stampsPerSecond();
+	this->resetCongestionState();
 	hasRemoteFailed_ = false;
 	unackedCriticalSeq_ = SEQ_NULL;
 	wantsFirstPacket_ = false;
@@ -1743,6 +1917,8 @@ void Channel::reset( const Address & newAddr, bool warnOnDiscard,
 	numBytesReceived_ = 0;
 	numPacketsResent_ = 0;
 	numReliablePacketsSent_ = 0;
+	numCongestionEvents_ = 0;
+	numResendsDeferred_ = 0;
 
 	// Increment the version, since we're not going to be talking to the same
 	// channel on the other side anymore.
@@ -1796,6 +1972,7 @@ void Channel::configureFrom( const Channel & other )
 {
 	this->isIrregular( other.isIrregular() );
 	this->shouldAutoSwitchToSrcAddr( other.shouldAutoSwitchToSrcAddr() );
+	this->shouldUseSelectiveAcks( other.shouldUseSelectiveAcks() );
 	this->pushUnsentAcksThreshold( other.pushUnsentAcksThreshold() );
 
 	// We don't support setting this fields post-construction, so for now, just
@@ -1994,9 +2171,20 @@ WatcherPtr Channel::pWatcher()
 		ADD_WATCHER( reliablePacketsResent,		numReliablePacketsSent_ );
 
 		ADD_WATCHER( isIrregular,		isIrregular_ );
+		ADD_WATCHER( selectiveAcks,		shouldUseSelectiveAcks_ );
 
 		pWatcher->addChild( "roundTripTime",
 				makeWatcher( *pNull, &Channel::roundTripTimeInSeconds ) );
+		pWatcher->addChild( "roundTripTimeVar",
+				makeWatcher( *pNull, &Channel::roundTripTimeVarInSeconds ) );
+
+		ADD_WATCHER( congestion/window,			congestionWindow_ );
+		ADD_WATCHER( congestion/slowStartThreshold,	slowStartThreshold_ );
+		ADD_WATCHER( congestion/events,			numCongestionEvents_ );
+		ADD_WATCHER( congestion/resendsDeferred,	numResendsDeferred_ );
+
+		pWatcher->addChild( "congestion/lossRatio",
+				makeWatcher( *pNull, &Channel::lossRatio ) );
 	}
 #endif /* ENABLE_WATCHERS */
 
@@ -2034,6 +2222,7 @@ Channel::UnackedPacket * Channel::UnackedPacket::initFromStream(
 		pInstance->lastSentTime_ = timeNow;
 		pInstance->wasResent_ = false;
 		pInstance->nextMissing_ = SEQ_NULL;
+		pInstance->prevMissing_ = SEQ_NULL;
 
 		return pInstance;
 	}
@@ -208,6 +208,13 @@ public:
 	uint64 roundTripTime() const { return roundTripTime_; }
 	double roundTripTimeInSeconds() const
 		{ return roundTripTime_/::stampsPerSecondD(); }
+	double roundTripTimeVarInSeconds() const
+		{ return roundTripTimeVar_/::stampsPerSecondD(); }
+	uint64 resendTimeout() const;
+
+	float congestionWindow() const	{ return congestionWindow_; }
+	float slowStartThreshold() const	{ return slowStartThreshold_; }
+	double lossRatio() const;
 
 	std::pair< Packet*, bool > queueAckForPacket(
 		Packet * p, SeqNum seq, const Address & srcAddr, bool shouldSendAck, 
@@ -234,6 +241,17 @@ public:
 	bool shouldAutoSwitchToSrcAddr() const { return shouldAutoSwitchToSrcAddr_; }
 	void shouldAutoSwitchToSrcAddr( bool b );
 
+	/**
+	 *	This method returns whether ACKs sent on this channel may be packed
+	 *	into selective ACK blocks (FLAG_HAS_SACKS). Both ends must understand
+	 *	them, so this is off by default. Internal channels start with it on
+	 *	if useInternalSelectiveAcks is set (networking/selectiveAcks in
+	 *	bw.xml). Any channel turns it on when the other end sends selective
+	 *	ACKs to us.
+	 */
+	bool shouldUseSelectiveAcks() const { return shouldUseSelectiveAcks_; }
+	void shouldUseSelectiveAcks( bool b ) { shouldUseSelectiveAcks_ = b; }
+
 	SeqNum useNextSequenceID();
 	void onPacketReceived( int bytes );
 
@@ -391,6 +409,23 @@ public:
 		Channel::s_assertOnMaxOverflowPackets = shouldAssert;
 	}
 
+	/// Whether resends are limited to the congestion window and paced.
+	static bool s_useCongestionControl;
+
+	/// Whether new internal channels start with selective ACKs turned on.
+	/// Every server process in the cluster must understand them.
+	static bool s_useInternalSelectiveAcks;
+
+	static bool useInternalSelectiveAcks()
+	{
+		return Channel::s_useInternalSelectiveAcks;
+	}
+
+	static void useInternalSelectiveAcks( bool value )
+	{
+		Channel::s_useInternalSelectiveAcks = value;
+	}
+
 private:
 	enum TimeOutType
 	{
@@ -462,6 +497,28 @@ private:
 	/// when roundTripTime_ is low with respect to tick time.
 	uint64			minInactivityResendDelay_;
 
+	/// The average deviation of the round trip time from roundTripTime_, in
+	/// timestamp units.
+	uint64			roundTripTimeVar_;
+
+	/// The congestion window, in packets. At most this many packets are
+	/// resent per round trip.
+	float			congestionWindow_;
+
+	/// The congestion window below which it grows by a packet per ACK (slow
+	/// start) rather than by a packet per window's worth of ACKs.
+	float			slowStartThreshold_;
+
+	/// The number of packets that may be resent right now. This is refilled
+	/// at congestionWindow_ packets per round trip, which paces resends out
+	/// instead of sending them in one burst.
+	float			resendCredit_;
+	uint64			lastResendCreditTime_;
+
+	/// The last time the congestion window was cut. It is cut at most once
+	/// per round trip, however many packets were lost.
+	uint64			lastCongestionEventTime_;
+
 	/**
 	 *	This class stores sent packets that may need to be resent.  These things
 	 *	need to be fast so we pool them and use custom allocators.
@@ -489,6 +546,10 @@ private:
 		/// lastMissing_. Should be SEQ_NULL for lastMissing_ (and otherwise).
 		SeqNum	nextMissing_;
 
+		/// The packet before this one in the same list. Should be SEQ_NULL
+		/// for firstMissing_ (and otherwise).
+		SeqNum	prevMissing_;
+
 		/// The outgoing sequence number on the channel the last time this
 		/// packet was sent.
 		SeqNum  lastSentAtOutSeq_;
@@ -539,6 +600,11 @@ private:
 
 	void sendUnacked( UnackedPacket & unacked );
 
+	void resetCongestionState();
+	void onPacketAcked( const UnackedPacket & unacked );
+	void onPacketLoss( bool isTimeout );
+	bool takeResendCredit();
+
 	/// The next packet that we expect to receive.
 	SeqNum			inSeqAt_;
 
@@ -602,6 +668,9 @@ private:
 	/// the source address of incoming packets.
 	bool			shouldAutoSwitchToSrcAddr_;
 
+	/// If true, outgoing ACKs may be sent as selective ACK blocks.
+	bool			shouldUseSelectiveAcks_;
+
 	/// If true, this channel will drop all incoming packets unless they are
 	/// flagged as FLAG_CREATE_CHANNEL.  This is only used by Channels that are
 	/// reset() and want to ensure that they don't buffer any delayed incoming
@@ -631,6 +700,8 @@ private:
 	uint32	numBytesReceived_;
 	uint32	numPacketsResent_;
 	uint32	numReliablePacketsSent_;
+	uint32	numCongestionEvents_;
+	uint32	numResendsDeferred_;
 
 	// Message filter
 	MessageFilterPtr pMessageFilter_;
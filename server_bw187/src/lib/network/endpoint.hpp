@@ -34,6 +34,11 @@ criminal penalties as provided by law.
 #include <errno.h>
 #include <stdlib.h>
 
+#ifdef __linux__
+/// Linux can send and receive several datagrams in a single system call.
+#define MERCURY_HAS_MMSG
+#endif
+
 #ifndef unix
 
 #ifndef socklen_t
@@ -125,6 +130,12 @@ public:
 		u_int16_t * networkPort, u_int32_t * networkAddr );
 	int recvfrom( void * gramData, int gramSize,
 		struct sockaddr_in & sin );
+
+#ifdef MERCURY_HAS_MMSG
+	bool canUseMultipleMessages() const;
+	int recvmmsg( struct mmsghdr * pMessages, int count );
+	int sendmmsg( struct mmsghdr * pMessages, int count );
+#endif
 	//@}
 
 	/// @name Connecting Socket Methods
@@ -547,6 +547,47 @@ INLINE int Endpoint::recvfrom( void * gramData, int gramSize,
 	return ret;
 }
 
+#ifdef MERCURY_HAS_MMSG
+/**
+ *	This method returns whether recvmmsg and sendmmsg can be used on this
+ *	endpoint. They cannot be used while traffic is being hijacked by a
+ *	front-end process, since that path only understands single datagrams.
+ */
+INLINE bool Endpoint::canUseMultipleMessages() const
+{
+	return !pHijackEndpoint_ && !s_pHijackStream_ && !s_pHijackEndpointSync_;
+}
+
+
+/**
+ *	This method attempts to receive several datagrams at once.
+ *
+ *	@param pMessages	The message headers to receive into.
+ *	@param count		The number of message headers.
+ *
+ *	@return The number of datagrams received, or -1 if an error occurred.
+ */
+INLINE int Endpoint::recvmmsg( struct mmsghdr * pMessages, int count )
+{
+	return ::recvmmsg( socket_, pMessages, count, 0, NULL );
+}
+
+
+/**
+ *	This method attempts to send several datagrams at once.
+ *
+ *	@param pMessages	The message headers to send.
+ *	@param count		The number of message headers.
+ *
+ *	@return The number of datagrams sent, or -1 if an error occurred.
+ */
+INLINE int Endpoint::sendmmsg( struct mmsghdr * pMessages, int count )
+{
+	return ::sendmmsg( socket_, pMessages, count, 0 );
+}
+#endif
+
+
 /**
  *	This method instructs this endpoint to listen for incoming connections.
  */
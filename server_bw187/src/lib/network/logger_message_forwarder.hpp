@@ -227,6 +227,10 @@ private:
 		BWConfig::get( "maxChannelOverflow/isAssert",						\
 		Mercury::Channel::assertOnMaxOverflowPackets() ));					\
 																			\
+	Mercury::Channel::useInternalSelectiveAcks(								\
+		BWConfig::get( "networking/selectiveAcks",							\
+		Mercury::Channel::useInternalSelectiveAcks() ));					\
+																			\
 	if (monitoringInterfaceName == "")										\
 	{																		\
 		monitoringInterfaceName =											\
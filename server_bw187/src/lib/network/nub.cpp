@@ -27,6 +27,10 @@ criminal penalties as provided by law.
 #include "cstdmf/concurrency.hpp"
 #include "cstdmf/profile.hpp"
 
+#ifdef MF_SERVER
+#include "server/bwconfig.hpp"
+#endif
+
 #include <sstream>
 
 namespace Mercury
@@ -92,6 +96,15 @@ const uint Nub::ERROR_REPORT_COUNT_MAX_LIFETIME_MS = 10000; // 10 seconds
  */
 const int Nub::RECV_BUFFER_SIZE = 16 * 1024 * 1024; // 16MB
 
+namespace
+{
+/// The number of packets that a receive thread can hold for the main thread.
+const int RECEIVE_THREAD_CAPACITY = 8192;
+
+/// The weight given to the newest sample in the average receive latency.
+const double RECEIVE_LATENCY_AVERAGE_BIAS = 0.01;
+} // anonymous namespace
+
 /**
  * 	This is the constructor. It initialises the socket, and
  * 	establishes the default internal Nub interfaces.
@@ -106,6 +119,13 @@ Nub::Nub( uint16 listeningPort, const char * listeningInterface ) :
 	interfaceTable_( 256 ),
 	timerQueue_(),
 	pCurrentTimer_( NULL ),
+	recvBatchSize_( 1 ),
+	sendBatchSize_( 1 ),
+#ifdef MERCURY_HAS_MMSG
+	recvBatchNext_( 0 ),
+	recvBatchCount_( 0 ),
+	sendBatchCount_( 0 ),
+#endif
 	artificialDropPerMillion_( 0 ),
 	artificialLatencyMin_( 0 ),
 	artificialLatencyMax_( 0 ),
@@ -113,11 +133,20 @@ Nub::Nub( uint16 listeningPort, const char * listeningInterface ) :
 	nextReplyID_( (uint32(timestamp())%100000) + 10101 ),
 	nextSequenceID_( 1 ),
 	nextPacket_( NULL ),
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	pReceiveThread_( NULL ),
+	lastReceiveLatency_( 0 ),
+	averageReceiveLatency_( 0.0 ),
+#endif
 	clearFragmentedBundlesTimerID_( TIMER_ID_NONE ),
 	breakProcessing_( false ),
 	drainSocketInput_( false ),
 	fdLargest_( -1 ),
 	fdWriteCount_( 0 ),
+#ifdef MERCURY_HAS_EPOLL
+	fdInterest_(),
+	epollFD_( -1 ),
+#endif
 	pBundleEventHandler_( NULL ),
 	pPacketMonitor_( NULL ),
 	channelMap_(),
@@ -147,6 +176,8 @@ Nub::Nub( uint16 listeningPort, const char * listeningInterface ) :
 	numFailedBundleSend_( 0 ),
 	numCorruptedPacketsReceived_( 0 ),
 	numCorruptedBundlesReceived_( 0 ),
+	numSelectiveAckPacketsSent_( 0 ),
+	numSelectiveAckBytesSaved_( 0 ),
 	lastNumBytesSent_( 0 ),
 	lastNumBytesReceived_( 0 ),
 	lastNumPacketsSent_( 0 ),
@@ -190,10 +221,30 @@ Nub::Nub( uint16 listeningPort, const char * listeningInterface ) :
 	FD_ZERO( &fdWriteSet_ );
 	fdLargest_ = -1;
 
+#ifdef MERCURY_HAS_EPOLL
+	// Prefer epoll where it is available. If it cannot be created we quietly
+	// stay with select.
+	this->shouldUseEpoll( true );
+#endif
+
 	// This registers the file descriptor and so needs to be done after
 	// initialising fdReadSet_ etc.
 	this->recreateListeningSocket( listeningPort, listeningInterface );
 
+#ifdef MF_SERVER
+	this->recvBatchSize(
+		BWConfig::get( "networking/recvBatchSize", recvBatchSize_ ) );
+	this->sendBatchSize(
+		BWConfig::get( "networking/sendBatchSize", sendBatchSize_ ) );
+
+	if (BWConfig::get( "networking/useReceiveThread", false ) &&
+			!this->shouldUseReceiveThread( true ))
+	{
+		WARNING_MSG( "Nub::Nub: networking/useReceiveThread is set but the "
+			"receive thread could not be started\n" );
+	}
+#endif
+
 	// and put ourselves in as the reply handler
 	this->serveInterfaceElement( InterfaceElement::REPLY,
 		InterfaceElement::REPLY.id(), this );
@@ -201,6 +252,10 @@ Nub::Nub( uint16 listeningPort, const char * listeningInterface ) :
 	// always have a packet handy
 	nextPacket_ = new Packet();
 	memset( loopStats_, 0, sizeof(loopStats_) );
+	memset( recvBatchHistogram_, 0, sizeof( recvBatchHistogram_ ) );
+	memset( sendBatchHistogram_, 0, sizeof( sendBatchHistogram_ ) );
+	memset( lastRecvBatchHistogram_, 0, sizeof( lastRecvBatchHistogram_ ) );
+	memset( lastSendBatchHistogram_, 0, sizeof( lastSendBatchHistogram_ ) );
 
 	// report any pending exceptions every so often
 	reportLimitTimerID_ = this->registerTimer( ERROR_REPORT_MIN_PERIOD_MS * 1000,
@@ -221,6 +276,8 @@ Nub::~Nub()
 {
 	delayedChannels_.clear();
 
+	this->flushSendQueue();
+
 	// We do not want to trigger any handler exceptions here so delete them all.
 	if (!replyHandlerMap_.empty())
 	{
@@ -267,6 +324,9 @@ Nub::~Nub()
 		pMasterNub_->deregisterChildNub( this );
 	}
 
+	// The receive thread must stop reading before the socket is closed.
+	this->shouldUseReceiveThread( false );
+
 	// close the socket
 	if (socket_.good())
 	{
@@ -294,6 +354,14 @@ Nub::~Nub()
 		this->cancelTimer( (int)tqe );
 		this->finishProcessingTimerEvent( tqe );
 	}
+
+#ifdef MERCURY_HAS_EPOLL
+	if (epollFD_ != -1)
+	{
+		::close( epollFD_ );
+		epollFD_ = -1;
+	}
+#endif
 }
 
 
@@ -361,6 +429,11 @@ bool Nub::queryMachinedInterface( u_int32_t & addr )
 bool Nub::recreateListeningSocket( uint16 listeningPort,
 	const char * listeningInterface )
 {
+	// The receive thread is tied to the old socket, so it is stopped here and
+	// started again on the new one.
+	const bool wasUsingReceiveThread = this->isUsingReceiveThread();
+	this->shouldUseReceiveThread( false );
+
 	// first unregister any existing interfaces.
 	if (socket_.good())
 	{
@@ -484,6 +557,8 @@ bool Nub::recreateListeningSocket( uint16 listeningPort,
 		this->registerWithMachined( interfaceName_, interfaceID_ );
 	}
 
+	this->shouldUseReceiveThread( wasUsingReceiveThread );
+
 	return true;
 }
 
@@ -780,6 +855,14 @@ bool Nub::processPendingEvents( bool expectingPacket )
 		oldSpareTime_ = totSpareTime_;
 		totSpareTime_ = accSpareTime_ + spareTime_;
 
+		// Publish the batch histograms of the period just ended.
+		memcpy( lastRecvBatchHistogram_, recvBatchHistogram_,
+			sizeof( recvBatchHistogram_ ) );
+		memcpy( lastSendBatchHistogram_, sendBatchHistogram_,
+			sizeof( sendBatchHistogram_ ) );
+		memset( recvBatchHistogram_, 0, sizeof( recvBatchHistogram_ ) );
+		memset( sendBatchHistogram_, 0, sizeof( sendBatchHistogram_ ) );
+
 		lastStatisticsGathered_ = timestamp();
 	}
 
@@ -790,7 +873,32 @@ bool Nub::processPendingEvents( bool expectingPacket )
 
 	// try a recvfrom
 	Address	srcAddr;
-	int len = nextPacket_->recvFromEndpoint( socket_, srcAddr );
+	int len;
+
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	// Set if the receive thread collected the address that a receive error
+	// was about. It reads the socket's error queue itself, so we cannot.
+	bool hasThreadOffender = false;
+
+	if (pReceiveThread_)
+	{
+		len = this->recvFromReceiveThread( srcAddr, hasThreadOffender );
+	}
+	else
+#endif
+#ifdef MERCURY_HAS_MMSG
+	// Packets left over from the last batch must be processed before anything
+	// else is read from the socket.
+	if (recvBatchNext_ < recvBatchCount_ ||
+		(recvBatchSize_ > 1 && socket_.canUseMultipleMessages()))
+	{
+		len = this->recvFromBatch( srcAddr );
+	}
+	else
+#endif
+	{
+		len = nextPacket_->recvFromEndpoint( socket_, srcAddr );
+	}
 
 	recvSystemTimer_.stop( len > 0 );
 
@@ -855,10 +963,14 @@ bool Nub::processPendingEvents( bool expectingPacket )
 #ifdef _WIN32
 			wsaErr == WSAEWOULDBLOCK
 #else
-			errno == EAGAIN && !expectingPacket
+			errno == EAGAIN &&
+				(!expectingPacket || this->isUsingReceiveThread())
 #endif
 			)
 		{
+			// The socket is dry, so this is a good time to send anything that
+			// was queued while processing what came in.
+			this->flushSendQueue();
 			return false;
 		}
 
@@ -871,8 +983,21 @@ bool Nub::processPendingEvents( bool expectingPacket )
 			errno == EHOSTUNREACH)
 		{
 			Mercury::Address offender;
+			bool hasOffender;
 
-			if (socket_.getClosedPort( offender ))
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+			if (pReceiveThread_)
+			{
+				offender = srcAddr;
+				hasOffender = hasThreadOffender;
+			}
+			else
+#endif
+			{
+				hasOffender = socket_.getClosedPort( offender );
+			}
+
+			if (hasOffender)
 			{
 				// If we got a NO_SUCH_PORT error and there is an internal
 				// channel to this address, mark it as remote failed.  The logic
@@ -975,20 +1100,20 @@ void Nub::processContinuously()
 		}
 		while (gotPacket && !breakProcessing_);
 
-		// if processing has been stopped then get out
+		// if processing has been stopped then get out, sending anything that
+		// was queued while processing the last packets
 		if (breakProcessing_)
 		{
+			this->flushSendQueue();
 			break;
 		}
 
-		// ok, nothing's urgent then: settle down to a select
+		// ok, nothing's urgent then: settle down to a select (or epoll_wait)
 		//  on the socket and the topmost timer
 		BeginThreadBlockingOperation();
 
 		uint64		startSelect = timestamp();
 
-		readFDs = fdReadSet_;
-		writeFDs = fdWriteSet_;
 		if (timerQueue_.empty())
 		{
 			selectArg = NULL;
@@ -1017,8 +1142,37 @@ void Nub::processContinuously()
 			selectArg = &nextTimeout;
 		}
 
-		int countReady = select( fdLargest_+1, &readFDs,
+		int countReady;
+
+		pollTimer_.start();
+
+#ifdef MERCURY_HAS_EPOLL
+		if (epollFD_ != -1)
+		{
+			// Round up so that we do not spin waiting for a timer that is
+			// due in less than a millisecond.
+			int timeoutMs = -1;
+
+			if (selectArg)
+			{
+				timeoutMs = nextTimeout.tv_sec * 1000 +
+					(nextTimeout.tv_usec + 999) / 1000;
+			}
+
+			countReady = epoll_wait( epollFD_, epollEvents_,
+				MAX_EPOLL_EVENTS, timeoutMs );
+		}
+		else
+#endif
+		{
+			readFDs = fdReadSet_;
+			writeFDs = fdWriteSet_;
+
+			countReady = select( fdLargest_+1, &readFDs,
 				fdWriteCount_ ? &writeFDs : NULL, NULL, selectArg );
+		}
+
+		pollTimer_.stop( true );
 
 		uint64 endofSelect = timestamp();
 		spareTime_ += endofSelect - startSelect;
@@ -1026,11 +1180,18 @@ void Nub::processContinuously()
 
 		CeaseThreadBlockingOperation();
 
+#ifdef MERCURY_HAS_EPOLL
+		if (countReady > 0 && epollFD_ != -1)
+		{
+			this->handleEpollNotifications( countReady, expectPacket );
+		}
+		else
+#endif
 		if (countReady > 0)
 		{
 			// If the primary socket for this nub is ready to read, it takes
 			// priority over the other sockets registered here.
-			if (FD_ISSET( socket_, &readFDs ))
+			if (FD_ISSET( this->receiveFileDescriptor(), &readFDs ))
 			{
 				expectPacket = true;
 			}
@@ -1047,7 +1208,9 @@ void Nub::processContinuously()
 			if (!breakProcessing_)
 			{
 				WARNING_MSG( "Nub::processContinuously: "
-					"error in select(): %s\n", strerror( errno ) );
+					"error in %s(): %s\n",
+					this->isUsingEpoll() ? "epoll_wait" : "select",
+					strerror( errno ) );
 			}
 		}
 	}
@@ -1077,6 +1240,7 @@ void Nub::processUntilBreak()
 			}
 		}
 	}
+	this->flushSendQueue();
 	this->reportPendingExceptions( true /* reportBelowThreshold */ );
 }
 
@@ -1199,15 +1363,73 @@ void Nub::handleInputNotifications( int &countReady,
 }
 
 
+#ifdef MERCURY_HAS_EPOLL
+/**
+ *	This method triggers input notification handlers for the events returned
+ *	by epoll_wait in processContinuously.
+ *
+ *	@param countReady	The number of events in epollEvents_.
+ *	@param expectPacket	Set to true if the nub's own socket is readable.
+ */
+void Nub::handleEpollNotifications( int countReady, bool & expectPacket )
+{
+	// As with select, if the primary socket for this nub is ready to read it
+	// takes priority over the other descriptors registered here. Those are
+	// level-triggered and so will be reported again next time around.
+	for (int i = 0; i < countReady; ++i)
+	{
+		if (epollEvents_[i].data.fd == this->receiveFileDescriptor())
+		{
+			expectPacket = true;
+			return;
+		}
+	}
+
+	for (int i = 0; i < countReady; ++i)
+	{
+		const int fd = epollEvents_[i].data.fd;
+		const uint32 events = epollEvents_[i].events;
+
+		// A handler may deregister other descriptors, so check that each is
+		// still registered before calling it.
+		if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+			this->isReadFileDescriptor( fd ))
+		{
+			InputNotificationHandler * pHandler = fdHandlers_[ fd ];
+			if (pHandler)
+				pHandler->handleInputNotification( fd );
+		}
+
+		if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) &&
+			this->isWriteFileDescriptor( fd ))
+		{
+			InputNotificationHandler * pHandler = fdWriteHandlers_[ fd ];
+			if (pHandler)
+				pHandler->handleInputNotification( fd );
+		}
+	}
+}
+#endif
+
+
 /**
  *  This method is the nub's own input notification callback.  This is used by
  *  slave nubs when registering with a master nub.  It simply calls process
  *  pending events on the nub so that it can process incoming packets and timers
  *  just like the master nub.
+ *
+ *	As in processContinuously, everything waiting is processed. A receive
+ *	thread may have queued many packets behind a single wake up.
  */
 int Nub::handleInputNotification( int fd )
 {
-	this->processPendingEvents( /* expectingPacket: */ true );
+	bool expectingPacket = true;
+
+	while (this->processPendingEvents( expectingPacket ) && !breakProcessing_)
+	{
+		expectingPacket = false;
+	}
+
 	return 0;
 }
 
@@ -1267,6 +1489,7 @@ void Nub::drainSocketInput()
 void Nub::shutdown()
 {
     this->breakProcessing();
+    this->shouldUseReceiveThread( false );
     socket_.close();
 }
 
@@ -1413,6 +1636,71 @@ inline SeqNum Nub::getNextSequenceID()
 }
 
 
+namespace
+{
+/**
+ *	This structure is a selective ACK block as it is sent in the packet
+ *	footers.
+ */
+struct SelectiveAckBlock
+{
+	SeqNum				base;
+	Packet::SackBits	bits;
+};
+
+typedef std::vector< SeqNum > SeqNums;
+typedef std::vector< SelectiveAckBlock > SelectiveAckBlocks;
+
+/**
+ *	This functor orders sequence numbers, allowing for wrap around.
+ */
+struct SeqLessThan
+{
+	bool operator()( SeqNum a, SeqNum b ) const
+	{
+		return Channel::seqLessThan( a, b );
+	}
+};
+
+/**
+ *	This function packs the given ACKs into as few selective ACK blocks as
+ *	a single pass can manage. The ACKs are sorted as a side effect.
+ */
+void buildSelectiveAckBlocks( SeqNums & acks, SelectiveAckBlocks & blocks )
+{
+	const int MAX_OFFSET = 8 * sizeof( Packet::SackBits );
+
+	std::sort( acks.begin(), acks.end(), SeqLessThan() );
+
+	blocks.clear();
+
+	for (SeqNums::const_iterator iter = acks.begin();
+			iter != acks.end(); ++iter)
+	{
+		if (!blocks.empty())
+		{
+			SelectiveAckBlock & block = blocks.back();
+			SeqNum offset = Channel::seqMask( *iter - block.base );
+
+			if (offset == 0)
+			{
+				continue;
+			}
+
+			if (offset <= SeqNum( MAX_OFFSET ))
+			{
+				block.bits |= Packet::SackBits( 1 ) << (offset - 1);
+				continue;
+			}
+		}
+
+		SelectiveAckBlock block = { *iter, 0 };
+		blocks.push_back( block );
+	}
+}
+} // anonymous namespace
+
+
 /**
  * 	This method sends a bundle to the given address.
  * 	Note: any pointers you have into the packet may become invalid
@@ -1474,6 +1762,11 @@ void Nub::send( const Address & address, Bundle & bundle, Channel * pChannel )
 	SeqNum lastSeq = 0;
 	Bundle::AckOrders::iterator ackIter = bundle.ackOrders_.begin();
 
+	// The ACKs on the packet being written, and their selective ACK blocks if
+	// they are being sent that way.
+	SeqNums packetAcks;
+	SelectiveAckBlocks sackBlocks;
+
 	{
 
 		// Write footers for each packet.
@@ -1496,6 +1789,41 @@ void Nub::send( const Address & address, Bundle & bundle, Channel * pChannel )
 				p->enableFlags( Packet::FLAG_ON_CHANNEL );
 			}
 
+			packetAcks.clear();
+			sackBlocks.clear();
+
+			while (ackIter != bundle.ackOrders_.end() && ackIter->p == p)
+			{
+				packetAcks.push_back( ackIter->forseq );
+				++ackIter;
+			}
+
+			// If the other end understands them, ACKs are sent as selective
+			// ACK blocks when that takes less space. Space for the plain ACKs
+			// was reserved as they were added, so hand back what is saved.
+			if (pChannel && pChannel->shouldUseSelectiveAcks() &&
+				(packetAcks.size() > 1))
+			{
+				buildSelectiveAckBlocks( packetAcks, sackBlocks );
+
+				int saved = int( packetAcks.size() * sizeof( SeqNum ) ) -
+					int( sackBlocks.size() ) * Packet::SACK_BLOCK_SIZE;
+
+				if (saved > 0)
+				{
+					p->disableFlags( Packet::FLAG_HAS_ACKS );
+					p->enableFlags( Packet::FLAG_HAS_SACKS );
+					p->reserveFooter( -saved );
+
+					++numSelectiveAckPacketsSent_;
+					numSelectiveAckBytesSaved_ += saved;
+				}
+				else
+				{
+					sackBlocks.clear();
+				}
+			}
+
 			// At this point, p->back() is positioned just after the message
 			// data, so we advance it to the end of where the footers end, then
 			// write backwards towards the message data. We check that we finish
@@ -1606,17 +1934,28 @@ void Nub::send( const Address & address, Bundle & bundle, Channel * pChannel )
 			{
 				p->packFooter( (uint8)p->nAcks() );
 
-				int numAcks = 0;
-				while (ackIter != bundle.ackOrders_.end() && ackIter->p == p)
+				for (SeqNums::const_iterator iter = packetAcks.begin();
+						iter != packetAcks.end(); ++iter)
 				{
-					p->packFooter( ackIter->forseq );
-					++ackIter;
-					++numAcks;
+					p->packFooter( *iter );
 				}
 
 				// There cannot be more than this since ACK count is 8 bits
-				MF_ASSERT( numAcks <= Packet::MAX_ACKS );
-				MF_ASSERT( numAcks == p->nAcks() );
+				MF_ASSERT( int( packetAcks.size() ) <= Packet::MAX_ACKS );
+				MF_ASSERT( int( packetAcks.size() ) == p->nAcks() );
+			}
+			else if (p->hasFlags( Packet::FLAG_HAS_SACKS ))
+			{
+				// There are never more blocks than ACKs.
+				p->packFooter( (Packet::AckCount)sackBlocks.size() );
+
+				for (SelectiveAckBlocks::const_iterator iter =
+						sackBlocks.begin();
+					iter != sackBlocks.end(); ++iter)
+				{
+					p->packFooter( iter->base );
+					p->packFooter( iter->bits );
+				}
 			}
 
 			// Add the sequence number
@@ -1771,8 +2110,33 @@ void Nub::sendPacket( const Address & address,
 /**
  *	Basic packet sending functionality that retries a few times
  *	if there are transitory errors.
+ *
+ *	If send batching is enabled, the packet is queued instead and
+ *	REASON_SUCCESS is returned. Errors are then reported when the queue is
+ *	flushed.
  */
 Reason Nub::basicSendWithRetries( const Address & addr, Packet * p )
+{
+#ifdef MERCURY_HAS_MMSG
+	if (sendBatchSize_ > 1 && socket_.canUseMultipleMessages())
+	{
+		this->queueSend( addr, p );
+		return REASON_SUCCESS;
+	}
+
+	// Batching may have just been turned off. Keep packets in order.
+	this->flushSendQueue();
+#endif
+
+	return this->sendWithRetries( addr, p );
+}
+
+
+/**
+ *	This method sends a packet immediately, retrying a few times if there are
+ *	transitory errors.
+ */
+Reason Nub::sendWithRetries( const Address & addr, Packet * p )
 {
 	// try sending a few times
 	int retries = 0;
@@ -1909,104 +2273,308 @@ Reason Nub::basicSendSingleTry( const Address & addr, Packet * p )
 	}
 }
 
+namespace
+{
 /**
- * This method reschedules a packet to be sent to the address provided
- * some short time in the future (or drop it) depending on the latency
- * settings on the nub.
- *
- * @return true if rescheduled
+ *	This function returns the batch size histogram bucket for a batch of the
+ *	given size.
  */
-bool Nub::rescheduleSend( const Address & addr, Packet * packet, bool isResend )
+inline int batchHistogramIndex( int batchSize )
 {
+	int index = 0;
 
-	// see if we drop it
-	if (dropNextSend_ ||
-		((artificialDropPerMillion_ != 0) &&
-		rand() < int64( artificialDropPerMillion_ ) * RAND_MAX / 1000000))
+	while (batchSize > 1)
 	{
-		if (packet->seq() != Channel::SEQ_NULL)
-		{
-			if (packet->channelID() != CHANNEL_ID_NULL)
-			{
-				DEBUG_MSG( "Nub::rescheduleSend: "
-					"dropped packet #%d to %s/%d due to artificial loss\n",
-					packet->seq(), addr.c_str(), packet->channelID() );
-			}
-			else
-			{
-				DEBUG_MSG( "Nub::rescheduleSend: "
-					"dropped packet #%d to %s due to artificial loss\n",
-					packet->seq(), addr.c_str() );
-			}
-		}
-		else
-		{
-			// All internal messages should be reliable
-			MF_ASSERT( isExternal_ ||
-				packet->msgEndOffset() == Packet::HEADER_SIZE );
-
-			DEBUG_MSG( "Nub::rescheduleSend: "
-				"Dropped packet with %d ACKs to %s due to artificial loss\n",
-				packet->nAcks(), addr.c_str() );
-		}
-
-		dropNextSend_ = false;
-
-		return true;
+		batchSize >>= 1;
+		++index;
 	}
 
-	// now see if we delay it
-	if (artificialLatencyMax_ == 0)
-		return false;
-
-	int latency = (artificialLatencyMax_ > artificialLatencyMin_) ?
-		artificialLatencyMin_ +
-				rand() % (artificialLatencyMax_ - artificialLatencyMin_) :
-		artificialLatencyMin_;
-
-	if (latency < 2)
-		return false;	// 2ms => send now
+	return index;
+}
+} // anonymous namespace
 
-	// ok, we'll delay this packet then
-	new RescheduledSender( *this, addr, packet, latency, isResend );
 
-	return true;
+/**
+ *	This method sets the number of datagrams that processPendingEvents reads
+ *	from the socket per system call. A size of 1 turns receive batching off.
+ *	Batching is only available on Linux.
+ */
+void Nub::recvBatchSize( int size )
+{
+	recvBatchSize_ = std::max( 1, std::min( size, int( Packet::MAX_BATCH_SIZE ) ) );
 }
 
 
 /**
- *	Constructor for RescheduledSender.
+ *	This method sets the number of outgoing datagrams that are queued before
+ *	being sent with a single system call. A size of 1 turns send batching off.
+ *	Batching is only available on Linux.
+ *
+ *	Queued packets are also sent whenever processPendingEvents finds the
+ *	socket empty, so they are not held for longer than it takes to process
+ *	the current burst of input. Code that sends without then returning to
+ *	processPendingEvents should call flushSendQueue.
  */
-Nub::RescheduledSender::RescheduledSender( Nub & nub, const Address & addr,
-	Packet * pPacket, int latencyMilli, bool isResend ) :
-	nub_( nub ),
-	addr_( addr ),
-	pPacket_( pPacket ),
-	isResend_( isResend )
+void Nub::sendBatchSize( int size )
 {
-	nub_.registerCallback( latencyMilli*1000, this );
+	sendBatchSize_ = std::max( 1, std::min( size, int( Packet::MAX_BATCH_SIZE ) ) );
+
+	if (sendBatchSize_ == 1)
+	{
+		this->flushSendQueue();
+	}
 }
 
 
-int Nub::RescheduledSender::handleTimeout( int, void * )
+/**
+ *	This method sends any packets queued by send batching.
+ */
+void Nub::flushSendQueue()
 {
-	Channel * pChannel = pPacket_->hasFlags( Packet::FLAG_ON_CHANNEL ) ?
-		nub_.findChannel( addr_ ) : NULL;
+#ifdef MERCURY_HAS_MMSG
+	const int count = sendBatchCount_;
 
-	if (isResend_)
+	if (count == 0)
 	{
-		nub_.sendPacket( addr_, pPacket_.get(), pChannel, true );
+		return;
 	}
-	else
-	{
-		PacketFilterPtr pFilter = pChannel ? pChannel->pFilter() : NULL;
 
-		if(nub_.pPacketMonitor_)
-		{
-			nub_.pPacketMonitor_->packetOut( addr_, *pPacket_ );
-		}
+	++sendBatchHistogram_[ batchHistogramIndex( count ) ];
 
-		if (pFilter)
+	mmsghdr messages[ Packet::MAX_BATCH_SIZE ];
+	iovec iovecs[ Packet::MAX_BATCH_SIZE ];
+	sockaddr_in addrs[ Packet::MAX_BATCH_SIZE ];
+
+	memset( messages, 0, sizeof( mmsghdr ) * count );
+
+	for (int i = 0; i < count; ++i)
+	{
+		Packet * p = sendBatch_[i].get();
+
+		addrs[i].sin_family = AF_INET;
+		addrs[i].sin_port = sendBatchAddrs_[i].port;
+		addrs[i].sin_addr.s_addr = sendBatchAddrs_[i].ip;
+
+		iovecs[i].iov_base = p->data();
+		iovecs[i].iov_len = p->totalSize();
+
+		messages[i].msg_hdr.msg_iov = &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+		messages[i].msg_hdr.msg_name = &addrs[i];
+		messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+	}
+
+	int numSent = 0;
+
+	while (numSent < count)
+	{
+		sendSystemTimer_.start();
+		int ret = socket_.sendmmsg( messages + numSent, count - numSent );
+		sendSystemTimer_.stop( true );
+
+		if (ret > 0)
+		{
+			for (int i = numSent; i < numSent + ret; ++i)
+			{
+				numBytesSent_ += messages[i].msg_len + UDP_OVERHEAD;
+				numPacketsSent_++;
+			}
+
+			numSent += ret;
+		}
+		else
+		{
+			// Let the single packet path retry and report the error for the
+			// first unsent packet, then carry on with the rest.
+			this->sendWithRetries( sendBatchAddrs_[ numSent ],
+				sendBatch_[ numSent ].get() );
+			++numSent;
+		}
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		sendBatch_[i] = NULL;
+	}
+
+	sendBatchCount_ = 0;
+#endif
+}
+
+
+#ifdef MERCURY_HAS_MMSG
+/**
+ *	This method queues a packet to be sent by flushSendQueue, flushing first
+ *	if the queue is already full.
+ */
+void Nub::queueSend( const Address & addr, Packet * p )
+{
+	const int batchSize = std::min( sendBatchSize_,
+		int( Packet::MAX_BATCH_SIZE ) );
+
+	if (sendBatchCount_ >= batchSize)
+	{
+		this->flushSendQueue();
+	}
+
+	sendBatch_[ sendBatchCount_ ] = p;
+	sendBatchAddrs_[ sendBatchCount_ ] = addr;
+	++sendBatchCount_;
+
+	if (sendBatchCount_ >= batchSize)
+	{
+		this->flushSendQueue();
+	}
+}
+
+
+/**
+ *	This method is the batched equivalent of Packet::recvFromEndpoint. It
+ *	hands out packets from the last recvmmsg call, refilling the batch when it
+ *	runs out. The received packet is left in nextPacket_.
+ *
+ *	@return The length of the packet, or the recvmmsg result if nothing could
+ *	be received.
+ */
+int Nub::recvFromBatch( Address & srcAddr )
+{
+	if (recvBatchNext_ == recvBatchCount_)
+	{
+		const int batchSize = std::min( recvBatchSize_,
+			int( Packet::MAX_BATCH_SIZE ) );
+
+		for (int i = 0; i < batchSize; ++i)
+		{
+			if (!recvBatch_[i])
+			{
+				recvBatch_[i] = new Packet();
+			}
+		}
+
+		int numReceived = Packet::recvBatchFromEndpoint( socket_,
+			recvBatch_, recvBatchAddrs_, batchSize );
+
+		recvBatchNext_ = recvBatchCount_ = 0;
+
+		if (numReceived <= 0)
+		{
+			return numReceived;
+		}
+
+		recvBatchCount_ = numReceived;
+		++recvBatchHistogram_[ batchHistogramIndex( numReceived ) ];
+	}
+
+	// Hand over the filled packet, leaving our unused spare in its slot.
+	const int i = recvBatchNext_++;
+	PacketPtr pFilled = recvBatch_[i];
+	recvBatch_[i] = nextPacket_;
+	nextPacket_ = pFilled;
+	srcAddr = recvBatchAddrs_[i];
+
+	return nextPacket_->msgEndOffset();
+}
+#endif
+
+
+/**
+ * This method reschedules a packet to be sent to the address provided
+ * some short time in the future (or drop it) depending on the latency
+ * settings on the nub.
+ *
+ * @return true if rescheduled
+ */
+bool Nub::rescheduleSend( const Address & addr, Packet * packet, bool isResend )
+{
+
+	// see if we drop it
+	if (dropNextSend_ ||
+		((artificialDropPerMillion_ != 0) &&
+		rand() < int64( artificialDropPerMillion_ ) * RAND_MAX / 1000000))
+	{
+		if (packet->seq() != Channel::SEQ_NULL)
+		{
+			if (packet->channelID() != CHANNEL_ID_NULL)
+			{
+				DEBUG_MSG( "Nub::rescheduleSend: "
+					"dropped packet #%d to %s/%d due to artificial loss\n",
+					packet->seq(), addr.c_str(), packet->channelID() );
+			}
+			else
+			{
+				DEBUG_MSG( "Nub::rescheduleSend: "
+					"dropped packet #%d to %s due to artificial loss\n",
+					packet->seq(), addr.c_str() );
+			}
+		}
+		else
+		{
+			// All internal messages should be reliable
+			MF_ASSERT( isExternal_ ||
+				packet->msgEndOffset() == Packet::HEADER_SIZE );
+
+			DEBUG_MSG( "Nub::rescheduleSend: "
+				"Dropped packet with %d ACKs to %s due to artificial loss\n",
+				packet->nAcks(), addr.c_str() );
+		}
+
+		dropNextSend_ = false;
+
+		return true;
+	}
+
+	// now see if we delay it
+	if (artificialLatencyMax_ == 0)
+		return false;
+
+	int latency = (artificialLatencyMax_ > artificialLatencyMin_) ?
+		artificialLatencyMin_ +
+				rand() % (artificialLatencyMax_ - artificialLatencyMin_) :
+		artificialLatencyMin_;
+
+	if (latency < 2)
+		return false;	// 2ms => send now
+
+	// ok, we'll delay this packet then
+	new RescheduledSender( *this, addr, packet, latency, isResend );
+
+	return true;
+}
+
+
+/**
+ *	Constructor for RescheduledSender.
+ */
+Nub::RescheduledSender::RescheduledSender( Nub & nub, const Address & addr,
+	Packet * pPacket, int latencyMilli, bool isResend ) :
+	nub_( nub ),
+	addr_( addr ),
+	pPacket_( pPacket ),
+	isResend_( isResend )
+{
+	nub_.registerCallback( latencyMilli*1000, this );
+}
+
+
+int Nub::RescheduledSender::handleTimeout( int, void * )
+{
+	Channel * pChannel = pPacket_->hasFlags( Packet::FLAG_ON_CHANNEL ) ?
+		nub_.findChannel( addr_ ) : NULL;
+
+	if (isResend_)
+	{
+		nub_.sendPacket( addr_, pPacket_.get(), pChannel, true );
+	}
+	else
+	{
+		PacketFilterPtr pFilter = pChannel ? pChannel->pFilter() : NULL;
+
+		if(nub_.pPacketMonitor_)
+		{
+			nub_.pPacketMonitor_->packetOut( addr_, *pPacket_ );
+		}
+
+		if (pFilter)
 		{
 			pFilter->send( nub_, addr_, pPacket_.get() );
 		}
@@ -2588,6 +3156,85 @@ Reason Nub::processFilteredPacket( const Address & addr, Packet * p,
 		}
 	}
 
+	// Strip and handle selective ACKs
+	if (p->hasFlags( Packet::FLAG_HAS_SACKS ))
+	{
+		Packet::AckCount numBlocks;
+
+		if (!p->stripFooter( numBlocks ) || (numBlocks == 0) ||
+			p->hasFlags( Packet::FLAG_HAS_ACKS ))
+		{
+			WARNING_MSG( "Nub::processFilteredPacket( %s ): "
+				"Bad selective ACK footer (%d bytes left)\n",
+				addr.c_str(), p->bodySize() );
+
+			RETURN_FOR_CORRUPTED_PACKET();
+		}
+
+		int sackSize = numBlocks * Packet::SACK_BLOCK_SIZE;
+
+		if (p->bodySize() < sackSize)
+		{
+			WARNING_MSG( "Nub::processFilteredPacket( %s ): "
+				"Not enough footers for %d selective ACK blocks "
+				"(have %d bytes but need %d)\n",
+				addr.c_str(), numBlocks, p->bodySize(), sackSize );
+
+			RETURN_FOR_CORRUPTED_PACKET();
+		}
+
+		if (pChannel || !p->hasFlags( Packet::FLAG_ON_CHANNEL ))
+		{
+			// The other end understands selective ACKs, so we can send them
+			// too.
+			if (pChannel)
+			{
+				pChannel->shouldUseSelectiveAcks( true );
+			}
+
+			for (uint i = 0; i < numBlocks; i++)
+			{
+				SeqNum base;
+				Packet::SackBits bits;
+				p->stripFooter( base );
+				p->stripFooter( bits );
+
+				// Offset 0 is the base itself, and offset i + 1 is bit i.
+				for (int offset = 0; offset <= 8 * int( sizeof( bits ) );
+						++offset)
+				{
+					if ((offset > 0) && !(bits & (1U << (offset - 1))))
+					{
+						continue;
+					}
+
+					SeqNum seq = Channel::seqMask( base + offset );
+
+					if (!pChannel)
+					{
+						this->delOnceOffResendTimer( addr, seq );
+					}
+					else if (!pChannel->delResendTimer( seq ))
+					{
+						WARNING_MSG( "Nub::processFilteredPacket( %s ): "
+							"delResendTimer() failed for #%d\n",
+							addr.c_str(), seq );
+
+						RETURN_FOR_CORRUPTED_PACKET();
+					}
+				}
+			}
+		}
+		else
+		{
+			p->shrink( sackSize );
+
+			WARNING_MSG( "Nub::processFilteredPacket( %s ): "
+				"Got %d selective ACK blocks without a channel\n",
+				addr.c_str(), numBlocks );
+		}
+	}
+
 	// Strip sequence number
 	if (p->hasFlags( Packet::FLAG_HAS_SEQUENCE_NUMBER ))
 	{
@@ -3411,10 +4058,10 @@ bool Nub::registerFileDescriptor( int fd,
 	InputNotificationHandler * handler )
 {
 #ifndef _WIN32
-	if (fd >= FD_SETSIZE)
+	if (fd < 0 || (fd >= FD_SETSIZE && !this->isUsingEpoll()))
 	{
 		ERROR_MSG( "Nub::registerFileDescriptor: "
-			"Tried to register fd %d >= FD_SETSIZE (%d)\n",
+			"Tried to register fd %d >= FD_SETSIZE (%d) without epoll\n",
 			fd, FD_SETSIZE );
 
 		return false;
@@ -3422,14 +4069,30 @@ bool Nub::registerFileDescriptor( int fd,
 #endif
 
 	// Bail early if it's already in the read set
-	if (FD_ISSET( fd, &fdReadSet_ ))
+	if (this->isReadFileDescriptor( fd ))
 		return false;
 
+#ifdef _WIN32
 	FD_SET( fd, &fdReadSet_ );
+#else
+	if (fd < FD_SETSIZE)
+		FD_SET( fd, &fdReadSet_ );
+
+	if (fd >= (int)fdHandlers_.size())
+	{
+		fdHandlers_.resize( fd + 1, NULL );
+		fdWriteHandlers_.resize( fd + 1, NULL );
+	}
+#endif
+
 	fdHandlers_[fd] = handler;
 
 	if (fd > fdLargest_) fdLargest_ = fd;
 
+#ifdef MERCURY_HAS_EPOLL
+	this->changeFileDescriptorInterest( fd, FD_INTEREST_READ, true );
+#endif
+
 	return true;
 }
 
@@ -3448,24 +4111,41 @@ bool Nub::registerWriteFileDescriptor( int fd,
 	InputNotificationHandler * handler )
 {
 #ifndef _WIN32
-	if (fd >= FD_SETSIZE)
+	if (fd < 0 || (fd >= FD_SETSIZE && !this->isUsingEpoll()))
 	{
 		ERROR_MSG( "Nub::registerWriteFileDescriptor: "
-			"Tried to register fd %d >= FD_SETSIZE (%d)\n",
+			"Tried to register fd %d >= FD_SETSIZE (%d) without epoll\n",
 			fd, FD_SETSIZE );
 
 		return false;
 	}
 #endif
 
-	if(FD_ISSET( fd, &fdWriteSet_ )) return false;
+	if (this->isWriteFileDescriptor( fd )) return false;
 
+#ifdef _WIN32
 	FD_SET( fd, &fdWriteSet_ );
+#else
+	if (fd < FD_SETSIZE)
+		FD_SET( fd, &fdWriteSet_ );
+
+	if (fd >= (int)fdWriteHandlers_.size())
+	{
+		fdHandlers_.resize( fd + 1, NULL );
+		fdWriteHandlers_.resize( fd + 1, NULL );
+	}
+#endif
+
 	fdWriteHandlers_[fd] = handler;
 
 	if (fd > fdLargest_) fdLargest_ = fd;
 
 	++fdWriteCount_;
+
+#ifdef MERCURY_HAS_EPOLL
+	this->changeFileDescriptorInterest( fd, FD_INTEREST_WRITE, true );
+#endif
+
 	return true;
 }
 
@@ -3480,15 +4160,21 @@ bool Nub::registerWriteFileDescriptor( int fd,
  */
 bool Nub::deregisterFileDescriptor( int fd )
 {
-#ifndef _WIN32
-	if (fd >= FD_SETSIZE) return false;
-#endif
-
-	if(!FD_ISSET( fd, &fdReadSet_ )) return false;
+	if (!this->isReadFileDescriptor( fd )) return false;
 
+#ifdef _WIN32
 	FD_CLR( fd, &fdReadSet_ );
+#else
+	if (fd < FD_SETSIZE)
+		FD_CLR( fd, &fdReadSet_ );
+#endif
+
 	fdHandlers_[fd] = NULL;
 
+#ifdef MERCURY_HAS_EPOLL
+	this->changeFileDescriptorInterest( fd, FD_INTEREST_READ, false );
+#endif
+
 	if (fd == fdLargest_)
 	{
 		this->findLargestFileDescriptor();
@@ -3507,15 +4193,21 @@ bool Nub::deregisterFileDescriptor( int fd )
  */
 bool Nub::deregisterWriteFileDescriptor( int fd )
 {
-#ifndef _WIN32
-	if (fd >= FD_SETSIZE) return false;
-#endif
-
-	if(!FD_ISSET( fd, &fdWriteSet_ )) return false;
+	if (!this->isWriteFileDescriptor( fd )) return false;
 
+#ifdef _WIN32
 	FD_CLR( fd, &fdWriteSet_ );
+#else
+	if (fd < FD_SETSIZE)
+		FD_CLR( fd, &fdWriteSet_ );
+#endif
+
 	fdWriteHandlers_[fd] = NULL;
 
+#ifdef MERCURY_HAS_EPOLL
+	this->changeFileDescriptorInterest( fd, FD_INTEREST_WRITE, false );
+#endif
+
 	if (fd == fdLargest_)
 	{
 		this->findLargestFileDescriptor();
@@ -3525,6 +4217,420 @@ bool Nub::deregisterWriteFileDescriptor( int fd )
 	return true;
 }
 
+
+/**
+ *	This method returns whether the given file descriptor is registered for
+ *	read notifications.
+ */
+bool Nub::isReadFileDescriptor( int fd ) const
+{
+#ifdef MERCURY_HAS_EPOLL
+	return (fd >= 0) && (fd < (int)fdInterest_.size()) &&
+		(fdInterest_[ fd ] & FD_INTEREST_READ);
+#elif defined( _WIN32 )
+	return FD_ISSET( fd, &fdReadSet_ );
+#else
+	return (fd >= 0) && (fd < FD_SETSIZE) && FD_ISSET( fd, &fdReadSet_ );
+#endif
+}
+
+
+/**
+ *	This method returns whether the given file descriptor is registered for
+ *	write notifications.
+ */
+bool Nub::isWriteFileDescriptor( int fd ) const
+{
+#ifdef MERCURY_HAS_EPOLL
+	return (fd >= 0) && (fd < (int)fdInterest_.size()) &&
+		(fdInterest_[ fd ] & FD_INTEREST_WRITE);
+#elif defined( _WIN32 )
+	return FD_ISSET( fd, &fdWriteSet_ );
+#else
+	return (fd >= 0) && (fd < FD_SETSIZE) && FD_ISSET( fd, &fdWriteSet_ );
+#endif
+}
+
+
+/**
+ *	This method returns whether processContinuously is waiting on epoll rather
+ *	than select.
+ */
+bool Nub::isUsingEpoll() const
+{
+#ifdef MERCURY_HAS_EPOLL
+	return epollFD_ != -1;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ *	This method switches processContinuously between waiting on epoll and
+ *	waiting on select. Registered file descriptors are carried across.
+ *
+ *	Falling back to select fails if a descriptor at or above FD_SETSIZE is
+ *	currently registered.
+ *
+ *	@param value	Whether epoll should be used.
+ *	@return true if the nub is now using the requested backend.
+ */
+bool Nub::shouldUseEpoll( bool value )
+{
+#ifdef MERCURY_HAS_EPOLL
+	if (value == this->isUsingEpoll())
+	{
+		return true;
+	}
+
+	if (value)
+	{
+		// The size argument is only a hint.
+		epollFD_ = epoll_create( FD_SETSIZE );
+
+		if (epollFD_ == -1)
+		{
+			WARNING_MSG( "Nub::shouldUseEpoll: "
+				"epoll_create failed (%s). Using select instead.\n",
+				strerror( errno ) );
+			return false;
+		}
+
+		for (int fd = 0; fd < (int)fdInterest_.size(); ++fd)
+		{
+			if (fdInterest_[ fd ] && !this->applyEpollInterest( fd, 0 ))
+			{
+				::close( epollFD_ );
+				epollFD_ = -1;
+				return false;
+			}
+		}
+	}
+	else
+	{
+		if (fdLargest_ >= FD_SETSIZE)
+		{
+			ERROR_MSG( "Nub::shouldUseEpoll: "
+				"Cannot use select while fd %d >= FD_SETSIZE (%d) "
+				"is registered\n",
+				fdLargest_, FD_SETSIZE );
+			return false;
+		}
+
+		::close( epollFD_ );
+		epollFD_ = -1;
+	}
+
+	return true;
+#else
+	return !value;
+#endif
+}
+
+
+/**
+ *	This method returns whether socket_ is being read by a ReceiveThread.
+ */
+bool Nub::isUsingReceiveThread() const
+{
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	return pReceiveThread_ != NULL;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ *	This method moves the reading of socket_ onto a dedicated thread, or back
+ *	onto the main thread. While the thread is used, processContinuously waits
+ *	on the thread's wake up pipe instead of on socket_, and
+ *	processPendingEvents takes packets from the thread's queue.
+ *
+ *	The thread only reads datagrams. Filtering, checksums, reassembly of
+ *	fragmented bundles and dispatch all still happen in processPendingEvents,
+ *	since they rely on channel state that belongs to the main thread.
+ *
+ *	Server processes start with the thread if networking/useReceiveThread is
+ *	set in bw.xml.
+ *
+ *	@param value	Whether the receive thread should be used.
+ *	@return true if the nub is now doing what was requested.
+ */
+bool Nub::shouldUseReceiveThread( bool value )
+{
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	if (value == this->isUsingReceiveThread())
+	{
+		return true;
+	}
+
+	if (value)
+	{
+		if (!socket_.good())
+		{
+			return false;
+		}
+
+		ReceiveThread * pThread =
+			new ReceiveThread( socket_, RECEIVE_THREAD_CAPACITY );
+
+		if (!pThread->good())
+		{
+			delete pThread;
+			return false;
+		}
+
+		this->deregisterFileDescriptor( socket_ );
+		this->registerFileDescriptor( pThread->fileDescriptor(), NULL );
+		this->moveMasterRegistration( socket_, pThread->fileDescriptor() );
+		pReceiveThread_ = pThread;
+
+		INFO_MSG( "Nub::shouldUseReceiveThread: "
+			"Reading %s on a receive thread\n", this->c_str() );
+	}
+	else
+	{
+		this->deregisterFileDescriptor( pReceiveThread_->fileDescriptor() );
+		this->moveMasterRegistration(
+			pReceiveThread_->fileDescriptor(), socket_ );
+
+		// Anything still queued is discarded. Since it has already left the
+		// kernel buffer, it is as if it were dropped on the wire.
+		delete pReceiveThread_;
+		pReceiveThread_ = NULL;
+
+		if (socket_.good())
+		{
+			this->registerFileDescriptor( socket_, NULL );
+		}
+	}
+
+	return true;
+#else
+	return !value;
+#endif
+}
+
+
+/**
+ *	This method returns the file descriptor that processContinuously should
+ *	wait on for this nub's own packets.
+ */
+int Nub::receiveFileDescriptor() const
+{
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	if (pReceiveThread_)
+	{
+		return pReceiveThread_->fileDescriptor();
+	}
+#endif
+
+	return socket_;
+}
+
+
+/**
+ *	This method moves this nub's registration with its master nub, if it has
+ *	one, from one file descriptor to another. The handler is kept.
+ */
+void Nub::moveMasterRegistration( int oldFD, int newFD )
+{
+	if (!pMasterNub_ || !pMasterNub_->isReadFileDescriptor( oldFD ))
+	{
+		return;
+	}
+
+	InputNotificationHandler * pHandler = pMasterNub_->fdHandlers_[ oldFD ];
+
+	pMasterNub_->deregisterFileDescriptor( oldFD );
+	pMasterNub_->registerFileDescriptor( newFD, pHandler );
+}
+
+
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+/**
+ *	This method is the receive thread equivalent of Packet::recvFromEndpoint.
+ *	It takes the oldest packet that the thread has read and leaves it in
+ *	nextPacket_.
+ *
+ *	@param srcAddr		Set to the address the packet came from, or for an
+ *						error, the address the error was about.
+ *	@param hasOffender	Set to whether srcAddr is valid for an error.
+ *	@return The length of the packet, or -1 with errno set on error. errno is
+ *	EAGAIN if nothing is waiting.
+ */
+int Nub::recvFromReceiveThread( Address & srcAddr, bool & hasOffender )
+{
+	ReceiveThread::Entry entry;
+
+	if (!pReceiveThread_->pop( entry ))
+	{
+		// Clear the wake ups only once the queue looks empty, and then look
+		// again in case the thread added something in between.
+		pReceiveThread_->clearWakeUps();
+
+		if (!pReceiveThread_->pop( entry ))
+		{
+			errno = EAGAIN;
+			return -1;
+		}
+	}
+
+	lastReceiveLatency_ = timestamp() - entry.receiveTime;
+	averageReceiveLatency_ += RECEIVE_LATENCY_AVERAGE_BIAS *
+		(double( lastReceiveLatency_ ) - averageReceiveLatency_);
+
+	srcAddr = entry.srcAddr;
+	hasOffender = entry.hasOffender;
+
+	if (entry.pPacket == NULL)
+	{
+		errno = entry.errorNumber;
+		return entry.length;
+	}
+
+	nextPacket_ = entry.pPacket;
+
+	return entry.length;
+}
+#endif
+
+
+/**
+ *	This method returns the number of packets that the receive thread has
+ *	read but that have not yet been processed.
+ */
+int Nub::receiveQueueDepth() const
+{
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	return pReceiveThread_ ? pReceiveThread_->queueDepth() : 0;
+#else
+	return 0;
+#endif
+}
+
+
+/**
+ *	This method returns the number of packets that the receive thread has
+ *	dropped because its queue was full.
+ */
+uint32 Nub::numReceiveQueueDrops() const
+{
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	return pReceiveThread_ ? pReceiveThread_->numDropped() : 0;
+#else
+	return 0;
+#endif
+}
+
+
+/**
+ *	This method returns how long the last packet from the receive thread
+ *	waited before being processed, in microseconds.
+ */
+double Nub::lastReceiveLatencyUs() const
+{
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	return double( lastReceiveLatency_ ) * 1000000.0 / stampsPerSecondD();
+#else
+	return 0.0;
+#endif
+}
+
+
+/**
+ *	This method returns the moving average of how long packets from the
+ *	receive thread waited before being processed, in microseconds.
+ */
+double Nub::averageReceiveLatencyUs() const
+{
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	return averageReceiveLatency_ * 1000000.0 / stampsPerSecondD();
+#else
+	return 0.0;
+#endif
+}
+
+
+#ifdef MERCURY_HAS_EPOLL
+/**
+ *	This method adds or removes interest in read or write events for a file
+ *	descriptor and updates the epoll registration to match.
+ */
+void Nub::changeFileDescriptorInterest( int fd, uint8 interest,
+		bool isInterested )
+{
+	if (fd >= (int)fdInterest_.size())
+	{
+		fdInterest_.resize( fd + 1, 0 );
+	}
+
+	uint8 oldInterest = fdInterest_[ fd ];
+
+	if (isInterested)
+	{
+		fdInterest_[ fd ] |= interest;
+	}
+	else
+	{
+		fdInterest_[ fd ] &= ~interest;
+	}
+
+	if (epollFD_ != -1)
+	{
+		this->applyEpollInterest( fd, oldInterest );
+	}
+}
+
+
+/**
+ *	This method makes the epoll registration of a file descriptor match its
+ *	entry in fdInterest_.
+ *
+ *	The nub's own socket is registered edge-triggered, since
+ *	processContinuously always drains it before waiting again. Other
+ *	descriptors are level-triggered, as their handlers are written to expect
+ *	select semantics and may not consume all available input.
+ *
+ *	@param fd			The file descriptor.
+ *	@param oldInterest	The interest that is currently registered with epoll.
+ *	@return true on success.
+ */
+bool Nub::applyEpollInterest( int fd, uint8 oldInterest )
+{
+	uint8 newInterest = fdInterest_[ fd ];
+
+	epoll_event event;
+	memset( &event, 0, sizeof( event ) );
+	event.data.fd = fd;
+
+	if (newInterest & FD_INTEREST_READ)
+		event.events |= EPOLLIN;
+
+	if (newInterest & FD_INTEREST_WRITE)
+		event.events |= EPOLLOUT;
+
+	if (fd == (int)socket_)
+		event.events |= EPOLLET;
+
+	int op = (oldInterest == 0) ? EPOLL_CTL_ADD :
+		(newInterest == 0) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+
+	if (epoll_ctl( epollFD_, op, fd, &event ) == -1)
+	{
+		ERROR_MSG( "Nub::applyEpollInterest: "
+				"epoll_ctl failed for fd %d (%s)\n",
+			fd, strerror( errno ) );
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+
 /**
  * 	This method sets a handler that will be called after each successful bundle
  *	has finished being processed.
@@ -3554,8 +4660,8 @@ void Nub::findLargestFileDescriptor()
 
 #else
 	while (fdLargest_ > 0 &&
-		!FD_ISSET( fdLargest_, &fdReadSet_ ) &&
-		!FD_ISSET( fdLargest_, &fdWriteSet_ ))
+		!this->isReadFileDescriptor( fdLargest_ ) &&
+		!this->isWriteFileDescriptor( fdLargest_ ))
 	{
 		fdLargest_--;
 	}
@@ -3568,7 +4674,7 @@ void Nub::findLargestFileDescriptor()
  */
 bool Nub::deregisterChildNub( Nub * pChildNub )
 {
-	this->deregisterFileDescriptor( pChildNub->socket_ );
+	this->deregisterFileDescriptor( pChildNub->receiveFileDescriptor() );
 
 	ChildNubs::iterator iter = std::find(
 		childNubs_.begin(), childNubs_.end(), pChildNub );
@@ -3633,7 +4739,10 @@ bool Nub::registerChildNub( Nub * pChildNub,
 		pHandler = pChildNub;
 	}
 
-	bool ret = this->registerFileDescriptor( pChildNub->socket_, pHandler );
+	// With a receive thread, the child's packets are signalled on the
+	// thread's wake up pipe rather than on its socket.
+	bool ret = this->registerFileDescriptor(
+		pChildNub->receiveFileDescriptor(), pHandler );
 
 	if (ret)
 	{
@@ -3709,6 +4818,14 @@ double Nub::peakCalculator( LastVisitTime idx, const unsigned int & now,
  */
 void Nub::switchSockets( Nub * pOtherNub )
 {
+	// Receive threads are tied to a socket, so they are restarted on the
+	// swapped sockets afterwards.
+	const bool wasUsingReceiveThread = this->isUsingReceiveThread();
+	const bool otherWasUsingReceiveThread = pOtherNub->isUsingReceiveThread();
+
+	this->shouldUseReceiveThread( false );
+	pOtherNub->shouldUseReceiveThread( false );
+
 	int tempFD = (int)socket_;
 	Address tempAddr = advertisedAddress_;
 
@@ -3722,6 +4839,9 @@ void Nub::switchSockets( Nub * pOtherNub )
 
 	pOtherNub->socket_.setFileDescriptor( tempFD );
 	pOtherNub->advertisedAddress_ = tempAddr;
+
+	this->shouldUseReceiveThread( wasUsingReceiveThread );
+	pOtherNub->shouldUseReceiveThread( otherWasUsingReceiveThread );
 }
 
 namespace
@@ -3763,7 +4883,8 @@ bool Nub::handleHijackData( int fd, BinaryIStream & stream )
 	}
 	else
 	{
-		InputNotificationHandler *	pHandler = fdHandlers_[fd];
+		InputNotificationHandler *	pHandler =
+			this->isReadFileDescriptor( fd ) ? fdHandlers_[fd] : NULL;
 
 		if (pHandler)
 		{
@@ -3870,6 +4991,47 @@ WatcherPtr Nub::pWatcher()
 		watchMe->addChild( "misc/largestFD",
 			makeWatcher( pNull->fdLargest_ ) );
 
+		watchMe->addChild( "misc/usingEpoll",
+			makeWatcher( *pNull, &Nub::isUsingEpoll ) );
+
+		watchMe->addChild( "receiveThread/enabled",
+			makeWatcher( *pNull, &Nub::isUsingReceiveThread ) );
+		watchMe->addChild( "receiveThread/queueDepth",
+			makeWatcher( *pNull, &Nub::receiveQueueDepth ) );
+		watchMe->addChild( "receiveThread/numDropped",
+			makeWatcher( *pNull, &Nub::numReceiveQueueDrops ) );
+		watchMe->addChild( "receiveThread/lastLatencyUs",
+			makeWatcher( *pNull, &Nub::lastReceiveLatencyUs ) );
+		watchMe->addChild( "receiveThread/averageLatencyUs",
+			makeWatcher( *pNull, &Nub::averageReceiveLatencyUs ) );
+
+		watchMe->addChild( "timing/poll",
+				makeWatcher( pNull->pollTimer_ ) );
+
+		watchMe->addChild( "batching/recvBatchSize",
+			new MemberWatcher< int, Nub >( *pNull,
+				MF_ACCESSORS( int, Nub, recvBatchSize ) ) );
+		watchMe->addChild( "batching/sendBatchSize",
+			new MemberWatcher< int, Nub >( *pNull,
+				MF_ACCESSORS( int, Nub, sendBatchSize ) ) );
+
+		// Each histogram bucket is labelled with the smallest batch size it
+		// counts. The counts are for the last second.
+		for (int i = 0; i < BATCH_HISTOGRAM_SIZE; ++i)
+		{
+			char name[ 64 ];
+
+			bw_snprintf( name, sizeof( name ),
+				"batching/recvHistogram/%d", 1 << i );
+			watchMe->addChild( name,
+				makeWatcher( pNull->lastRecvBatchHistogram_[i] ) );
+
+			bw_snprintf( name, sizeof( name ),
+				"batching/sendHistogram/%d", 1 << i );
+			watchMe->addChild( name,
+				makeWatcher( pNull->lastSendBatchHistogram_[i] ) );
+		}
+
 		watchMe->addChild( "timing/mercurySend",
 				makeWatcher( pNull->sendMercuryTimer_ ) );
 		watchMe->addChild( "timing/systemSend",
@@ -3888,6 +5050,10 @@ WatcherPtr Nub::pWatcher()
 			makeWatcher( pNull->numCorruptedPacketsReceived_ ) );
 		watchMe->addChild( "totals/corruptedBundlesReceived",
 			makeWatcher( pNull->numCorruptedBundlesReceived_ ) );
+		watchMe->addChild( "totals/selectiveAckPacketsSent",
+			makeWatcher( pNull->numSelectiveAckPacketsSent_ ) );
+		watchMe->addChild( "totals/selectiveAckBytesSaved",
+			makeWatcher( pNull->numSelectiveAckBytesSaved_ ) );
 
 		watchMe->addChild( "totals/bytesSent",
 			makeWatcher( pNull->numBytesSent_ ) );
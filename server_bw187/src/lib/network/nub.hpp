@@ -21,6 +21,7 @@ criminal penalties as provided by law.
 #include "machine_guard.hpp"
 #include "misc.hpp"
 #include "packet.hpp"
+#include "receive_thread.hpp"
 
 #include "cstdmf/timestamp.hpp"
 
@@ -28,6 +29,13 @@ criminal penalties as provided by law.
 #include <map>
 #include <queue>
 #include <set>
+#include <vector>
+
+#ifdef __linux__
+/// Linux builds can wait on epoll rather than select in processContinuously.
+#define MERCURY_HAS_EPOLL
+#include <sys/epoll.h>
+#endif
 
 namespace Mercury
 {
@@ -181,6 +189,12 @@ public:
 	Reason basicSendWithRetries( const Address & addr, Packet * p );
 	Reason basicSendSingleTry( const Address & addr, Packet * p );
 
+	int recvBatchSize() const			{ return recvBatchSize_; }
+	void recvBatchSize( int size );
+	int sendBatchSize() const			{ return sendBatchSize_; }
+	void sendBatchSize( int size );
+	void flushSendQueue();
+
 	void delayedSend( Channel * pChannel );
 
 	TimerID registerTimer( int microseconds, TimerExpiryHandler * handler,
@@ -199,6 +213,12 @@ public:
 	void pBundleEventHandler( BundleEventHandler * handler );
 	void findLargestFileDescriptor();
 
+	bool isUsingEpoll() const;
+	bool shouldUseEpoll( bool value );
+
+	bool isUsingReceiveThread() const;
+	bool shouldUseReceiveThread( bool value );
+
 	bool registerChildNub( Nub * pChildNub,
 		InputNotificationHandler * pHandler = NULL );
 
@@ -328,6 +348,44 @@ private:
 
 	bool rescheduleSend( const Address & addr, Packet * packet, bool isResend );
 
+	Reason sendWithRetries( const Address & addr, Packet * p );
+
+	/// The number of datagrams to receive per system call. Batching is off
+	/// when this is 1.
+	int		recvBatchSize_;
+
+	/// The number of datagrams to queue before sending them with a single
+	/// system call. Batching is off when this is 1.
+	int		sendBatchSize_;
+
+	/// Histograms of the number of datagrams handled per system call when
+	/// batching. Bucket i counts batches with between 2^i and 2^(i+1) - 1
+	/// datagrams. These count the current statistics period, and the last
+	/// ones hold the previous period, which is what the watchers show.
+	static const int BATCH_HISTOGRAM_SIZE = 7;
+	unsigned int recvBatchHistogram_[ BATCH_HISTOGRAM_SIZE ];
+	unsigned int sendBatchHistogram_[ BATCH_HISTOGRAM_SIZE ];
+	unsigned int lastRecvBatchHistogram_[ BATCH_HISTOGRAM_SIZE ];
+	unsigned int lastSendBatchHistogram_[ BATCH_HISTOGRAM_SIZE ];
+
+#ifdef MERCURY_HAS_MMSG
+	int recvFromBatch( Address & srcAddr );
+	void queueSend( const Address & addr, Packet * p );
+
+	/// Packets filled by the last recvmmsg, and their source addresses.
+	/// Entries before recvBatchNext_ hold unused packets ready for the next
+	/// call.
+	PacketPtr	recvBatch_[ Packet::MAX_BATCH_SIZE ];
+	Address		recvBatchAddrs_[ Packet::MAX_BATCH_SIZE ];
+	int			recvBatchNext_;
+	int			recvBatchCount_;
+
+	/// Packets waiting to be sent by flushSendQueue.
+	PacketPtr	sendBatch_[ Packet::MAX_BATCH_SIZE ];
+	Address		sendBatchAddrs_[ Packet::MAX_BATCH_SIZE ];
+	int			sendBatchCount_;
+#endif
+
 	// Of every million packets sent, this many packets will be dropped for
 	// debugging.
 	int		artificialDropPerMillion_;
@@ -425,6 +483,26 @@ private:
 	PacketPtr nextPacket_;
 	Address	advertisedAddress_;
 
+	int receiveFileDescriptor() const;
+	void moveMasterRegistration( int oldFD, int newFD );
+
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+	int recvFromReceiveThread( Address & srcAddr, bool & hasOffender );
+
+	/// The thread that reads socket_, or NULL if the main thread reads it.
+	ReceiveThread *	pReceiveThread_;
+
+	/// How long the last packet, and the average packet, waited between
+	/// being read by the receive thread and being processed, in stamps.
+	uint64	lastReceiveLatency_;
+	double	averageReceiveLatency_;
+#endif
+
+	int receiveQueueDepth() const;
+	uint32 numReceiveQueueDrops() const;
+	double lastReceiveLatencyUs() const;
+	double averageReceiveLatencyUs() const;
+
 public:
 	/**
 	 *  This class represents partially reassembled multi-packet bundles.
@@ -490,17 +568,46 @@ private:
 	std::map<int,InputNotificationHandler*> fdHandlers_;
 	std::map<int,InputNotificationHandler*> fdWriteHandlers_;
 #else
-	// yeah, yeah - 4KB+512B of baggage:
-	InputNotificationHandler *	fdHandlers_[FD_SETSIZE];
-	// May be better with a map?
-	InputNotificationHandler *	fdWriteHandlers_[FD_SETSIZE];
+	// Indexed by file descriptor. These grow on demand, since the epoll
+	// backend is not limited to FD_SETSIZE descriptors.
+	typedef std::vector< InputNotificationHandler * > FDHandlers;
+	FDHandlers					fdHandlers_;
+	FDHandlers					fdWriteHandlers_;
 #endif
 
+	bool isReadFileDescriptor( int fd ) const;
+	bool isWriteFileDescriptor( int fd ) const;
+
 	fd_set						fdReadSet_;
 	fd_set						fdWriteSet_;
 	int							fdLargest_;
 	int							fdWriteCount_;
 
+#ifdef MERCURY_HAS_EPOLL
+	enum
+	{
+		FD_INTEREST_READ = 0x1,
+		FD_INTEREST_WRITE = 0x2
+	};
+
+	void changeFileDescriptorInterest( int fd, uint8 interest,
+		bool isInterested );
+	bool applyEpollInterest( int fd, uint8 oldInterest );
+	void handleEpollNotifications( int countReady, bool & expectPacket );
+
+	/// The events each registered descriptor is interested in, indexed by
+	/// file descriptor. This is kept up to date whichever backend is in use
+	/// so that we can switch between epoll and select at any time.
+	std::vector< uint8 >		fdInterest_;
+
+	/// The epoll instance, or -1 if processContinuously is using select.
+	int							epollFD_;
+
+	/// The most events collected by a single call to epoll_wait.
+	static const int MAX_EPOLL_EVENTS = 256;
+	epoll_event					epollEvents_[ MAX_EPOLL_EVENTS ];
+#endif
+
 	BundleEventHandler *		pBundleEventHandler_;
 
 	PacketMonitor*				pPacketMonitor_;
@@ -663,6 +770,8 @@ private:
 	unsigned int numFailedBundleSend_;
 	unsigned int numCorruptedPacketsReceived_;
 	unsigned int numCorruptedBundlesReceived_;
+	unsigned int numSelectiveAckPacketsSent_;
+	unsigned int numSelectiveAckBytesSaved_;
 
 	mutable unsigned int lastNumBytesSent_;
 	mutable unsigned int lastNumBytesReceived_;
@@ -677,6 +786,7 @@ private:
 	MiniTimer	sendSystemTimer_;
 	MiniTimer	recvMercuryTimer_;
 	MiniTimer	recvSystemTimer_;
+	MiniTimer	pollTimer_;
 
 	uint64		spareTime_,		accSpareTime_;
 	uint64		oldSpareTime_,	totSpareTime_;
@@ -16,6 +16,7 @@ criminal penalties as provided by law.
 
 #include "cstdmf/binary_stream.hpp"
 #include "cstdmf/concurrency.hpp"
+#include "cstdmf/watcher.hpp"
 
 namespace Mercury
 {
@@ -30,7 +31,42 @@ namespace Mercury
 // this to whatever you need.
 const int Packet::MAX_SIZE = 1472;
 
-PoolAllocator<SimpleMutex> Packet::s_allocator_;
+LockFreePoolAllocator Packet::s_allocator_;
+
+namespace
+{
+
+class WatcherIniter
+{
+public:
+	WatcherIniter()
+	{
+		Packet::staticInit();
+	}
+};
+
+WatcherIniter s_watcherIniter_;
+
+} // anonymous namespace
+
+
+/**
+ *  This static method adds watchers for the packet pool.
+ */
+void Packet::staticInit()
+{
+	MF_WATCH( "network/packetPool/allocated", s_allocator_,
+		&LockFreePoolAllocator::totalInstances );
+
+	MF_WATCH( "network/packetPool/live", s_allocator_,
+		&LockFreePoolAllocator::numLive );
+
+	MF_WATCH( "network/packetPool/peak", s_allocator_,
+		&LockFreePoolAllocator::peakLive );
+
+	MF_WATCH( "network/packetPool/recycled", s_allocator_,
+		&LockFreePoolAllocator::numRecycled );
+}
 
 
 /**
@@ -115,6 +151,54 @@ int Packet::recvFromEndpoint( Endpoint & ep, Address & addr )
 }
 
 
+/**
+ *  This method receives up to count datagrams from the endpoint in a single
+ *  system call, setting the length of each packet that is filled.  The return
+ *  value is the number of packets filled, or -1 on error (including when no
+ *  data is waiting).  It must only be called when the endpoint supports
+ *  multiple messages, and count must not exceed MAX_BATCH_SIZE.
+ */
+int Packet::recvBatchFromEndpoint( Endpoint & ep, PacketPtr * pPackets,
+	Address * pAddrs, int count )
+{
+#ifdef MERCURY_HAS_MMSG
+	MF_ASSERT( count <= MAX_BATCH_SIZE );
+
+	mmsghdr messages[ MAX_BATCH_SIZE ];
+	iovec iovecs[ MAX_BATCH_SIZE ];
+	sockaddr_in addrs[ MAX_BATCH_SIZE ];
+
+	memset( messages, 0, sizeof( mmsghdr ) * count );
+
+	for (int i = 0; i < count; ++i)
+	{
+		iovecs[i].iov_base = pPackets[i]->data_;
+		iovecs[i].iov_len = MAX_SIZE;
+
+		messages[i].msg_hdr.msg_iov = &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+		messages[i].msg_hdr.msg_name = &addrs[i];
+		messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+	}
+
+	int numReceived = ep.recvmmsg( messages, count );
+
+	for (int i = 0; i < numReceived; ++i)
+	{
+		pPackets[i]->msgEndOffset( messages[i].msg_len );
+		pAddrs[i].ip = addrs[i].sin_addr.s_addr;
+		pAddrs[i].port = addrs[i].sin_port;
+		pAddrs[i].salt = 0;
+	}
+
+	return numReceived;
+#else
+	MF_ASSERT( !"Packet::recvBatchFromEndpoint: Not supported" );
+	return -1;
+#endif
+}
+
+
 /**
  *  This method writes this packet to the provided stream.  This is used when
  *  offloading entity channels and the buffered and unacked packets need to be
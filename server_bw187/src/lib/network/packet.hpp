@@ -66,12 +66,21 @@ public:
 		FLAG_INDEXED_CHANNEL		= 0x0080,
 		FLAG_HAS_CHECKSUM			= 0x0100,
 		FLAG_CREATE_CHANNEL			= 0x0200,
-		KNOWN_FLAGS					= 0x03FF
+		FLAG_HAS_SACKS				= 0x0400,
+		KNOWN_FLAGS					= 0x07FF
 	};
 
-	/// The type of the ACK counter in the packet footers.
+	/// The type of the ACK counter in the packet footers. With FLAG_HAS_SACKS
+	/// this counts selective ACK blocks rather than ACKs.
 	typedef uint8 AckCount;
 
+	/// The type of the bitmap in a selective ACK block. Bit i acknowledges
+	/// the block's base sequence number plus i + 1.
+	typedef uint32 SackBits;
+
+	/// The size of a selective ACK block in the packet footers.
+	static const int SACK_BLOCK_SIZE = sizeof( SeqNum ) + sizeof( SackBits );
+
 	/// The type of offsets relative to the start of the packet data.
 	typedef uint16 Offset;
 
@@ -85,8 +94,10 @@ private:
 	/// and extraFilterSize_.
 	static const int MAX_SIZE;
 
-	/// Pool from which instances of Packet are drawn.
-	static PoolAllocator<SimpleMutex> s_allocator_;
+	/// Pool from which instances of Packet are drawn.  Packets are built and
+	/// released by worker threads as well as the main thread, so this must be
+	/// thread-safe.  Memory is recycled as soon as the last PacketPtr drops.
+	static LockFreePoolAllocator s_allocator_;
 
 public:
 	///	The size of the header on a packet.
@@ -102,7 +113,7 @@ public:
 	/// there's not too much wastage.
 	static const int RESERVED_FOOTER_SIZE =
 		sizeof( Offset ) + // FLAG_HAS_REQUESTS
-		sizeof( AckCount ) + // FLAG_HAS_ACKS
+		sizeof( AckCount ) + // FLAG_HAS_ACKS or FLAG_HAS_SACKS
 		sizeof( SeqNum ) + // FLAG_HAS_SEQUENCE_NUMBER
 		sizeof( SeqNum ) * 2 + // FLAG_IS_FRAGMENT
 		sizeof( ChannelID ) + sizeof( ChannelVersion ) + // FLAG_INDEXED_CHANNEL
@@ -331,6 +342,12 @@ public:
 
 	int recvFromEndpoint( Endpoint & ep, Address & addr );
 
+	/// The most packets that recvBatchFromEndpoint will fill in one call.
+	static const int MAX_BATCH_SIZE = 64;
+
+	static int recvBatchFromEndpoint( Endpoint & ep, PacketPtr * pPackets,
+		Address * pAddrs, int count );
+
 	// -------------------------------------------------------------------------
 	// Section: Static methods
 	// -------------------------------------------------------------------------
@@ -353,6 +370,8 @@ public:
 
 	static PacketPtr createFromStream( BinaryIStream & data, int state );
 
+	static void staticInit();
+
 	/**
 	 *  This method returns the maximum possible body size for a single packet.
 	 *  It does not take into account packetFilter reservations or footers, so
@@ -13,6 +13,9 @@ criminal penalties as provided by law.
 
 #include "public_key_cipher.hpp"
 
+#include "cstdmf/concurrency.hpp"
+
+#include "openssl/crypto.h"
 #include "openssl/err.h"
 #include "openssl/rand.h"
 
@@ -22,6 +25,37 @@ criminal penalties as provided by law.
 #define	RSA_PADDING	41	
 
 
+namespace
+{
+/// The locks that OpenSSL asks for through lockingCallback, once
+/// PublicKeyCipher::initThreading has been called.
+SimpleMutex * s_pOpenSSLLocks = NULL;
+
+/**
+ *	This function is OpenSSL's locking callback.
+ */
+void lockingCallback( int mode, int type, const char * file, int line )
+{
+	if (mode & CRYPTO_LOCK)
+	{
+		s_pOpenSSLLocks[ type ].grab();
+	}
+	else
+	{
+		s_pOpenSSLLocks[ type ].give();
+	}
+}
+
+/**
+ *	This function is OpenSSL's thread id callback.
+ */
+unsigned long idCallback()
+{
+	return OurThreadID();
+}
+}
+
+
 namespace Mercury
 {
 
@@ -29,6 +63,25 @@ namespace Mercury
 // Section: PublicKeyCipher
 // -----------------------------------------------------------------------------
 
+/**
+ *	This method sets up OpenSSL to be used from more than one thread at once.
+ *	OpenSSL 0.9.8 does no locking of its own, so this must be called before
+ *	a second thread uses it. The locks last for the life of the process.
+ */
+void PublicKeyCipher::initThreading()
+{
+	if (s_pOpenSSLLocks != NULL)
+	{
+		return;
+	}
+
+	s_pOpenSSLLocks = new SimpleMutex[ CRYPTO_num_locks() ];
+
+	CRYPTO_set_id_callback( &idCallback );
+	CRYPTO_set_locking_callback( &lockingCallback );
+}
+
+
 /**
  *  Sets the key to be used by this object.
  */
@@ -96,6 +96,8 @@ public:
 
 	const char * err_str() const;
 
+	static void initThreading();
+
 protected:
 	void cleanup();
 	void setReadableKey();
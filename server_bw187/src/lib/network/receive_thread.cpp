@@ -0,0 +1,328 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "pch.hpp"
+
+#include "receive_thread.hpp"
+
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+
+#include "endpoint.hpp"
+#include "packet.hpp"
+
+#include "cstdmf/debug.hpp"
+#include "cstdmf/timestamp.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+DECLARE_DEBUG_COMPONENT2( "Network", 0 )
+
+namespace Mercury
+{
+
+namespace
+{
+/// How long the thread waits on the socket before checking whether it has
+/// been asked to stop.
+const int POLL_TIMEOUT_MS = 100;
+
+/**
+ *	This function returns the smallest power of two that is at least value.
+ */
+int roundUpToPowerOfTwo( int value )
+{
+	int result = 1;
+
+	while (result < value)
+	{
+		result <<= 1;
+	}
+
+	return result;
+}
+}
+
+
+/**
+ *	Constructor. The thread starts reading from the socket straight away.
+ *
+ *	@param socket	The socket to read. It must be non-blocking and must not be
+ *					read by anything else while this object exists.
+ *	@param capacity	The number of packets that can be waiting for the main
+ *					thread. Packets that arrive while the ring is full are
+ *					dropped.
+ */
+ReceiveThread::ReceiveThread( Endpoint & socket, int capacity ) :
+	socket_( socket ),
+	capacity_( roundUpToPowerOfTwo( std::max( capacity, 2 ) ) ),
+	entries_( new Entry[ capacity_ ] ),
+	head_( 0 ),
+	tail_( 0 ),
+	numDropped_( 0 ),
+	isStopping_( false ),
+	pThread_( NULL )
+{
+	wakePipe_[0] = wakePipe_[1] = -1;
+
+	if (pipe( wakePipe_ ) == -1)
+	{
+		ERROR_MSG( "ReceiveThread::ReceiveThread: "
+			"Could not create wake up pipe: %s\n", strerror( errno ) );
+		wakePipe_[0] = wakePipe_[1] = -1;
+		return;
+	}
+
+	fcntl( wakePipe_[0], F_SETFL, O_NONBLOCK );
+	fcntl( wakePipe_[1], F_SETFL, O_NONBLOCK );
+
+	pThread_ = new SimpleThread( &ReceiveThread::s_run, this );
+}
+
+
+/**
+ *	Destructor. This stops the thread and discards any packets that the main
+ *	thread has not collected.
+ */
+ReceiveThread::~ReceiveThread()
+{
+	isStopping_ = true;
+
+	// This joins the thread.
+	delete pThread_;
+	pThread_ = NULL;
+
+	Entry entry;
+
+	while (this->pop( entry ))
+	{
+		delete entry.pPacket;
+	}
+
+	delete [] entries_;
+
+	if (wakePipe_[0] != -1)
+	{
+		close( wakePipe_[0] );
+		close( wakePipe_[1] );
+	}
+}
+
+
+/**
+ *	This method takes the oldest entry off the ring. It must only be called
+ *	from the main thread.
+ *
+ *	@return	false if the ring is empty.
+ */
+bool ReceiveThread::pop( Entry & entry )
+{
+	if (head_ == tail_)
+	{
+		return false;
+	}
+
+	// Make sure the entry is not read before tail_ is.
+	__sync_synchronize();
+
+	entry = entries_[ head_ & (capacity_ - 1) ];
+
+	// Make sure the entry has been copied out before the slot is handed back.
+	__sync_synchronize();
+
+	++head_;
+
+	return true;
+}
+
+
+/**
+ *	This method empties the wake up pipe. The main thread should call this
+ *	once the ring is empty, and then check the ring once more.
+ */
+void ReceiveThread::clearWakeUps()
+{
+	char buf[ 64 ];
+
+	while (read( wakePipe_[0], buf, sizeof( buf ) ) > 0)
+	{
+		; // Just drain it
+	}
+}
+
+
+/**
+ *	This method returns the number of entries waiting for the main thread.
+ */
+int ReceiveThread::queueDepth() const
+{
+	return int( tail_ - head_ );
+}
+
+
+/**
+ *	This method adds an entry to the ring. It must only be called from the
+ *	receive thread.
+ *
+ *	@return	false if the ring is full.
+ */
+bool ReceiveThread::push( const Entry & entry )
+{
+	if (tail_ - head_ >= uint32( capacity_ ))
+	{
+		return false;
+	}
+
+	entries_[ tail_ & (capacity_ - 1) ] = entry;
+
+	// Make sure the entry is written before the main thread can see it.
+	__sync_synchronize();
+
+	++tail_;
+
+	return true;
+}
+
+
+/**
+ *	This method tells the main thread that there is something in the ring.
+ */
+void ReceiveThread::wakeUp()
+{
+	char c = 0;
+
+	// If the pipe is full, the main thread already has a wake up pending.
+	if (write( wakePipe_[1], &c, 1 ) == -1 && errno != EAGAIN)
+	{
+		WARNING_MSG( "ReceiveThread::wakeUp: write failed: %s\n",
+			strerror( errno ) );
+	}
+}
+
+
+/**
+ *	This static method is the entry point of the receive thread.
+ */
+void ReceiveThread::s_run( void * arg )
+{
+	static_cast< ReceiveThread * >( arg )->run();
+}
+
+
+/**
+ *	This method is the body of the receive thread.
+ */
+void ReceiveThread::run()
+{
+	pollfd pfd;
+	pfd.fd = socket_;
+	pfd.events = POLLIN;
+
+	while (!isStopping_)
+	{
+		pfd.revents = 0;
+
+		int countReady = poll( &pfd, 1, POLL_TIMEOUT_MS );
+
+		if (pfd.revents & POLLNVAL)
+		{
+			// The socket was closed under us. The nub should have stopped
+			// this thread first.
+			ERROR_MSG( "ReceiveThread::run: Socket is no longer valid\n" );
+			break;
+		}
+
+		if (countReady > 0)
+		{
+			this->receiveAll();
+		}
+		else if (countReady == -1 && errno != EINTR)
+		{
+			WARNING_MSG( "ReceiveThread::run: poll failed: %s\n",
+				strerror( errno ) );
+		}
+	}
+}
+
+
+/**
+ *	This method reads from the socket until it is dry, and then wakes the
+ *	main thread if anything was added to the ring.
+ */
+void ReceiveThread::receiveAll()
+{
+	bool hasAdded = false;
+	Packet * pPacket = NULL;
+
+	while (!isStopping_)
+	{
+		if (pPacket == NULL)
+		{
+			pPacket = new Packet();
+		}
+
+		Entry entry;
+		entry.length = pPacket->recvFromEndpoint( socket_, entry.srcAddr );
+		entry.errorNumber = (entry.length > 0) ? 0 : errno;
+		entry.pPacket = (entry.length > 0) ? pPacket : NULL;
+		entry.hasOffender = false;
+		entry.receiveTime = timestamp();
+
+		if (entry.length == -1 && entry.errorNumber == EAGAIN)
+		{
+			break;
+		}
+
+		// Collect the offending address while the error is still queued on
+		// the socket.
+		if (entry.errorNumber == ECONNREFUSED ||
+			entry.errorNumber == EHOSTUNREACH)
+		{
+			entry.hasOffender = socket_.getClosedPort( entry.srcAddr );
+		}
+
+		if (this->push( entry ))
+		{
+			hasAdded = true;
+
+			if (entry.pPacket)
+			{
+				pPacket = NULL;
+			}
+		}
+		else
+		{
+			// The packet is reused for the next read.
+			++numDropped_;
+		}
+
+		// Report at most one error per wake up, in case it persists.
+		if (entry.length <= 0)
+		{
+			break;
+		}
+	}
+
+	delete pPacket;
+
+	if (hasAdded)
+	{
+		this->wakeUp();
+	}
+}
+
+} // namespace Mercury
+
+#endif // MERCURY_HAS_RECEIVE_THREAD
+
+// receive_thread.cpp
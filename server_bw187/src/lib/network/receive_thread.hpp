@@ -0,0 +1,112 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef RECEIVE_THREAD_HPP
+#define RECEIVE_THREAD_HPP
+
+#ifndef _WIN32
+/// Unix builds can read a nub's socket on a dedicated thread.
+#define MERCURY_HAS_RECEIVE_THREAD
+#endif
+
+#ifdef MERCURY_HAS_RECEIVE_THREAD
+
+#include "basictypes.hpp"
+
+#include "cstdmf/concurrency.hpp"
+
+class Endpoint;
+
+namespace Mercury
+{
+
+class Packet;
+
+/**
+ *	This class reads datagrams from a nub's socket on its own thread, so that
+ *	the kernel's receive buffer keeps being emptied while the main thread is
+ *	busy with a game tick.
+ *
+ *	Received packets are handed to the main thread through a fixed size,
+ *	single producer, single consumer ring. Each time the thread adds to the
+ *	ring it writes a byte to a pipe, so the main thread waits on the read end
+ *	of that pipe (see fileDescriptor) instead of on the socket itself.
+ *
+ *	Only the datagrams are moved to this thread. Packets are still filtered,
+ *	checksummed, reassembled and dispatched by the nub on the main thread,
+ *	since that depends on channel state that is not safe to share.
+ */
+class ReceiveThread
+{
+public:
+	/**
+	 *	This structure is an entry in the ring. If pPacket is NULL, the entry
+	 *	reports a receive error instead. errorNumber then holds errno and, if
+	 *	hasOffender is set, srcAddr holds the address that the error was
+	 *	about.
+	 */
+	struct Entry
+	{
+		Packet *	pPacket;
+		Address		srcAddr;
+		int			length;
+		int			errorNumber;
+		bool		hasOffender;
+		uint64		receiveTime;
+	};
+
+	ReceiveThread( Endpoint & socket, int capacity );
+	~ReceiveThread();
+
+	bool good() const				{ return pThread_ != NULL; }
+
+	bool pop( Entry & entry );
+	void clearWakeUps();
+
+	int fileDescriptor() const		{ return wakePipe_[0]; }
+
+	int queueDepth() const;
+	int capacity() const			{ return capacity_; }
+	uint32 numDropped() const		{ return numDropped_; }
+
+private:
+	static void s_run( void * arg );
+	void run();
+
+	void receiveAll();
+	bool push( const Entry & entry );
+	void wakeUp();
+
+	Endpoint &			socket_;
+
+	/// The number of entries in the ring. This is a power of two, so that
+	/// head_ and tail_ can be masked into an index even after they wrap.
+	const int			capacity_;
+	Entry *				entries_;
+
+	/// The count of entries read. Only the main thread changes this.
+	volatile uint32		head_;
+
+	/// The count of entries written. Only the receive thread changes this.
+	volatile uint32		tail_;
+
+	volatile uint32		numDropped_;
+	volatile bool		isStopping_;
+
+	int					wakePipe_[2];
+	SimpleThread *		pThread_;
+};
+
+} // namespace Mercury
+
+#endif // MERCURY_HAS_RECEIVE_THREAD
+
+#endif // RECEIVE_THREAD_HPP
@@ -142,6 +142,9 @@ public:
 	const State*		first();
 	const State*		next();
 
+	/// This method returns the number of states expanded by the last search.
+	int					numExpanded() const		{ return numExpanded_; }
+
 	// quick hack to detect this.
 	bool infiniteLoopProblem;
 
@@ -302,6 +305,7 @@ private:
 
 	IntState* 	iter_;
 	IntState* 	start_;
+	int			numExpanded_;
 	AStarSet 	set_;
 	AStarQueue 	open_;
 };
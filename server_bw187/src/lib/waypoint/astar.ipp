@@ -21,6 +21,7 @@ template<class State, class GoalState>
 AStar<State, GoalState>::AStar() :
 	iter_(NULL),
 	start_(NULL),
+	numExpanded_(0),
 	open_( cmp_f(), AStarVector( buffer_ ) )
 {
 }
@@ -103,6 +104,7 @@ bool AStar<State, GoalState>::search(const State& start, const GoalState& goal,
 	open_.push(pCurrent);
 
 	this->infiniteLoopProblem = false;
+	numExpanded_ = 0;
 	
 	while(!open_.empty())
 	{
@@ -119,6 +121,7 @@ bool AStar<State, GoalState>::search(const State& start, const GoalState& goal,
 		
 		pCurrent = open_.top();
 		open_.pop();
+		++numExpanded_;
 
 		//DEBUG_MSG( "pop pCurrent->f %f open size %d\n", pCurrent->f, open_.size() );
 
@@ -0,0 +1,124 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#include "pch.hpp"
+
+#include "astar_arena.hpp"
+
+#include "cstdmf/concurrency.hpp"
+#include "cstdmf/debug.hpp"
+
+DECLARE_DEBUG_COMPONENT2( "Waypoint", 0 )
+
+/// The arena of each thread, created when the thread first searches.
+static THREADLOCAL( AStarArena * ) s_pThreadArena( NULL );
+
+
+/**
+ *	Constructor.
+ */
+AStarArena::AStarArena() :
+	blocks_(),
+	blockIndex_( 0 ),
+	offset_( 0 ),
+	numBytes_( 0 )
+{
+}
+
+
+/**
+ *	Destructor.
+ */
+AStarArena::~AStarArena()
+{
+	for (Blocks::iterator iter = blocks_.begin(); iter != blocks_.end(); ++iter)
+	{
+		delete [] iter->pData;
+	}
+}
+
+
+/**
+ *	This method allocates the given number of bytes. The memory is aligned
+ *	for any type that a search state is likely to hold.
+ */
+void * AStarArena::allocate( size_t size )
+{
+	size = (size + ALIGNMENT - 1) & ~size_t( ALIGNMENT - 1 );
+
+	while ((blockIndex_ < blocks_.size()) &&
+			(offset_ + size > blocks_[ blockIndex_ ].size))
+	{
+		++blockIndex_;
+		offset_ = 0;
+	}
+
+	if (blockIndex_ == blocks_.size())
+	{
+		Block block;
+		block.size = std::max( size_t( BLOCK_SIZE ), size );
+		block.pData = new char[ block.size ];
+
+		blocks_.push_back( block );
+		numBytes_ += block.size;
+		offset_ = 0;
+	}
+
+	void * pData = blocks_[ blockIndex_ ].pData + offset_;
+	offset_ += size;
+
+	return pData;
+}
+
+
+/**
+ *	This method returns the current position in the arena.
+ */
+AStarArena::Mark AStarArena::mark() const
+{
+	Mark mark;
+	mark.blockIndex = blockIndex_;
+	mark.offset = offset_;
+	return mark;
+}
+
+
+/**
+ *	This method frees everything allocated since the given mark was taken.
+ *	The blocks are kept for the next search.
+ */
+void AStarArena::release( const Mark & mark )
+{
+	MF_ASSERT( (mark.blockIndex < blockIndex_) ||
+		((mark.blockIndex == blockIndex_) && (mark.offset <= offset_)) );
+
+	blockIndex_ = mark.blockIndex;
+	offset_ = mark.offset;
+}
+
+
+/**
+ *	This static method returns the arena of the calling thread.
+ */
+AStarArena & AStarArena::threadInstance()
+{
+	AStarArena * pArena = s_pThreadArena;
+
+	if (pArena == NULL)
+	{
+		pArena = new AStarArena();
+		s_pThreadArena = pArena;
+	}
+
+	return *pArena;
+}
+
+// astar_arena.cpp
@@ -0,0 +1,78 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef ASTAR_ARENA_HPP
+#define ASTAR_ARENA_HPP
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ *	This class is the memory that IndexedAStar searches allocate from. Memory
+ *	is handed out from large blocks by bumping an offset, and is only freed
+ *	all at once, by rolling the offset back to a mark. The blocks are kept,
+ *	so once a thread has done its largest search it does not allocate again.
+ *
+ *	Searches may be nested, as long as each releases its memory before the
+ *	search that started before it does.
+ */
+class AStarArena
+{
+public:
+	/**
+	 *	This structure records a position in the arena to release back to.
+	 */
+	struct Mark
+	{
+		size_t	blockIndex;
+		size_t	offset;
+	};
+
+	AStarArena();
+	~AStarArena();
+
+	void * allocate( size_t size );
+
+	Mark mark() const;
+	void release( const Mark & mark );
+
+	size_t numBytes() const		{ return numBytes_; }
+
+	static AStarArena & threadInstance();
+
+private:
+	AStarArena( const AStarArena & );
+	AStarArena & operator=( const AStarArena & );
+
+	/**
+	 *	This structure is a block of memory owned by the arena.
+	 */
+	struct Block
+	{
+		char *	pData;
+		size_t	size;
+	};
+
+	enum
+	{
+		BLOCK_SIZE = 256 * 1024,
+		ALIGNMENT = 16
+	};
+
+	typedef std::vector< Block > Blocks;
+
+	Blocks	blocks_;
+	size_t	blockIndex_;
+	size_t	offset_;
+	size_t	numBytes_;
+};
+
+#endif // ASTAR_ARENA_HPP
@@ -12,6 +12,7 @@ criminal penalties as provided by law.
 #include "pch.hpp"
 
 #include "chunk_waypoint_set.hpp"
+#include "navigator.hpp"
 #include "chunk/chunk_space.hpp"
 
 #include "waypoint/waypoint.hpp"
@@ -722,6 +723,8 @@ void ChunkWaypointSet::toss( Chunk * pChunk )
 		// Note: program flow arrives here when pChunk_ is
 		// being ejected (with pChunk = NULL)
 
+		Navigator::invalidatePathCache( pChunk_->space() );
+
 		//this->toWorldCoords();
 		this->removeOthersConnections();
 		this->removeOurConnections();
@@ -742,6 +745,8 @@ void ChunkWaypointSet::toss( Chunk * pChunk )
 
 		//this->toLocalCoords() // ... now already there
 
+		Navigator::invalidatePathCache( pChunk_->space() );
+
 		// now that we are in local co-ords we can add ourselves to the
 		// cache maintained by ChunkNavigator
 		ChunkNavigator::instance( *pChunk_ ).add( this );
@@ -759,6 +764,9 @@ void ChunkWaypointSet::bind()
 	// so we have to delay this until the set we are connected to is tossed
 	// out of its chunk.
 
+	// new connections may give shorter paths than those already shared
+	Navigator::invalidatePathCache( pChunk_->space() );
+
 	// now make new connections
 	ChunkWaypoints::iterator wit;
 	ChunkWaypoint::Edges::iterator eit;
@@ -0,0 +1,111 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+#ifndef INDEXED_ASTAR_HPP
+#define INDEXED_ASTAR_HPP
+
+#include "astar_arena.hpp"
+
+#include "cstdmf/debug.hpp"
+
+/**
+ *	This class implements an A* search over the same states as AStar, and
+ *	finds the same paths. It differs in how it stores the search:
+ *
+ *	- The open states are kept in a 4-ary heap. Each state knows its index in
+ *	  the heap, so a state that is reached again more cheaply has its cost
+ *	  lowered in place instead of being pushed a second time.
+ *	- Each state is found from its hash in an open addressing table.
+ *	- The states, the heap and the table are all allocated from an
+ *	  AStarArena, which by default is the one of the calling thread. All of
+ *	  it is freed at once when the search object is destroyed.
+ *
+ *	The State must provide the interface described for AStar, including
+ *	hash().
+ */
+template <class State, class GoalState = State> class IndexedAStar
+{
+public:
+	typedef State TState;
+	typedef GoalState TGoalState;
+
+	IndexedAStar( AStarArena & arena = AStarArena::threadInstance() );
+	~IndexedAStar();
+
+	bool				search( const State & start, const GoalState & goal,
+							float maxDistance );
+	const State *		first();
+	const State *		next();
+
+	/// This method returns the number of states expanded by the last search.
+	int					numExpanded() const		{ return numExpanded_; }
+
+	bool infiniteLoopProblem;
+
+private:
+	IndexedAStar( const IndexedAStar & );
+	IndexedAStar & operator=( const IndexedAStar & );
+
+	/**
+	 *	This structure is a state of the search.
+	 */
+	struct Node
+	{
+		State		ext;		///< User defined state
+		float		g;			///< Cost to get here from start
+		float		f;			///< g + estimated cost from here to goal
+		Node *		pParent;	///< The state before us in the search
+		Node *		pChild;		///< The state after us in the path found
+		int			heapIndex;	///< Index in the open heap, or CLOSED
+	};
+
+	enum
+	{
+		CLOSED = -1,
+		HEAP_ARITY = 4,
+		MAX_OPEN = 9999,
+		MAX_PATH_LENGTH = 10000,
+		INITIAL_TABLE_BITS = 8,
+		INITIAL_HEAP_CAPACITY = 64
+	};
+
+	Node *		newNode( const State & ext );
+	unsigned	slot( const State & ext ) const;
+	Node *		find( const State & ext ) const;
+	void		insert( Node * pNode );
+	void		growTable();
+
+	void		push( Node * pNode );
+	Node *		pop();
+	void		siftUp( int index );
+	void		siftDown( int index );
+
+	void		destroyNodes();
+
+	AStarArena &		arena_;
+	AStarArena::Mark	mark_;
+
+	Node **		pTable_;
+	int			tableBits_;
+	int			numNodes_;
+
+	Node **		pHeap_;
+	int			heapSize_;
+	int			heapCapacity_;
+
+	Node *		start_;
+	Node *		iter_;
+	int			numExpanded_;
+};
+
+#include "indexed_astar.ipp"
+
+#endif // INDEXED_ASTAR_HPP
@@ -0,0 +1,517 @@
+/******************************************************************************
+BigWorld Technology
+Copyright BigWorld Pty, Ltd.
+All Rights Reserved. Commercial in confidence.
+
+WARNING: This computer program is protected by copyright law and international
+treaties. Unauthorized use, reproduction or distribution of this program, or
+any portion of this program, may result in the imposition of civil and
+criminal penalties as provided by law.
+******************************************************************************/
+
+/**
+ *	This file contains the implementation of the IndexedAStar class.
+ */
+
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+
+/**
+ *	Constructor. Nothing is allocated from the arena until a search is done.
+ */
+template <class State, class GoalState>
+IndexedAStar<State, GoalState>::IndexedAStar( AStarArena & arena ) :
+	infiniteLoopProblem( false ),
+	arena_( arena ),
+	mark_( arena.mark() ),
+	pTable_( NULL ),
+	tableBits_( 0 ),
+	numNodes_( 0 ),
+	pHeap_( NULL ),
+	heapSize_( 0 ),
+	heapCapacity_( 0 ),
+	start_( NULL ),
+	iter_( NULL ),
+	numExpanded_( 0 )
+{
+}
+
+
+/**
+ *	Destructor. This releases everything that was allocated from the arena.
+ */
+template <class State, class GoalState>
+IndexedAStar<State, GoalState>::~IndexedAStar()
+{
+	this->destroyNodes();
+	arena_.release( mark_ );
+}
+
+
+/**
+ *	This method performs an A* search.
+ *
+ *	@param start	This is the initial state of the search.
+ *	@param goal		This is the goal state
+ *	@param maxDistance		This is max distance to search
+ *							(-1. means no limit)
+ *
+ *	@return	True if successful.
+ */
+template <class State, class GoalState>
+bool IndexedAStar<State, GoalState>::search( const State & start,
+	const GoalState & goal, float maxDistance )
+{
+	// Forget any earlier search.
+	this->destroyNodes();
+	arena_.release( mark_ );
+
+	pTable_ = NULL;
+	tableBits_ = 0;
+	pHeap_ = NULL;
+	heapSize_ = 0;
+	heapCapacity_ = 0;
+	iter_ = NULL;
+
+	this->infiniteLoopProblem = false;
+	numExpanded_ = 0;
+
+	bool checkMaxDist = maxDistance > 0.f;
+
+	start_ = this->newNode( start );
+	start_->g = 0.f;
+	start_->f = start.distanceToGoal( goal );
+	start_->pParent = NULL;
+
+	this->insert( start_ );
+	this->push( start_ );
+
+	State adjacent;
+
+	while (heapSize_ > 0)
+	{
+		if (heapSize_ > MAX_OPEN)
+		{
+			ERROR_MSG( "IndexedAStar::search: Too many open states!\n" );
+			this->infiniteLoopProblem = true;
+			return false;
+		}
+
+		Node * pCurrent = this->pop();
+		++numExpanded_;
+
+		// If it satisfies the goal requirements, we are done. Walk
+		// backwards and construct the path.
+
+		if (pCurrent->ext.isGoal( goal ))
+		{
+			int safetyCount = 0;
+
+			while (pCurrent->pParent && (++safetyCount < MAX_PATH_LENGTH))
+			{
+				pCurrent->pParent->pChild = pCurrent;
+				pCurrent = pCurrent->pParent;
+			}
+
+			if (safetyCount < MAX_PATH_LENGTH)
+			{
+				return true;
+			}
+
+			ERROR_MSG( "IndexedAStar::search: Entered infinite loop!\n" );
+			this->infiniteLoopProblem = true;
+			return false;
+		}
+
+		typename State::adjacency_iterator adjIter =
+			pCurrent->ext.adjacenciesBegin();
+
+		for (; adjIter != pCurrent->ext.adjacenciesEnd(); ++adjIter)
+		{
+			if (!pCurrent->ext.getAdjacency( adjIter, adjacent, goal ))
+			{
+				continue;
+			}
+
+			// Don't return to the start state. This would cause a loop in
+			// the path.
+
+			if (adjacent.compare( start_->ext ) == 0)
+			{
+				continue;
+			}
+
+			if (checkMaxDist &&
+				(adjacent.distanceToGoal( start ) > maxDistance))
+			{
+				continue;
+			}
+
+			float g = pCurrent->g + adjacent.distanceFromParent();
+			float f = g + adjacent.distanceToGoal( goal );
+
+			Node * pAdjacency = this->find( adjacent );
+
+			if (pAdjacency == NULL)
+			{
+				pAdjacency = this->newNode( adjacent );
+				pAdjacency->g = g;
+				pAdjacency->f = f;
+				pAdjacency->pParent = pCurrent;
+
+				this->insert( pAdjacency );
+				this->push( pAdjacency );
+				continue;
+			}
+
+			// If we have already reached this state more cheaply, forget
+			// about it this time.
+
+			if (pAdjacency->f <= f)
+			{
+				continue;
+			}
+
+			// Don't make a state the child of its own descendant.
+
+			Node * pAncestor = pCurrent;
+
+			while (pAncestor && (pAncestor != pAdjacency))
+			{
+				pAncestor = pAncestor->pParent;
+			}
+
+			if (pAncestor)
+			{
+				continue;
+			}
+
+			pAdjacency->ext = adjacent;
+			pAdjacency->g = g;
+			pAdjacency->f = f;
+			pAdjacency->pParent = pCurrent;
+
+			if (pAdjacency->heapIndex == CLOSED)
+			{
+				this->push( pAdjacency );
+			}
+			else
+			{
+				this->siftUp( pAdjacency->heapIndex );
+			}
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ *	If the search was successful, this method is used to find the first
+ *	state in the search result. It will always be the same as the start
+ *	state that was passed in.
+ *
+ *	@return First state in the search.
+ */
+template <class State, class GoalState>
+const State * IndexedAStar<State, GoalState>::first()
+{
+	iter_ = start_;
+	return iter_ ? &iter_->ext : NULL;
+}
+
+
+/**
+ *	This method should be called repeatedly to find subsequent states in
+ *	the search result. If will return NULL if there are no more states.
+ *
+ *	@return Next state in the search, or NULL if complete.
+ */
+template <class State, class GoalState>
+const State * IndexedAStar<State, GoalState>::next()
+{
+	if (iter_)
+	{
+		iter_ = iter_->pChild;
+	}
+
+	return iter_ ? &iter_->ext : NULL;
+}
+
+
+/**
+ *	This method creates a new node from the arena.
+ */
+template <class State, class GoalState>
+typename IndexedAStar<State, GoalState>::Node *
+	IndexedAStar<State, GoalState>::newNode( const State & ext )
+{
+	Node * pNode = new (arena_.allocate( sizeof( Node ) )) Node;
+
+	pNode->ext = ext;
+	pNode->pParent = NULL;
+	pNode->pChild = NULL;
+	pNode->heapIndex = CLOSED;
+
+	return pNode;
+}
+
+
+/**
+ *	This method returns the slot in the table where the search for the given
+ *	state starts.
+ */
+template <class State, class GoalState>
+inline unsigned IndexedAStar<State, GoalState>::slot( const State & ext ) const
+{
+	// Fibonacci hashing, so that states with similar hashes are spread out.
+	// This relies on unsigned being 32 bits.
+	return (unsigned( ext.hash() ) * 2654435769U) >> (32 - tableBits_);
+}
+
+
+/**
+ *	This method returns the node of the given state, or NULL if the state has
+ *	not been reached.
+ */
+template <class State, class GoalState>
+typename IndexedAStar<State, GoalState>::Node *
+	IndexedAStar<State, GoalState>::find( const State & ext ) const
+{
+	if (pTable_ == NULL)
+	{
+		return NULL;
+	}
+
+	unsigned mask = (1U << tableBits_) - 1;
+
+	for (unsigned i = this->slot( ext ); pTable_[ i ] != NULL;
+			i = (i + 1) & mask)
+	{
+		if (pTable_[ i ]->ext.compare( ext ) == 0)
+		{
+			return pTable_[ i ];
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+ *	This method adds a node to the table. Its state must not already be in
+ *	the table.
+ */
+template <class State, class GoalState>
+void IndexedAStar<State, GoalState>::insert( Node * pNode )
+{
+	// Keep the table at most half full, so that probes stay short.
+	if ((pTable_ == NULL) || (2 * (numNodes_ + 1) > (1 << tableBits_)))
+	{
+		this->growTable();
+	}
+
+	unsigned mask = (1U << tableBits_) - 1;
+	unsigned i = this->slot( pNode->ext );
+
+	while (pTable_[ i ] != NULL)
+	{
+		i = (i + 1) & mask;
+	}
+
+	pTable_[ i ] = pNode;
+	++numNodes_;
+}
+
+
+/**
+ *	This method doubles the size of the table. The old table is left in the
+ *	arena until the search is released.
+ */
+template <class State, class GoalState>
+void IndexedAStar<State, GoalState>::growTable()
+{
+	Node ** pOldTable = pTable_;
+	int oldSize = pOldTable ? (1 << tableBits_) : 0;
+
+	tableBits_ = pOldTable ? (tableBits_ + 1) : int( INITIAL_TABLE_BITS );
+
+	int size = 1 << tableBits_;
+	pTable_ = static_cast< Node ** >(
+		arena_.allocate( size * sizeof( Node * ) ) );
+	memset( pTable_, 0, size * sizeof( Node * ) );
+
+	unsigned mask = size - 1;
+
+	for (int oldIndex = 0; oldIndex < oldSize; ++oldIndex)
+	{
+		Node * pNode = pOldTable[ oldIndex ];
+
+		if (pNode != NULL)
+		{
+			unsigned i = this->slot( pNode->ext );
+
+			while (pTable_[ i ] != NULL)
+			{
+				i = (i + 1) & mask;
+			}
+
+			pTable_[ i ] = pNode;
+		}
+	}
+}
+
+
+/**
+ *	This method adds a node to the open heap.
+ */
+template <class State, class GoalState>
+void IndexedAStar<State, GoalState>::push( Node * pNode )
+{
+	if (heapSize_ == heapCapacity_)
+	{
+		int capacity = heapCapacity_ ?
+			2 * heapCapacity_ : int( INITIAL_HEAP_CAPACITY );
+		Node ** pHeap = static_cast< Node ** >(
+			arena_.allocate( capacity * sizeof( Node * ) ) );
+
+		if (heapSize_ > 0)
+		{
+			memcpy( pHeap, pHeap_, heapSize_ * sizeof( Node * ) );
+		}
+
+		pHeap_ = pHeap;
+		heapCapacity_ = capacity;
+	}
+
+	pHeap_[ heapSize_ ] = pNode;
+	pNode->heapIndex = heapSize_;
+	++heapSize_;
+
+	this->siftUp( pNode->heapIndex );
+}
+
+
+/**
+ *	This method removes the open node with the smallest f from the heap.
+ */
+template <class State, class GoalState>
+typename IndexedAStar<State, GoalState>::Node *
+	IndexedAStar<State, GoalState>::pop()
+{
+	Node * pTop = pHeap_[ 0 ];
+	pTop->heapIndex = CLOSED;
+
+	--heapSize_;
+
+	if (heapSize_ > 0)
+	{
+		pHeap_[ 0 ] = pHeap_[ heapSize_ ];
+		pHeap_[ 0 ]->heapIndex = 0;
+		this->siftDown( 0 );
+	}
+
+	return pTop;
+}
+
+
+/**
+ *	This method moves the node at the given index of the heap towards the top
+ *	until its parent's f is no greater than its own. It is used when a node is
+ *	added or its f is lowered.
+ */
+template <class State, class GoalState>
+void IndexedAStar<State, GoalState>::siftUp( int index )
+{
+	Node * pNode = pHeap_[ index ];
+
+	while (index > 0)
+	{
+		int parent = (index - 1) / HEAP_ARITY;
+
+		if (pHeap_[ parent ]->f <= pNode->f)
+		{
+			break;
+		}
+
+		pHeap_[ index ] = pHeap_[ parent ];
+		pHeap_[ index ]->heapIndex = index;
+		index = parent;
+	}
+
+	pHeap_[ index ] = pNode;
+	pNode->heapIndex = index;
+}
+
+
+/**
+ *	This method moves the node at the given index of the heap towards the
+ *	bottom until none of its children has a smaller f.
+ */
+template <class State, class GoalState>
+void IndexedAStar<State, GoalState>::siftDown( int index )
+{
+	Node * pNode = pHeap_[ index ];
+
+	for (;;)
+	{
+		int firstChild = HEAP_ARITY * index + 1;
+
+		if (firstChild >= heapSize_)
+		{
+			break;
+		}
+
+		int lastChild = std::min( firstChild + HEAP_ARITY, heapSize_ );
+		int best = firstChild;
+
+		for (int child = firstChild + 1; child < lastChild; ++child)
+		{
+			if (pHeap_[ child ]->f < pHeap_[ best ]->f)
+			{
+				best = child;
+			}
+		}
+
+		if (pHeap_[ best ]->f >= pNode->f)
+		{
+			break;
+		}
+
+		pHeap_[ index ] = pHeap_[ best ];
+		pHeap_[ index ]->heapIndex = index;
+		index = best;
+	}
+
+	pHeap_[ index ] = pNode;
+	pNode->heapIndex = index;
+}
+
+
+/**
+ *	This method calls the destructors of the nodes. The states may hold
+ *	references that need to be released. Their memory stays in the arena.
+ */
+template <class State, class GoalState>
+void IndexedAStar<State, GoalState>::destroyNodes()
+{
+	if (pTable_ != NULL)
+	{
+		int size = 1 << tableBits_;
+
+		for (int i = 0; i < size; ++i)
+		{
+			if (pTable_[ i ] != NULL)
+			{
+				pTable_[ i ]->~Node();
+			}
+		}
+	}
+
+	numNodes_ = 0;
+	start_ = NULL;
+}
+
+// indexed_astar.ipp
@@ -21,8 +21,13 @@ DECLARE_DEBUG_COMPONENT2( "Waypoint", 0 )
 #include "chunk_waypoint_set.hpp"
 #include "common/chunk_portal.hpp"
 #include "astar.hpp"
+#include "indexed_astar.hpp"
 #include "chunk/chunk_space.hpp"
 #include "chunk/chunk.hpp"
+#include "cstdmf/cache.hpp"
+#include "cstdmf/timestamp.hpp"
+#include "cstdmf/watcher.hpp"
+#include <map>
 #include <sstream>
 
 
@@ -503,16 +508,23 @@ bool ChunkWaypointState::getAdjacency( int index, ChunkWaypointState & neigh,
 class NavigatorCache : public ReferenceCount
 {
 public:
-	const ChunkWaypointState * saveWayPath( AStar<ChunkWaypointState> & astar );
+	template <class ASTAR>
+	const ChunkWaypointState * saveWayPath( ASTAR & astar );
 
 	const ChunkWaypointState * findWayPath(
 		const ChunkWaypointState & src, const ChunkWaypointState & dst );
 
-	const ChunkWPSetState * saveWaySetPath( AStar<ChunkWPSetState> & astar );
+	template <class ASTAR>
+	const ChunkWPSetState * saveWaySetPath( ASTAR & astar );
 
 	const ChunkWPSetState * findWaySetPath(
 		const ChunkWPSetState & src, const ChunkWPSetState & dst );
 
+	const ChunkWaypointState * useWayPath(
+		const std::vector<ChunkWaypointState> & path );
+	const ChunkWPSetState * useWaySetPath(
+		const std::vector<ChunkWPSetState> & path );
+
 	int getWaySetPathSize() const;
 
 	// this may be necessary because different results will be obtained depending
@@ -526,6 +538,9 @@ public:
 	const std::vector<ChunkWaypointState>& wayPath() const
 		{ return wayPath_; }
 
+	const std::vector<ChunkWPSetState>& waySetPath() const
+		{ return waySetPath_; }
+
 	void passedShellBoundary( bool a )
 		{ passedShellBoundary_ = a; }
 
@@ -543,8 +558,8 @@ private:
  *  Both the source and destination (goal) are extracted from the
  *  search result in the given AStar object. (i.e. must be unspoilt)
  */
-const ChunkWaypointState * NavigatorCache::saveWayPath(
-	AStar<ChunkWaypointState> & astar )
+template <class ASTAR>
+const ChunkWaypointState * NavigatorCache::saveWayPath( ASTAR & astar )
 {
 	std::vector<const ChunkWaypointState *>		fwdPath;
 
@@ -638,8 +653,8 @@ const ChunkWaypointState * NavigatorCache::findWayPath(
  *  Both the source and destination (goal) are extracted from the
  *  search result in the given AStar object. (i.e. must be unspoilt)
  */
-const ChunkWPSetState * NavigatorCache::saveWaySetPath(
-	AStar<ChunkWPSetState> & astar )
+template <class ASTAR>
+const ChunkWPSetState * NavigatorCache::saveWaySetPath( ASTAR & astar )
 {
 	std::vector<const ChunkWPSetState *>		fwdPath;
 
@@ -710,6 +725,33 @@ const ChunkWPSetState * NavigatorCache::findWaySetPath(
 	return NULL;
 }
 
+/**
+ *  This method makes the given waypoint path, found by another Navigator,
+ *  the current one.
+ */
+const ChunkWaypointState * NavigatorCache::useWayPath(
+	const std::vector<ChunkWaypointState> & path )
+{
+	wayPath_ = path;
+
+	MF_ASSERT_DEBUG( wayPath_.size() >= 2 );
+	return &wayPath_[wayPath_.size()-2];
+}
+
+/**
+ *  This method makes the given waypoint set path, found by another
+ *  Navigator, the current one.
+ */
+const ChunkWPSetState * NavigatorCache::useWaySetPath(
+	const std::vector<ChunkWPSetState> & path )
+{
+	waySetPath_ = path;
+	passedShellBoundary_ = false;
+
+	MF_ASSERT_DEBUG( waySetPath_.size() >= 2 );
+	return &waySetPath_[waySetPath_.size()-2];
+}
+
 /**
  *  This method finds a waypoint path
  */
@@ -718,6 +760,514 @@ int NavigatorCache::getWaySetPathSize() const
 	return waySetPath_.size();
 }
 
+
+// -----------------------------------------------------------------------------
+// Section: SharedNavigatorCache
+// -----------------------------------------------------------------------------
+
+/**
+ *  This class caches the paths found by all Navigators, so that entities
+ *  heading the same way do not each repeat the same search. It is only
+ *  consulted when a Navigator's own cache misses.
+ *
+ *  The paths are sharded by space, and each shard holds a bounded number of
+ *  paths in least recently used order. A shard is dropped whenever a waypoint
+ *  set in its space is bound or tossed, since the connections between the
+ *  sets may have changed.
+ *
+ *  Waypoint set paths that pass through a shell boundary are not shared, as
+ *  they are not reused by a single Navigator either.
+ */
+class SharedNavigatorCache
+{
+public:
+	~SharedNavigatorCache();
+
+	static SharedNavigatorCache & instance();
+
+	const std::vector<ChunkWaypointState> * findWayPath(
+		const ChunkWaypointState & src, const ChunkWaypointState & dst );
+	void saveWayPath( const std::vector<ChunkWaypointState> & path );
+
+	const std::vector<ChunkWPSetState> * findWaySetPath(
+		const ChunkWPSetState & src, const ChunkWPSetState & dst );
+	void saveWaySetPath( const std::vector<ChunkWPSetState> & path );
+
+	void invalidate( ChunkSpace * pSpace );
+
+	static void addWatchers();
+
+	static uint32 s_numSearches;
+	static uint32 s_numExpansions;
+
+private:
+	/**
+	 *  This structure is the key of a cached path.
+	 */
+	struct PathKey
+	{
+		const ChunkWaypointSet *	pSrcSet;
+		int							srcWaypoint;
+		const ChunkWaypointSet *	pDstSet;
+		int							dstWaypoint;
+		float						girth;
+		bool						blockNonPermissive;
+
+		bool operator<( const PathKey & other ) const;
+	};
+
+	typedef Cache< PathKey, std::vector<ChunkWaypointState> > WayPaths;
+	typedef Cache< PathKey, std::vector<ChunkWPSetState> > WaySetPaths;
+
+	/**
+	 *  This structure holds the cached paths of a single space.
+	 */
+	struct Shard
+	{
+		Shard( unsigned int maxSize ) :
+			wayPaths( maxSize ),
+			waySetPaths( maxSize )
+		{}
+
+		WayPaths	wayPaths;
+		WaySetPaths	waySetPaths;
+	};
+
+	typedef std::map< ChunkSpace *, Shard * > Shards;
+
+	static PathKey wayKey( const NavLoc & src, const NavLoc & dst );
+	static PathKey waySetKey( const ChunkWaypointSetPtr & pSrc,
+		const ChunkWaypointSetPtr & pDst );
+	static ChunkSpace * spaceOf( const ChunkWaypointSetPtr & pSet );
+
+	Shard * findShard( ChunkSpace * pSpace, bool shouldCreate );
+
+	static float hitRatio();
+
+	Shards shards_;
+
+	static int s_maxPathsPerSpace;
+
+	static uint32 s_numHits;
+	static uint32 s_numMisses;
+	static uint32 s_numInvalidations;
+};
+
+int SharedNavigatorCache::s_maxPathsPerSpace = 256;
+uint32 SharedNavigatorCache::s_numSearches = 0;
+uint32 SharedNavigatorCache::s_numExpansions = 0;
+uint32 SharedNavigatorCache::s_numHits = 0;
+uint32 SharedNavigatorCache::s_numMisses = 0;
+uint32 SharedNavigatorCache::s_numInvalidations = 0;
+
+
+/**
+ *  Destructor.
+ */
+SharedNavigatorCache::~SharedNavigatorCache()
+{
+	for (Shards::iterator iter = shards_.begin(); iter != shards_.end(); ++iter)
+	{
+		delete iter->second;
+	}
+}
+
+
+/**
+ *  This static method returns the singleton instance of this class.
+ */
+SharedNavigatorCache & SharedNavigatorCache::instance()
+{
+	static SharedNavigatorCache s_instance;
+	return s_instance;
+}
+
+
+/**
+ *  This method orders keys for the LRU caches.
+ */
+bool SharedNavigatorCache::PathKey::operator<( const PathKey & other ) const
+{
+	if (pSrcSet != other.pSrcSet) return pSrcSet < other.pSrcSet;
+	if (pDstSet != other.pDstSet) return pDstSet < other.pDstSet;
+	if (srcWaypoint != other.srcWaypoint)
+		return srcWaypoint < other.srcWaypoint;
+	if (dstWaypoint != other.dstWaypoint)
+		return dstWaypoint < other.dstWaypoint;
+	if (girth != other.girth) return girth < other.girth;
+	return blockNonPermissive < other.blockNonPermissive;
+}
+
+
+/**
+ *  This method returns the key for a waypoint path.
+ */
+SharedNavigatorCache::PathKey SharedNavigatorCache::wayKey(
+	const NavLoc & src, const NavLoc & dst )
+{
+	PathKey key;
+	key.pSrcSet = src.set().getObject();
+	key.srcWaypoint = src.waypoint();
+	key.pDstSet = dst.set().getObject();
+	key.dstWaypoint = dst.waypoint();
+	key.girth = src.set()->girth();
+	key.blockNonPermissive = false;
+	return key;
+}
+
+
+/**
+ *  This method returns the key for a waypoint set path. These depend on
+ *  ChunkWPSetState::blockNonPermissive as well as the sets.
+ */
+SharedNavigatorCache::PathKey SharedNavigatorCache::waySetKey(
+	const ChunkWaypointSetPtr & pSrc, const ChunkWaypointSetPtr & pDst )
+{
+	PathKey key;
+	key.pSrcSet = pSrc.getObject();
+	key.srcWaypoint = -1;
+	key.pDstSet = pDst.getObject();
+	key.dstWaypoint = -1;
+	key.girth = pSrc->girth();
+	key.blockNonPermissive = ChunkWPSetState::blockNonPermissive;
+	return key;
+}
+
+
+/**
+ *  This method returns the space that the given set is in, or NULL if it is
+ *  not in a chunk.
+ */
+ChunkSpace * SharedNavigatorCache::spaceOf( const ChunkWaypointSetPtr & pSet )
+{
+	return (pSet && pSet->chunk()) ? pSet->chunk()->space() : NULL;
+}
+
+
+/**
+ *  This method returns the shard for the given space.
+ */
+SharedNavigatorCache::Shard * SharedNavigatorCache::findShard(
+	ChunkSpace * pSpace, bool shouldCreate )
+{
+	if ((pSpace == NULL) || (s_maxPathsPerSpace <= 0))
+	{
+		return NULL;
+	}
+
+	Shards::iterator iter = shards_.find( pSpace );
+
+	if (iter != shards_.end())
+	{
+		return iter->second;
+	}
+
+	if (!shouldCreate)
+	{
+		return NULL;
+	}
+
+	Shard * pShard = new Shard( s_maxPathsPerSpace );
+	shards_[ pSpace ] = pShard;
+
+	return pShard;
+}
+
+
+/**
+ *  This method returns the cached waypoint path from src to dst, or NULL if
+ *  there is none.
+ */
+const std::vector<ChunkWaypointState> * SharedNavigatorCache::findWayPath(
+	const ChunkWaypointState & src, const ChunkWaypointState & dst )
+{
+	Shard * pShard = this->findShard( spaceOf( src.navLoc().set() ), false );
+
+	const std::vector<ChunkWaypointState> * pPath = pShard ?
+		pShard->wayPaths.find( wayKey( src.navLoc(), dst.navLoc() ) ) : NULL;
+
+	if (pPath)
+		++s_numHits;
+	else
+		++s_numMisses;
+
+	return pPath;
+}
+
+
+/**
+ *  This method adds a waypoint path found by a Navigator. The path is in
+ *  reverse order, as NavigatorCache stores it.
+ */
+void SharedNavigatorCache::saveWayPath(
+	const std::vector<ChunkWaypointState> & path )
+{
+	if (path.size() < 2) return;
+
+	const NavLoc & src = path.back().navLoc();
+	Shard * pShard = this->findShard( spaceOf( src.set() ), true );
+
+	if (pShard)
+	{
+		pShard->wayPaths.insert( wayKey( src, path.front().navLoc() ), path );
+	}
+}
+
+
+/**
+ *  This method returns the cached waypoint set path from src to dst, or NULL
+ *  if there is none.
+ */
+const std::vector<ChunkWPSetState> * SharedNavigatorCache::findWaySetPath(
+	const ChunkWPSetState & src, const ChunkWPSetState & dst )
+{
+	Shard * pShard = this->findShard( spaceOf( src.set() ), false );
+
+	const std::vector<ChunkWPSetState> * pPath = pShard ?
+		pShard->waySetPaths.find( waySetKey( src.set(), dst.set() ) ) : NULL;
+
+	if (pPath)
+		++s_numHits;
+	else
+		++s_numMisses;
+
+	return pPath;
+}
+
+
+/**
+ *  This method adds a waypoint set path found by a Navigator. The path is in
+ *  reverse order, as NavigatorCache stores it.
+ */
+void SharedNavigatorCache::saveWaySetPath(
+	const std::vector<ChunkWPSetState> & path )
+{
+	if (path.size() < 2) return;
+
+	ChunkWaypointSetPtr pSrc = path.back().set();
+	Shard * pShard = this->findShard( spaceOf( pSrc ), true );
+
+	if (pShard)
+	{
+		pShard->waySetPaths.insert(
+			waySetKey( pSrc, path.front().set() ), path );
+	}
+}
+
+
+/**
+ *  This method drops all paths in the given space.
+ */
+void SharedNavigatorCache::invalidate( ChunkSpace * pSpace )
+{
+	Shards::iterator iter = shards_.find( pSpace );
+
+	if (iter != shards_.end())
+	{
+		delete iter->second;
+		shards_.erase( iter );
+		++s_numInvalidations;
+	}
+}
+
+
+/**
+ *  This method returns the fraction of lookups that found a path.
+ */
+float SharedNavigatorCache::hitRatio()
+{
+	uint32 numLookups = s_numHits + s_numMisses;
+
+	return (numLookups > 0) ? float( s_numHits ) / float( numLookups ) : 0.f;
+}
+
+
+/**
+ *  This static method adds the watchers associated with this class.
+ */
+void SharedNavigatorCache::addWatchers()
+{
+	MF_WATCH( "navigation/pathCache/maxPathsPerSpace", s_maxPathsPerSpace,
+		Watcher::WT_READ_WRITE,
+		"The number of paths of each kind cached for each space. "
+			"0 disables the cache. Applies to spaces cached afterwards" );
+	MF_WATCH( "navigation/pathCache/hits", s_numHits, Watcher::WT_READ_ONLY,
+		"The number of paths found in the shared path cache" );
+	MF_WATCH( "navigation/pathCache/misses", s_numMisses,
+		Watcher::WT_READ_ONLY,
+		"The number of paths not found in the shared path cache" );
+	MF_WATCH( "navigation/pathCache/hitRatio", &SharedNavigatorCache::hitRatio );
+	MF_WATCH( "navigation/pathCache/invalidations", s_numInvalidations,
+		Watcher::WT_READ_ONLY,
+		"The number of times the paths of a space were dropped because "
+			"its waypoint sets were bound or tossed" );
+	MF_WATCH( "navigation/astar/searches", s_numSearches,
+		Watcher::WT_READ_ONLY, "The number of A* searches" );
+	MF_WATCH( "navigation/astar/expansions", s_numExpansions,
+		Watcher::WT_READ_ONLY,
+		"The number of states expanded by all A* searches" );
+}
+
+// -----------------------------------------------------------------------------
+// Section: AStarComparison
+// -----------------------------------------------------------------------------
+
+/**
+ *  This class does the A* searches for Navigators. When enabled, it also
+ *  repeats each search with the original AStar engine, and keeps the number
+ *  of states each engine expanded and the time each took. This compares the
+ *  two on the waypoints of real spaces.
+ */
+class AStarComparison
+{
+public:
+	template <class STATE>
+	static bool search( IndexedAStar<STATE> & astar,
+		const STATE & src, const STATE & dst, float maxDistance );
+
+	static void addWatchers();
+
+private:
+	static float indexedExpansionsPerPath();
+	static float legacyExpansionsPerPath();
+	static float indexedMicrosecondsPerPath();
+	static float legacyMicrosecondsPerPath();
+
+	static float perPath( double total );
+
+	static bool s_isEnabled;
+
+	static uint32 s_numSearches;
+	static uint32 s_numMismatches;
+	static double s_indexedExpansions;
+	static double s_legacyExpansions;
+	static uint64 s_indexedStamps;
+	static uint64 s_legacyStamps;
+};
+
+bool AStarComparison::s_isEnabled = false;
+uint32 AStarComparison::s_numSearches = 0;
+uint32 AStarComparison::s_numMismatches = 0;
+double AStarComparison::s_indexedExpansions = 0.0;
+double AStarComparison::s_legacyExpansions = 0.0;
+uint64 AStarComparison::s_indexedStamps = 0;
+uint64 AStarComparison::s_legacyStamps = 0;
+
+
+/**
+ *  This static method searches for a path from src to dst.
+ *
+ *  @return True if a path was found. It is then in astar.
+ */
+template <class STATE>
+bool AStarComparison::search( IndexedAStar<STATE> & astar,
+	const STATE & src, const STATE & dst, float maxDistance )
+{
+	if (!s_isEnabled)
+	{
+		return astar.search( src, dst, maxDistance );
+	}
+
+	uint64 startTime = timestamp();
+	bool found = astar.search( src, dst, maxDistance );
+	uint64 indexedTime = timestamp() - startTime;
+
+	AStar<STATE> legacy;
+
+	startTime = timestamp();
+	bool legacyFound = legacy.search( src, dst, maxDistance );
+	uint64 legacyTime = timestamp() - startTime;
+
+	++s_numSearches;
+	s_indexedExpansions += astar.numExpanded();
+	s_legacyExpansions += legacy.numExpanded();
+	s_indexedStamps += indexedTime;
+	s_legacyStamps += legacyTime;
+
+	if (found != legacyFound)
+	{
+		++s_numMismatches;
+	}
+
+	return found;
+}
+
+
+/**
+ *  This static method returns the given total divided by the number of
+ *  searches compared.
+ */
+float AStarComparison::perPath( double total )
+{
+	return (s_numSearches > 0) ? float( total / s_numSearches ) : 0.f;
+}
+
+
+/**
+ *  This static method returns the average number of states the indexed
+ *  engine expanded for each search compared.
+ */
+float AStarComparison::indexedExpansionsPerPath()
+{
+	return perPath( s_indexedExpansions );
+}
+
+
+/**
+ *  This static method returns the average number of states the original
+ *  engine expanded for each search compared.
+ */
+float AStarComparison::legacyExpansionsPerPath()
+{
+	return perPath( s_legacyExpansions );
+}
+
+
+/**
+ *  This static method returns the average time in microseconds the indexed
+ *  engine took for each search compared.
+ */
+float AStarComparison::indexedMicrosecondsPerPath()
+{
+	return perPath( s_indexedStamps * 1000000.0 / stampsPerSecondD() );
+}
+
+
+/**
+ *  This static method returns the average time in microseconds the original
+ *  engine took for each search compared.
+ */
+float AStarComparison::legacyMicrosecondsPerPath()
+{
+	return perPath( s_legacyStamps * 1000000.0 / stampsPerSecondD() );
+}
+
+
+/**
+ *  This static method adds the watchers associated with this class.
+ */
+void AStarComparison::addWatchers()
+{
+	MF_WATCH( "navigation/astar/compareWithLegacy", s_isEnabled,
+		Watcher::WT_READ_WRITE,
+		"Whether each search is repeated with the original A* engine "
+			"to compare the two" );
+	MF_WATCH( "navigation/astar/comparison/searches", s_numSearches,
+		Watcher::WT_READ_ONLY,
+		"The number of searches done with both engines" );
+	MF_WATCH( "navigation/astar/comparison/mismatches", s_numMismatches,
+		Watcher::WT_READ_ONLY,
+		"The number of searches where only one engine found a path" );
+	MF_WATCH( "navigation/astar/comparison/indexed/expansionsPerPath",
+		&AStarComparison::indexedExpansionsPerPath );
+	MF_WATCH( "navigation/astar/comparison/legacy/expansionsPerPath",
+		&AStarComparison::legacyExpansionsPerPath );
+	MF_WATCH( "navigation/astar/comparison/indexed/microsecondsPerPath",
+		&AStarComparison::indexedMicrosecondsPerPath );
+	MF_WATCH( "navigation/astar/comparison/legacy/microsecondsPerPath",
+		&AStarComparison::legacyMicrosecondsPerPath );
+}
+
 // -----------------------------------------------------------------------------
 // Section: NavLoc
 // -----------------------------------------------------------------------------
@@ -900,6 +1450,47 @@ std::string NavLoc::desc() const
 // Section: Navigator
 // -----------------------------------------------------------------------------
 
+namespace
+{
+
+/**
+ *	This function looks for a waypoint path in the shared cache, and makes it
+ *	the Navigator's current path if there is one.
+ */
+const ChunkWaypointState * findSharedWayPath( NavigatorCache & cache,
+	const ChunkWaypointState & src, const ChunkWaypointState & dst )
+{
+	const std::vector<ChunkWaypointState> * pSharedPath =
+		SharedNavigatorCache::instance().findWayPath( src, dst );
+
+	return pSharedPath ? cache.useWayPath( *pSharedPath ) : NULL;
+}
+
+/**
+ *	This function saves the result of a waypoint search in the Navigator's
+ *	cache and the shared cache.
+ */
+const ChunkWaypointState * saveWayPath( NavigatorCache & cache,
+	IndexedAStar<ChunkWaypointState> & astar )
+{
+	const ChunkWaypointState * pWayState = cache.saveWayPath( astar );
+	SharedNavigatorCache::instance().saveWayPath( cache.wayPath() );
+
+	return pWayState;
+}
+
+/**
+ *	This function adds an A* search to the statistics.
+ */
+template <class STATE>
+void countSearch( const IndexedAStar<STATE> & astar )
+{
+	++SharedNavigatorCache::s_numSearches;
+	SharedNavigatorCache::s_numExpansions += astar.numExpanded();
+}
+
+}
+
 /**
  *	Constructor
  */
@@ -915,6 +1506,25 @@ Navigator::~Navigator()
 {
 }
 
+/**
+ *	This static method adds the watchers for the path cache shared by all
+ *	Navigators, and for the A* searches.
+ */
+void Navigator::addWatchers()
+{
+	SharedNavigatorCache::addWatchers();
+	AStarComparison::addWatchers();
+}
+
+/**
+ *	This static method drops the shared paths in the given space. It should
+ *	be called whenever a waypoint set in the space is bound or tossed.
+ */
+void Navigator::invalidatePathCache( ChunkSpace * pSpace )
+{
+	SharedNavigatorCache::instance().invalidate( pSpace );
+}
+
 void Navigator::clearWPSetCache()
 {
 	if (pCache_)
@@ -967,17 +1577,23 @@ bool Navigator::findPath( const NavLoc & src, const NavLoc & dst, float maxDista
 		const ChunkWaypointState * pWayState =
 			pCache_->findWayPath( srcState, dstState );
 		if (pWayState == NULL)
+		{
+			pWayState = findSharedWayPath( *pCache_, srcState, dstState );
+		}
+		if (pWayState == NULL)
 		{
 			// do an A-Star search amongst the waypoints then
-			AStar<ChunkWaypointState> astar;
+			IndexedAStar<ChunkWaypointState> astar;
 
-			if (astar.search( srcState, dstState, maxDistanceInSet ))
+			if (AStarComparison::search( astar,
+					srcState, dstState, maxDistanceInSet ))
 			{
-				pWayState = pCache_->saveWayPath( astar );
+				pWayState = saveWayPath( *pCache_, astar );
 				//DEBUG_MSG( "Navigator::findPath: "
 				//		"Next waypoint %d found through a new search\n",
 				//	pWayState->navLoc().waypoint() );
 			}
+			countSearch( astar );
 			if ( astar.infiniteLoopProblem )
 			{
 				ERROR_MSG( "Navigator::findPath: Infinite Loop problem "
@@ -1014,15 +1630,36 @@ bool Navigator::findPath( const NavLoc & src, const NavLoc & dst, float maxDista
 
 		if (pWaySetState == NULL)
 		{
-			// do an A-Star search amongst the waypoint sets then
 			ChunkWPSetState::blockNonPermissive = blockNonPermissive;
-			AStar<ChunkWPSetState> astarSet;
-			if (astarSet.search( srcSetState, dstSetState, maxDistance ))
+
+			const std::vector<ChunkWPSetState> * pSharedPath =
+				SharedNavigatorCache::instance().findWaySetPath(
+					srcSetState, dstSetState );
+
+			if (pSharedPath != NULL)
+			{
+				pWaySetState = pCache_->useWaySetPath( *pSharedPath );
+			}
+		}
+
+		if (pWaySetState == NULL)
+		{
+			// do an A-Star search amongst the waypoint sets then
+			IndexedAStar<ChunkWPSetState> astarSet;
+			if (AStarComparison::search( astarSet,
+					srcSetState, dstSetState, maxDistance ))
 			{
 				pWaySetState = pCache_->saveWaySetPath( astarSet );
+
+				if (!pCache_->passedShellBoundary())
+				{
+					SharedNavigatorCache::instance().saveWaySetPath(
+						pCache_->waySetPath() );
+				}
 				//DEBUG_MSG( "Next waypoint set 0x%08X found through "
 				//	"a new search\n", &*pWaySetState->set() );
 			}
+			countSearch( astarSet );
 			if ( astarSet.infiniteLoopProblem )
 			{
 				ERROR_MSG( "Navigator::findPath: Infinite Loop problem "
@@ -1046,15 +1683,21 @@ bool Navigator::findPath( const NavLoc & src, const NavLoc & dst, float maxDista
 			const ChunkWaypointState * pWayState =
 				pCache_->findWayPath( srcState, dstState );
 			if (pWayState == NULL)
+			{
+				pWayState = findSharedWayPath( *pCache_, srcState, dstState );
+			}
+			if (pWayState == NULL)
 			{
 				// do the A-Star waypoint search then
-				AStar<ChunkWaypointState> astar;
-				if (astar.search( srcState, dstState, maxDistanceInSet ))
+				IndexedAStar<ChunkWaypointState> astar;
+				if (AStarComparison::search( astar,
+						srcState, dstState, maxDistanceInSet ))
 				{
-					pWayState = pCache_->saveWayPath( astar );
+					pWayState = saveWayPath( *pCache_, astar );
 					//DEBUG_MSG( "Next ulterior waypoint %d found through "
 					//	"a new search\n", pWayState->navLoc().waypoint() );
 				}
+				countSearch( astar );
 				if ( astar.infiniteLoopProblem )
 				{
 					ERROR_MSG( "Navigator::findPath: Infinite Loop problem "
@@ -64,7 +64,8 @@ typedef SmartPointer<NavigatorCache> NavigatorCachePtr;
 /**
  *	This class guides vessels through the treacherous domain of chunk
  *	space navigation. Each instance caches recent data so similar searches
- *	can reuse previous effort.
+ *	can reuse previous effort. Paths are also shared between instances,
+ *	through a cache for each space.
  */
 class Navigator
 {
@@ -90,6 +91,9 @@ public:
 	static void astarSearchTimeLimit( float seconds );
 	static float astarSearchTimeLimit();
 
+	static void addWatchers();
+	static void invalidatePathCache( ChunkSpace * pSpace );
+
 private:
 	Navigator( const Navigator & other );
 	Navigator & operator = ( const Navigator & other );